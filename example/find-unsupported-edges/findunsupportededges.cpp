@@ -24,11 +24,13 @@
 #include <cassert>
 #include "ncl/nxsdefs.h"
 #include "ncl/nxstreesblock.h"
+#include "ncl/nxslcaindex.h"
 #include <cstdint>
 
 using namespace std;
 long gStrictLevel = 2;
 bool gVerbose = false;
+NxsLCAIndex gRefLCAIndex; // MRCA queries on the reference tree (gRefTree)
 void processContent(PublicNexusReader & nexusReader, ostream *out);
 
 bool newTreeHook(NxsFullTreeDescription &, void *, NxsTreesBlock *);
@@ -124,38 +126,20 @@ void writeSubtreeNewickOTTIDs(ostream &out, const NxsSimpleNode * node, const ma
 
 const NxsSimpleNode * findMRCAFromIDSet(const map<long, const NxsSimpleNode *> & ref,
 	                           			const set<long> & idSet, long trigger) {
-	map<const NxsSimpleNode *, unsigned int> n2c;
-	long shortestPathLen = -1;
-	const NxsSimpleNode * shortestPathNode = 0;
+	vector<unsigned> nodeIndices;
+	nodeIndices.reserve(idSet.size());
 	for (set<long>::const_iterator toIt = idSet.begin(); toIt != idSet.end(); ++toIt) {
-		const NxsSimpleNode * nd = 0;
 		map<long, const NxsSimpleNode *>::const_iterator rIt = ref.find(*toIt);
 		if (rIt == ref.end()) {
 			cerr << "tip " << *toIt << " a descendant of " << trigger << " not found.\n";
 			assert(false);
 		}
-		nd = rIt->second;
-		long currPathLen = 0;
-		while (nd != 0) {
-			n2c[nd] += 1;
-			currPathLen += 1;
-			nd = nd->GetEdgeToParentRef().GetParent();
-		}
-		if (shortestPathLen < 0 || currPathLen < shortestPathLen) {
-			shortestPathLen = currPathLen;
-			shortestPathNode = rIt->second;
-		}
-	}
-	const unsigned nTips = idSet.size();
-	const NxsSimpleNode * cn = shortestPathNode;
-	while (cn != 0) {
-		if (n2c[cn] == nTips) {
-			return cn;
-		}
-		cn = cn->GetEdgeToParentRef().GetParent();
+		const unsigned ind = gRefLCAIndex.GetNodeIndex(rIt->second);
+		assert(ind != UINT_MAX);
+		nodeIndices.push_back(ind);
 	}
-	assert(false);
-	return 0L;
+	assert(!nodeIndices.empty());
+	return gRefLCAIndex.GetNode(gRefLCAIndex.GetMRCAIndex(nodeIndices));
 }
 
 void writeSet(std::ostream & out, const char *indent, const set<long> &fir, const char * sep) {
@@ -451,19 +435,12 @@ void processTaxonomyTree(const NxsTaxaBlockAPI * tb, const NxsSimpleTree * tree)
 	}
 }
 
-//@recursive!
 void fillTipOTTIDs(const map<long, const NxsSimpleNode *> &taxonomy, long ottID, set<long> & tipOTTIDs) {
 	map<long, const NxsSimpleNode *>::const_iterator tnIt = taxonomy.find(ottID);
 	assert(tnIt != taxonomy.end());
-	const NxsSimpleNode * tn = tnIt->second;
-	vector<NxsSimpleNode *> children = tn->GetChildren();
-	const unsigned outDegree = children.size();
-	if (outDegree == 0) {
-		tipOTTIDs.insert(gTaxNode2ottID[tn]);
-	} else {
-		for (vector<NxsSimpleNode *>::const_iterator cIt = children.begin(); cIt != children.end(); ++cIt) {
-			long ct = gTaxNode2ottID[*cIt];
-			fillTipOTTIDs(taxonomy, ct, tipOTTIDs);
+	for (NxsSimpleNodeWalker w(tnIt->second, NxsSimpleNodeWalker::PREORDER); w.GetNode() != 0; w.Next()) {
+		if (w.GetNode()->IsTip()) {
+			tipOTTIDs.insert(gTaxNode2ottID[w.GetNode()]);
 		}
 	}
 }
@@ -710,6 +687,7 @@ bool newTreeHook(NxsFullTreeDescription &ftd, void * arg, NxsTreesBlock *treesB)
 	gTabooLeaf.clear();
 	if (gRefTree == 0) {
 		gRefTree = nst;
+		gRefLCAIndex.Build(*nst);
 		processRefTree(taxa, nst);
 	} else if (gTaxonTree == 0) {
 		gTaxonTree = nst;
@@ -49,11 +49,13 @@
 #include "ncl/nxsblock.h"
 #include "ncl/nxspublicblocks.h"
 #include "ncl/nxsmultiformat.h"
+#include "ncl/nxsparallel.h"
 #include "normalizer.h"
 using namespace std;
 
 void writeAsNexml(PublicNexusReader & nexusReader, ostream & os, TranslatingConventions & transConv);
 extern bool gQuietMode;
+extern long gNumThreads;
 
 
 
@@ -463,6 +465,140 @@ void writeUnalignedBlockToStream(
 		}
 }
 
+/* Fills `storedSeqs` with the rows of a characters block (as strings), for writing interleaved pages.*/
+class StoreMatrixRowsWorker
+{
+	public:
+		StoreMatrixRowsWorker(const NxsCharactersBlock & charsBlock, std::vector<std::string> & seqs)
+			:cb(charsBlock),
+			storedSeqs(seqs)
+			{}
+		void operator()(unsigned workerIndex, unsigned numWorkers)
+			{
+			const unsigned nt = storedSeqs.size();
+			for (unsigned i = workerIndex; i < nt; i += numWorkers)
+				storedSeqs[i] = cb.GetMatrixRowAsStr(i);
+			}
+	private:
+		const NxsCharactersBlock & cb;
+		std::vector<std::string> & storedSeqs;
+};
+
+/* Formats the rows of a characters block for writeCharactersBlockToStream.
+	Chunk c holds rows [c*rowsPerChunk, (c+1)*rowsPerChunk) of the matrix. If `storedSeqs`
+	is not NULL, the rows are written as interleaved pages and chunk c holds those
+	rows of page c/chunksPerPage.
+*/
+class CharactersRowChunkFormatter
+{
+	public:
+		CharactersRowChunkFormatter(const NxsCharactersBlock & charsBlock,
+									const std::vector<std::string> & names,
+									MultiFormatReader::DataFormatType fmt,
+									long pageLen,
+									unsigned seqStartCol,
+									const std::vector<std::string> * seqs)
+			:cb(charsBlock),
+			taxaNames(names),
+			f(fmt),
+			interleaveLen(pageLen),
+			seqStartColumn(seqStartCol),
+			nt(names.size()),
+			nc(charsBlock.GetNChar()),
+			storedSeqs(seqs)
+			{
+			// aim for chunks of roughly 64KB of output, so that the threads have similar amounts of work
+			const unsigned charsPerRow = (storedSeqs && (unsigned)interleaveLen < nc ? (unsigned)interleaveLen : nc);
+			rowsPerChunk = 65536/(charsPerRow + 1);
+			if (rowsPerChunk == 0)
+				rowsPerChunk = 1;
+			chunksPerPage = (nt + rowsPerChunk - 1)/rowsPerChunk;
+			if (chunksPerPage == 0)
+				chunksPerPage = 1;
+			}
+		unsigned GetNumChunks() const
+			{
+			if (storedSeqs == 0L || nc <= (unsigned)interleaveLen)
+				return chunksPerPage;
+			const unsigned nPages = (nc + (unsigned)interleaveLen - 1)/(unsigned)interleaveLen;
+			return nPages*chunksPerPage;
+			}
+		void operator()(unsigned chunkIndex, std::string & buffer) const
+			{
+			const unsigned page = chunkIndex/chunksPerPage;
+			const unsigned firstRow = (chunkIndex - page*chunksPerPage)*rowsPerChunk;
+			const unsigned endRow = (firstRow + rowsPerChunk > nt ? nt : firstRow + rowsPerChunk);
+			if (storedSeqs)
+				appendPage(buffer, page, firstRow, endRow);
+			else
+				{
+				for (unsigned i = firstRow; i < endRow; ++i)
+					appendRow(buffer, i);
+				}
+			}
+	private:
+		void appendName(std::string & buffer, unsigned i) const
+			{
+			const std::string & name = taxaNames[i];
+			if (IsFastaType(f))
+				{
+				buffer.push_back('>');
+				buffer.append(name);
+				buffer.push_back('\n');
+				return;
+				}
+			buffer.append(name);
+			if (IsRelaxedPhylipType(f))
+				buffer.append(seqStartColumn - name.length(), ' ');
+			}
+		void appendRow(std::string & buffer, unsigned i) const
+			{
+			appendName(buffer, i);
+			const std::string seq = cb.GetMatrixRowAsStr(i);
+			if (interleaveLen < 1)
+				{
+				buffer.append(seq);
+				buffer.push_back('\n');
+				return;
+				}
+			// wrapping at interleaveLen
+			for (unsigned currIndex = 0; currIndex == 0 || currIndex < nc; currIndex += (unsigned)interleaveLen)
+				{
+				const unsigned nCharsToWrite = ((nc - currIndex) > (unsigned)interleaveLen ? (unsigned)interleaveLen : (nc - currIndex));
+				buffer.append(seq, currIndex, nCharsToWrite);
+				buffer.push_back('\n');
+				}
+			}
+		void appendPage(std::string & buffer, unsigned page, unsigned firstRow, unsigned endRow) const
+			{
+			const unsigned currIndex = page*(unsigned)interleaveLen;
+			const unsigned nCharsToWrite = ((nc - currIndex) > (unsigned)interleaveLen ? (unsigned)interleaveLen : (nc - currIndex));
+			if (page > 0 && firstRow == 0)
+				buffer.push_back('\n');
+			for (unsigned i = firstRow; i < endRow; ++i)
+				{
+				if (page == 0)
+					appendName(buffer, i);
+				buffer.append((*storedSeqs)[i], currIndex, nCharsToWrite);
+				buffer.push_back('\n');
+				}
+			}
+
+		const NxsCharactersBlock & cb;
+		const std::vector<std::string> & taxaNames;
+		MultiFormatReader::DataFormatType f;
+		long interleaveLen;
+		unsigned seqStartColumn;
+		unsigned nt;
+		unsigned nc;
+		const std::vector<std::string> * storedSeqs;
+		unsigned rowsPerChunk;
+		unsigned chunksPerPage;
+};
+
+/* Writes the rows of `cb` in a PHYLIP or FASTA format. The rows are formatted
+	by gNumThreads threads (and written in order).
+*/
 void writeCharactersBlockToStream(
   const NxsCharactersBlock & cb,
   ostream & outf,
@@ -472,7 +608,7 @@ void writeCharactersBlockToStream(
 {
 	const unsigned nt = taxaNames.size();
 	const unsigned nc = cb.GetNChar();
-	unsigned nCharsToWrite;
+	const unsigned numThreads = (gNumThreads < 0 ? 1 : (unsigned) gNumThreads);
 	unsigned seqStartColumn = 0;
 
 	if (IsRelaxedPhylipType(f))
@@ -486,104 +622,30 @@ void writeCharactersBlockToStream(
 		seqStartColumn += 1;
 		}
 
-
+	std::vector<std::string> storedSeqs;
+	const std::vector<std::string> * pagesFrom = 0L;
 	if (IsPhylipType(f) || IsRelaxedPhylipType(f))
 		{
-		std::string sep;
-
 		outf << nt << ' ' << nc << '\n';
-
 		if (IsInterleaveType(f) && interleaveLen > 0)
 			{
-			std::vector<std::string> storedSeqs;
-			storedSeqs.reserve(nt);
-			std::string *sp;
-			nCharsToWrite = (nc > (unsigned) interleaveLen ? (unsigned)interleaveLen : nc);
-			for (unsigned i = 0; i < nt; ++i)
-				{
-				const std::string & name = taxaNames[i];
-				storedSeqs.push_back(cb.GetMatrixRowAsStr(i));
-				sp = &(storedSeqs[i]);
-				if (IsRelaxedPhylipType(f))
-					{
-					sep.clear();
-					sep.append(seqStartColumn - name.length(), ' ');
-					}
-				outf << name << sep << sp->substr(0, nCharsToWrite) << '\n';
-				}
-
-			for (unsigned currIndex = (unsigned)interleaveLen; currIndex < nc; currIndex += (unsigned)interleaveLen)
-				{
-				outf << '\n';
-				nCharsToWrite = ((nc - currIndex) > (unsigned)interleaveLen ? (unsigned)interleaveLen : (nc - currIndex));
-				for (unsigned i = 0; i < nt; ++i)
-					{
-					sp = &(storedSeqs[i]);
-					outf << sp->substr(currIndex, nCharsToWrite) << '\n';
-					}
-				}
-			}
-		else
-			{
-			if (interleaveLen > 0)
-				{
-				// not interleaved, but wrapping at interleaveLen
-				for (unsigned i = 0; i < nt; ++i)
-					{
-					nCharsToWrite = (nc > (unsigned)interleaveLen ? (unsigned)interleaveLen : nc);
-					const std::string & name = taxaNames[i];
-					std::string seq = cb.GetMatrixRowAsStr(i);
-					if (IsRelaxedPhylipType(f))
-						{
-						sep.clear();
-						sep.append(seqStartColumn - name.length(), ' ');
-						}
-					outf << name << sep << seq.substr(0, nCharsToWrite) << '\n';
-					for (unsigned currIndex = (unsigned)interleaveLen; currIndex < nc; currIndex += (unsigned)interleaveLen)
-						{
-						nCharsToWrite = ((nc - currIndex) > (unsigned)interleaveLen ? (unsigned)interleaveLen : (nc - currIndex));
-						outf << seq.substr(currIndex, nCharsToWrite) << '\n';
-						}
-					}
-				}
-			else
-				{
-				// not interleaved, and not wrapping
-				for (unsigned i = 0; i < nt; ++i)
-					{
-					const std::string & name = taxaNames[i];
-					std::string seq = cb.GetMatrixRowAsStr(i);
-					if (IsRelaxedPhylipType(f))
-						{
-						sep.clear();
-						sep.append(seqStartColumn - name.length(), ' ');
-						}
-					outf << name << sep << seq << '\n';
-					}
-				}
+			storedSeqs.resize(nt);
+			StoreMatrixRowsWorker storer(cb, storedSeqs);
+			NxsRunWorkers(storer, NxsChooseNumThreads(numThreads, nt));
+			pagesFrom = &storedSeqs;
 			}
 		}
 	else if (IsFastaType(f))
 		{
 		if (interleaveLen < 1)
 			interleaveLen = 60; // default FASTA line length
-		for (unsigned i = 0; i < nt; ++i)
-			{
-			nCharsToWrite = (nc > (unsigned)interleaveLen ? (unsigned)interleaveLen : nc);
-			const std::string & name = taxaNames[i];
-			std::string seq = cb.GetMatrixRowAsStr(i);
-			outf << '>' << name << '\n' << seq.substr(0, nCharsToWrite) << '\n';
-			for (unsigned currIndex = (unsigned)interleaveLen; currIndex < nc; currIndex += (unsigned)interleaveLen)
-				{
-				nCharsToWrite = ((nc - currIndex) > (unsigned)interleaveLen ? (unsigned)interleaveLen : (nc - currIndex));
-				outf << seq.substr(currIndex, nCharsToWrite) << '\n';
-				}
-			}
 		}
 	else
 		{
 		throw NxsException("writeCharactersBlockToStream requested for unsupported format");
 		}
+	CharactersRowChunkFormatter formatter(cb, taxaNames, f, interleaveLen, seqStartColumn, pagesFrom);
+	NxsWriteChunksInOrder(outf, formatter, formatter.GetNumChunks(), numThreads);
 }
 
 
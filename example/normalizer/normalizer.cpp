@@ -112,6 +112,7 @@ bool gUnderscoresToSpaces = false;
 bool gValidateInternals = true;
 bool gTreesViaInMemoryStruct = true;
 long gInterleaveLen = -1;
+long gNumThreads = 1;
 bool blocksReadInValidation = false;
 bool gSuppressingNameTranslationFile = false;
 bool gAllowNumericInterpretationOfTaxLabels = true;
@@ -382,6 +383,8 @@ MultiFormatReader * instantiateReader()
 		charsB->SetWriteInterleaveLen(gInterleaveLen);
 		dataB->SetWriteInterleaveLen(gInterleaveLen);
 		}
+	charsB->SetWriteNumThreads((unsigned) gNumThreads);
+	dataB->SetWriteNumThreads((unsigned) gNumThreads);
 
 	NxsTreesBlock * treesB = nexusReader->GetTreesBlockTemplate();
 	assert(treesB);
@@ -580,6 +583,8 @@ void printHelp(ostream & out)
 	out << "    -h help. on the command line shows this help message\n\n";
 #if !defined(JUST_VALIDATE_NEXUS) && !defined(JUST_REPORT_NEXUS) && !defined(TO_NEXML_CONVERTER)
 	out << "    -i<number> specifies the length of the interleaved pages to create\n";
+	out << "    -n<number> specifies the number of threads used to format matrices for output\n";
+	out << "             (-n0 uses one thread per processor; the default is 1)\n";
 #endif
 #if defined(NCL_CONVERTER_APP) && NCL_CONVERTER_APP
 	out << "    -j     Suppress the creation of a NameTranslationFile\n";
@@ -686,6 +691,15 @@ int do_main(int argc, char *argv[])
 				return 2;
 				}
 			}
+		else if (filepath[1] == 'n')
+			{
+			if ((slen == 2) || (!NxsString::to_long(filepath + 2, &gNumThreads)) || gNumThreads < 0)
+				{
+				cerr << "Expecting a non-negative integer after -n\n" << endl;
+				printHelp(cerr);
+				return 2;
+				}
+			}
 		else if (filepath[1] == 'a')
 			{
 			if ((slen != 2))
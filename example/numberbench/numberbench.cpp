@@ -0,0 +1,178 @@
+//	Copyright (C) 2007-2008 Mark T. Holder
+//
+//	This file is part of NCL (Nexus Class Library).
+//
+//	NCL is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	NCL is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with NCL; if not, write to the Free Software Foundation, Inc.,
+//	59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+/*******************************************************************************
+ * NEXUSnumberbench is a benchmark for NxsString::to_double, which NCL uses to
+ *	convert edge lengths and DISTANCES matrix cells.
+ *
+ * It formats -n random numbers the way edge lengths are usually written
+ *	(cycling through "%.6f", "%g", "%.10g" and "%e"), converts all of them
+ *	-r times with NxsString::to_double and -r times with strtod, and reports
+ *	both times. Every result of to_double is checked to be bit-identical to the
+ *	result of strtod; the program exits with an error if one is not.
+ *
+ * The speed-up of to_double over strtod is measured with:
+ *		NEXUSnumberbench -n3000000 -r5
+ *	with NCL and this program built with -O2.
+ */
+#include "ncl/ncl.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#if defined(NCL_HAS_STD_THREAD)
+#	include <chrono>
+#else
+#	include <ctime>
+#endif
+
+using namespace std;
+long gNumStrings = 3000000;
+long gNumReps = 1;
+unsigned long gSeed = 1;
+
+double secondsSinceStart()
+	{
+#	if defined(NCL_HAS_STD_THREAD)
+		static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#	else
+		return double(clock())/CLOCKS_PER_SEC;
+#	endif
+	}
+
+////////////////////////////////////////////////////////////////////////////////
+// A small linear congruential generator, so that every platform benchmarks
+//	the same strings for the same seed.
+// \returns a number in [0, 1).
+////////////////////////////////////////////////////////////////////////////////
+double nextUniform(unsigned long long & state)
+	{
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return double(state >> 11) / 9007199254740992.0;
+	}
+
+void fillNumberStrings(std::vector<std::string> & numbers)
+	{
+	static const char * formats[] = {"%.6f", "%g", "%.10g", "%e"};
+	unsigned long long state = gSeed;
+	char buffer[64];
+	numbers.resize((std::size_t) gNumStrings);
+	for (std::size_t i = 0; i < numbers.size(); ++i)
+		{
+		/* exponentially distributed, like the edge lengths of most trees */
+		const double x = -0.1 * log(1.0 - nextUniform(state));
+		sprintf(buffer, formats[i % 4], x);
+		numbers[i] = buffer;
+		}
+	}
+
+void printHelp(ostream & out)
+	{
+	out << "NEXUSnumberbench times NxsString::to_double against strtod on random edge-length strings.\n";
+	out << "\nThe most common usage is simply:\n    NEXUSnumberbench -n3000000 -r5\n";
+	out << "\nCommand-line flags:\n\n";
+	out << "    -h on the command line shows this help message\n\n";
+	out << "    -n<number> the number of strings to convert (default 3000000)\n\n";
+	out << "    -r<number> the number of times every string is converted (default 1)\n\n";
+	out << "    -s<number> the seed of the random numbers (default 1)\n\n";
+	}
+
+bool readLongArg(const char * arg, long & value)
+	{
+	if (strlen(arg) < 3 || !NxsString::to_long(arg + 2, &value) || value < 1)
+		{
+		cerr << "Expecting a positive integer after " << std::string(arg, 2) << "\n" << endl;
+		printHelp(cerr);
+		return false;
+		}
+	return true;
+	}
+
+int main(int argc, char *argv[])
+	{
+	for (int i = 1; i < argc; ++i)
+		{
+		const char * arg = argv[i];
+		if (strlen(arg) > 1 && arg[0] == '-')
+			{
+			if (arg[1] == 'h')
+				{
+				printHelp(cout);
+				return 0;
+				}
+			long value = 0;
+			if (arg[1] == 'n' || arg[1] == 'r' || arg[1] == 's')
+				{
+				if (!readLongArg(arg, value))
+					return 2;
+				if (arg[1] == 'n')
+					gNumStrings = value;
+				else if (arg[1] == 'r')
+					gNumReps = value;
+				else
+					gSeed = (unsigned long) value;
+				continue;
+				}
+			}
+		cerr << "Unknown argument: " << arg << "\n" << endl;
+		printHelp(cerr);
+		return 2;
+		}
+
+	std::vector<std::string> numbers;
+	fillNumberStrings(numbers);
+	std::vector<double> fromNCL(numbers.size());
+	std::vector<double> fromStrtod(numbers.size());
+
+	double start = secondsSinceStart();
+	for (long r = 0; r < gNumReps; ++r)
+		{
+		for (std::size_t i = 0; i < numbers.size(); ++i)
+			{
+			if (!NxsString::to_double(numbers[i].c_str(), &fromNCL[i]))
+				{
+				cerr << "NxsString::to_double rejected \"" << numbers[i] << "\"\n";
+				return 1;
+				}
+			}
+		}
+	const double nclTime = secondsSinceStart() - start;
+
+	start = secondsSinceStart();
+	for (long r = 0; r < gNumReps; ++r)
+		{
+		for (std::size_t i = 0; i < numbers.size(); ++i)
+			fromStrtod[i] = strtod(numbers[i].c_str(), NULL);
+		}
+	const double strtodTime = secondsSinceStart() - start;
+
+	for (std::size_t i = 0; i < numbers.size(); ++i)
+		{
+		if (memcmp(&fromNCL[i], &fromStrtod[i], sizeof(double)) != 0)
+			{
+			cerr << "NxsString::to_double and strtod differ for \"" << numbers[i] << "\"\n";
+			return 1;
+			}
+		}
+	cout << gNumStrings << " strings, " << gNumReps << " repetitions (every result is identical to strtod):\n";
+	cout << "    NxsString::to_double:  " << nclTime << " sec\n";
+	cout << "    strtod:                " << strtodTime << " sec\n";
+	return 0;
+	}
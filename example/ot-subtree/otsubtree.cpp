@@ -24,6 +24,7 @@
 #include <cassert>
 #include "ncl/nxsdefs.h"
 #include "ncl/nxstreesblock.h"
+#include "ncl/nxslcaindex.h"
 
 using namespace std;
 long gStrictLevel = 2;
@@ -35,18 +36,6 @@ bool newTreeHook(NxsFullTreeDescription &, void *, NxsTreesBlock *);
 
 void describeUnnamedNode(const NxsTaxaBlockAPI* taxa, const NxsSimpleNode &, ostream & out);
 
-void fillAncMRCA(const NxsSimpleNode * nd, map<const NxsSimpleNode *, set<long> > &n2m) {
-	const vector<NxsSimpleNode *> children = nd->GetChildren();
-	set<long> & mrca = n2m[nd];
-	for (vector<NxsSimpleNode *>::const_iterator cIt = children.begin(); cIt != children.end(); ++cIt) {
-		const NxsSimpleNode * c = *cIt;
-		if (n2m.find(c) != n2m.end()) {
-			set<long> & csl = n2m[c];
-			mrca.insert(csl.begin(), csl.end());
-		}
-	}
-}
-
 /* use some globals, because I'm being lazy... */
 string gCurrentFilename;
 string gCurrTmpFilepath;
@@ -94,35 +83,33 @@ int gExitCode = 0;
 
 void writeNewickSubtree(ostream & out, const NxsSimpleNode * sr, map<const NxsSimpleNode *, string > & leafNode2name) {
 	assert(sr != 0);
-	if (sr->IsTip()) {
-		out << NxsString::GetEscaped(leafNode2name[sr]);
-	} else {
-		out << '(';
-		bool first = true;
-		const std::vector<NxsSimpleNode *> children = sr->GetChildren();
-		for (std::vector<NxsSimpleNode *>::const_iterator cIt = children.begin(); cIt != children.end(); ++cIt) {
-			const NxsSimpleNode * child = *cIt;
-			if (first) {
-				first = false;
-			} else {
-				out << ',';
-			}
-			writeNewickSubtree(out, child, leafNode2name);
+	const NxsSimpleNode * nd = sr;
+	for (;;) {
+		if (!nd->IsTip()) {
+			out << '(';
+			nd = nd->GetFirstChild();
+			continue;
+		}
+		out << NxsString::GetEscaped(leafNode2name[nd]);
+		while (nd != sr && nd->GetNextSib() == 0) {
+			nd = nd->GetParent();
+			out << ')';
 		}
-		assert(!first);
-		out << ')';
+		if (nd == sr) {
+			break;
+		}
+		out << ',';
+		nd = nd->GetNextSib();
 	}
-
 }
 
 bool processRefTree(const NxsTaxaBlockAPI * tb, const NxsSimpleTree * tree) {
-	vector<const NxsSimpleNode *> nodes =  tree->GetPreorderTraversal();
-	map<const NxsSimpleNode *, set<long> > refNdp2mrca;
+	const NxsLCAIndex lcaIndex(*tree);
 	map<const NxsSimpleNode *, string > leafNode2name;
-	const unsigned numMRCADesignators = gMRCADesignatorSet.size();
-	assert(numMRCADesignators > 1);
-	for (vector<const NxsSimpleNode *>::const_reverse_iterator nIt = nodes.rbegin(); nIt != nodes.rend(); ++nIt) {
-		const NxsSimpleNode * nd = *nIt;
+	vector<unsigned> designatorNodes;
+	assert(gMRCADesignatorSet.size() > 1);
+	for (unsigned i = 0; i < lcaIndex.GetNumNodes(); ++i) {
+		const NxsSimpleNode * nd = lcaIndex.GetNode(i);
 		if (nd->IsTip()) {
 			long ottID = getOTTIndex(tb, *nd);
 			assert(ottID >= 0);
@@ -132,24 +119,19 @@ bool processRefTree(const NxsTaxaBlockAPI * tb, const NxsSimpleTree * tree) {
 			leafNode2name[nd] = tn;
 			if (gMRCADesignatorSet.find(ottID) != gMRCADesignatorSet.end()) {
 				gMRCADesignatorSet.erase(ottID);
-				refNdp2mrca[nd].insert(ottID);
-			}
-		} else {
-			fillAncMRCA(nd, refNdp2mrca);
-			if (refNdp2mrca[nd].size() == numMRCADesignators) {
-				writeNewickSubtree(cout, nd, leafNode2name);
-				cout << ";\n";
-				return true;
+				designatorNodes.push_back(i);
 			}
 		}
 	}
 	if (gMRCADesignatorSet.empty()) {
-		std::cerr << "Very odd: no node found that is an ancestor of all MRCA designators, but all designators found.\n";
-	} else {
-		std::cerr << "There following MRCA designator(s) not found (they all have to be leaf nodes):\n";
-		for (set<long>::const_iterator mIt = gMRCADesignatorSet.begin(); mIt != gMRCADesignatorSet.end(); ++mIt) {
-			std::cerr << *mIt << "\n";
-		}
+		const NxsSimpleNode * mrca = lcaIndex.GetNode(lcaIndex.GetMRCAIndex(designatorNodes));
+		writeNewickSubtree(cout, mrca, leafNode2name);
+		cout << ";\n";
+		return true;
+	}
+	std::cerr << "There following MRCA designator(s) not found (they all have to be leaf nodes):\n";
+	for (set<long>::const_iterator mIt = gMRCADesignatorSet.begin(); mIt != gMRCADesignatorSet.end(); ++mIt) {
+		std::cerr << *mIt << "\n";
 	}
 	return false;
 }
@@ -87,7 +87,7 @@ bool polytomyCountHook(NxsFullTreeDescription &ftd, void * arg, NxsTreesBlock *t
 	std::vector<const NxsSimpleNode *> nodes =  nst.GetPreorderTraversal();
 	for (std::vector<const NxsSimpleNode *>::const_iterator nIt = nodes.begin();
 		 nIt != nodes.end(); ++nIt) {
-		const unsigned outDegree = (*nIt)->GetChildren().size();
+		const unsigned outDegree = (*nIt)->GetOutDegree();
 		if (outDegree >= outDegreeCounts.size()) {
 			outDegreeCounts.resize(outDegree + 1, 0);
 		}
@@ -74,12 +74,11 @@ std::string getLeftmostDesName(const NxsTaxaBlockAPI* taxa, const NxsSimpleNode
 	if (!name.empty()) {
 		return name;
 	}
-	const unsigned outDegree = nd.GetChildren().size();
-	if (outDegree == 0) {
+	if (nd.IsTip()) {
 		assert(false);
 		return name;
 	}
-	return getLeftmostDesName(taxa, *nd.GetChildren()[0]);
+	return getLeftmostDesName(taxa, *nd.GetFirstChild());
 }
 
 std::string getRightmostDesName(const NxsTaxaBlockAPI* taxa, const NxsSimpleNode &nd) {
@@ -91,23 +90,21 @@ std::string getRightmostDesName(const NxsTaxaBlockAPI* taxa, const NxsSimpleNode
 	if (!name.empty()) {
 		return name;
 	}
-	const unsigned outDegree = nd.GetChildren().size();
-	if (outDegree == 0) {
+	if (nd.IsTip()) {
 		assert(false);
 		return name;
 	}
-	const unsigned lastInd = outDegree - 1;
-	return getRightmostDesName(taxa, *nd.GetChildren()[lastInd]);
+	return getRightmostDesName(taxa, *nd.GetLastChild());
 }
 void describeUnnamedNode(const NxsTaxaBlockAPI *taxa, const NxsSimpleNode &nd, std::ostream & out, unsigned int anc) {
-	const NxsSimpleNode *c = nd.GetChildren()[0];
+	const NxsSimpleNode *c = nd.GetFirstChild();
 	assert(c);
 	const std::string & cname = c->GetName();
 	if (!cname.empty()) {
 		out << "ancestor " << 1 + anc << " node(s) before \"" << cname << "\"\n";
 		out.flush();
 	} else {
-		const unsigned coutDegree = c->GetChildren().size();
+		const unsigned coutDegree = c->GetOutDegree();
 		if (coutDegree == 1U) {
 			describeUnnamedNode(taxa, *c, out, anc + 1);
 		} else {
@@ -134,7 +131,7 @@ bool newTreeHook(NxsFullTreeDescription &ftd, void * arg, NxsTreesBlock *treesB)
 	for (std::vector<const NxsSimpleNode *>::const_iterator nIt = nodes.begin();
 		 nIt != nodes.end(); ++nIt) {
 		const NxsSimpleNode *nd = *nIt;
-		const unsigned outDegree = nd->GetChildren().size();
+		const unsigned outDegree = nd->GetOutDegree();
 		if (outDegree == 1) {
 			const std::string & nname = nd->GetName();
 			if (nname.empty()) {
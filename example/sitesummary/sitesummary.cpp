@@ -0,0 +1,284 @@
+//	Copyright (C) 2007-2008 Mark T. Holder
+//
+//	This file is part of NCL (Nexus Class Library).
+//
+//	NCL is free software; you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation; either version 2 of the License, or
+//	(at your option) any later version.
+//
+//	NCL is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//	GNU General Public License for more details.
+//
+//	You should have received a copy of the GNU General Public License
+//	along with NCL; if not, write to the Free Software Foundation, Inc.,
+//	59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+/*******************************************************************************
+ * NEXUSsitesummary reads a file and, for every characters block, reports the
+ *	number of constant, singleton and parsimony-informative sites using
+ *	NxsSummarizeDiscreteMatrixSites.
+ *
+ * With the -b flag the program also acts as a benchmark: the summary is
+ *	recomputed -r times with 1 thread and with -t threads, and compared to a
+ *	naive cell-by-cell loop over the matrix. The timings are written to stderr.
+ */
+#include "ncl/ncl.h"
+#include "ncl/nxsblock.h"
+#include "ncl/nxspublicblocks.h"
+#include "ncl/nxsmultiformat.h"
+#include "ncl/nxscxxdiscretematrix.h"
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+#if defined(NCL_HAS_STD_THREAD)
+#	include <chrono>
+#else
+#	include <ctime>
+#endif
+
+using namespace std;
+long gStrictLevel = 2;
+long gNumThreads = 0;
+long gNumReps = 10;
+bool gBenchmark = false;
+bool gStandardizeCoding = true;
+
+double secondsSinceStart()
+	{
+#	if defined(NCL_HAS_STD_THREAD)
+		static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#	else
+		return double(clock())/CLOCKS_PER_SEC;
+#	endif
+	}
+
+////////////////////////////////////////////////////////////////////////////////
+// The obvious way to count parsimony-informative sites: walk down each column
+//	and tally the states. Used as the reference for the benchmark.
+////////////////////////////////////////////////////////////////////////////////
+unsigned naiveCountPISites(const NxsCXXDiscreteMatrix & mat)
+	{
+	const unsigned nChar = mat.getNChar();
+	const unsigned nTax = mat.getNTax();
+	const unsigned nStates = mat.getNStates();
+	const NxsCDiscreteStateSet * const * m = mat.getMatrix();
+	unsigned nPI = 0;
+	std::vector<unsigned> counts(nStates);
+	for (unsigned j = 0; j < nChar; ++j)
+		{
+		std::fill(counts.begin(), counts.end(), 0U);
+		for (unsigned i = 0; i < nTax; ++i)
+			{
+			const NxsCDiscreteStateSet c = m[i][j];
+			if (c >= 0 && (unsigned) c < nStates)
+				counts[c] += 1;
+			}
+		unsigned nSeenTwice = 0;
+		for (unsigned s = 0; s < nStates; ++s)
+			{
+			if (counts[s] > 1)
+				++nSeenTwice;
+			}
+		if (nSeenTwice > 1)
+			++nPI;
+		}
+	return nPI;
+	}
+
+void benchmark(const NxsCXXDiscreteMatrix & mat, unsigned nPI)
+	{
+	double start = secondsSinceStart();
+	unsigned naivePI = 0;
+	for (long r = 0; r < gNumReps; ++r)
+		naivePI = naiveCountPISites(mat);
+	const double naiveTime = secondsSinceStart() - start;
+	if (naivePI != nPI)
+		cerr << "Warning: the naive loop found " << naivePI << " parsimony-informative sites\n";
+
+	NxsDiscreteSiteSummary summary;
+	start = secondsSinceStart();
+	for (long r = 0; r < gNumReps; ++r)
+		NxsSummarizeDiscreteMatrixSites(mat, summary, 1);
+	const double serialTime = secondsSinceStart() - start;
+
+	start = secondsSinceStart();
+	for (long r = 0; r < gNumReps; ++r)
+		NxsSummarizeDiscreteMatrixSites(mat, summary, (unsigned) gNumThreads);
+	const double threadedTime = secondsSinceStart() - start;
+
+	cerr << "  " << gNumReps << " repetitions:\n";
+	cerr << "    naive loop:            " << naiveTime << " sec\n";
+	cerr << "    summary (1 thread):    " << serialTime << " sec\n";
+	cerr << "    summary (" << gNumThreads << " threads):  " << threadedTime << " sec  (0 threads means one per processor)\n";
+	}
+
+void processContent(PublicNexusReader & nexusReader, ostream & out)
+	{
+	const unsigned nTaxaBlocks = nexusReader.GetNumTaxaBlocks();
+	for (unsigned t = 0; t < nTaxaBlocks; ++t)
+		{
+		const NxsTaxaBlock * tb = nexusReader.GetTaxaBlock(t);
+		const unsigned nCharBlocks = nexusReader.GetNumCharactersBlocks(tb);
+		for (unsigned c = 0; c < nCharBlocks; ++c)
+			{
+			const NxsCharactersBlock * cb = nexusReader.GetCharactersBlock(tb, c);
+			if (cb->GetDataType() == NxsCharactersBlock::continuous)
+				continue;
+			NxsCXXDiscreteMatrix mat(*cb, false, 0L, gStandardizeCoding);
+			NxsDiscreteSiteSummary summary;
+			NxsSummarizeDiscreteMatrixSites(mat, summary, (unsigned) gNumThreads);
+			unsigned nConstant = 0;
+			unsigned nSingleton = 0;
+			unsigned nPI = 0;
+			double gapFrac = 0.0;
+			double missingFrac = 0.0;
+			for (unsigned j = 0; j < summary.nChar; ++j)
+				{
+				if (summary.IsParsimonyInformative(j))
+					++nPI;
+				else if (summary.IsSingletonSite(j))
+					++nSingleton;
+				else
+					++nConstant;
+				gapFrac += summary.gapFraction[j];
+				missingFrac += summary.missingFraction[j];
+				}
+			if (summary.nChar > 0)
+				{
+				gapFrac /= summary.nChar;
+				missingFrac /= summary.nChar;
+				}
+			out << "Characters block " << 1 + c << " (" << summary.nTax << " taxa, " << summary.nChar << " characters):\n";
+			out << "  constant sites: " << nConstant << '\n';
+			out << "  singleton sites: " << nSingleton << '\n';
+			out << "  parsimony-informative sites: " << nPI << '\n';
+			out << "  mean gap fraction: " << gapFrac << '\n';
+			out << "  mean missing fraction: " << missingFrac << '\n';
+			if (gBenchmark)
+				benchmark(mat, nPI);
+			}
+		}
+	}
+
+void processFilepath(const char * filename, MultiFormatReader::DataFormatType fmt)
+	{
+	assert(filename);
+	try
+		{
+		MultiFormatReader nexusReader(-1, NxsReader::WARNINGS_TO_STDERR);
+		if (gStrictLevel != 2)
+			nexusReader.SetWarningToErrorThreshold((int)NxsReader::FATAL_WARNING + 1 - (int) gStrictLevel);
+		try {
+			nexusReader.ReadFilepath(filename, fmt);
+			processContent(nexusReader, cout);
+			}
+		catch(...)
+			{
+			nexusReader.DeleteBlocksFromFactories();
+			throw;
+			}
+		nexusReader.DeleteBlocksFromFactories();
+		}
+	catch (const NxsException &x)
+		{
+		cerr << "Error:\n " << x.msg << endl;
+		if (x.line >=0)
+			cerr << "at line " << x.line << ", column (approximately) " << x.col << " (and file position "<< x.pos << ")" << endl;
+		exit(2);
+		}
+	}
+
+void printHelp(ostream & out)
+	{
+	out << "NEXUSsitesummary reports the number of constant, singleton and parsimony-informative sites in each characters block.\n";
+	out << "\nThe most common usage is simply:\n    NEXUSsitesummary <path to NEXUS file>\n";
+	out << "\nCommand-line flags:\n\n";
+	out << "    -h on the command line shows this help message\n\n";
+	out << "    -b benchmark the summary (timings are written to standard error)\n\n";
+	out << "    -u summarize the matrix without standardizing its coding (NCL's own state codes are used)\n\n";
+	out << "    -t<non-negative integer> number of threads (the default, 0, uses one per processor)\n\n";
+	out << "    -r<positive integer> number of repetitions used by -b (default 10)\n\n";
+	out << "    -s<non-negative integer> controls the NEXUS strictness level.\n";
+	out << "    -f<format> specifies the input file format expected:\n";
+	out << "            -fnexus     NEXUS (this is also the default)\n";
+	out << "            -fdnafasta  DNA data in fasta\n";
+	out << "        The complete list of format names that can follow the -f flag is:\n";
+	std::vector<std::string> fmtNames =  MultiFormatReader::getFormatNames();
+	for (std::vector<std::string>::const_iterator n = fmtNames.begin(); n != fmtNames.end(); ++n)
+		out << "            "<< *n << "\n";
+	}
+
+bool readLongFlag(const char * arg, char flag, long * value, long minValue)
+	{
+	if ((strlen(arg) == 2) || (!NxsString::to_long(arg + 2, value)) || *value < minValue)
+		{
+		cerr << "Expecting an integer >= " << minValue << " after -" << flag << "\n" << endl;
+		printHelp(cerr);
+		return false;
+		}
+	return true;
+	}
+
+int main(int argc, char *argv[])
+	{
+	MultiFormatReader::DataFormatType f(MultiFormatReader::NEXUS_FORMAT);
+	bool readfile = false;
+	for (int i = 1; i < argc; ++i)
+		{
+		const char * filepath = argv[i];
+		const unsigned slen = strlen(filepath);
+		if (slen > 1 && filepath[0] == '-' && filepath[1] == 'h')
+			printHelp(cout);
+		else if (slen == 2 && filepath[0] == '-' && filepath[1] == 'b')
+			gBenchmark = true;
+		else if (slen == 2 && filepath[0] == '-' && filepath[1] == 'u')
+			gStandardizeCoding = false;
+		else if (slen > 1 && filepath[0] == '-' && filepath[1] == 't')
+			{
+			if (!readLongFlag(filepath, 't', &gNumThreads, 0))
+				return 2;
+			}
+		else if (slen > 1 && filepath[0] == '-' && filepath[1] == 'r')
+			{
+			if (!readLongFlag(filepath, 'r', &gNumReps, 1))
+				return 2;
+			}
+		else if (slen > 1 && filepath[0] == '-' && filepath[1] == 's')
+			{
+			if (!readLongFlag(filepath, 's', &gStrictLevel, 0))
+				return 2;
+			}
+		else if (slen > 1 && filepath[0] == '-' && filepath[1] == 'f')
+			{
+			f = MultiFormatReader::UNSUPPORTED_FORMAT;
+			if (slen > 2)
+				{
+				std::string fmtName(filepath + 2, slen - 2);
+				f =  MultiFormatReader::formatNameToCode(fmtName);
+				}
+			if (f == MultiFormatReader::UNSUPPORTED_FORMAT)
+				{
+				cerr << "Expecting a format after after -f\n" << endl;
+				printHelp(cerr);
+				return 2;
+				}
+			}
+		else
+			{
+			readfile = true;
+			processFilepath(filepath, f);
+			}
+		}
+	if (!readfile)
+		{
+		cerr << "Expecting the path to NEXUS file as the only command line argument!\n" << endl;
+		printHelp(cerr);
+		return 1;
+		}
+	return 0;
+	}
@@ -132,36 +132,36 @@ void processContent(PublicNexusReader & nexusReader, ostream *out)
 		if (b->GetID() == "TAXA")
 			b->WriteAsNexus(*out);
 		}
-	TreesToSplits::TaxaBlockToSplitsMap::const_iterator tbtsm = gTreesToSplitsB->taxaBlockToSplitsMap.begin();
-	for (; tbtsm != gTreesToSplitsB->taxaBlockToSplitsMap.end(); ++tbtsm) {
+	TreesToSplits::TaxaBlockToSplitCounter::const_iterator tbtsc = gTreesToSplitsB->taxaBlockToSplitCounter.begin();
+	for (; tbtsc != gTreesToSplitsB->taxaBlockToSplitCounter.end(); ++tbtsc) {
 		*out << "Begin Trees;\n";
-		NxsTaxaBlockAPI * tb = tbtsm->first;
-		if (tb && gTreesToSplitsB->taxaBlockToSplitsMap.size() > 1)
+		NxsTaxaBlockAPI * tb = tbtsc->first;
+		if (tb && gTreesToSplitsB->taxaBlockToSplitCounter.size() > 1)
 			*out << "Link Taxa = " << NxsString::GetEscaped(tb->GetTitle()) << ";\n";
 		writeTranslateCommand(tb, *out);
-		const TreesToSplits::NTreesSplitsMap & ntsm = tbtsm->second;
-		const unsigned nt = ntsm.first;
-		const TreesToSplits::SplitsMap & sm = ntsm.second;
+		const NxsSplitCounter & sc = *(tbtsc->second);
+		const unsigned nt = sc.GetNumTrees();
+		const NxsSplitTable & st = sc.GetSplitTable();
 		unsigned n = 1;
 		writeStarTreeCommand(tb, *out);
 
-
-		for (TreesToSplits::SplitsMap::const_iterator smIt = sm.begin(); smIt != sm.end(); ++smIt, ++n) {
-			const SplitInfo & si = smIt->second;
+		const std::vector<unsigned> splitOrder = TreesToSplits::getSortedSplitIndices(st);
+		for (std::vector<unsigned>::const_iterator sIt = splitOrder.begin(); sIt != splitOrder.end(); ++sIt, ++n) {
+			const NxsSplitInfo & si = st.GetSplitInfo(*sIt);
 			*out << "Tree split_" << n << " = " << " [&";
 			*out << (gTreesToSplitsB->treatAsRooted ? 'R' : 'U');
 			*out << "] [";
 			if (gTreesToSplitsB->trackFreq || gTreesToSplitsB->trackEdgeLenSummary || gTreesToSplitsB->trackEdgeLen)
 				*out << "&W " << ((double)si.nTimes)/((double)nt) << " ] [";
 			if (gTreesToSplitsB->trackHeightSummary) {
-				*out << "meanH =" << ((double)si.heightSum)/((double)si.nTimes);
+				*out << "meanH =" << si.heightSummary.GetMean();
 			}
 			*out << "] ";
 
 			if (gTreesToSplitsB->trackEdgeLenSummary)
-				smIt->first.writeNewick(*out, si.edgeLenSum/((double)si.nTimes), true);
+				TreesToSplits::writeNewick(*out, st, *sIt, si.edgeLenSummary.GetMean(), true, true);
 			else
-				smIt->first.writeNewick(*out, true);
+				TreesToSplits::writeNewick(*out, st, *sIt, 0.0, false, true);
 			*out << ";\n";
 
 		}
@@ -265,6 +265,14 @@ void printHelp(ostream & out)
 	{
 	out << "NEXUStosplits takes reads a file and writes trees for each split that occurs in any tree in the file.\n";
 	out << "\nThe most common usage is simply:\n    NEXUStosplits <path to NEXUS file>\n";
+	out << "\nThe splits are counted with NxsSplitCounter (see ncl/nxssplits.h). For some trees the output differs from\n";
+	out << "the output of versions of this program that did not use NxsSplitCounter:\n";
+	out << "    - an internal node that is labelled with a taxon is in the splits of the nodes above it, so the tree\n";
+	out << "        ((A,B)G,C,(D,E)) has the split {A,B,G} (the older versions reported {A,B}).\n";
+	out << "    - trivial splits (-t) of unrooted trees are written relative to the taxa of the tree that they\n";
+	out << "        occur in. For a tree that lacks some of the taxa, the trivial split of its lowest-numbered\n";
+	out << "        taxon is written as the tree's other taxa, rather than as all of the other taxa in the block.\n";
+	out << "    Trees that have all of the taxa of the block, each as a leaf, give the same output as before.\n";
 	out << "\nCommand-line flags:\n\n";
 	out << "    -h on the command line shows this help message\n\n";
 	out << "    -v verbose output\n\n";
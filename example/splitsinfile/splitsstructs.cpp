@@ -1,5 +1,6 @@
 #include "splitsstructs.h"
 #include <algorithm>
+#include "ncl/nxstaxablock.h"
 bool TreesToSplits::gTrackTrivial = false;
 bool TreesToSplits::gTreatAsRooted = false;
 bool TreesToSplits::gTrackFreq = false;
@@ -9,144 +10,86 @@ bool TreesToSplits::gTrackEdgeLenSummary = false;
 bool TreesToSplits::gTrackHeight = false;
 bool TreesToSplits::gTrackHeightSummary = false;
 
-
-const WORD_INT_TYPE gLastMask[] = {1, 3, 7, 0x0F, 0x1F, 0x3F, 0x7F, 0x7F };
-const WORD_INT_TYPE gBit[] = {1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80 };
-Split::Split(unsigned nTax)
-	:splitRep(1 + ((nTax - 1)/NBITS_IN_WORD), 0),
-	lastMask(gLastMask[(nTax-1) % NBITS_IN_WORD])
-	{
-	}
-
-void Split::setIndex(unsigned ind)
-{
-	const unsigned elIndex = ind/NBITS_IN_WORD;
-	assert(elIndex < splitRep.size());
-	WORD_INT_TYPE & el = splitRep[elIndex];
-	el |= gBit[ind % NBITS_IN_WORD ];
+TreesToSplits::~TreesToSplits() {
+	for (TaxaBlockToSplitCounter::iterator tIt = taxaBlockToSplitCounter.begin(); tIt != taxaBlockToSplitCounter.end(); ++tIt)
+		delete tIt->second;
 }
 
-
-unsigned gCounter = 0;
-
 void TreesToSplits::recordTree(const NxsFullTreeDescription & ftd, NxsTaxaBlockAPI *taxB) {
-	TaxaBlockToSplitsMap::iterator tsmIt = taxaBlockToSplitsMap.find(taxB);
-	if (tsmIt == taxaBlockToSplitsMap.end()) {
-		taxaBlockToSplitsMap[taxB] = NTreesSplitsMap(0, SplitsMap());
-		tsmIt = taxaBlockToSplitsMap.find(taxB);
+	TaxaBlockToSplitCounter::iterator tscIt = taxaBlockToSplitCounter.find(taxB);
+	if (tscIt == taxaBlockToSplitCounter.end()) {
+		NxsSplitCounter * sc = new NxsSplitCounter(taxB->GetNTax());
+		sc->SetTreatAsRooted(treatAsRooted);
+		sc->SetTrackTrivial(trackTrivial);
+		sc->SetTrackOccurrence(trackOccurrence);
+		sc->SetTrackEdgeLen(trackEdgeLen);
+		sc->SetTrackEdgeLenSummary(trackEdgeLenSummary);
+		sc->SetTrackHeight(trackHeight);
+		sc->SetTrackHeightSummary(trackHeightSummary);
+		tscIt = taxaBlockToSplitCounter.insert(TaxaBlockToSplitCounter::value_type(taxB, sc)).first;
 	}
-	NTreesSplitsMap & ntsm = tsmIt->second;
-	SplitsMap & sm = ntsm.second;
-	unsigned nextNTax = taxB->GetNTax();
-	if (nextNTax != nTax)
-		splits.clear();
-	nTax = nextNTax;
-	recordTreeToSplitsMap(ftd, sm, ntsm.first);
-	ntsm.first += 1;
+	tscIt->second->RecordTree(ftd);
 }
 
-void TreesToSplits::recordTreeToSplitsMap(const NxsFullTreeDescription & ftd, TreesToSplits::SplitsMap & sm, unsigned treeIndex) {
-	nst.Initialize(ftd);
-	if (!treatAsRooted)
-		nst.RerootAt(0);
-	std::vector<const NxsSimpleNode *> nodes =  nst.GetPreorderTraversal();
-	if (nodes.empty())
-		return;
-	std::vector<const NxsSimpleNode *>::reverse_iterator last =  nodes.rend();
-	--last; /* root is a trivial split */
-	while (splits.size() < nodes.size())
-		splits.push_back(SplitAndScratch(Split(nTax), NULL));
-
-	const bool doHeights = (trackHeight || trackHeightSummary);
-	if (doHeights) {
-		while (dblScratch.size() < nodes.size())
-			dblScratch.push_back(0.0);
-	}
-	std::vector<double>::iterator hIt = dblScratch.begin();
-
-	std::vector<SplitAndScratch>::iterator spIt = splits.begin();
-	for (std::vector<const NxsSimpleNode *>::reverse_iterator ndIt = nodes.rbegin(); ndIt != last; ++ndIt, ++spIt) {
-		const NxsSimpleNode * nd = *ndIt;
-		//cout << "visiting node " << (long) nd << '\n';
-		assert(nd);
-		assert(spIt != splits.end());
-		SplitAndScratch & ss = *spIt;
-		Split & split = ss.first;
-		split.reset();
-		const NxsSimpleNode * c = nd->GetFirstChild();
-		nd->scratch = (void *)&ss;
-		double * h = 0L;
-		if (doHeights) {
-			h = &(*hIt);
-			ss.second = (void *) h;
-			++hIt;
-			*h = 0.0;
-		}
-		if (c) {
-			while (c) {
-				const SplitAndScratch * css = (SplitAndScratch *)(c->scratch);
-				const Split * cSplit = &(css->first);
-				assert(cSplit);
-				split.setToUnion(*cSplit);
-				if (doHeights) {
-					NxsSimpleEdge nse = c->GetEdgeToParent();
-					double n = nse.GetDblEdgeLen();
-					double * ch = (double*)(css->second);
-					n += *ch;
-					*h = std::max(*h, n);
+/* orders splits by their bits, taxa 1-8 first (the order of the std::map that this program used to store splits in) */
+class SplitOrder
+{
+	public:
+		SplitOrder(const NxsSplitTable & t)
+			:table(t)
+			{}
+		bool operator()(unsigned one, unsigned another) const {
+			const NxsSplitWord * o = table.GetSplitWords(one);
+			const NxsSplitWord * a = table.GetSplitWords(another);
+			for (unsigned w = 0; w < table.GetNumWords(); ++w) {
+				if (o[w] != a[w]) {
+					unsigned shift = 0;
+					while ((((o[w] ^ a[w]) >> shift) & 0xFF) == 0)
+						shift += 8;
+					return ((o[w] >> shift) & 0xFF) < ((a[w] >> shift) & 0xFF);
 				}
-				c = c->GetNextSib();
 			}
-			if (!treatAsRooted)
-				split.invertIfNeeded();
-			recordSplit(split, nd, sm, treeIndex);
-		}
-		else {
-			split.setIndex(nd->GetTaxonIndex());
-			if (!treatAsRooted)
-				split.invertIfNeeded();
-			if (trackTrivial)
-				recordSplit(split, nd, sm, treeIndex);
+			return false;
 		}
-	}
+	private:
+		const NxsSplitTable & table;
+};
+
+std::vector<unsigned> TreesToSplits::getSortedSplitIndices(const NxsSplitTable & table) {
+	std::vector<unsigned> inds(table.GetNumSplits());
+	for (unsigned i = 0; i < inds.size(); ++i)
+		inds[i] = i;
+	std::sort(inds.begin(), inds.end(), SplitOrder(table));
+	return inds;
 }
 
-void TreesToSplits::recordSplit(const Split &split, const NxsSimpleNode *nd, TreesToSplits::SplitsMap & sm, unsigned treeIndex) {
-	gCounter++;
-	TreesToSplits::SplitsMap::iterator smIt = sm.find(split);
-	if (smIt == sm.end()) {
-		sm[split] = SplitInfo();
-		smIt = sm.find(split);
-		//std::cout << "New Split " << gCounter << ": " << split.getNewick() << '\n';
+bool TreesToSplits::writeNewick(std::ostream &out, const NxsSplitTable & table, unsigned splitIndex, double edgeLen, bool writeEdgeLen, bool evenIfTrivial) {
+	const std::vector<unsigned> inc = table.GetTaxonIndices(splitIndex);
+	std::vector<unsigned> exc;
+	std::vector<unsigned>::const_iterator iIt = inc.begin();
+	for (unsigned i = 0; i < table.GetNumTaxa(); ++i) {
+		if (iIt != inc.end() && *iIt == i)
+			++iIt;
+		else
+			exc.push_back(i);
 	}
-	else {
-		//std::cout << "Repeated Split " << gCounter << ": " << split.getNewick() << '\n';
+	if (!evenIfTrivial && (inc.size() == 1 || exc.size() == 1))
+		return false;
+	out << '(';
+	std::vector<unsigned>::const_iterator sIt = inc.begin();
+	if (!inc.empty()) {
+		out << '(' << (1 + *sIt);
+		for (++sIt; sIt != inc.end(); ++sIt)
+			out << ',' << (1 + *sIt);
+		out << ')';
+		if (writeEdgeLen)
+			out << ':' << edgeLen;
 	}
 
-	SplitInfo & info = smIt->second;
-	if (trackFreq || trackEdgeLenSummary || trackEdgeLen)
-		info.nTimes += 1;
-	if (trackOccurrence)
-		info.inclusion.insert(treeIndex);
-
-	if (trackEdgeLenSummary) {
-		NxsSimpleEdge nse = nd->GetEdgeToParent();
-		const double el = nse.GetDblEdgeLen();
-		info.edgeLenSum += el;
-		info.edgeLenSumSq += el*el;
-	}
-	else if (trackEdgeLen){
-		NxsSimpleEdge nse = nd->GetEdgeToParent();
-		const double el = nse.GetDblEdgeLen();
-		info.edgeLen.push_back(el);
+	if (!exc.empty()) {
+		for (sIt = exc.begin(); sIt != exc.end(); ++sIt)
+			out << ',' << (1 + *sIt);
+		out << ')';
 	}
-
-	if (trackHeightSummary)
-		{
-		const SplitAndScratch * css = (SplitAndScratch *)(nd->scratch);
-		double *h = (double *)css->second;
-		info.heightSum += *h;
-		}
-	else if (trackHeight)
-		{}
+	return true;
 }
@@ -0,0 +1,240 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <exception>
+#include "ncl/nxsbatchreader.h"
+#include "ncl/nxsparallel.h"
+
+using namespace std;
+
+MultiFormatReader * NxsBatchReadHandler::CreateReader(unsigned, const std::string &)
+        {
+        return new MultiFormatReader(-1, NxsReader::IGNORE_WARNINGS);
+        }
+
+void NxsBatchReadHandler::FileFailed(unsigned, const std::string &, const NxsException &)
+        {
+        /* FileFailed is called while the exception is being handled, so this rethrows it with its own type */
+        throw;
+        }
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Functor used by NxsReadFilepaths. Each worker repeatedly claims the next unread file and parses it without holding
+|        the lock. Results that are ready to be reported are reported by one worker at a time (the worker that set
+|        `reporting`), and the handler is called without holding the lock, so the other workers keep reading files while
+|        the handler runs.
+*/
+class NxsBatchReadWorker
+        {
+        public:
+                NxsBatchReadWorker(const std::vector<std::string> & paths,
+                                                   MultiFormatReader::DataFormatType fmt,
+                                                   NxsBatchReadHandler & h,
+                                                   bool ordered)
+                        :filepaths(paths),
+                        format(fmt),
+                        handler(h),
+                        inInputOrder(ordered),
+                        nextToStart(0),
+                        nextToReport(0),
+                        stopped(false),
+                        reporting(false),
+                        readers(paths.size(), (MultiFormatReader *) 0L),
+                        errors(paths.size()),
+                        finished(paths.size(), 0)
+                        {}
+                ~NxsBatchReadWorker()
+                        {
+                        for (unsigned i = 0; i < readers.size(); ++i)
+                                Dispose(readers[i]);
+                        }
+                void operator()(unsigned, unsigned)
+                        {
+                        for (;;)
+                                {
+                                unsigned fileIndex;
+                                        {
+                                        NxsMutexLocker locker(mutex);
+                                        if (stopped || nextToStart >= filepaths.size())
+                                                return;
+                                        fileIndex = nextToStart++;
+                                        }
+                                ReadOneFile(fileIndex);
+                                }
+                        }
+        private:
+                void ReadOneFile(unsigned fileIndex)
+                        {
+                        const std::string & filepath = filepaths[fileIndex];
+                        MultiFormatReader * reader = 0L;
+                        std::exception_ptr error; /* kept with its dynamic type until the file is reported */
+                        try
+                                {
+                                reader = handler.CreateReader(fileIndex, filepath);
+                                if (reader == 0L)
+                                        throw NxsNCLAPIException("NxsBatchReadHandler::CreateReader returned NULL");
+                                if (reader->GetCancellationToken() == NULL)
+                                        reader->SetCancellationToken(&batchCancellationToken);
+                                reader->ReadFilepath(filepath.c_str(), format);
+                                }
+                        catch (const NxsSignalCanceledParseException &)
+                                {
+                                const bool canceledByBatch = batchCancellationToken.IsCanceled();
+                                Stop(reader);
+                                if (canceledByBatch)
+                                        return; /* another worker is already reporting the reason for stopping */
+                                throw;
+                                }
+                        catch (const NxsException &)
+                                {
+                                error = std::current_exception();
+                                }
+                        catch (...)
+                                {
+                                Stop(reader);
+                                throw;
+                                }
+                                {
+                                NxsMutexLocker locker(mutex);
+                                readers[fileIndex] = reader;
+                                errors[fileIndex] = error;
+                                finished[fileIndex] = 1;
+                                if (!inInputOrder)
+                                        unreported.push_back(fileIndex);
+                                if (reporting)
+                                        return; /* the worker that is reporting will report this file */
+                                reporting = true;
+                                }
+                        ReportReadyFiles();
+                        }
+                /* Called by the worker that set `reporting`. Reports files until none is ready, then clears `reporting`. */
+                void ReportReadyFiles()
+                        {
+                        std::vector<unsigned> toReport;
+                        for (;;)
+                                {
+                                        {
+                                        NxsMutexLocker locker(mutex);
+                                        toReport.clear();
+                                        if (!stopped)
+                                                {
+                                                if (inInputOrder)
+                                                        {
+                                                        while (nextToReport < filepaths.size() && finished[nextToReport])
+                                                                toReport.push_back(nextToReport++);
+                                                        }
+                                                else
+                                                        toReport.swap(unreported);
+                                                }
+                                        if (toReport.empty())
+                                                {
+                                                reporting = false;
+                                                return;
+                                                }
+                                        }
+                                for (std::vector<unsigned>::const_iterator rIt = toReport.begin(); rIt != toReport.end(); ++rIt)
+                                        Report(*rIt);
+                                }
+                        }
+                /* Called without the lock held (only by the reporting worker). Once the batch has stopped no more files
+                        are reported (the readers that have not been reported are deleted by the destructor).
+                */
+                void Report(unsigned fileIndex)
+                        {
+                        MultiFormatReader * reader;
+                        std::exception_ptr error;
+                                {
+                                NxsMutexLocker locker(mutex);
+                                if (stopped)
+                                        return;
+                                reader = readers[fileIndex];
+                                error = errors[fileIndex];
+                                readers[fileIndex] = 0L;
+                                errors[fileIndex] = std::exception_ptr();
+                                }
+                        try
+                                {
+                                if (error)
+                                        {
+                                        try
+                                                {
+                                                std::rethrow_exception(error);
+                                                }
+                                        catch (const NxsException & x)
+                                                {
+                                                handler.FileFailed(fileIndex, filepaths[fileIndex], x);
+                                                }
+                                        }
+                                else
+                                        handler.FileRead(fileIndex, filepaths[fileIndex], *reader);
+                                }
+                        catch (...)
+                                {
+                                Dispose(reader);
+                                NxsMutexLocker locker(mutex);
+                                stopped = true;
+                                batchCancellationToken.Cancel();
+                                throw;
+                                }
+                        Dispose(reader);
+                        }
+                void Stop(MultiFormatReader * reader)
+                        {
+                        Dispose(reader);
+                        NxsMutexLocker locker(mutex);
+                        stopped = true;
+                        batchCancellationToken.Cancel();
+                        }
+                static void Dispose(MultiFormatReader * reader)
+                        {
+                        if (reader)
+                                {
+                                reader->DeleteBlocksFromFactories();
+                                delete reader;
+                                }
+                        }
+
+                const std::vector<std::string> & filepaths;
+                MultiFormatReader::DataFormatType format;
+                NxsBatchReadHandler & handler;
+                bool inInputOrder;
+                NxsMutex mutex;
+                NxsCancellationToken batchCancellationToken; /* canceled when the batch stops, so that files that are being read are abandoned */
+                unsigned nextToStart;
+                unsigned nextToReport;
+                bool stopped;
+                bool reporting; /* true while a worker is calling the handler */
+                std::vector<MultiFormatReader *> readers; /* parsed files that have not been reported yet */
+                std::vector<std::exception_ptr> errors; /* errors that have not been reported yet */
+                std::vector<char> finished;
+                std::vector<unsigned> unreported; /* files that are finished but not reported (if !inInputOrder) */
+        };
+
+void NxsReadFilepaths(
+  const std::vector<std::string> & filepaths,
+  MultiFormatReader::DataFormatType format,
+  NxsBatchReadHandler & handler,
+  unsigned numThreads,
+  bool inInputOrder)
+        {
+        if (filepaths.empty())
+                return;
+        NxsBatchReadWorker worker(filepaths, format, handler, inInputOrder);
+        NxsRunWorkers(worker, NxsChooseNumThreads(numThreads, (unsigned) filepaths.size()));
+        }
@@ -0,0 +1,78 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSBATCHREADER_H
+#define NCL_NXSBATCHREADER_H
+
+#include <string>
+#include <vector>
+#include "ncl/nxsdefs.h"
+#include "ncl/nxsexception.h"
+#include "ncl/nxsmultiformat.h"
+
+/*! Receives the results of NxsReadFilepaths.
+
+        NxsReadFilepaths creates one MultiFormatReader for every file (so each file is read with its own
+        reader and its own block factories). The reader is created by CreateReader, used to parse the file,
+        then passed to FileRead (or the exception is passed to FileFailed). After FileRead or FileFailed
+        returns, DeleteBlocksFromFactories() is called and the reader is deleted.
+
+        If the reader does not have a NxsCancellationToken, it is given one that is shared by the batch, so that
+        an error that stops the batch also stops the other files that are being parsed.
+
+        Calls to FileRead and FileFailed are never made concurrently, so subclasses do not need to lock
+        their own data in those methods. They are made without holding the lock of the batch, so the other files
+        continue to be read while they run. CreateReader can be called from several threads at the same time.
+*/
+class NxsBatchReadHandler
+        {
+        public:
+                virtual ~NxsBatchReadHandler()
+                        {}
+                /*! \returns a new reader (allocated with new) for the file at `filepath`.
+                        The default implementation creates a MultiFormatReader that ignores warnings.
+                */
+                virtual MultiFormatReader * CreateReader(unsigned fileIndex, const std::string & filepath);
+                /*! Called with the `reader` that successfully parsed the file at index `fileIndex` in the list of paths.*/
+                virtual void FileRead(unsigned fileIndex, const std::string & filepath, MultiFormatReader & reader) = 0;
+                /*! Called when reading the file at index `fileIndex` raised `x`. `x` has the type of the exception
+                        that was raised, and FileFailed is called while it is being handled.
+                        The default implementation rethrows `x` (with its own type), which stops the batch (files that
+                        have not been started will not be read).
+                */
+                virtual void FileFailed(unsigned fileIndex, const std::string & filepath, const NxsException & x);
+        };
+
+/*! Reads every file in `filepaths` (all in the format `format`) and reports the results to `handler`.
+
+        `numThreads` files are read at a time (0 means one thread per hardware thread). If `inInputOrder`
+        is true then the results are given to the handler in the same order as `filepaths` (files
+        that finish early are held until the files before them have been reported). Otherwise the
+        results are given to the handler as soon as each file has been read.
+
+        If NCL was built without thread support, the files are read one at a time in input order.
+*/
+void NxsReadFilepaths(
+  const std::vector<std::string> & filepaths,
+  MultiFormatReader::DataFormatType format,
+  NxsBatchReadHandler & handler,
+  unsigned numThreads = 0,
+  bool inInputOrder = true);
+
+#endif
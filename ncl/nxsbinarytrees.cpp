@@ -0,0 +1,702 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdint.h>
+#include "ncl/nxsbinarytrees.h"
+#include "ncl/nxsoutputbuffer.h"
+
+using namespace std;
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Layout of a binary tree collection. Unsigned numbers marked "varint" are written 7 bits per byte (low bits first,
+|        the high bit of a byte is set if more bytes follow). Signed numbers are zig-zag encoded before they are written as
+|        varints. Other numbers use the byte order of the machine that wrote the file.
+|
+|        header:        char[8] "NCLTREES", uint32 format version, uint32 0x01020304 (byte order mark), varint number of
+|                        taxa, then the taxon labels (each as a varint length followed by the characters).
+|        trees:        one record per tree:
+|                        varint name length, name, uint8 record kind, varint flags, zig-zag minIntEdgeLen, double minDblEdgeLen,
+|                        uint8 requireNewickNameTokenizing. Then, depending on the record kind:
+|                        TEXT_RECORD:                varint length, newick string.
+|                        TOPOLOGY_RECORD:        the topology (varint number of nodes, the varint out-degree of each node in preorder,
+|                                                the varint taxon index of each leaf in preorder), then the edge lengths and names.
+|                        SHARED_TOPOLOGY_RECORD:        varint index of the (earlier) tree whose record holds the topology, then the
+|                                                edge lengths and names.
+|                        edge lengths:        uint8 kind (0 = none, 1 = integers, 2 = doubles, 3 = decimals). For decimals, a uint8
+|                                                number of decimal places follows. Unless the kind is 0: a bit for each node (set
+|                                                if the node has an edge length), followed by the lengths of those nodes (doubles,
+|                                                or zig-zag varints of the integer lengths or of length*10^places). If the 0x80 bit
+|                                                of the kind of doubles or decimals is set, the tree also has integer edge lengths,
+|                                                and a bit for each node (set if its edge length is an integer) follows the
+|                                                bits of the nodes that have edge lengths.
+|                        names:                varint number of named (internal) nodes, then the varint preorder index, varint length
+|                                                and characters of each name.
+|        index:        uint64 offset of each tree record, uint64 number of trees, uint64 offset of the index.
+*/
+namespace
+{
+const char kBinaryTreesMagic[8] = {'N', 'C', 'L', 'T', 'R', 'E', 'E', 'S'};
+const uint32_t kByteOrderMark = 0x01020304;
+
+enum TreeRecordKind
+        {
+        TEXT_RECORD = 0,
+        TOPOLOGY_RECORD = 1,
+        SHARED_TOPOLOGY_RECORD = 2
+        };
+
+enum EdgeLengthKind
+        {
+        NO_EDGE_LENGTHS = 0,
+        INT_EDGE_LENGTHS = 1,
+        DBL_EDGE_LENGTHS = 2,
+        DECIMAL_EDGE_LENGTHS = 3
+        };
+const unsigned kHasIntEdgeLengthsBit = 0x80; /* set in the kind of doubles or decimals if some of the lengths are integers */
+
+const unsigned kMaxDecimalPlaces = 9;
+const int64_t kMaxExactInteger = ((int64_t) 1) << 53;
+const double kPowersOfTen[kMaxDecimalPlaces + 1] = {1.0, 10.0, 100.0, 1000.0, 1.0e4, 1.0e5, 1.0e6, 1.0e7, 1.0e8, 1.0e9};
+
+/* \returns the smallest number of decimal places (up to kMaxDecimalPlaces) with which `d` can be written as
+        mantissa/10^places (the mantissa is stored in `mantissa`), or UINT_MAX if there is no such number.
+        A decimal number with up to 9 decimal places is always found, because dividing the (exact) mantissa by the
+        (exact) power of ten is rounded the same way as strtod rounds the decimal number.
+*/
+unsigned FindDecimalPlaces(double d, int64_t * mantissa)
+        {
+        for (unsigned places = 0; places <= kMaxDecimalPlaces; ++places)
+                {
+                const double scaled = d*kPowersOfTen[places];
+                if (scaled >= (double) kMaxExactInteger || scaled <= -(double) kMaxExactInteger)
+                        return UINT_MAX;
+                const int64_t m = (int64_t) (scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+                if (((double) m)/kPowersOfTen[places] == d)
+                        {
+                        *mantissa = m;
+                        return places;
+                        }
+                }
+        return UINT_MAX;
+        }
+
+void AppendVarint(std::string & buffer, uint64_t value)
+        {
+        while (value >= 0x80)
+                {
+                buffer.push_back((char) ((value & 0x7F) | 0x80));
+                value >>= 7;
+                }
+        buffer.push_back((char) value);
+        }
+
+void AppendZigZag(std::string & buffer, int64_t v)
+        {
+        AppendVarint(buffer, (((uint64_t) v) << 1) ^ (uint64_t) (v >> 63));
+        }
+
+void AppendString(std::string & buffer, const std::string & s)
+        {
+        AppendVarint(buffer, s.length());
+        buffer.append(s);
+        }
+
+template<typename T>
+void AppendBinary(std::string & buffer, T value)
+        {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+/* Appends mantissa/10^places as a decimal number (without trailing zeros after the decimal point). If the number is
+        an integer, it is written without a decimal point, unless `keepDecimalPoint` is true (then "1.0" is written
+        instead of "1").
+*/
+void AppendDecimalText(std::string & buffer, int64_t mantissa, unsigned places, bool keepDecimalPoint)
+        {
+        if (mantissa < 0)
+                {
+                buffer.push_back('-');
+                mantissa = -mantissa;
+                }
+        uint64_t m = (uint64_t) mantissa;
+        while (places > 0 && m % 10 == 0)
+                {
+                m /= 10;
+                --places;
+                }
+        char digits[32];
+        char * end = digits + sizeof(digits);
+        char * p = end;
+        for (unsigned k = 0; k < places; ++k)
+                {
+                *(--p) = (char) ('0' + (m % 10));
+                m /= 10;
+                }
+        if (places > 0)
+                *(--p) = '.';
+        do
+                {
+                *(--p) = (char) ('0' + (m % 10));
+                m /= 10;
+                }
+        while (m > 0);
+        buffer.append(p, end);
+        if (places == 0 && keepDecimalPoint)
+                buffer.append(".0");
+        }
+
+/* Reads the numbers in a tree collection, checking that every read is within the collection */
+class BinaryTreesCursor
+        {
+        public:
+                BinaryTreesCursor(const char * start, const char * endOfData)
+                        :curr(start),
+                        end(endOfData)
+                        {}
+                const char * Advance(std::size_t n)
+                        {
+                        if ((std::size_t)(end - curr) < n)
+                                throw NxsException("The binary tree collection is truncated or corrupted");
+                        const char * p = curr;
+                        curr += n;
+                        return p;
+                        }
+                template<typename T>
+                T Read()
+                        {
+                        T value;
+                        std::memcpy(&value, Advance(sizeof(T)), sizeof(T));
+                        return value;
+                        }
+                uint64_t ReadVarint()
+                        {
+                        uint64_t value = 0;
+                        for (unsigned shift = 0; shift < 64; shift += 7)
+                                {
+                                const unsigned char b = (unsigned char) *Advance(1);
+                                value |= ((uint64_t) (b & 0x7F)) << shift;
+                                if ((b & 0x80) == 0)
+                                        return value;
+                                }
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                        }
+                /* reads the number of items that follow, when every item takes at least one byte */
+                unsigned ReadCount()
+                        {
+                        const uint64_t v = ReadVarint();
+                        if (v > (uint64_t) (end - curr) + 1)
+                                throw NxsException("The binary tree collection is truncated or corrupted");
+                        return (unsigned) v;
+                        }
+                int64_t ReadZigZag()
+                        {
+                        const uint64_t v = ReadVarint();
+                        return ((int64_t) (v >> 1) ^ -((int64_t) (v & 1)));
+                        }
+                std::string ReadString()
+                        {
+                        const unsigned len = ReadCount();
+                        return std::string(Advance(len), len);
+                        }
+        private:
+                const char * curr;
+                const char * end;
+        };
+
+/* The fields that precede the body of every tree record */
+class TreeRecordHeader
+        {
+        public:
+                std::string name;
+                unsigned kind;
+                int flags;
+                int minIntEdgeLen;
+                double minDblEdgeLen;
+                bool requireNewickNameTokenizing;
+
+                void Read(BinaryTreesCursor & cursor)
+                        {
+                        name = cursor.ReadString();
+                        kind = cursor.Read<uint8_t>();
+                        flags = (int) cursor.ReadVarint();
+                        minIntEdgeLen = (int) cursor.ReadZigZag();
+                        minDblEdgeLen = cursor.Read<double>();
+                        requireNewickNameTokenizing = (cursor.Read<uint8_t>() != 0);
+                        }
+        };
+
+/* Reads the out-degrees and leaf taxon indices of a TOPOLOGY_RECORD */
+void ReadTopology(BinaryTreesCursor & cursor, std::vector<unsigned> & outDegree, std::vector<unsigned> & leafTaxa)
+        {
+        const unsigned nNodes = cursor.ReadCount();
+        outDegree.resize(nNodes);
+        unsigned nLeaves = 0;
+        for (unsigned i = 0; i < nNodes; ++i)
+                {
+                outDegree[i] = (unsigned) cursor.ReadVarint();
+                if (outDegree[i] == 0)
+                        ++nLeaves;
+                }
+        leafTaxa.resize(nLeaves);
+        for (unsigned i = 0; i < nLeaves; ++i)
+                leafTaxa[i] = (unsigned) cursor.ReadVarint();
+        }
+
+void AppendTopology(std::string & buffer, const std::vector<const NxsSimpleNode *> & preorder)
+        {
+        AppendVarint(buffer, preorder.size());
+        for (std::vector<const NxsSimpleNode *>::const_iterator nIt = preorder.begin(); nIt != preorder.end(); ++nIt)
+                AppendVarint(buffer, (*nIt)->GetOutDegree());
+        for (std::vector<const NxsSimpleNode *>::const_iterator nIt = preorder.begin(); nIt != preorder.end(); ++nIt)
+                {
+                if ((*nIt)->IsTip())
+                        AppendVarint(buffer, (*nIt)->GetTaxonIndex());
+                }
+        }
+
+void AppendEdgeLengthsAndNames(std::string & buffer, const std::vector<const NxsSimpleNode *> & preorder)
+        {
+        const unsigned nNodes = (unsigned) preorder.size();
+        bool anyLength = false;
+        bool allInts = true;
+        bool anyInt = false;
+        std::string present((nNodes + 7)/8, '\0');
+        std::string isInt((nNodes + 7)/8, '\0');
+        for (unsigned i = 0; i < nNodes; ++i)
+                {
+                const NxsSimpleEdge & edge = preorder[i]->GetEdgeToParentRef();
+                if (edge.EdgeLenIsDefaultValue())
+                        continue;
+                anyLength = true;
+                present[i/8] |= (char) (1 << (i % 8));
+                if (!edge.IsIntEdgeLen())
+                        allInts = false;
+                if (edge.EdgeLenIsWrittenAsInt())
+                        {
+                        anyInt = true;
+                        isInt[i/8] |= (char) (1 << (i % 8));
+                        }
+                }
+        /* lengths that were written with a few decimal places (as most programs write them) are stored as integers */
+        std::vector<int64_t> mantissas;
+        std::vector<unsigned> placesOfLength;
+        unsigned decimalPlaces = 0;
+        if (anyLength && !allInts)
+                {
+                mantissas.resize(nNodes, 0);
+                placesOfLength.resize(nNodes, 0);
+                for (unsigned i = 0; i < nNodes && decimalPlaces != UINT_MAX; ++i)
+                        {
+                        const NxsSimpleEdge & edge = preorder[i]->GetEdgeToParentRef();
+                        if (edge.EdgeLenIsDefaultValue())
+                                continue;
+                        const unsigned places = FindDecimalPlaces(edge.GetDblEdgeLen(), &mantissas[i]);
+                        placesOfLength[i] = places;
+                        if (places == UINT_MAX)
+                                decimalPlaces = UINT_MAX;
+                        else if (places > decimalPlaces)
+                                decimalPlaces = places;
+                        }
+                /* rescale the mantissas to the common number of decimal places */
+                for (unsigned i = 0; i < nNodes && decimalPlaces != UINT_MAX; ++i)
+                        {
+                        const NxsSimpleEdge & edge = preorder[i]->GetEdgeToParentRef();
+                        if (edge.EdgeLenIsDefaultValue())
+                                continue;
+                        const unsigned shift = decimalPlaces - placesOfLength[i];
+                        const double scaled = ((double) mantissas[i])*kPowersOfTen[shift];
+                        if (scaled >= (double) kMaxExactInteger || scaled <= -(double) kMaxExactInteger)
+                                decimalPlaces = UINT_MAX;
+                        else
+                                mantissas[i] *= (int64_t) kPowersOfTen[shift];
+                        }
+                }
+        if (!anyLength)
+                AppendBinary<uint8_t>(buffer, NO_EDGE_LENGTHS);
+        else
+                {
+                EdgeLengthKind kind = DBL_EDGE_LENGTHS;
+                if (allInts)
+                        kind = INT_EDGE_LENGTHS;
+                else if (decimalPlaces != UINT_MAX)
+                        kind = DECIMAL_EDGE_LENGTHS;
+                /* the integer lengths of a tree that also has other lengths are marked, so that they are written back
+                        as integers */
+                const bool markInts = (anyInt && !allInts);
+                AppendBinary<uint8_t>(buffer, (uint8_t) (markInts ? (kind | kHasIntEdgeLengthsBit) : kind));
+                if (kind == DECIMAL_EDGE_LENGTHS)
+                        AppendBinary<uint8_t>(buffer, (uint8_t) decimalPlaces);
+                buffer.append(present);
+                if (markInts)
+                        buffer.append(isInt);
+                for (unsigned i = 0; i < nNodes; ++i)
+                        {
+                        const NxsSimpleEdge & edge = preorder[i]->GetEdgeToParentRef();
+                        if (edge.EdgeLenIsDefaultValue())
+                                continue;
+                        if (kind == INT_EDGE_LENGTHS)
+                                AppendZigZag(buffer, edge.GetIntEdgeLen());
+                        else if (kind == DECIMAL_EDGE_LENGTHS)
+                                AppendZigZag(buffer, mantissas[i]);
+                        else
+                                AppendBinary<double>(buffer, edge.GetDblEdgeLen());
+                        }
+                }
+        unsigned nNamed = 0;
+        for (unsigned i = 0; i < nNodes; ++i)
+                {
+                if (!preorder[i]->IsTip() && !preorder[i]->GetName().empty())
+                        ++nNamed;
+                }
+        AppendVarint(buffer, nNamed);
+        for (unsigned i = 0; nNamed > 0 && i < nNodes; ++i)
+                {
+                if (!preorder[i]->IsTip() && !preorder[i]->GetName().empty())
+                        {
+                        AppendVarint(buffer, i);
+                        AppendString(buffer, preorder[i]->GetName());
+                        }
+                }
+        }
+
+/* Builds the newick string (with 1-based taxon numbers) of a tree from its topology, edge lengths and names. */
+std::string BuildNewick(const std::vector<unsigned> & outDegree,
+                        const std::vector<unsigned> & leafTaxa,
+                        BinaryTreesCursor & cursor,
+                        const std::vector<unsigned> * taxonIndices,
+                        unsigned nTaxa)
+        {
+        const unsigned nNodes = (unsigned) outDegree.size();
+        const unsigned kindByte = cursor.Read<uint8_t>();
+        const unsigned lengthKind = (kindByte & ~kHasIntEdgeLengthsBit);
+        const bool marksInts = ((kindByte & kHasIntEdgeLengthsBit) != 0);
+        if (lengthKind > DECIMAL_EDGE_LENGTHS || (marksInts && lengthKind != DBL_EDGE_LENGTHS && lengthKind != DECIMAL_EDGE_LENGTHS))
+                throw NxsException("The binary tree collection is truncated or corrupted");
+        unsigned decimalPlaces = 0;
+        if (lengthKind == DECIMAL_EDGE_LENGTHS)
+                {
+                decimalPlaces = cursor.Read<uint8_t>();
+                if (decimalPlaces > kMaxDecimalPlaces)
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                }
+        const unsigned char * present = 0L;
+        const unsigned char * isInt = 0L;
+        std::vector<int64_t> intLengths;
+        std::vector<double> dblLengths;
+        if (lengthKind != NO_EDGE_LENGTHS)
+                {
+                present = reinterpret_cast<const unsigned char *>(cursor.Advance((nNodes + 7)/8));
+                if (marksInts)
+                        isInt = reinterpret_cast<const unsigned char *>(cursor.Advance((nNodes + 7)/8));
+                if (lengthKind == DBL_EDGE_LENGTHS)
+                        dblLengths.resize(nNodes);
+                else
+                        intLengths.resize(nNodes);
+                for (unsigned i = 0; i < nNodes; ++i)
+                        {
+                        if ((present[i/8] & (1 << (i % 8))) == 0)
+                                continue;
+                        if (lengthKind == DBL_EDGE_LENGTHS)
+                                dblLengths[i] = cursor.Read<double>();
+                        else
+                                intLengths[i] = cursor.ReadZigZag();
+                        }
+                }
+        std::vector<std::string> names;
+        const unsigned nNamed = cursor.ReadCount();
+        if (nNamed > 0)
+                names.resize(nNodes);
+        for (unsigned i = 0; i < nNamed; ++i)
+                {
+                const uint64_t nodeIndex = cursor.ReadVarint();
+                if (nodeIndex >= nNodes)
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                names[(unsigned) nodeIndex] = NxsString::GetEscaped(cursor.ReadString());
+                }
+
+        std::string newick;
+        newick.reserve(16*nNodes);
+        std::vector<unsigned> openNodes;
+        std::vector<unsigned> childrenWritten;
+        unsigned leafIndex = 0;
+        for (unsigned i = 0; i < nNodes; ++i)
+                {
+                if (!openNodes.empty())
+                        {
+                        if (childrenWritten.back() > 0)
+                                newick.push_back(',');
+                        ++childrenWritten.back();
+                        }
+                else if (i > 0)
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                if (outDegree[i] > 0)
+                        {
+                        newick.push_back('(');
+                        openNodes.push_back(i);
+                        childrenWritten.push_back(0);
+                        continue;
+                        }
+                unsigned taxonIndex = leafTaxa[leafIndex++];
+                if (taxonIndex >= nTaxa)
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                if (taxonIndices)
+                        taxonIndex = (*taxonIndices)[taxonIndex];
+                AppendDecimalText(newick, 1 + (int64_t) taxonIndex, 0, false);
+                unsigned nodeToClose = i;
+                for (;;)
+                        {
+                        if (present != 0L && (present[nodeToClose/8] & (1 << (nodeToClose % 8))) != 0)
+                                {
+                                newick.push_back(':');
+                                const bool writeAsDouble = (lengthKind != INT_EDGE_LENGTHS && (isInt == 0L || (isInt[nodeToClose/8] & (1 << (nodeToClose % 8))) == 0));
+                                if (lengthKind == DBL_EDGE_LENGTHS)
+                                        NxsAppendShortestDouble(newick, dblLengths[nodeToClose], writeAsDouble);
+                                else
+                                        AppendDecimalText(newick, intLengths[nodeToClose], decimalPlaces, writeAsDouble);
+                                }
+                        if (openNodes.empty() || childrenWritten.back() < outDegree[openNodes.back()])
+                                break;
+                        nodeToClose = openNodes.back();
+                        openNodes.pop_back();
+                        childrenWritten.pop_back();
+                        newick.push_back(')');
+                        if (!names.empty())
+                                newick.append(names[nodeToClose]);
+                        }
+                }
+        if (!openNodes.empty())
+                throw NxsException("The binary tree collection is truncated or corrupted");
+        return newick;
+        }
+} // anonymous namespace
+
+void NxsBinaryTreeCollection::Write(std::ostream & out,
+                                    const std::vector<std::string> & labels,
+                                    const std::vector<NxsFullTreeDescription> & trees,
+                                    bool shareTopologies)
+        {
+        std::string buffer(kBinaryTreesMagic, sizeof(kBinaryTreesMagic));
+        AppendBinary<uint32_t>(buffer, (uint32_t) FORMAT_VERSION);
+        AppendBinary<uint32_t>(buffer, kByteOrderMark);
+        AppendVarint(buffer, labels.size());
+        for (std::vector<std::string>::const_iterator lIt = labels.begin(); lIt != labels.end(); ++lIt)
+                AppendString(buffer, *lIt);
+
+        std::vector<uint64_t> offsets;
+        offsets.reserve(trees.size());
+        uint64_t written = 0;
+        std::map<std::string, unsigned> topologyToTree;
+        std::string topology;
+        NxsSimpleTree nst(0, 0.0);
+        for (unsigned k = 0; k < trees.size(); ++k)
+                {
+                const NxsFullTreeDescription & td = trees[k];
+                if (!td.IsProcessed())
+                        throw NxsNCLAPIException("Trees must be processed before they are written as a binary tree collection");
+                offsets.push_back(written + buffer.size());
+                AppendString(buffer, td.GetName());
+                const bool asText = (td.GetNewick().find('[') != std::string::npos);
+                unsigned sharedWith = UINT_MAX;
+                std::vector<const NxsSimpleNode *> preorder;
+                if (!asText)
+                        {
+                        nst.Initialize(td, true);
+                        preorder = nst.GetPreorderTraversal();
+                        topology.clear();
+                        AppendTopology(topology, preorder);
+                        if (shareTopologies)
+                                {
+                                std::map<std::string, unsigned>::const_iterator tIt = topologyToTree.find(topology);
+                                if (tIt == topologyToTree.end())
+                                        topologyToTree[topology] = k;
+                                else
+                                        sharedWith = tIt->second;
+                                }
+                        }
+                const TreeRecordKind kind = (asText ? TEXT_RECORD : (sharedWith == UINT_MAX ? TOPOLOGY_RECORD : SHARED_TOPOLOGY_RECORD));
+                AppendBinary<uint8_t>(buffer, (uint8_t) kind);
+                AppendVarint(buffer, (uint64_t) (unsigned) td.flags);
+                AppendZigZag(buffer, td.minIntEdgeLen);
+                AppendBinary<double>(buffer, td.minDblEdgeLen);
+                AppendBinary<uint8_t>(buffer, (uint8_t) (td.RequiresNewickNameTokenizing() ? 1 : 0));
+                if (kind == TEXT_RECORD)
+                        AppendString(buffer, td.GetNewick());
+                else
+                        {
+                        if (kind == TOPOLOGY_RECORD)
+                                buffer.append(topology);
+                        else
+                                AppendVarint(buffer, sharedWith);
+                        AppendEdgeLengthsAndNames(buffer, preorder);
+                        }
+                if (buffer.size() >= 65536)
+                        {
+                        out.write(buffer.data(), (std::streamsize) buffer.size());
+                        written += buffer.size();
+                        buffer.clear();
+                        }
+                }
+        const uint64_t indexOffset = written + buffer.size();
+        for (std::vector<uint64_t>::const_iterator oIt = offsets.begin(); oIt != offsets.end(); ++oIt)
+                AppendBinary<uint64_t>(buffer, *oIt);
+        AppendBinary<uint64_t>(buffer, (uint64_t) offsets.size());
+        AppendBinary<uint64_t>(buffer, indexOffset);
+        out.write(buffer.data(), (std::streamsize) buffer.size());
+        if (!out.good())
+                throw NxsException("Error writing the binary tree collection");
+        }
+
+bool NxsBinaryTreeCollection::IsBinaryTreeCollection(std::istream & inp)
+        {
+        char start[sizeof(kBinaryTreesMagic)];
+        const std::streampos pos = inp.tellg();
+        inp.read(start, sizeof(start));
+        const bool matches = (inp.gcount() == (std::streamsize) sizeof(start) && std::memcmp(start, kBinaryTreesMagic, sizeof(start)) == 0);
+        inp.clear();
+        inp.seekg(pos);
+        return matches;
+        }
+
+void NxsBinaryTreeCollection::ReadFilepath(const char * filepath)
+        {
+        std::ifstream inp(filepath, std::ios::binary);
+        if (!inp.good())
+                {
+                NxsString msg;
+                msg << "Could not open the file \"" << filepath << "\"";
+                throw NxsException(msg);
+                }
+        ReadStream(inp);
+        }
+
+void NxsBinaryTreeCollection::ReadStream(std::istream & inp)
+        {
+        contents.clear();
+        const std::streampos start = inp.tellg();
+        inp.seekg(0, std::ios::end);
+        const std::streampos end = inp.tellg();
+        if (start != std::streampos(-1) && end != std::streampos(-1) && inp.good())
+                {
+                inp.seekg(start);
+                contents.resize((std::size_t) (end - start));
+                if (!contents.empty())
+                        inp.read(&contents[0], (std::streamsize) contents.size());
+                if ((std::size_t) inp.gcount() != contents.size())
+                        throw NxsException("Error reading the binary tree collection");
+                }
+        else
+                {
+                /* the stream cannot seek (a pipe, for example) */
+                inp.clear();
+                contents.assign(std::istreambuf_iterator<char>(inp), std::istreambuf_iterator<char>());
+                }
+        taxonLabels.clear();
+        treeOffsets.clear();
+        const char * data = (contents.empty() ? 0L : &contents[0]);
+        const std::size_t dataLength = contents.size();
+        BinaryTreesCursor cursor(data, data + dataLength);
+        if (dataLength < sizeof(kBinaryTreesMagic) || std::memcmp(cursor.Advance(sizeof(kBinaryTreesMagic)), kBinaryTreesMagic, sizeof(kBinaryTreesMagic)) != 0)
+                throw NxsException("The file is not a binary tree collection");
+        const uint32_t version = cursor.Read<uint32_t>();
+        const uint32_t bom = cursor.Read<uint32_t>();
+        if (version != FORMAT_VERSION || bom != kByteOrderMark)
+                throw NxsException("The binary tree collection was written by a version of NCL (or a machine) that uses a different format");
+        const unsigned nTaxa = cursor.ReadCount();
+        taxonLabels.reserve(nTaxa);
+        for (unsigned i = 0; i < nTaxa; ++i)
+                taxonLabels.push_back(cursor.ReadString());
+
+        if (dataLength < 2*sizeof(uint64_t))
+                throw NxsException("The binary tree collection is truncated or corrupted");
+        BinaryTreesCursor footer(data + dataLength - 2*sizeof(uint64_t), data + dataLength);
+        const uint64_t nTrees = footer.Read<uint64_t>();
+        const uint64_t indexOffset = footer.Read<uint64_t>();
+        if (indexOffset > dataLength || nTrees > (dataLength - indexOffset)/sizeof(uint64_t))
+                throw NxsException("The binary tree collection is truncated or corrupted");
+        BinaryTreesCursor index(data + indexOffset, data + dataLength);
+        treeOffsets.resize((std::size_t) nTrees);
+        for (std::size_t i = 0; i < treeOffsets.size(); ++i)
+                {
+                const uint64_t offset = index.Read<uint64_t>();
+                if (offset >= indexOffset)
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                treeOffsets[i] = (std::size_t) offset;
+                }
+        }
+
+NxsFullTreeDescription NxsBinaryTreeCollection::GetTreeDescription(unsigned treeIndex, const std::vector<unsigned> * taxonIndices) const
+        {
+        if (treeIndex >= treeOffsets.size())
+                throw NxsNCLAPIException("Tree index out of range in NxsBinaryTreeCollection::GetTreeDescription");
+        const char * data = &contents[0];
+        const char * endOfData = data + contents.size();
+        BinaryTreesCursor cursor(data + treeOffsets[treeIndex], endOfData);
+        TreeRecordHeader header;
+        header.Read(cursor);
+        std::string newick;
+        if (header.kind == TEXT_RECORD)
+                {
+                if (taxonIndices)
+                        {
+                        for (unsigned i = 0; i < taxonIndices->size(); ++i)
+                                {
+                                if ((*taxonIndices)[i] != i)
+                                        {
+                                        NxsString msg;
+                                        msg << "The tree " << header.name << " in the binary tree collection is stored as text, and cannot be read into a taxa block with different taxa";
+                                        throw NxsException(msg);
+                                        }
+                                }
+                        }
+                newick = cursor.ReadString();
+                }
+        else
+                {
+                std::vector<unsigned> outDegree;
+                std::vector<unsigned> leafTaxa;
+                if (header.kind == TOPOLOGY_RECORD)
+                        ReadTopology(cursor, outDegree, leafTaxa);
+                else if (header.kind == SHARED_TOPOLOGY_RECORD)
+                        {
+                        const uint64_t sharedWith = cursor.ReadVarint();
+                        if (sharedWith >= treeIndex)
+                                throw NxsException("The binary tree collection is truncated or corrupted");
+                        BinaryTreesCursor topologyCursor(data + treeOffsets[(unsigned) sharedWith], endOfData);
+                        TreeRecordHeader sharedHeader;
+                        sharedHeader.Read(topologyCursor);
+                        if (sharedHeader.kind != TOPOLOGY_RECORD)
+                                throw NxsException("The binary tree collection is truncated or corrupted");
+                        ReadTopology(topologyCursor, outDegree, leafTaxa);
+                        }
+                else
+                        throw NxsException("The binary tree collection is truncated or corrupted");
+                newick = BuildNewick(outDegree, leafTaxa, cursor, taxonIndices, GetNumTaxa());
+                }
+        NxsFullTreeDescription td(newick, header.name, header.flags);
+        td.minIntEdgeLen = header.minIntEdgeLen;
+        td.minDblEdgeLen = header.minDblEdgeLen;
+        td.requireNewickNameTokenizing = header.requireNewickNameTokenizing;
+        return td;
+        }
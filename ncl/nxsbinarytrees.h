@@ -0,0 +1,108 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSBINARYTREES_H
+#define NCL_NXSBINARYTREES_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ncl/nxsdefs.h"
+#include "ncl/nxstreesblock.h"
+
+/*! Reads the compact binary format for collections of trees (such as the trees sampled by an MCMC run).
+
+        A binary tree collection has one table of taxon labels, followed by one record per tree and an index of the
+        offsets of the records (so any tree can be read without reading the trees before it). A tree record stores:
+                - the name of the tree and the flags of its NxsFullTreeDescription,
+                - the topology, as the out-degree of every node in preorder and the taxon index of every leaf. If the
+                        topology (including the order of the children) is identical to the topology of an earlier tree,
+                        only the index of that tree is stored. Posterior samples usually repeat a small number of topologies,
+                        so most records hold only edge lengths.
+                - the edge lengths and the labels of labelled internal nodes. Edge lengths are stored as numbers: lengths
+                        that have at most 9 decimal places (which covers the output of most programs) are stored as variable
+                        length integers (scaled by a power of ten), other lengths as doubles.
+        Trees with comments in their newick description (NHX or other metadata) are stored as newick text.
+
+        Numbers are stored with the byte order of the machine that wrote the file. Reading a file written with a
+        different byte order (or a different version of the format) raises an NxsException.
+
+        Edge lengths are stored as numbers, so the newick strings returned by GetTreeDescription write each edge length in
+        the shortest form that is read back as the same value (an edge length written as "0.10" in the original file
+        is returned as "0.1"). The kind of every edge length is kept: lengths that are doubles keep a decimal point
+        ("1.0" is not returned as "1"), so they are still read as doubles, and integer lengths are written as integers
+        (also in trees that have both kinds of lengths).
+
+        Files are written with NxsTreesBlock::WriteAsBinaryTreeCollection, and can be read into a NxsTreesBlock with
+        NxsTreesBlock::ReadBinaryTreeCollection (or with MultiFormatReader using NCL_BINARY_TREES_FORMAT).
+*/
+class NxsBinaryTreeCollection
+        {
+        public:
+                enum {FORMAT_VERSION = 1};
+
+                NxsBinaryTreeCollection()
+                        {}
+                /*! Reads a binary tree collection from `inp` (which should be opened in binary mode).
+                        Raises an NxsException if the stream does not hold a binary tree collection.
+                */
+                void ReadStream(std::istream & inp);
+                /*! Reads the binary tree collection in the file `filepath` (see ReadStream). */
+                void ReadFilepath(const char * filepath);
+
+                unsigned GetNumTaxa() const
+                        {
+                        return (unsigned) taxonLabels.size();
+                        }
+                const std::vector<std::string> & GetTaxonLabels() const
+                        {
+                        return taxonLabels;
+                        }
+                unsigned GetNumTrees() const
+                        {
+                        return (unsigned) treeOffsets.size();
+                        }
+                /*! \returns the description of tree `treeIndex`, with 1-based taxon numbers in its newick string (the
+                        same form that NxsTreesBlock stores). Only the record of the tree (and the record of the tree that holds
+                        its topology) are read.
+
+                        If `taxonIndices` is not NULL, taxon `i` of the collection is written as taxon `(*taxonIndices)[i]`
+                        (this is used to read the trees into a taxa block that orders the taxa differently). Trees that are
+                        stored as text cannot be renumbered, and raise an NxsException.
+                */
+                NxsFullTreeDescription GetTreeDescription(unsigned treeIndex, const std::vector<unsigned> * taxonIndices = NULL) const;
+
+                /*! Writes the `trees` (which must be processed) as a binary tree collection that uses `taxonLabels` as
+                        its taxon table. If `shareTopologies` is false, the topology is stored in every tree record.
+                */
+                static void Write(std::ostream & out,
+                                  const std::vector<std::string> & taxonLabels,
+                                  const std::vector<NxsFullTreeDescription> & trees,
+                                  bool shareTopologies = true);
+                /*! \returns true if `inp` starts with the bytes that mark a binary tree collection. The stream position is
+                        restored.
+                */
+                static bool IsBinaryTreeCollection(std::istream & inp);
+        private:
+                std::vector<char> contents;
+                std::vector<std::string> taxonLabels;
+                std::vector<std::size_t> treeOffsets;
+        };
+
+#endif
@@ -128,7 +128,7 @@ void NxsBlock::WarnDangerousContent(const std::string &s, const ProcessedNxsToke
         }
 void NxsBlock::SkipCommand(NxsToken & token)
         {
-        if (nexusReader)
+        if (nexusReader && nexusReader->ShouldReportWarning(NxsReader::SKIPPING_CONTENT_WARNING))
                 {
                 errormsg = "Skipping command: ";
                 errormsg << token.GetTokenReference();
@@ -199,7 +199,7 @@ void NxsBlock::HandleTitleCommand(NxsToken & token)
         token.GetNextToken();
         if (token.Equals(";"))
                 GenerateUnexpectedTokenNxsException(token, "a title for the block");
-        if (!title.empty() && nexusReader)
+        if (!title.empty() && nexusReader && nexusReader->ShouldReportWarning(NxsReader::OVERWRITING_CONTENT_WARNING))
                 {
                 errormsg = "Multiple TITLE commands were encountered the title \"";
                 errormsg += title;
@@ -24,6 +24,8 @@
 #include <climits>
 
 #include "ncl/nxscharactersblock.h"
+#include "ncl/nxsoutputbuffer.h"
+#include "ncl/nxsparallel.h"
 #include "ncl/nxsreader.h"
 #include "ncl/nxsassumptionsblock.h"
 #include "ncl/nxssetreader.h"
@@ -2062,9 +2064,9 @@ void NxsCharactersBlock::HandleFormat(
                                 const char c = *pp;
                                 if (IsInSymbols(c))
                                         {
-                                        errormsg << "The character " << c << " defined in SYMBOLS is predefined for this DATATYPE and should not occur in a SYMBOLS statement";
-                                        if (nexusReader)
+                                        if (nexusReader && nexusReader->ShouldReportWarning(NxsReader::SKIPPING_CONTENT_WARNING))
                                                 {
+                                                errormsg << "The character " << c << " defined in SYMBOLS is predefined for this DATATYPE and should not occur in a SYMBOLS statement";
                                                 nexusReader->NexusWarnToken(errormsg, NxsReader::SKIPPING_CONTENT_WARNING, token);
                                                 errormsg.clear();
                                                 }
@@ -2084,14 +2086,12 @@ void NxsCharactersBlock::HandleFormat(
                                         {
                                         if (this->allowAugmentingOfSequenceSymbols)
                                                 {
-                                                errormsg << "Adding symbols to the " << GetNameOfDatatype(this->datatype) << " datatype will cause the matrix to be treated as if it were a";
-                                                if (this->convertAugmentedToMixed)
-                                                        errormsg << " MIXED datatype matrix";
-                                                else
-                                                        errormsg << " STANDARD datatype matrix";
-                                                if (!this->convertAugmentedToMixed)
+                                                if (!this->convertAugmentedToMixed && nexusReader && nexusReader->ShouldReportWarning(NxsReader::AMBIGUOUS_CONTENT_WARNING))
+                                                        {
+                                                        errormsg << "Adding symbols to the " << GetNameOfDatatype(this->datatype) << " datatype will cause the matrix to be treated as if it were a STANDARD datatype matrix";
                                                         nexusReader->NexusWarnToken(errormsg, NxsReader::AMBIGUOUS_CONTENT_WARNING, token);
-                                                errormsg.clear();
+                                                        errormsg.clear();
+                                                        }
                                                 }
                                         else
                                                 {
@@ -2848,6 +2848,74 @@ void NxsDiscreteDatatypeMapper::WriteStateCodeAsNexusString(std::ostream & out,
         out <<        (stateSetInfo.isPolymorphic ? ')' : '}');
         }
 
+/*!
+        Appends the NEXUS representation of `scode` to `buffer` (see WriteStateCodeAsNexusString).
+*/
+void NxsDiscreteDatatypeMapper::AppendStateCodeAsNexus(std::string & buffer, NxsDiscreteStateCell scode) const
+        {
+        if (scode >= sclOffset && scode < sclOffset + (NxsDiscreteStateCell) stateSetsVec.size())
+                {
+                const char c = stateCodeLookupPtr[scode].nexusSymbol;
+                if (c != '\0')
+                        {
+                        buffer.push_back(c);
+                        return;
+                        }
+                }
+        std::ostringstream o;
+        WriteStateCodeAsNexusString(o, scode, true);
+        buffer.append(o.str());
+        }
+
+/*!
+        Fills `symbolLookup` with the NEXUS symbol of every state code (indexed by code - sclOffset), or '\0' for the
+        codes that are written with more than one character. The table is only valid until new state sets are added
+        to the mapper.
+*/
+void NxsDiscreteDatatypeMapper::FillNexusSymbolLookup(std::vector<char> & symbolLookup) const
+        {
+        const unsigned nCodes = (unsigned) stateSetsVec.size();
+        symbolLookup.resize(nCodes);
+        for (unsigned i = 0; i < nCodes; ++i)
+                symbolLookup[i] = stateSetsVec[i].nexusSymbol;
+        }
+
+/*!
+        Appends the NEXUS representation of the state codes in [`begIt`, `endIt`) to `buffer`.
+        The symbols of all of the state codes are gathered into a lookup table first, so most cells are converted with
+        one table lookup. Callers that write many rows should build the table once with FillNexusSymbolLookup and use
+        the overload that takes it.
+*/
+void NxsDiscreteDatatypeMapper::AppendStateCodeRowAsNexus(std::string & buffer, NxsDiscreteStateRow::const_iterator begIt, const NxsDiscreteStateRow::const_iterator & endIt) const
+        {
+        std::vector<char> symbolLookup;
+        FillNexusSymbolLookup(symbolLookup);
+        AppendStateCodeRowAsNexus(buffer, begIt, endIt, symbolLookup);
+        }
+
+/*!
+        Appends the NEXUS representation of the state codes in [`begIt`, `endIt`) to `buffer`, using a `symbolLookup`
+        table filled by FillNexusSymbolLookup. Codes that are written with more than one character (e.g. {AG}) and
+        illegal codes are passed to WriteStateCodeAsNexusString.
+*/
+void NxsDiscreteDatatypeMapper::AppendStateCodeRowAsNexus(std::string & buffer, NxsDiscreteStateRow::const_iterator begIt, const NxsDiscreteStateRow::const_iterator & endIt, const std::vector<char> & symbolLookup) const
+        {
+        const unsigned nCodes = (unsigned) symbolLookup.size();
+        buffer.reserve(buffer.size() + (endIt - begIt));
+        for (; begIt != endIt; ++begIt)
+                {
+                const unsigned codeIndex = (unsigned) (*begIt - sclOffset);
+                if (codeIndex < nCodes && symbolLookup[codeIndex] != '\0')
+                        buffer.push_back(symbolLookup[codeIndex]);
+                else
+                        {
+                        std::ostringstream o;
+                        WriteStateCodeAsNexusString(o, *begIt, true);
+                        buffer.append(o.str());
+                        }
+                }
+        }
+
 unsigned NxsDiscreteDatatypeMapper::GetNumStatesInStateCode(NxsDiscreteStateCell scode) const
         {
         ValidateStateCode(scode);
@@ -3510,6 +3578,8 @@ NxsCharactersBlock::NxsCharactersBlock(
         convertAugmentedToMixed = false;
         allowAugmentingOfSequenceSymbols = false;
         writeInterleaveLen = -1;
+        writeNumThreads = 1;
+        acceptSnapshotMatrixCommand = false;
         Reset();
         }
 /*! Excludes characters whose indices are contained in the set `exset'.
@@ -3604,6 +3674,8 @@ void NxsCharactersBlock::Consume(
         convertAugmentedToMixed = other.convertAugmentedToMixed;
         allowAugmentingOfSequenceSymbols = other.allowAugmentingOfSequenceSymbols;
         writeInterleaveLen = other.writeInterleaveLen;
+        writeNumThreads = other.writeNumThreads;
+        snapshotMatrixSection = other.snapshotMatrixSection;
         other.Reset();
         transfMgr.Reset();
         }
@@ -3631,83 +3703,87 @@ void NxsCharactersBlock::WriteStatesForTaxonAsNexus(
                 }
         else
                 {
-                const NxsDiscreteStateRow & row = GetDiscreteMatrixRow(taxNum);
-                const unsigned rs = (const unsigned)row.size();
-                NCL_ASSERT(endCharInd <= rs);
-                if (rs > 0)
+                std::string s;
+                AppendDiscreteStatesForTaxonAsNexus(s, taxNum, beginCharInd, endCharInd);
+                out.write(s.data(), (std::streamsize) s.size());
+                }
+        }
+
+/*!
+        Appends the NEXUS representation of the states for characters [`beginCharInd`, `endCharInd`) of taxon `taxNum`
+        to `buffer`. The matrix must not be continuous (see WriteStatesForTaxonAsNexus).
+        `symbolLookup` may point to the table filled by NxsDiscreteDatatypeMapper::FillNexusSymbolLookup for the mapper
+        of the block, so that the table is not rebuilt for every row.
+*/
+void NxsCharactersBlock::AppendDiscreteStatesForTaxonAsNexus(
+  std::string &buffer,
+  unsigned taxNum,
+  unsigned beginCharInd,
+  unsigned endCharInd,
+  const std::vector<char> * symbolLookup) const
+        {
+        NCL_ASSERT(datatype != continuous);
+        const NxsDiscreteStateRow & row = GetDiscreteMatrixRow(taxNum);
+        const unsigned rs = (const unsigned)row.size();
+        NCL_ASSERT(endCharInd <= rs);
+        if (rs == 0)
+                return;
+        if (this->datatype == NxsCharactersBlock::codon)
+                {
+                for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
                         {
-                        if (this->datatype == NxsCharactersBlock::codon)
+                        NxsDiscreteStateCell sc = row[charInd];
+                        if (sc == NXS_GAP_STATE_CODE)
+                                buffer.append(3, gap);
+                        else if (sc >= 0 && sc < (NxsDiscreteStateCell) globalStateLabels.size())
+                                buffer.append(globalStateLabels[sc]);
+                        else
+                                buffer.append(3, missing);
+                        }
+                return;
+                }
+        const NxsDiscreteDatatypeMapper * dm = GetDatatypeMapperForChar(0);
+        if (dm == NULL)
+                throw NxsNCLAPIException("No DatatypeMapper in WriteStatesForTaxonAsNexus");
+        if (IsMixedType())
+                {
+                for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
+                        {
+                        dm = GetDatatypeMapperForChar(charInd);
+                        if (dm == NULL)
                                 {
-                                for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
-                                        {
-                                        NxsDiscreteStateCell sc = row[charInd];
-                                        if (sc == NXS_GAP_STATE_CODE)
-                                                out << gap << gap << gap;
-                                        else if (sc >= 0 && sc < (NxsDiscreteStateCell) globalStateLabels.size())
-                                                out << globalStateLabels[sc];
-                                        else
-                                                out << missing << missing << missing;
-                                        }
+                                NxsString msg("No DatatypeMapper for character ");
+                                msg << charInd + 1 << " in WriteStatesForTaxonAsNexus";
+                                throw NxsNCLAPIException(msg);
                                 }
+                        dm->AppendStateCodeAsNexus(buffer, row.at(charInd));
+                        }
+                }
+        else if (tokens)
+                {
+                for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
+                        {
+                        NxsDiscreteStateCell sc = row[charInd];
+                        buffer.push_back(' ');
+                        if (sc == NXS_GAP_STATE_CODE)
+                                buffer.push_back(gap);
                         else
                                 {
-                                const NxsDiscreteDatatypeMapper * dm = GetDatatypeMapperForChar(0);
-                                if (dm == NULL)
-                                        throw NxsNCLAPIException("No DatatypeMapper in WriteStatesForTaxonAsNexus");
-                                if (IsMixedType())
+                                NxsString sl = GetStateLabel(charInd, sc); /*v2.1to2.2 4 */
+                                if (sl == " ")
                                         {
-
-                                        for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
-                                                {
-                                                dm = GetDatatypeMapperForChar(charInd);
-                                                if (dm == NULL)
-                                                        {
-                                                        errormsg = "No DatatypeMapper for character ";
-                                                        errormsg << charInd + 1 << " in WriteStatesForTaxonAsNexus";
-                                                        throw NxsNCLAPIException(errormsg);
-                                                        }
-                                                const NxsDiscreteStateCell c = row.at(charInd);
-                                                dm->WriteStateCodeAsNexusString(out, c);
-                                                }
-                                        }
-                                else
-                                        {
-                                        if (tokens)
-                                                {
-                                                for (unsigned charInd = beginCharInd; charInd < endCharInd; ++charInd)
-                                                        {
-                                                        NxsDiscreteStateCell sc = row[charInd];
-                                                        out << ' ';
-                                                        if (sc == NXS_GAP_STATE_CODE)
-                                                                out << gap;
-                                                        else
-                                                                {
-                                                                NxsString sl = GetStateLabel(charInd, sc); /*v2.1to2.2 4 */
-                                                                if (sl == " ")
-                                                                        {
-                                                                        errormsg = "Writing character state ";
-                                                                        errormsg << 1 + sc << " for character " << 1+charInd << ", but no appropriate chararcter label or symbol was found.";
-                                                                        throw NxsNCLAPIException(errormsg);
-                                                                        }
-                                                                else
-                                                                        out  << NxsString::GetEscaped(sl);
-                                                                }
-                                                        }
-                                                }
-                                        else
-                                                {
-                                                std::vector<NxsDiscreteStateCell>::const_iterator endIt = row.begin() + beginCharInd;
-                                                std::vector<NxsDiscreteStateCell>::const_iterator begIt = endIt;
-                                                if (endCharInd == row.size())
-                                                        endIt = row.end();
-                                                else
-                                                        endIt += endCharInd - beginCharInd;
-                                                dm->WriteStateCodeRowAsNexus(out, begIt, endIt);
-                                                }
+                                        NxsString msg("Writing character state ");
+                                        msg << 1 + sc << " for character " << 1+charInd << ", but no appropriate chararcter label or symbol was found.";
+                                        throw NxsNCLAPIException(msg);
                                         }
+                                buffer.append(NxsString::GetEscaped(sl));
                                 }
                         }
                 }
+        else if (symbolLookup != NULL)
+                dm->AppendStateCodeRowAsNexus(buffer, row.begin() + beginCharInd, row.begin() + endCharInd, *symbolLookup);
+        else
+                dm->AppendStateCodeRowAsNexus(buffer, row.begin() + beginCharInd, row.begin() + endCharInd);
         }
 
 
@@ -4111,15 +4187,15 @@ void NxsCharactersBlock::HandleStdMatrix(
         std::vector<unsigned> toInMem(nTaxWithData, UINT_MAX);
         std::vector<unsigned> nCharsRead(nTaxWithData, 0);
 
-        unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
-        const bool checkingSignals = NxsReader::getNCLCatchesSignals();
+        const unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
+        const bool checkingSignals = (nexusReader != NULL);
         const unsigned MAX_NUM_CHARS_BETWEEN_SIGNAL_CHECKS = 1000;
         for (; currChar < nChar; page++)
                 {
                 for (indOfTaxInCommand = 0; indOfTaxInCommand < nTaxWithData ; indOfTaxInCommand++)
                         {
                         unsigned numCharsSinceLastSignalCheck = 0;
-                        if (checkingSignals && NxsReader::getNumSignalIntsCaught() != numSigInts)
+                        if (checkingSignals && nexusReader->IsParseCanceled(numSigInts))
                                 {
                                 if (datatype == NxsCharactersBlock::continuous)
                                         continuousMatrix.clear();
@@ -4235,7 +4311,7 @@ void NxsCharactersBlock::HandleStdMatrix(
                                         {
                                         if (numCharsSinceLastSignalCheck >= MAX_NUM_CHARS_BETWEEN_SIGNAL_CHECKS)
                                                 {
-                                                if (NxsReader::getNumSignalIntsCaught() != numSigInts)
+                                                if (nexusReader->IsParseCanceled(numSigInts))
                                                         {
                                                         if (datatype == NxsCharactersBlock::continuous)
                                                                 continuousMatrix.clear();
@@ -4292,7 +4368,7 @@ void NxsCharactersBlock::HandleStdMatrix(
                         else
                                 {
                                 const char nextch = token.PeekAtNextChar();
-                                if (indOfTaxInCommand > 0 && (!atEOL) && (strchr(";[\n\r \t", nextch) == NULL) && nexusReader)
+                                if (indOfTaxInCommand > 0 && (!atEOL) && (strchr(";[\n\r \t", nextch) == NULL) && nexusReader && nexusReader->ShouldReportWarning(NxsReader::UNCOMMON_SYNTAX_WARNING))
                                         {
                                         errormsg << "Expecting a whitespace character at the end of the characters for taxon \""<< nameStr << "\" but found " << nextch;
                                         nexusReader->NexusWarnToken(errormsg, NxsReader::UNCOMMON_SYNTAX_WARNING, token);
@@ -4465,6 +4541,43 @@ void NxsCharactersBlock::HandleTransposedMatrix(
         token MATRIX up to and including the semicolon that terminates the MATRIX command.
 */
 void NxsCharactersBlock::HandleMatrix(
+  NxsToken &token)        /* the token used to read from `in' */
+        {
+        PrepareForMatrix(token);
+        const unsigned ntax = taxa->GetNTax();
+
+        discreteMatrix.clear();
+        continuousMatrix.clear();
+
+        if (datatype == NxsCharactersBlock::continuous)
+                {
+                continuousMatrix.clear();
+                continuousMatrix.resize(ntax);
+                }
+        else
+                {
+                discreteMatrix.clear();
+                discreteMatrix.resize(ntax);
+                }
+        if (IsMixedType())
+                {
+                if (transposing)
+                        throw NxsUnimplementedException("Reading of transposed, mixed datatype matrices will probably never be supported by NCL");
+                /*        HandleMixedDatatypeMatrix(token); */
+                }
+        if (transposing)
+                HandleTransposedMatrix(token);
+        else
+                HandleStdMatrix(token);
+        DemandEndSemicolon(token, "MATRIX");
+        FinishMatrix();
+        }
+
+/*!
+        Creates the datatype mappers (if they have not been created by the FORMAT command) and checks that there is a
+        taxa block for the matrix. Called before the matrix is read.
+*/
+void NxsCharactersBlock::PrepareForMatrix(
   NxsToken &token)        /* the token used to read from `in' */
         {
         const NxsPartition dtParts;
@@ -4504,37 +4617,39 @@ void NxsCharactersBlock::HandleMatrix(
                 errormsg << NCL_BLOCKTYPE_ATTR_NAME << " block with a TAXA block or specify NEWTAXA and NTAX in the DIMENSIONS command";
                 throw NxsException(errormsg, token.GetFilePosition(), token.GetFileLine(), token.GetFileColumn());
                 }
+        }
 
-        discreteMatrix.clear();
-        continuousMatrix.clear();
-
-        if (datatype == NxsCharactersBlock::continuous)
-                {
-                continuousMatrix.clear();
-                continuousMatrix.resize(ntax);
-                }
-        else
-                {
-                discreteMatrix.clear();
-                discreteMatrix.resize(ntax);
-                }
-        if (IsMixedType())
-                {
-                if (transposing)
-                        throw NxsUnimplementedException("Reading of transposed, mixed datatype matrices will probably never be supported by NCL");
-                /*        HandleMixedDatatypeMatrix(token); */
-                }
-        if (transposing)
-                HandleTransposedMatrix(token);
-        else
-                HandleStdMatrix(token);
-        DemandEndSemicolon(token, "MATRIX");
+/*!
+        Called after the matrix has been stored.
+*/
+void NxsCharactersBlock::FinishMatrix()
+        {
         if (assumptionsBlock)
                 assumptionsBlock->SetCallback(this);
         if (convertAugmentedToMixed)
                 AugmentedSymbolsToMixed();
         }
 
+/*!
+        Handles the SnapshotMatrix command that NxsSnapshotIO writes in place of the MATRIX command of a block whose
+        matrix is stored in a binary section of a snapshot. Only understood while NxsSnapshotIO is reading a snapshot
+        (in other contexts the command is skipped). The block records the section number, and NxsSnapshotIO fills the
+        matrix after the NEXUS part of the snapshot has been read.
+*/
+void NxsCharactersBlock::HandleSnapshotMatrix(
+  NxsToken &token)        /* the token used to read from `in' */
+        {
+        PrepareForMatrix(token);
+        token.GetNextToken();
+        long sectionIndex = -1;
+        if (!NxsString::to_long(token.GetTokenReference().c_str(), &sectionIndex) || sectionIndex < 0)
+                GenerateNxsException(token, "Expecting a section number after SnapshotMatrix");
+        DemandEndSemicolon(token, "SnapshotMatrix");
+        discreteMatrix.clear();
+        continuousMatrix.clear();
+        snapshotMatrixSection = (unsigned) sectionIndex;
+        }
+
 /*!
         Called when STATELABELS command needs to be parsed from within the DIMENSIONS block. Deals with everything after
         the token STATELABELS up to and including the semicolon that terminates the STATELABELS command. Note that the
@@ -4608,7 +4723,7 @@ void NxsCharactersBlock::Read(
                 NxsBlock::NxsCommandResult res = HandleBasicBlockCommands(token);
                 if (res == NxsBlock::NxsCommandResult(STOP_PARSING_BLOCK))
                         {
-                        if (discreteMatrix.empty() && continuousMatrix.empty())
+                        if (discreteMatrix.empty() && continuousMatrix.empty() && snapshotMatrixSection == UINT_MAX)
                                 {
                                 errormsg.clear();
                                 errormsg << "\nA " << NCL_BLOCKTYPE_ATTR_NAME << " block must contain a Matrix command";
@@ -4634,6 +4749,8 @@ void NxsCharactersBlock::Read(
                                 HandleStatelabels(token);
                         else if (token.Equals("MATRIX"))
                                 HandleMatrix(token);
+                        else if (acceptSnapshotMatrixCommand && token.Equals("SNAPSHOTMATRIX"))
+                                HandleSnapshotMatrix(token);
                         else
                                 SkipCommand(token);
                         }
@@ -4773,6 +4890,15 @@ void NxsCharactersBlock::Report(
         }
 
 void NxsCharactersBlock::WriteAsNexus(std::ostream &out) const
+        {
+        WriteBlockAsNexus(out, UINT_MAX);
+        }
+
+/*!
+        Writes the block. If `matrixSnapshotSection` is not UINT_MAX then a "SnapshotMatrix <section>;" command is
+        written instead of the MATRIX command (see NxsSnapshotIO).
+*/
+void NxsCharactersBlock::WriteBlockAsNexus(std::ostream &out, unsigned matrixSnapshotSection) const
         {
         out << "BEGIN CHARACTERS;\n";
         WriteBasicBlockCommands(out);
@@ -4792,7 +4918,10 @@ void NxsCharactersBlock::WriteAsNexus(std::ostream &out) const
         this->WriteEliminateCommand(out);
         this->WriteFormatCommand(out);
         this->WriteCharStateLabelsCommand(out);
-        this->WriteMatrixCommand(out);
+        if (matrixSnapshotSection == UINT_MAX)
+                this->WriteMatrixCommand(out);
+        else
+                out << "    SnapshotMatrix " << matrixSnapshotSection << ";\n";
         WriteSkippedCommands(out);
         out << "END;\n";
         }
@@ -4810,6 +4939,72 @@ void NxsCharactersBlock::WriteEliminateCommand(
         }
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+|        Formats the rows of a discrete matrix for NxsCharactersBlock::WriteMatrixCommand. Chunk c holds up to
+|        `rowsPerChunk` rows of one interleave page (the chunks for page p are numbered from p*chunksPerPage), so that the
+|        chunks can be formatted on different threads and then written in order. `labels` holds the escaped label of
+|        every taxon. The symbol lookup table of the mapper is built once, and shared by all rows and threads.
+*/
+class NxsDiscreteMatrixChunkFormatter
+        {
+        public:
+                NxsDiscreteMatrixChunkFormatter(const NxsCharactersBlock & cb,
+                                                                                const std::vector<std::string> & labels,
+                                                                                const std::vector<unsigned> & rows,
+                                                                                unsigned labelWidth,
+                                                                                unsigned pageStride,
+                                                                                unsigned chunkRows)
+                        :charsBlock(cb),
+                        escapedLabels(labels),
+                        rowsToWrite(rows),
+                        width(labelWidth),
+                        stride(pageStride),
+                        rowsPerChunk(chunkRows),
+                        nChar(cb.GetNCharTotal())
+                        {
+                        const NxsDiscreteDatatypeMapper * dm = cb.GetDatatypeMapperForChar(0);
+                        if (dm != NULL)
+                                dm->FillNexusSymbolLookup(symbolLookup);
+                        chunksPerPage = (unsigned)((rowsToWrite.size() + rowsPerChunk - 1) / rowsPerChunk);
+                        if (chunksPerPage == 0)
+                                chunksPerPage = 1;
+                        }
+                unsigned GetNumChunks() const
+                        {
+                        const unsigned nPages = (nChar + stride - 1) / stride;
+                        return nPages * chunksPerPage;
+                        }
+                void operator()(unsigned chunkIndex, std::string & buffer) const
+                        {
+                        const unsigned page = chunkIndex / chunksPerPage;
+                        const unsigned firstRow = (chunkIndex % chunksPerPage) * rowsPerChunk;
+                        const unsigned endRow = std::min(firstRow + rowsPerChunk, (unsigned) rowsToWrite.size());
+                        const unsigned begChar = page * stride;
+                        const unsigned endChar = std::min(begChar + stride, nChar);
+                        if (page > 0 && firstRow == 0)
+                                buffer.push_back('\n');
+                        for (unsigned r = firstRow; r < endRow; ++r)
+                                {
+                                const std::string & currTaxonLabel = escapedLabels[rowsToWrite[r]];
+                                buffer.append(currTaxonLabel);
+                                const unsigned diff = width - (unsigned)currTaxonLabel.size();
+                                buffer.append(diff + 5, ' ');
+                                charsBlock.AppendDiscreteStatesForTaxonAsNexus(buffer, rowsToWrite[r], begChar, endChar, &symbolLookup);
+                                buffer.push_back('\n');
+                                }
+                        }
+        private:
+                const NxsCharactersBlock & charsBlock;
+                const std::vector<std::string> & escapedLabels;
+                const std::vector<unsigned> & rowsToWrite;
+                std::vector<char> symbolLookup;
+                unsigned width;
+                unsigned stride;
+                unsigned rowsPerChunk;
+                unsigned nChar;
+                unsigned chunksPerPage;
+        };
+
 void NxsCharactersBlock::WriteMatrixCommand(
   std::ostream &out) const /* output stream on which to print matrix */
         {
@@ -4818,36 +5013,54 @@ void NxsCharactersBlock::WriteMatrixCommand(
         unsigned width = taxa->GetMaxTaxonLabelLength();
         const unsigned ntaxTotal = taxa->GetNTax();
         out << "Matrix\n";
-        int prec = 6;
-        if (datatype == continuous)
-                prec = (int)out.precision(10);
         unsigned stride = (this->writeInterleaveLen < 1 ? this->nChar : this->writeInterleaveLen);
+        /* the escaped labels are cached by the taxa block, and reused for every interleave page */
+        std::vector<std::string> escapedStorage;
+        const std::vector<std::string> & escapedLabels = NxsGetEscapedTaxonLabels(*taxa, escapedStorage);
+        std::vector<unsigned> rowsToWrite;
+        rowsToWrite.reserve(ntaxTotal);
+        for (unsigned i = 0; i < ntaxTotal; i++)
+                {
+                if (this->TaxonIndHasData(i))
+                        rowsToWrite.push_back(i);
+                }
+        if (datatype != continuous)
+                {
+                if (this->nChar > 0)
+                        {
+                        /* aim for chunks of roughly 64KB of output, so that the threads have similar amounts of work */
+                        const unsigned charsPerRow = std::min(stride, this->nChar) + width + 6;
+                        const unsigned rowsPerChunk = std::max(1U, 65536U / charsPerRow);
+                        NxsDiscreteMatrixChunkFormatter formatter(*this, escapedLabels, rowsToWrite, width, stride, rowsPerChunk);
+                        NxsWriteChunksInOrder(out, formatter, formatter.GetNumChunks(), this->writeNumThreads);
+                        }
+                out << ";\n";
+                return;
+                }
+        const int prec = (int)out.precision(10);
         unsigned begChar = 0;
+        NxsOutputBuffer buffer(out);
         while (begChar < this->nChar)
                 {
                 if (begChar > 0)
-                        out << '\n';
+                        buffer.Append('\n');
                 unsigned endChar  = std::min(begChar + stride, this->nChar);
-                for (unsigned i = 0; i < ntaxTotal; i++)
+                for (unsigned r = 0; r < rowsToWrite.size(); r++)
                         {
-                        if (this->TaxonIndHasData(i))
-                                {
-                                const std::string currTaxonLabel = NxsString::GetEscaped(taxa->GetTaxonLabel(i));
-                                out << currTaxonLabel;
-                                unsigned currTaxonLabelLen = (unsigned)currTaxonLabel.size();
-                                unsigned diff = width - currTaxonLabelLen;
-                                for (unsigned k = 0; k < diff+5; k++)
-                                        out << ' ';
-
-                                WriteStatesForMatrixRow(out, i, UINT_MAX, begChar, endChar);
-                                out << '\n';
-                                }
+                        const std::string & currTaxonLabel = escapedLabels[rowsToWrite[r]];
+                        buffer.Append(currTaxonLabel);
+                        unsigned currTaxonLabelLen = (unsigned)currTaxonLabel.size();
+                        unsigned diff = width - currTaxonLabelLen;
+                        buffer.AppendRepeated(diff + 5, ' ');
+                        buffer.Flush();
+                        WriteStatesForMatrixRow(out, rowsToWrite[r], UINT_MAX, begChar, endChar);
+                        buffer.Append('\n');
                         }
                 begChar = endChar;
                 }
-        out << ";\n";
-        if (datatype == continuous)
-                out.precision(prec);
+        buffer.Append(";\n");
+        buffer.Flush();
+        out.precision(prec);
         }
 
 std::string NxsCharactersBlock::GetMatrixRowAsStr(const unsigned rowIndex) const /* output stream on which to print matrix */
@@ -5076,6 +5289,7 @@ void NxsCharactersBlock::Reset()
         NxsBlock::Reset();
         nTaxWithData = 0;
         nChar = 0;
+        snapshotMatrixSection = UINT_MAX;
         newtaxa                                = false;
         interleaving                = false;
         transposing                        = false;
@@ -5493,6 +5707,9 @@ void NxsCharactersBlock::CopyCharactersContents(const NxsCharactersBlock &other)
         allowAugmentingOfSequenceSymbols = other.allowAugmentingOfSequenceSymbols;
         restrictionDataype = other.restrictionDataype;
         writeInterleaveLen = other.writeInterleaveLen;
+        writeNumThreads = other.writeNumThreads;
+        acceptSnapshotMatrixCommand = other.acceptSnapshotMatrixCommand;
+        snapshotMatrixSection = other.snapshotMatrixSection;
         }
 
 
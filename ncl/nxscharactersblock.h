@@ -887,6 +887,7 @@ class NxsCharactersBlock
                 virtual void DebugShowMatrix(std::ostream &out, bool use_matchchar, const char *marginText = NULL) const;
                 virtual void WriteLinkCommand(std::ostream &out) const;
                 void WriteStatesForTaxonAsNexus(std::ostream &out, unsigned taxNum, unsigned begChar, unsigned endChar) const;
+                void AppendDiscreteStatesForTaxonAsNexus(std::string &buffer, unsigned taxNum, unsigned begChar, unsigned endChar, const std::vector<char> * symbolLookup = NULL) const;
                 void WriteCharLabelsCommand(std::ostream &out) const;
                 void WriteCharStateLabelsCommand(std::ostream &out) const;
                 void WriteEliminateCommand(std::ostream &out) const;
@@ -948,6 +949,14 @@ class NxsCharactersBlock
                         {
                         writeInterleaveLen = interleaveLen;
                         }
+                /*! Sets the number of threads that WriteMatrixCommand uses to format the rows of a discrete matrix
+                        (0 means one thread per hardware thread). The output does not depend on the number of threads.
+                        The default is 1.
+                */
+                void SetWriteNumThreads(unsigned numThreads)
+                        {
+                        writeNumThreads = numThreads;
+                        }
 
                 std::string GetMatrixRowAsStr(const unsigned rowIndex) const;
                 NxsDiscreteStateCell        GetStateIndex(unsigned i, unsigned j, unsigned k) const;
@@ -1098,10 +1107,18 @@ class NxsCharactersBlock
                 bool convertAugmentedToMixed; /* false by default (see AugmentedSymbolsToMixed) */
                 bool allowAugmentingOfSequenceSymbols;
                 int writeInterleaveLen;
+                unsigned writeNumThreads; /* see SetWriteNumThreads */
+                bool acceptSnapshotMatrixCommand; /* false by default. Set by NxsSnapshotIO while it reads the NEXUS part of a snapshot */
+                unsigned snapshotMatrixSection; /* UINT_MAX unless the matrix is waiting to be filled from a section of a snapshot */
 
                 void CreateDatatypeMapperObjects(const NxsPartition & , const std::vector<DataTypesEnum> &);
+                void PrepareForMatrix(NxsToken &token);
+                void FinishMatrix();
+                void HandleSnapshotMatrix(NxsToken &token);
+                void WriteBlockAsNexus(std::ostream &out, unsigned matrixSnapshotSection) const;
                 friend class PublicNexusReader;
                 friend class MultiFormatReader;
+                friend class NxsSnapshotIO;
         };
 
 typedef NxsCharactersBlock CharactersBlock;
@@ -1249,6 +1266,10 @@ class NxsDiscreteDatatypeMapper
                 void WriteStateCodeRowAsNexus(std::ostream & out, const std::vector<NxsDiscreteStateCell> &row) const;
                 void WriteStateCodeRowAsNexus(std::ostream & out, std::vector<NxsDiscreteStateCell>::const_iterator & begIt, const std::vector<NxsDiscreteStateCell>::const_iterator & endIt) const;
                 void WriteStateCodeAsNexusString(std::ostream & out, NxsDiscreteStateCell scode, bool demandSymbols = true) const;
+                void AppendStateCodeAsNexus(std::string & buffer, NxsDiscreteStateCell scode) const;
+                void AppendStateCodeRowAsNexus(std::string & buffer, NxsDiscreteStateRow::const_iterator begIt, const NxsDiscreteStateRow::const_iterator & endIt) const;
+                void AppendStateCodeRowAsNexus(std::string & buffer, NxsDiscreteStateRow::const_iterator begIt, const NxsDiscreteStateRow::const_iterator & endIt, const std::vector<char> & symbolLookup) const;
+                void FillNexusSymbolLookup(std::vector<char> & symbolLookup) const;
                 bool WasRestrictionDataype() const;
                 void SetWasRestrictionDataype(bool v) {restrictionDataype = v;}
                 NxsDiscreteStateCell EncodeNexusStateString(const std::string &stateAsNexus, NxsToken & token,
@@ -1336,6 +1357,7 @@ class NxsDiscreteDatatypeMapper
 
                 friend class NxsCharactersBlock;
                 friend class MultiFormatReader;
+                friend class NxsSnapshotIO;
         };
 
 inline unsigned NxsDiscreteDatatypeMapper::GetNumStatesIncludingGap() const
@@ -1964,9 +1986,11 @@ inline void NxsDiscreteDatatypeMapper::WriteStateCodeRowAsNexus(std::ostream & o
         }
 
 inline void NxsDiscreteDatatypeMapper::WriteStateCodeRowAsNexus(std::ostream & out, NxsDiscreteStateRow::const_iterator & begIt, const NxsDiscreteStateRow::const_iterator & endIt) const
-        {//@mth optimize
-        for (; begIt != endIt; ++begIt)
-                WriteStateCodeAsNexusString(out, *begIt, true);
+        {
+        std::string s;
+        AppendStateCodeRowAsNexus(s, begIt, endIt);
+        out.write(s.data(), (std::streamsize) s.size());
+        begIt = endIt;
         }
 
 
@@ -0,0 +1,342 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include <sstream>
+#include "ncl/nxsconsensus.h"
+#include "ncl/nxsoutputbuffer.h"
+
+static inline bool HasTaxonBit(const NxsSplitWord * words, unsigned taxonIndex)
+        {
+        return ((words[taxonIndex / 64] >> (taxonIndex % 64)) & 1) != 0;
+        }
+
+/* returns the lowest taxon index in the split (UINT_MAX for an empty split) */
+static unsigned FirstTaxon(const NxsSplitWord * words, unsigned nWords)
+        {
+        for (unsigned w = 0; w < nWords; ++w)
+                {
+                NxsSplitWord x = words[w];
+                if (x != 0)
+                        {
+                        unsigned b = 0;
+                        for (; (x & 1) == 0; x >>= 1)
+                                b++;
+                        return 64 * w + b;
+                        }
+                }
+        return UINT_MAX;
+        }
+
+static bool IsSubset(const NxsSplitWord * sub, const NxsSplitWord * words, unsigned nWords)
+        {
+        for (unsigned w = 0; w < nWords; ++w)
+                {
+                if ((sub[w] & ~words[w]) != 0)
+                        return false;
+                }
+        return true;
+        }
+
+/* orders (number of trees, split index) pairs from the most frequent split to the least frequent */
+class NxsSplitFrequencyOrder
+        {
+        public:
+                bool operator()(const std::pair<unsigned, unsigned> & a, const std::pair<unsigned, unsigned> & b) const
+                        {
+                        if (a.first != b.first)
+                                return a.first > b.first;
+                        return a.second < b.second;
+                        }
+        };
+
+NxsConsensusBuilder::NxsConsensusBuilder(const NxsSplitCounter & splitCounter)
+        :counter(splitCounter),
+        nWords(0),
+        numLeaves(0)
+        {
+        }
+
+/*! Makes the hierarchy a star tree of the taxa that occur in the recorded trees */
+void NxsConsensusBuilder::ResetHierarchy()
+        {
+        const unsigned nTax = counter.GetSplitTable().GetNumTaxa();
+        const std::vector<NxsSplitWord> & taxa = counter.GetTaxaInTrees();
+        nWords = counter.GetSplitTable().GetNumWords();
+        numLeaves = (nWords == 0 ? 0 : NxsCountSplitTaxa(&taxa[0], nWords));
+        nodeParent.assign(1, UINT_MAX);
+        nodeChildren.assign(1, std::vector<unsigned>());
+        nodeTaxon.assign(1, UINT_MAX);
+        nodeSplit.assign(1, UINT_MAX);
+        nodeNumTaxa.assign(1, numLeaves);
+        nodeBitset.assign(1, 0);
+        bitsets = taxa;
+        taxonNode.assign(nTax, UINT_MAX);
+        for (unsigned t = 0; t < nTax; ++t)
+                {
+                if (!HasTaxonBit(&taxa[0], t))
+                        continue;
+                const unsigned nd = (unsigned) nodeParent.size();
+                taxonNode[t] = nd;
+                nodeParent.push_back(0);
+                nodeChildren.push_back(std::vector<unsigned>());
+                nodeTaxon.push_back(t);
+                nodeSplit.push_back(UINT_MAX);
+                nodeNumTaxa.push_back(1);
+                nodeBitset.push_back(UINT_MAX);
+                nodeChildren[0].push_back(nd);
+                }
+        }
+
+/*! Adds the split `splitIndex` to the hierarchy. \returns false (and leaves the hierarchy unchanged) if the split
+        is trivial, conflicts with the hierarchy, or holds taxa that are not leaves of the hierarchy.
+*/
+bool NxsConsensusBuilder::InsertSplit(unsigned splitIndex)
+        {
+        const NxsSplitWord * c = counter.GetSplitTable().GetSplitWords(splitIndex);
+        const unsigned k = NxsCountSplitTaxa(c, nWords);
+        if (IsTrivial(k))
+                return false;
+        const unsigned first = FirstTaxon(c, nWords);
+        if (taxonNode[first] == UINT_MAX)
+                return false;
+        /* the smallest cluster that contains the split */
+        unsigned v = nodeParent[taxonNode[first]];
+        while (nodeNumTaxa[v] < k || !IsSubset(c, &bitsets[nodeBitset[v]], nWords))
+                {
+                if (v == 0)
+                        return false;
+                v = nodeParent[v];
+                }
+        if (nodeNumTaxa[v] == k)
+                return false;
+        /* the split is compatible if each child of v is inside it or disjoint from it */
+        insideChildren.clear();
+        outsideChildren.clear();
+        const std::vector<unsigned> & children = nodeChildren[v];
+        for (std::vector<unsigned>::const_iterator chIt = children.begin(); chIt != children.end(); ++chIt)
+                {
+                const unsigned ch = *chIt;
+                bool inside;
+                if (nodeTaxon[ch] != UINT_MAX)
+                        inside = HasTaxonBit(c, nodeTaxon[ch]);
+                else
+                        {
+                        const NxsSplitWord * b = &bitsets[nodeBitset[ch]];
+                        bool someIn = false;
+                        bool someOut = false;
+                        for (unsigned w = 0; w < nWords; ++w)
+                                {
+                                if ((b[w] & c[w]) != 0)
+                                        someIn = true;
+                                if ((b[w] & ~c[w]) != 0)
+                                        someOut = true;
+                                }
+                        if (someIn && someOut)
+                                return false;
+                        inside = someIn;
+                        }
+                if (inside)
+                        insideChildren.push_back(ch);
+                else
+                        outsideChildren.push_back(ch);
+                }
+        const unsigned u = (unsigned) nodeParent.size();
+        nodeParent.push_back(v);
+        nodeChildren.push_back(insideChildren);
+        nodeTaxon.push_back(UINT_MAX);
+        nodeSplit.push_back(splitIndex);
+        nodeNumTaxa.push_back(k);
+        nodeBitset.push_back((unsigned) bitsets.size());
+        bitsets.insert(bitsets.end(), c, c + nWords);
+        for (std::vector<unsigned>::const_iterator chIt = insideChildren.begin(); chIt != insideChildren.end(); ++chIt)
+                nodeParent[*chIt] = u;
+        outsideChildren.push_back(u);
+        nodeChildren[v].swap(outsideChildren);
+        return true;
+        }
+
+std::vector<unsigned> NxsConsensusBuilder::SelectSplits(ConsensusMethod method, double minFrequency)
+        {
+        ResetHierarchy();
+        const NxsSplitTable & table = counter.GetSplitTable();
+        const unsigned nTrees = counter.GetNumTrees();
+        const double minTimes = minFrequency * (double) nTrees;
+        std::vector<std::pair<unsigned, unsigned> > candidates;
+        for (unsigned i = 0; i < table.GetNumSplits(); ++i)
+                {
+                const unsigned nTimes = table.GetSplitInfo(i).nTimes;
+                bool use;
+                if (method == STRICT_CONSENSUS)
+                        use = (nTimes == nTrees);
+                else if (method == MAJORITY_RULE_CONSENSUS)
+                        use = (2 * (uint64_t) nTimes > (uint64_t) nTrees && (double) nTimes >= minTimes);
+                else
+                        use = ((double) nTimes >= minTimes);
+                if (use && !IsTrivial(NxsCountSplitTaxa(table.GetSplitWords(i), nWords)))
+                        candidates.push_back(std::pair<unsigned, unsigned>(nTimes, i));
+                }
+        std::sort(candidates.begin(), candidates.end(), NxsSplitFrequencyOrder());
+        /* a fully resolved tree has numLeaves - 2 clusters (rooted) or numLeaves - 3 splits (unrooted) */
+        const unsigned nFixed = (counter.GetTreatAsRooted() ? 2 : 3);
+        const unsigned maxSplits = (numLeaves > nFixed ? numLeaves - nFixed : 0);
+        std::vector<unsigned> selected;
+        for (std::vector<std::pair<unsigned, unsigned> >::const_iterator cIt = candidates.begin(); cIt != candidates.end() && selected.size() < maxSplits; ++cIt)
+                {
+                if (InsertSplit(cIt->second))
+                        selected.push_back(cIt->second);
+                }
+        return selected;
+        }
+
+/*! Writes the length (and for internal edges, the support) of the edge below `node`, in the shortest form that is read
+        back as the same double.
+*/
+void NxsConsensusBuilder::AppendEdge(std::ostream & out, unsigned node, bool * missingLens)
+        {
+        const NxsSplitTable & table = counter.GetSplitTable();
+        unsigned splitIndex = nodeSplit[node];
+        if (splitIndex == UINT_MAX)
+                {
+                /* the trivial split of a leaf (for unrooted splits, the leaf with the lowest index is represented by the
+                        split of all the other leaves) */
+                const unsigned t = nodeTaxon[node];
+                scratchWords.assign(nWords, 0);
+                uint64_t h;
+                if (!counter.GetTreatAsRooted() && t == FirstTaxon(&bitsets[0], nWords))
+                        {
+                        for (unsigned w = 0; w < nWords; ++w)
+                                scratchWords[w] = bitsets[w];
+                        scratchWords[t / 64] &= ~(((NxsSplitWord) 1) << (t % 64));
+                        h = NxsCalcSplitHash(&scratchWords[0], nWords);
+                        }
+                else
+                        {
+                        scratchWords[t / 64] = ((NxsSplitWord) 1) << (t % 64);
+                        h = NxsGetTaxonSplitHash(t);
+                        }
+                splitIndex = table.FindSplit(&scratchWords[0], h);
+                }
+        if (splitIndex != UINT_MAX && counter.GetTrackEdgeLenSummary())
+                {
+                numberText.clear();
+                NxsAppendShortestDouble(numberText, table.GetSplitInfo(splitIndex).edgeLenSummary.GetMean(), false);
+                out << ':' << numberText;
+                }
+        else
+                *missingLens = true;
+        if (nodeTaxon[node] == UINT_MAX)
+                {
+                numberText.clear();
+                NxsAppendShortestDouble(numberText, (double) table.GetSplitInfo(splitIndex).nTimes / (double) counter.GetNumTrees(), false);
+                out << "[&&NHX:support=" << numberText << ']';
+                }
+        }
+
+NxsFullTreeDescription NxsConsensusBuilder::BuildTreeDescription(ConsensusMethod method, const std::string & treeName, double minFrequency)
+        {
+        if (counter.GetNumTrees() == 0)
+                throw NxsNCLAPIException("A consensus tree cannot be built before any trees have been recorded.");
+        SelectSplits(method, minFrequency);
+        /* children are written in the order of their lowest taxon index */
+        std::vector<unsigned> firstTaxon(nodeParent.size());
+        for (unsigned nd = 0; nd < nodeParent.size(); ++nd)
+                firstTaxon[nd] = (nodeTaxon[nd] != UINT_MAX ? nodeTaxon[nd] : FirstTaxon(&bitsets[nodeBitset[nd]], nWords));
+        std::vector<std::pair<unsigned, unsigned> > order;
+        bool hasPolytomies = false;
+        for (unsigned nd = 0; nd < nodeParent.size(); ++nd)
+                {
+                std::vector<unsigned> & children = nodeChildren[nd];
+                if (children.size() > 2 && (nd != 0 || counter.GetTreatAsRooted() || children.size() > 3))
+                        hasPolytomies = true;
+                order.clear();
+                for (std::vector<unsigned>::const_iterator chIt = children.begin(); chIt != children.end(); ++chIt)
+                        order.push_back(std::pair<unsigned, unsigned>(firstTaxon[*chIt], *chIt));
+                std::sort(order.begin(), order.end());
+                for (unsigned i = 0; i < order.size(); ++i)
+                        children[i] = order[i].second;
+                }
+        /* the newick string of a processed tree, with 1 + the taxon index as the label of each leaf */
+        std::ostringstream newick;
+        bool missingLens = false;
+        std::vector<std::pair<unsigned, unsigned> > toWrite; /* nodes that have been opened, with the number of children written */
+        toWrite.push_back(std::pair<unsigned, unsigned>(0, 0));
+        newick << '(';
+        while (!toWrite.empty())
+                {
+                const unsigned nd = toWrite.back().first;
+                const unsigned childPos = toWrite.back().second;
+                if (childPos < nodeChildren[nd].size())
+                        {
+                        toWrite.back().second++;
+                        if (childPos > 0)
+                                newick << ',';
+                        const unsigned ch = nodeChildren[nd][childPos];
+                        if (nodeTaxon[ch] != UINT_MAX)
+                                {
+                                newick << 1 + nodeTaxon[ch];
+                                AppendEdge(newick, ch, &missingLens);
+                                }
+                        else
+                                {
+                                newick << '(';
+                                toWrite.push_back(std::pair<unsigned, unsigned>(ch, 0));
+                                }
+                        }
+                else
+                        {
+                        newick << ')';
+                        if (nd != 0)
+                                AppendEdge(newick, nd, &missingLens);
+                        toWrite.pop_back();
+                        }
+                }
+        int flags = NxsFullTreeDescription::NXS_TREE_PROCESSED;
+        if (counter.GetTreatAsRooted())
+                flags |= NxsFullTreeDescription::NXS_IS_ROOTED_BIT;
+        if (counter.GetTrackEdgeLenSummary())
+                flags |= NxsFullTreeDescription::NXS_HAS_SOME_EDGE_LENGTHS_BIT;
+        if (missingLens)
+                flags |= NxsFullTreeDescription::NXS_MISSING_SOME_EDGE_LENGTHS_BIT;
+        if (nodeParent.size() > numLeaves + 1)
+                flags |= NxsFullTreeDescription::NXS_HAS_NHX_BIT;
+        if (hasPolytomies)
+                flags |= NxsFullTreeDescription::NXS_HAS_POLYTOMY_BIT;
+        if (numLeaves == counter.GetSplitTable().GetNumTaxa())
+                flags |= NxsFullTreeDescription::NXS_HAS_ALL_TAXA_BIT;
+        return NxsFullTreeDescription(newick.str(), treeName, flags);
+        }
+
+void NxsConsensusBuilder::BuildTree(NxsSimpleTree & tree, ConsensusMethod method, double minFrequency)
+        {
+        tree.Initialize(BuildTreeDescription(method, std::string(), minFrequency));
+        }
+
+void NxsConsensusBuilder::WriteTreeCommand(std::ostream & out, const NxsFullTreeDescription & ftd, const NxsTaxaBlockAPI * taxa)
+        {
+        NxsSimpleTree tree(ftd, 0, 0.0);
+        out << "    TREE ";
+        if (ftd.GetName().empty())
+                out << "UnnamedTree";
+        else
+                out << NxsString::GetEscaped(ftd.GetName());
+        out << " = [&" << (ftd.IsRooted() ? 'R' : 'U') << ']';
+        tree.WriteAsNewick(out, true, true, true, taxa, true);
+        out << ";\n";
+        }
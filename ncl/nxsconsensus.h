@@ -0,0 +1,116 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSCONSENSUS_H
+#define NCL_NXSCONSENSUS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ncl/nxssplits.h"
+
+/*! Builds consensus trees from the splits that were counted by an NxsSplitCounter.
+
+        The splits that a method accepts are inserted, from the most frequent to the least frequent, into a hierarchy
+        of clusters that starts as a star tree (unrooted splits are the clusters of the trees rooted at their
+        lowest-numbered taxon, which is the form that NxsSplitCounter stores them in). A split is compatible with the
+        hierarchy if it is the union of some of the children of the smallest cluster that contains it, so a
+        compatibility check compares the split's bitset with the children of one node rather than with every accepted
+        split.
+
+        The consensus tree is returned as a processed NxsFullTreeDescription, which can be used to build an
+        NxsSimpleTree or written in a TREES block. Each internal edge has an NHX comment with the proportion of the
+        trees that have its split ("support"). If the counter tracked edge-length summaries, each edge is given the mean
+        length of its split in the trees that have the split (leaf edges get lengths only if trivial splits were
+        tracked). For example:
+
+                NxsSplitCounter counter(taxa->GetNTax());
+                counter.SetTrackTrivial(true);
+                counter.SetTrackEdgeLenSummary(true);
+                counter.RecordTrees(treesBlock->GetProcessedTrees());
+                NxsConsensusBuilder builder(counter);
+                NxsFullTreeDescription ftd = builder.BuildTreeDescription(NxsConsensusBuilder::MAJORITY_RULE_CONSENSUS, "con");
+                NxsSimpleTree tree(ftd, 0, 0.0);
+
+        The leaves of the consensus tree are the taxa that occur in any of the recorded trees. The methods assume that
+        every tree has the same taxa.
+*/
+class NxsConsensusBuilder
+        {
+        public:
+                enum ConsensusMethod
+                        {
+                        STRICT_CONSENSUS, /* the splits that are in every tree */
+                        MAJORITY_RULE_CONSENSUS, /* the splits that are in more than half of the trees */
+                        GREEDY_CONSENSUS /* the majority-rule splits, then each less frequent split that is compatible with the splits accepted before it */
+                        };
+                /*! The builder refers to `splitCounter`, which must not be destroyed before the builder. */
+                NxsConsensusBuilder(const NxsSplitCounter & splitCounter);
+
+                /*! \returns the indices (in the split table of the counter) of the non-trivial splits of the consensus
+                        tree, from the most frequent to the least frequent (splits with the same frequency are taken in the
+                        order of their indices).
+
+                        Splits with a frequency below `minFrequency` are not used by the MAJORITY_RULE_CONSENSUS and
+                        GREEDY_CONSENSUS methods (so majority-rule consensus trees for higher thresholds can be built, and
+                        the greedy method can be stopped before it adds rare splits).
+                */
+                std::vector<unsigned> SelectSplits(ConsensusMethod method, double minFrequency = 0.0);
+                /*! \returns the processed description of the consensus tree. Raises an NxsNCLAPIException if the counter
+                        has not recorded any trees.
+                */
+                NxsFullTreeDescription BuildTreeDescription(ConsensusMethod method, const std::string & treeName, double minFrequency = 0.0);
+                /*! Replaces the contents of `tree` with the consensus tree. */
+                void BuildTree(NxsSimpleTree & tree, ConsensusMethod method, double minFrequency = 0.0);
+                /*! Writes the TREE command for `ftd` (with the labels of `taxa` and its NHX comments), as
+                        NxsTreesBlock::WriteTreesCommand would.
+                */
+                static void WriteTreeCommand(std::ostream & out, const NxsFullTreeDescription & ftd, const NxsTaxaBlockAPI * taxa);
+        private:
+                NxsConsensusBuilder(const NxsConsensusBuilder &); /** don't define, not copyable*/
+                NxsConsensusBuilder & operator=(const NxsConsensusBuilder &); /** don't define, not copyable*/
+
+                void ResetHierarchy();
+                bool InsertSplit(unsigned splitIndex);
+                void AppendEdge(std::ostream & out, unsigned node, bool * missingLens);
+                bool IsTrivial(unsigned numSplitTaxa) const
+                        {
+                        return (numSplitTaxa < 2 || numSplitTaxa + (counter.GetTreatAsRooted() ? 1 : 2) > numLeaves);
+                        }
+
+                const NxsSplitCounter & counter;
+                unsigned nWords;
+                unsigned numLeaves;
+                /* the hierarchy (node 0 is the root). Leaves have no bitset, internal nodes other than the root have the
+                        index of their split. */
+                std::vector<unsigned> nodeParent;
+                std::vector<std::vector<unsigned> > nodeChildren;
+                std::vector<unsigned> nodeTaxon; /* UINT_MAX for internal nodes */
+                std::vector<unsigned> nodeSplit; /* UINT_MAX for the root and the leaves */
+                std::vector<unsigned> nodeNumTaxa;
+                std::vector<unsigned> nodeBitset; /* position in bitsets (UINT_MAX for leaves) */
+                std::vector<NxsSplitWord> bitsets;
+                std::vector<unsigned> taxonNode; /* UINT_MAX for taxa that are not leaves */
+                std::vector<unsigned> insideChildren;
+                std::vector<unsigned> outsideChildren;
+                std::vector<NxsSplitWord> scratchWords;
+                std::string numberText; /* scratch space for AppendEdge */
+        };
+
+#endif
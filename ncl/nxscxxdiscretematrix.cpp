@@ -19,6 +19,7 @@
 #include <iterator>
 #include "ncl/nxscxxdiscretematrix.h"
 #include "ncl/nxsutilcopy.h"
+#include "ncl/nxsparallel.h"
 #include <cassert>
 using std::string;
 using std::vector;
@@ -272,6 +273,123 @@ void NxsTransposeCompressedMatrix(
                 }
 }
 
+/* number of adjacent columns that are summarized together by NxsSummarizeDiscreteMatrixSites */
+static const unsigned SITE_SUMMARY_BLOCK_WIDTH = 256;
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Functor that fills the statistics for every `numWorkers`-th block of columns (starting with block `workerIndex`)
+|        in a NxsDiscreteSiteSummary.
+*/
+class NxsSiteSummaryWorker
+        {
+        public:
+                NxsSiteSummaryWorker(const NxsCDiscreteStateSet * const * m,
+                                                         unsigned ntax,
+                                                         unsigned nchar,
+                                                         unsigned nstates,
+                                                         NxsCDiscreteStateSet gap,
+                                                         NxsCDiscreteStateSet missing,
+                                                         NxsDiscreteSiteSummary & s)
+                        :matrix(m),
+                        nTax(ntax),
+                        nChar(nchar),
+                        nStates(nstates),
+                        gapCode(gap),
+                        missingCode(missing),
+                        summary(s)
+                        {}
+                void operator()(unsigned workerIndex, unsigned numWorkers)
+                        {
+                        const unsigned W = SITE_SUMMARY_BLOCK_WIDTH;
+                        const unsigned nCounters = nStates + 2; /* one for each state, then gaps and missing */
+                        std::vector<unsigned> counters(nCounters*W);
+                        std::vector<NxsCDiscreteStateSet> codes(nCounters);
+                        for (unsigned s = 0; s < nStates; ++s)
+                                codes[s] = (NxsCDiscreteStateSet) s;
+                        codes[nStates] = gapCode;
+                        codes[nStates + 1] = missingCode;
+                        const double dntax = (nTax == 0 ? 1.0 : (double) nTax);
+                        for (unsigned firstCol = workerIndex*W; firstCol < nChar; firstCol += numWorkers*W)
+                                {
+                                const unsigned width = std::min(W, nChar - firstCol);
+                                std::fill(counters.begin(), counters.end(), 0U);
+                                for (unsigned r = 0; r < nTax; ++r)
+                                        {
+                                        const NxsCDiscreteStateSet * row = matrix[r] + firstCol;
+                                        for (unsigned k = 0; k < nCounters; ++k)
+                                                {
+                                                const NxsCDiscreteStateSet code = codes[k];
+                                                unsigned * counter = &counters[k*W];
+                                                for (unsigned c = 0; c < width; ++c)
+                                                        counter[c] += (row[c] == code ? 1U : 0U);
+                                                }
+                                        }
+                                for (unsigned c = 0; c < width; ++c)
+                                        {
+                                        const unsigned j = firstCol + c;
+                                        unsigned * destCounts = &(summary.stateCounts[j*nStates]);
+                                        unsigned nObserved = 0;
+                                        unsigned nSeenTwice = 0;
+                                        for (unsigned s = 0; s < nStates; ++s)
+                                                {
+                                                const unsigned n = counters[s*W + c];
+                                                destCounts[s] = n;
+                                                if (n > 0)
+                                                        {
+                                                        ++nObserved;
+                                                        if (n > 1)
+                                                                ++nSeenTwice;
+                                                        }
+                                                }
+                                        summary.numObservedStates[j] = nObserved;
+                                        summary.parsimonyInformative[j] = (nSeenTwice > 1 ? 1 : 0);
+                                        summary.singleton[j] = (nObserved > 1 && nSeenTwice < 2 ? 1 : 0);
+                                        summary.gapFraction[j] = ((double) counters[nStates*W + c])/dntax;
+                                        summary.missingFraction[j] = ((double) counters[(nStates + 1)*W + c])/dntax;
+                                        }
+                                }
+                        }
+        private:
+                const NxsCDiscreteStateSet * const * matrix;
+                unsigned nTax;
+                unsigned nChar;
+                unsigned nStates;
+                NxsCDiscreteStateSet gapCode;
+                NxsCDiscreteStateSet missingCode;
+                NxsDiscreteSiteSummary & summary;
+        };
+
+void NxsSummarizeDiscreteMatrixSites(
+  const NxsCXXDiscreteMatrix & mat,
+  NxsDiscreteSiteSummary & summary,
+  unsigned numThreads)
+        {
+        const NxsCDiscreteMatrix & cMat = mat.getConstNativeC();
+        const unsigned nstates = cMat.nStates;
+        const unsigned nchar = cMat.nChar;
+        summary.nStates = nstates;
+        summary.nChar = nchar;
+        summary.nTax = cMat.nTax;
+        summary.stateCounts.assign(nchar*nstates, 0);
+        summary.numObservedStates.assign(nchar, 0);
+        summary.singleton.assign(nchar, 0);
+        summary.parsimonyInformative.assign(nchar, 0);
+        summary.gapFraction.assign(nchar, 0.0);
+        summary.missingFraction.assign(nchar, 0.0);
+        if (nchar == 0 || cMat.nTax == 0)
+                return;
+        /* With standardized coding missing data is coded as nStates, and gaps as -1. Otherwise NCL's NXS_MISSING_CODE
+                and NXS_GAP_STATE_CODE are used.
+        */
+        const bool standardized = mat.isStandardized();
+        const NxsCDiscreteStateSet missingCode = (standardized ? (NxsCDiscreteStateSet) nstates : (NxsCDiscreteStateSet) NXS_MISSING_CODE);
+        const NxsCDiscreteStateSet gapCode = (standardized ? (NxsCDiscreteStateSet) -1 : (NxsCDiscreteStateSet) NXS_GAP_STATE_CODE);
+
+        const unsigned nBlocks = 1 + (nchar - 1)/SITE_SUMMARY_BLOCK_WIDTH;
+        NxsSiteSummaryWorker worker(mat.getMatrix(), cMat.nTax, nchar, nstates, gapCode, missingCode, summary);
+        NxsRunWorkers(worker, NxsChooseNumThreads(numThreads, nBlocks));
+        }
+
 NxsCXXDiscreteMatrix::NxsCXXDiscreteMatrix(const NxsCharactersBlock & cb, bool gapsToMissing, const NxsUnsignedSet * toInclude, bool standardizeCoding)
         {
         Initialize(&cb, gapsToMissing, toInclude, standardizeCoding);
@@ -295,6 +413,7 @@ void NxsCXXDiscreteMatrix::Initialize(const NxsCharactersBlock * cb, bool gapsTo
         this->intWts.clear();
         this->dblWts.clear();
         this->activeExSet.clear();
+        this->standardized = standardizeCoding;
         if (cb == NULL)
                 return;
         std::vector<const NxsDiscreteDatatypeMapper *> mappers = cb->GetAllDatatypeMappers();
@@ -482,11 +601,12 @@ void NxsCXXDiscreteMatrix::Initialize(const NxsCharactersBlock * cb, bool gapsTo
  *        Constructs  from the native C struct NxsCDiscreteMatrix
  *                by deep copy.
  */
-NxsCXXDiscreteMatrix::NxsCXXDiscreteMatrix(const NxsCDiscreteMatrix & mat)
+NxsCXXDiscreteMatrix::NxsCXXDiscreteMatrix(const NxsCDiscreteMatrix & mat, bool standardizedCoding)
         :nativeCMatrix(mat),//aliases pointers, but we'll fix this below
         symbolsStringAlias(mat.symbolsList),
         matrixAlias(mat.nTax, mat.nChar),
-        stateListPosAlias(mat.stateListPos, (mat.stateListPos + mat.nObservedStateSets))
+        stateListPosAlias(mat.stateListPos, (mat.stateListPos + mat.nObservedStateSets)),
+        standardized(standardizedCoding)
         {
         nativeCMatrix.symbolsList = symbolsStringAlias.c_str();
         nativeCMatrix.stateListPos = &stateListPosAlias[0];
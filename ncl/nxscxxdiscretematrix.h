@@ -41,7 +41,10 @@ class NxsCXXDiscreteMatrix
                         {
                         Initialize(0L, false);
                         }
-                NxsCXXDiscreteMatrix(const NxsCDiscreteMatrix & );
+                /*! `standardizedCoding` tells whether `mat` uses the coding of a matrix that was built with
+                        standardizeCoding=true (see isStandardized).
+                */
+                NxsCXXDiscreteMatrix(const NxsCDiscreteMatrix & mat, bool standardizedCoding = true);
                 NxsCXXDiscreteMatrix(const NxsCharactersBlock & cb, bool convertGapsToMissing, const NxsUnsignedSet * toInclude = 0L, bool standardizeCoding = true);
 
                 void Initialize(const NxsCharactersBlock * cb, bool convertGapsToMissing, const NxsUnsignedSet * toInclude = 0L, bool standardizeCoding = true);
@@ -71,6 +74,14 @@ class NxsCXXDiscreteMatrix
                         return nativeCMatrix.nStates;
                         }
 
+                /*! \returns true if the matrix uses the standardized coding (missing data is coded as nStates and gaps as
+                        -1), or false if it uses NCL's codes (NXS_MISSING_CODE and NXS_GAP_STATE_CODE).
+                */
+                bool isStandardized() const
+                        {
+                        return standardized;
+                        }
+
                 const char *        getSymbolsList() const   //POL added 15-Nov-2005
                         {
                         return nativeCMatrix.symbolsList;
@@ -169,6 +180,7 @@ class NxsCXXDiscreteMatrix
                 std::vector<int>                        intWts;
                 std::vector<double>                        dblWts;
                 std::set<unsigned>                        activeExSet;
+                bool                                                standardized;                /** true if the coding was standardized */
                 NxsCXXDiscreteMatrix(const NxsCXXDiscreteMatrix &); /** don't define, not copyable*/
                 NxsCXXDiscreteMatrix & operator=(const NxsCXXDiscreteMatrix &); /** don't define, not copyable*/
         };
@@ -259,6 +271,65 @@ void NxsTransposeCompressedMatrix(
   std::vector<unsigned> * patternCounts = 0L,
   std::vector<double> * patternWeights = 0L);
   
+/*----------------------------------------------------------------------------------------------------------------------
+| Per-site (column) statistics of a NxsCXXDiscreteMatrix. Filled by NxsSummarizeDiscreteMatrixSites.
+|
+| Every per-site vector has one element for each column of the matrix that was summarized.
+| Only cells that are coded as a single (fundamental) state are counted in `stateCounts`. Cells that are
+|   ambiguous or polymorphic are not counted as any state (and they are neither gaps nor missing), so
+|   they cannot make a site variable or parsimony-informative.
+*/
+class NxsDiscreteSiteSummary
+    {
+    public:
+        NxsDiscreteSiteSummary()
+            :nStates(0),
+            nChar(0),
+            nTax(0)
+            {}
+        /* returns the number of taxa that have the state `stateIndex` at site `charIndex` */
+        unsigned GetStateCount(unsigned charIndex, unsigned stateIndex) const
+            {
+            NCL_ASSERT(charIndex < nChar && stateIndex < nStates);
+            return stateCounts[charIndex*nStates + stateIndex];
+            }
+        /* returns true if at least two states each occur in at least two taxa at site `charIndex` */
+        bool IsParsimonyInformative(unsigned charIndex) const
+            {
+            return parsimonyInformative[charIndex] != 0;
+            }
+        /* returns true if the site is variable, but is not parsimony-informative. */
+        bool IsSingletonSite(unsigned charIndex) const
+            {
+            return singleton[charIndex] != 0;
+            }
+
+        unsigned nStates; /* number of fundamental states (the stride of `stateCounts`) */
+        unsigned nChar; /* number of sites summarized */
+        unsigned nTax; /* number of taxa (the denominator of the fractions) */
+        std::vector<unsigned> stateCounts; /* nChar x nStates. The count of taxa with state s at site j is stateCounts[j*nStates + s] */
+        std::vector<unsigned> numObservedStates; /* number of different fundamental states seen at each site */
+        std::vector<unsigned char> singleton; /* 1 for sites with more than one state, but in which only one state is seen in more than one taxon */
+        std::vector<unsigned char> parsimonyInformative; /* 1 for sites in which at least two states are each seen in at least two taxa*/
+        std::vector<double> gapFraction; /* the fraction of taxa that have a gap at each site */
+        std::vector<double> missingFraction; /* the fraction of taxa that are coded as missing at each site */
+    };
+
+/*----------------------------------------------------------------------------------------------------------------------
+| Fills `summary` with per-site statistics for every column in `mat`.
+|
+| The matrix is processed in blocks of adjacent columns. Within a block, every row is scanned with
+|   branch-free compare-and-add loops (which compilers can vectorize), and the blocks are divided among
+|   `numThreads` threads (0 means one thread per hardware thread).
+|
+| `mat` may have been built with or without standardized coding (see NxsCXXDiscreteMatrix::isStandardized). If
+|   gaps were converted to missing data when `mat` was created, then the gap fractions will all be 0.
+*/
+void NxsSummarizeDiscreteMatrixSites(
+  const NxsCXXDiscreteMatrix & mat, /**< is the data source */
+  NxsDiscreteSiteSummary & summary, /**< OUTPUT */
+  unsigned numThreads = 1); /**< number of threads to use. 0 means use one thread for each processor */
+
  
 
 #endif  // NXS_CXX_DISCRETE_MATRIX_H
@@ -0,0 +1,535 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <climits>
+#include <cstring>
+#include "ncl/nxsdecompress.h"
+#include "ncl/nxsexception.h"
+#include "ncl/nxsstring.h"
+#if defined(NCL_HAS_ZLIB)
+#        include <zlib.h>
+#endif
+#if defined(NCL_HAS_ZSTD)
+#        include <zstd.h>
+#endif
+#if defined(NCL_HAS_STD_THREAD)
+#        include <condition_variable>
+#        include <exception>
+#        include <mutex>
+#        include <thread>
+#endif
+
+/*! Decompresses the data read from a stream. */
+class NxsDecompressor
+        {
+        public:
+                virtual ~NxsDecompressor()
+                        {}
+                /*! Writes at most `capacity` decompressed bytes to `out`, and \returns the number of bytes written.
+                        0 is only returned at the end of the data.
+                */
+                virtual std::size_t Decompress(char * out, std::size_t capacity) = 0;
+        };
+
+#if defined(NCL_HAS_STD_THREAD)
+/*! The state that NxsDecompressingStreamBuf shares with its decompressing thread. The blocks are used in a ring: the
+        decompressing thread fills blocks in order, and the reader returns each block after it has been read.
+*/
+class NxsDecompressionQueue
+        {
+        public:
+                NxsDecompressionQueue()
+                        :numFilled(0),
+                        nextToRead(0),
+                        stopRequested(false)
+                        {}
+                std::mutex queueMutex;
+                std::condition_variable blockFilled;
+                std::condition_variable blockReleased;
+                unsigned numFilled;
+                unsigned nextToRead;
+                bool stopRequested;
+                std::exception_ptr decompressionError;
+                std::thread decompressingThread;
+        };
+#endif
+
+namespace {
+
+const std::size_t COMPRESSED_BUFFER_SIZE = 131072;
+
+/* deletes the object that it holds unless it is released (used to avoid leaks when a constructor throws) */
+template<typename T>
+class ScopedOwner
+        {
+        public:
+                ScopedOwner(T * p)
+                        :ptr(p)
+                        {}
+                ~ScopedOwner()
+                        {
+                        delete ptr;
+                        }
+                T * Get() const
+                        {
+                        return ptr;
+                        }
+                T * Release()
+                        {
+                        T * p = ptr;
+                        ptr = 0L;
+                        return p;
+                        }
+        private:
+                ScopedOwner(const ScopedOwner &); /** don't define, not copyable*/
+                ScopedOwner & operator=(const ScopedOwner &); /** don't define, not copyable*/
+
+                T * ptr;
+        };
+
+void ThrowTruncatedError(const char * formatName)
+        {
+        NxsString m;
+        m << "The " << formatName << " compressed input ended unexpectedly (the file is truncated)";
+        throw NxsException(m);
+        }
+
+#if defined(NCL_HAS_ZLIB)
+class NxsGzipDecompressor: public NxsDecompressor
+        {
+        public:
+                NxsGzipDecompressor(std::istream & compressedStream)
+                        :inp(compressedStream),
+                        inBuffer(COMPRESSED_BUFFER_SIZE),
+                        memberEnded(false),
+                        finished(false)
+                        {
+                        std::memset(&zs, 0, sizeof(zs));
+                        /* 15 + 32 : the largest window, and detection of the gzip (or zlib) header */
+                        if (inflateInit2(&zs, 15 + 32) != Z_OK)
+                                throw NxsException("Could not initialize zlib to decompress gzip input");
+                        }
+                ~NxsGzipDecompressor()
+                        {
+                        inflateEnd(&zs);
+                        }
+                std::size_t Decompress(char * out, std::size_t capacity)
+                        {
+                        zs.next_out = reinterpret_cast<Bytef *>(out);
+                        zs.avail_out = (uInt) capacity;
+                        while (zs.avail_out > 0 && !finished)
+                                {
+                                if (zs.avail_in == 0)
+                                        {
+                                        inp.read(&inBuffer[0], (std::streamsize) inBuffer.size());
+                                        const std::streamsize n = inp.gcount();
+                                        if (n <= 0)
+                                                {
+                                                if (!memberEnded)
+                                                        ThrowTruncatedError("gzip");
+                                                finished = true;
+                                                break;
+                                                }
+                                        zs.next_in = reinterpret_cast<Bytef *>(&inBuffer[0]);
+                                        zs.avail_in = (uInt) n;
+                                        }
+                                const int r = inflate(&zs, Z_NO_FLUSH);
+                                if (r == Z_STREAM_END)
+                                        {
+                                        /* gzip files can hold several members, which are decompressed in order */
+                                        memberEnded = true;
+                                        inflateReset(&zs);
+                                        }
+                                else if (r == Z_OK)
+                                        memberEnded = false;
+                                else if (r == Z_BUF_ERROR)
+                                        continue; /* no progress until more input is read */
+                                else if (memberEnded)
+                                        {
+                                        /* bytes after the last member are ignored (as gzip does) */
+                                        finished = true;
+                                        }
+                                else
+                                        {
+                                        NxsString m;
+                                        m << "The gzip compressed input is corrupt";
+                                        if (zs.msg)
+                                                m << " (" << zs.msg << ')';
+                                        throw NxsException(m);
+                                        }
+                                }
+                        return capacity - zs.avail_out;
+                        }
+        private:
+                std::istream & inp;
+                std::vector<char> inBuffer;
+                z_stream zs;
+                bool memberEnded;
+                bool finished;
+        };
+#endif
+
+#if defined(NCL_HAS_ZSTD)
+class NxsZstdDecompressor: public NxsDecompressor
+        {
+        public:
+                NxsZstdDecompressor(std::istream & compressedStream)
+                        :inp(compressedStream),
+                        inBuffer(ZSTD_DStreamInSize()),
+                        ds(ZSTD_createDStream()),
+                        frameEnded(false),
+                        finished(false)
+                        {
+                        if (ds == NULL)
+                                throw NxsException("Could not initialize libzstd to decompress zstd input");
+                        ZSTD_initDStream(ds);
+                        in.src = &inBuffer[0];
+                        in.size = 0;
+                        in.pos = 0;
+                        }
+                ~NxsZstdDecompressor()
+                        {
+                        ZSTD_freeDStream(ds);
+                        }
+                std::size_t Decompress(char * out, std::size_t capacity)
+                        {
+                        ZSTD_outBuffer outBuf;
+                        outBuf.dst = out;
+                        outBuf.size = capacity;
+                        outBuf.pos = 0;
+                        while (outBuf.pos < outBuf.size && !finished)
+                                {
+                                if (in.pos == in.size)
+                                        {
+                                        inp.read(&inBuffer[0], (std::streamsize) inBuffer.size());
+                                        const std::streamsize n = inp.gcount();
+                                        if (n <= 0)
+                                                {
+                                                if (!frameEnded)
+                                                        ThrowTruncatedError("zstd");
+                                                finished = true;
+                                                break;
+                                                }
+                                        in.size = (std::size_t) n;
+                                        in.pos = 0;
+                                        }
+                                /* returns 0 when a frame is complete (the next call starts the next frame) */
+                                const std::size_t r = ZSTD_decompressStream(ds, &outBuf, &in);
+                                if (ZSTD_isError(r))
+                                        {
+                                        NxsString m;
+                                        m << "The zstd compressed input is corrupt (" << ZSTD_getErrorName(r) << ')';
+                                        throw NxsException(m);
+                                        }
+                                frameEnded = (r == 0);
+                                }
+                        return outBuf.pos;
+                        }
+        private:
+                std::istream & inp;
+                std::vector<char> inBuffer;
+                ZSTD_DStream * ds;
+                ZSTD_inBuffer in;
+                bool frameEnded;
+                bool finished;
+        };
+#endif
+
+const char * GetCompressionFormatName(NxsCompressionFormat format)
+        {
+        if (format == NXS_GZIP_COMPRESSED)
+                return "gzip";
+        if (format == NXS_ZSTD_COMPRESSED)
+                return "zstd";
+        return "uncompressed";
+        }
+
+void ThrowUnsupportedCompression(NxsCompressionFormat format, const char * filepath)
+        {
+        const char * formatName = GetCompressionFormatName(format);
+        NxsString m;
+        if (filepath)
+                m << "The file \"" << filepath << "\" is ";
+        else
+                m << "The input is ";
+        m << formatName << " compressed, but this build of NCL cannot read " << formatName;
+        m << " data (NCL must be built with " << (format == NXS_ZSTD_COMPRESSED ? "libzstd" : "zlib") << ")";
+        throw NxsException(m);
+        }
+
+NxsDecompressor * CreateDecompressor(std::istream & compressedStream, NxsCompressionFormat format)
+        {
+#        if defined(NCL_HAS_ZLIB)
+                if (format == NXS_GZIP_COMPRESSED)
+                        return new NxsGzipDecompressor(compressedStream);
+#        endif
+#        if defined(NCL_HAS_ZSTD)
+                if (format == NXS_ZSTD_COMPRESSED)
+                        return new NxsZstdDecompressor(compressedStream);
+#        endif
+        ThrowUnsupportedCompression(format, NULL);
+        return NULL;
+        }
+
+} // anonymous namespace
+
+NxsCompressionFormat NxsDetectCompression(std::istream & inp)
+        {
+        const std::streampos start = inp.tellg();
+        if (start == std::streampos(-1))
+                return NXS_UNCOMPRESSED;
+        unsigned char magic[4] = {0, 0, 0, 0};
+        inp.read(reinterpret_cast<char *>(magic), 4);
+        const std::streamsize n = inp.gcount();
+        inp.clear();
+        inp.seekg(start);
+        if (n >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+                return NXS_GZIP_COMPRESSED;
+        if (n == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+                return NXS_ZSTD_COMPRESSED;
+        return NXS_UNCOMPRESSED;
+        }
+
+bool NxsCanDecompress(NxsCompressionFormat format)
+        {
+        if (format == NXS_UNCOMPRESSED)
+                return true;
+#        if defined(NCL_HAS_ZLIB)
+                if (format == NXS_GZIP_COMPRESSED)
+                        return true;
+#        endif
+#        if defined(NCL_HAS_ZSTD)
+                if (format == NXS_ZSTD_COMPRESSED)
+                        return true;
+#        endif
+        return false;
+        }
+
+NxsDecompressingStreamBuf::NxsDecompressingStreamBuf(
+  std::istream & compressedStream,
+  NxsCompressionFormat format,
+  std::size_t blockSize,
+  unsigned numBlocksAhead)
+        :decompressor(0L),
+        currentBlock(UINT_MAX),
+        bytesBeforeCurrentBlock(0),
+        atEnd(false),
+        queue(0L)
+        {
+        /* the destructor is not called if the constructor throws, so the decompressor is owned by a local until
+                nothing else can throw */
+        ScopedOwner<NxsDecompressor> decompressorOwner(CreateDecompressor(compressedStream, format));
+        if (blockSize == 0)
+                blockSize = 1;
+#        if defined(NCL_HAS_STD_THREAD)
+                blocks.resize(numBlocksAhead < 2 ? 2 : numBlocksAhead);
+#        else
+                blocks.resize(1);
+#        endif
+        for (std::vector<Block>::iterator bIt = blocks.begin(); bIt != blocks.end(); ++bIt)
+                {
+                bIt->data.resize(blockSize);
+                bIt->length = 0;
+                }
+        setg(0L, 0L, 0L);
+        decompressor = decompressorOwner.Get();
+#        if defined(NCL_HAS_STD_THREAD)
+                ScopedOwner<NxsDecompressionQueue> queueOwner(new NxsDecompressionQueue());
+                queue = queueOwner.Get();
+                queue->decompressingThread = std::thread(&NxsDecompressingStreamBuf::DecompressAhead, this);
+                queueOwner.Release();
+#        endif
+        decompressorOwner.Release();
+        }
+
+NxsDecompressingStreamBuf::~NxsDecompressingStreamBuf()
+        {
+#        if defined(NCL_HAS_STD_THREAD)
+                        {
+                        std::lock_guard<std::mutex> lock(queue->queueMutex);
+                        queue->stopRequested = true;
+                        }
+                queue->blockReleased.notify_one();
+                queue->decompressingThread.join();
+                delete queue;
+#        endif
+        delete decompressor;
+        }
+
+/* Fills `block` with decompressed data. The block is only partly filled at the end of the data. */
+void NxsDecompressingStreamBuf::FillBlock(Block & block)
+        {
+        block.length = 0;
+        const std::size_t capacity = block.data.size();
+        while (block.length < capacity)
+                {
+                const std::size_t n = decompressor->Decompress(&block.data[block.length], capacity - block.length);
+                if (n == 0)
+                        break;
+                block.length += n;
+                }
+        }
+
+#if defined(NCL_HAS_STD_THREAD)
+/* Runs on the decompressing thread: fills the blocks in order, waiting whenever all of them hold data that has not been read. */
+void NxsDecompressingStreamBuf::DecompressAhead()
+        {
+        const unsigned numBlocks = (unsigned) blocks.size();
+        unsigned nextToFill = 0;
+        for (;;)
+                {
+                        {
+                        std::unique_lock<std::mutex> lock(queue->queueMutex);
+                        while (queue->numFilled == numBlocks && !queue->stopRequested)
+                                queue->blockReleased.wait(lock);
+                        if (queue->stopRequested)
+                                return;
+                        }
+                Block & block = blocks[nextToFill];
+                std::exception_ptr error;
+                try
+                        {
+                        FillBlock(block);
+                        }
+                catch (...)
+                        {
+                        error = std::current_exception();
+                        block.length = 0;
+                        }
+                const bool lastBlock = (block.length == 0);
+                        {
+                        std::lock_guard<std::mutex> lock(queue->queueMutex);
+                        if (error)
+                                queue->decompressionError = error;
+                        ++queue->numFilled;
+                        }
+                queue->blockFilled.notify_one();
+                if (lastBlock)
+                        return;
+                nextToFill = (nextToFill + 1) % numBlocks;
+                }
+        }
+#endif
+
+void NxsDecompressingStreamBuf::ReleaseCurrentBlock()
+        {
+        if (currentBlock == UINT_MAX)
+                return;
+        bytesBeforeCurrentBlock += blocks[currentBlock].length;
+        setg(0L, 0L, 0L);
+#        if defined(NCL_HAS_STD_THREAD)
+                        {
+                        std::lock_guard<std::mutex> lock(queue->queueMutex);
+                        --queue->numFilled;
+                        queue->nextToRead = (currentBlock + 1) % ((unsigned) blocks.size());
+                        }
+                queue->blockReleased.notify_one();
+#        endif
+        currentBlock = UINT_MAX;
+        }
+
+NxsDecompressingStreamBuf::int_type NxsDecompressingStreamBuf::underflow()
+        {
+        if (gptr() < egptr())
+                return traits_type::to_int_type(*gptr());
+        if (atEnd)
+                return traits_type::eof();
+        ReleaseCurrentBlock();
+#        if defined(NCL_HAS_STD_THREAD)
+                unsigned blockIndex;
+                        {
+                        std::unique_lock<std::mutex> lock(queue->queueMutex);
+                        while (queue->numFilled == 0)
+                                queue->blockFilled.wait(lock);
+                        blockIndex = queue->nextToRead;
+                        }
+                if (blocks[blockIndex].length == 0)
+                        {
+                        atEnd = true;
+                        if (queue->decompressionError)
+                                std::rethrow_exception(queue->decompressionError);
+                        return traits_type::eof();
+                        }
+#        else
+                const unsigned blockIndex = 0;
+                try
+                        {
+                        FillBlock(blocks[0]);
+                        }
+                catch (...)
+                        {
+                        atEnd = true;
+                        throw;
+                        }
+                if (blocks[0].length == 0)
+                        {
+                        atEnd = true;
+                        return traits_type::eof();
+                        }
+#        endif
+        currentBlock = blockIndex;
+        Block & block = blocks[blockIndex];
+        setg(&block.data[0], &block.data[0], &block.data[0] + block.length);
+        return traits_type::to_int_type(*gptr());
+        }
+
+NxsDecompressingStreamBuf::pos_type NxsDecompressingStreamBuf::seekoff(
+  off_type off,
+  std::ios_base::seekdir dir,
+  std::ios_base::openmode which)
+        {
+        if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::in) == 0)
+                return pos_type(off_type(-1));
+        return pos_type(off_type(bytesBeforeCurrentBlock + (gptr() - eback())));
+        }
+
+NxsInputFile::~NxsInputFile()
+        {
+        /* the decompressing thread reads from `file`, so it is stopped before the file is closed */
+        delete decompressedStream;
+        delete decompressingBuf;
+        }
+
+bool NxsInputFile::Open(const char * filepath)
+        {
+        delete decompressedStream;
+        decompressedStream = 0L;
+        delete decompressingBuf;
+        decompressingBuf = 0L;
+        compressionFormat = NXS_UNCOMPRESSED;
+        if (file.is_open())
+                file.close();
+        file.clear();
+        file.open(filepath, std::ios::binary);
+        isOpen = file.good();
+        if (!isOpen)
+                return false;
+        compressionFormat = NxsDetectCompression(file);
+        if (compressionFormat == NXS_UNCOMPRESSED)
+                return true;
+        if (!NxsCanDecompress(compressionFormat))
+                ThrowUnsupportedCompression(compressionFormat, filepath);
+        decompressingBuf = new NxsDecompressingStreamBuf(file, compressionFormat);
+        decompressedStream = new std::istream(decompressingBuf);
+        /* errors in the compressed data are raised as NxsExceptions by the stream buffer. With badbit in the
+                exception mask, istream functions rethrow them instead of only setting badbit.
+        */
+        decompressedStream->exceptions(std::ios::badbit);
+        return true;
+        }
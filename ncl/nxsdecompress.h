@@ -0,0 +1,146 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSDECOMPRESS_H
+#define NCL_NXSDECOMPRESS_H
+
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "ncl/nxsdefs.h"
+
+/*! The compression formats that NCL recognizes (by the magic bytes at the start of a file).
+
+        Reading gzip input requires NCL to be built with zlib (NCL_HAS_ZLIB defined) and reading zstd input requires
+        NCL to be built with libzstd (NCL_HAS_ZSTD defined). The build scripts define these when the libraries are found.
+*/
+enum NxsCompressionFormat
+        {
+        NXS_UNCOMPRESSED,
+        NXS_GZIP_COMPRESSED,
+        NXS_ZSTD_COMPRESSED
+        };
+
+/*! \returns the compression format of the data at the current position of `inp` (which should be opened in
+        binary mode). The stream position is restored. Streams that cannot seek are reported as NXS_UNCOMPRESSED.
+*/
+NxsCompressionFormat NxsDetectCompression(std::istream & inp);
+/*! \returns true if this build of NCL can decompress `format` */
+bool NxsCanDecompress(NxsCompressionFormat format);
+
+class NxsDecompressor;
+class NxsDecompressionQueue;
+
+/*! A read-only std::streambuf that decompresses the data read from another stream.
+
+        The decompressed data are produced in blocks of `blockSize` bytes. If NCL was built with thread support, the
+        blocks are decompressed on a separate thread (up to `numBlocksAhead` blocks ahead of the reader), so that the
+        decompression overlaps with the parsing of the blocks that have already been decompressed.
+
+        If the compressed data are corrupt (or truncated) the reading function raises an NxsException. Streams
+        created by NxsInputFile set badbit in their exception mask, so that the NxsException reaches the caller of
+        istream functions such as read().
+
+        Only seekoff(0, std::ios::cur) is supported (so tellg reports the number of decompressed bytes that have been
+        read).
+*/
+class NxsDecompressingStreamBuf: public std::streambuf
+        {
+        public:
+                NxsDecompressingStreamBuf(std::istream & compressedStream,
+                                          NxsCompressionFormat format,
+                                          std::size_t blockSize = 262144,
+                                          unsigned numBlocksAhead = 4);
+                ~NxsDecompressingStreamBuf();
+        protected:
+                int_type underflow();
+                pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+        private:
+                NxsDecompressingStreamBuf(const NxsDecompressingStreamBuf &); /** don't define, not copyable*/
+                NxsDecompressingStreamBuf & operator=(const NxsDecompressingStreamBuf &); /** don't define, not copyable*/
+
+                /*! a block of decompressed data. `length` is 0 for the block that marks the end of the data */
+                class Block
+                        {
+                        public:
+                                std::vector<char> data;
+                                std::size_t length;
+                        };
+                void FillBlock(Block & block);
+                void ReleaseCurrentBlock();
+                void DecompressAhead();
+
+                NxsDecompressor * decompressor;
+                std::vector<Block> blocks;
+                unsigned currentBlock; /* the index of the block in the get area (UINT_MAX if none) */
+                std::size_t bytesBeforeCurrentBlock;
+                bool atEnd;
+                /* the state shared with the decompressing thread (NULL if NCL was built without thread support).
+                        It is kept out of this header so that the layout of the class does not depend on the C++
+                        standard that a client of the library is compiled with. */
+                NxsDecompressionQueue * queue;
+        };
+
+/*! Opens a file for reading, decompressing it if it starts with the magic bytes of gzip or zstd data.
+
+        NxsReader::ReadFilepath and MultiFormatReader::ReadFilepath read files through this class, so compressed
+        files can be read without decompressing them to a temporary file first.
+*/
+class NxsInputFile
+        {
+        public:
+                NxsInputFile()
+                        :isOpen(false),
+                        compressionFormat(NXS_UNCOMPRESSED),
+                        decompressingBuf(0L),
+                        decompressedStream(0L)
+                        {}
+                ~NxsInputFile();
+                /*! Opens the file at `filepath`. \returns false if the file could not be opened.
+                        Raises an NxsException if the file is compressed with a format that this build of NCL cannot
+                        decompress.
+                */
+                bool Open(const char * filepath);
+                bool IsOpen() const
+                        {
+                        return isOpen;
+                        }
+                NxsCompressionFormat GetCompressionFormat() const
+                        {
+                        return compressionFormat;
+                        }
+                /*! \returns the stream of (decompressed) file contents */
+                std::istream & GetStream()
+                        {
+                        return (decompressedStream ? *decompressedStream : file);
+                        }
+        private:
+                NxsInputFile(const NxsInputFile &); /** don't define, not copyable*/
+                NxsInputFile & operator=(const NxsInputFile &); /** don't define, not copyable*/
+
+                std::ifstream file;
+                bool isOpen;
+                NxsCompressionFormat compressionFormat;
+                NxsDecompressingStreamBuf * decompressingBuf;
+                std::istream * decompressedStream;
+        };
+
+#endif
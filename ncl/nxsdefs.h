@@ -58,6 +58,13 @@
 #        define NCL_ASSERT(expr)  if (!(expr)) ncl_assertion_failed((const char *)#expr, (const char *)__FUNCTION__, __FILE__, __LINE__)
 #endif
 
+// NCL_HAS_STD_THREAD is defined when the compiler supports C++11 threads.
+// Functions that take a `numThreads` argument do their work serially if it is
+//        not defined. Define NCL_NO_THREADS when you compile NCL to force this.
+#if !defined(NCL_NO_THREADS) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#        define NCL_HAS_STD_THREAD
+#endif
+
 // Maximum number of states that can be stored; the only limitation is that this
 // number be less than the maximum size of an int (not likely to be a problem).
 // A good number for this is 76, which is 96 (the number of distinct symbols
@@ -85,7 +85,7 @@ NxsDistancesBlock::NxsDistancesBlock(
         }
 
 /*!
-        Deletes `matrix' and `taxonPos' arrays.
+        Frees the matrix.
 */
 NxsDistancesBlock::~NxsDistancesBlock()
         {
@@ -375,7 +375,12 @@ bool NxsDistancesBlock::HandleNextPass(
                         if (token.GetTokenLength() == 1 && t[0] == missing)
                                 SetMissing(corrected_i, corrected_j);
                         else
-                                SetDistance(corrected_i, corrected_j, atof(t.c_str()));
+                                {
+                                double d;
+                                if (!NxsString::to_double(t.c_str(), &d))
+                                        d = atof(t.c_str()); /* keeps the leading number of a malformed token, as earlier versions did */
+                                SetDistance(corrected_i, corrected_j, d);
+                                }
                         }
                 }
         offset += jmax;
@@ -391,7 +396,23 @@ void NxsDistancesBlock::CopyDistancesContents(const NxsDistancesBlock &other)
         labels = other.labels;
         triangle = other.triangle;
         missing = other.missing;
-        matrix = other.matrix;
+        matrixDim = other.matrixDim;
+        packedTriangle = other.packedTriangle;
+        distances = other.distances;
+        missingCells = other.missingCells;
+        }
+
+/*!
+        Allocates a `dim` x `dim` matrix with every cell missing. The matrix is stored as a packed lower triangle unless
+        `triangle` is NxsDistancesBlockEnum(both).
+*/
+void NxsDistancesBlock::AllocateMatrix(unsigned dim)
+        {
+        matrixDim = dim;
+        packedTriangle = (triangle != NxsDistancesBlockEnum(both));
+        const std::size_t nCells = (packedTriangle ? (((std::size_t) dim) * (dim + 1))/2 : ((std::size_t) dim) * dim);
+        distances.assign(nCells, 0.0);
+        missingCells.assign(nCells, true);
         }
 
 /*!
@@ -429,8 +450,7 @@ void NxsDistancesBlock::HandleMatrixCommand(
                 errormsg << "NTAX in " << NCL_BLOCKTYPE_ATTR_NAME << " block must be less than or equal to NTAX in TAXA block\nNote: one circumstance that can cause this error is \nforgetting to specify NTAX in DIMENSIONS command when \na TAXA block has not been provided";
                 throw NxsException(errormsg, token.GetFilePosition(), token.GetFileLine(), token.GetFileColumn());
                 }
-        NxsDistanceDatumRow row(nTaxInTaxBlock);
-        matrix.assign(nTaxInTaxBlock, row);
+        AllocateMatrix(nTaxInTaxBlock);
         unsigned offset = 0;
         for (;;)
                 {
@@ -563,7 +583,10 @@ void NxsDistancesBlock::Reset()
         {
         NxsBlock::Reset();
         ResetSurrogate();
-        matrix.clear();
+        matrixDim = 0;
+        packedTriangle = true;
+        distances.clear();
+        missingCells.clear();
         expectedNtax        = 0;
         nchar       = 0;
         diagonal    = true;
@@ -582,14 +605,31 @@ unsigned NxsDistancesBlock::GetNchar() NCL_COULD_BE_CONST /*v2.1to2.2 1 */
         }
 
 /*!
-        Returns the value of the (`i', `j')th element of `matrix'. Assumes `i' and `j' are both in the range [0..`ntax')
-        and the distance stored at `matrix[i][j]' is not missing. Also assumes `matrix' is not NULL.
+        Returns the value of the (`i', `j')th element of the matrix (0.0 if that distance is missing). Throws
+        NxsNCLAPIException if `i' or `j' is not in the range [0..`ntax').
+        For triangular matrices GetDistance(i, j) and GetDistance(j, i) are the same cell.
 */
 double NxsDistancesBlock::GetDistance(
   unsigned i,        /* the row */
   unsigned j) const /* the column */
         {
-        return GetCell(i,j).value;
+        return distances[CellIndex(i, j)];
+        }
+
+/*!
+        Returns a pointer to the stored values of row `i', and sets `*rowLength' to the number of values in the row.
+
+        If IsPackedTriangle() is true then the row holds the distances from taxon `i' to taxa 0 through `i' (so
+        `*rowLength' is `i' + 1), otherwise it holds the distances to all taxa. Missing distances are stored as 0.0 (use
+        IsMissing to tell them apart from real zeros). The pointer is invalidated by Reset or by reading a new matrix.
+*/
+const double * NxsDistancesBlock::GetDistanceRow(
+  unsigned i,        /* the row */
+  unsigned *rowLength) const /* on exit, the number of values in the row */
+        {
+        const std::size_t start = CellIndex(i, 0);
+        *rowLength = (packedTriangle ? i + 1 : matrixDim);
+        return &distances[start];
         }
 
 /*!
@@ -657,41 +697,41 @@ bool NxsDistancesBlock::IsLabels() NCL_COULD_BE_CONST /*v2.1to2.2 1 */
         }
 
 /*!
-        Returns true if the (`i',`j')th distance is missing. Assumes `i' and `j' are both in the range [0..`ntax') and
-        `matrix' is not NULL.
+        Returns true if the (`i',`j')th distance is missing. Throws NxsNCLAPIException if `i' or `j' is not in the
+        range [0..`ntax').
 */
 bool NxsDistancesBlock::IsMissing(
   unsigned i,        /* the row */
   unsigned j) const        /* the column */
         {
-        return (bool)(GetCell(i,j).missing);
+        return missingCells[CellIndex(i, j)];
         }
 
 /*!
-        Sets the value of the (`i',`j')th matrix element to `d' and `missing' to false . Assumes `i' and `j' are both in
-        the range [0..`ntax') and `matrix' is not NULL.
+        Sets the value of the (`i',`j')th matrix element to `d' and marks it as not missing. Throws NxsNCLAPIException
+        if `i' or `j' is not in the range [0..`ntax').
 */
 void NxsDistancesBlock::SetDistance(
   unsigned i,        /* the row */
   unsigned j,        /* the column */
   double d)                /* the distance value */
         {
-        NxsDistanceDatum & c =  GetCell(i, j);
-        c.value = d;
-        c.missing = false;
+        const std::size_t c = CellIndex(i, j);
+        distances[c] = d;
+        missingCells[c] = false;
         }
 
 /*!
-        Sets the value of the (`i', `j')th `matrix' element to missing. Assumes `i' and `j' are both in the range
-        [0..`ntax') and `matrix' is not NULL.
+        Marks the (`i', `j')th matrix element as missing. Throws NxsNCLAPIException if `i' or `j' is not in the range
+        [0..`ntax').
 */
 void NxsDistancesBlock::SetMissing(
   unsigned i,        /* the row */
   unsigned j)        /* the column */
         {
-        NxsDistanceDatum & c =  GetCell(i, j);
-        c.missing = 1;
-        c.value = 0.0;
+        const std::size_t c = CellIndex(i, j);
+        distances[c] = 0.0;
+        missingCells[c] = true;
         }
 
 /*!
@@ -55,12 +55,17 @@
                                                            NxsTaxaBlockAPI        data member taxa)
                                                                            object)
 
-        MATRIX                             matrix              GetDistance
+        MATRIX                             distances           GetDistance
+                                           missingCells        GetDistanceRow
                                                                IsMissing
                                                                SetMissing
                                                                SetDistance
         ------------------------------------------------------------------------
 >
+        If the matrix is upper- or lower-triangular, only the lower triangle (including the diagonal) is stored, packed
+        row after row in one array of doubles, and the matrix is treated as symmetric (GetDistance(i, j) and
+        GetDistance(j, i) return the same value). A rectangular (TRIANGLE=BOTH) matrix is stored as a full ntax x ntax
+        array. In both cases the missing-data flags are kept in a separate bitmap.
 */
 class NxsDistancesBlock
   : public NxsBlock, public NxsTaxaBlockSurrogate
@@ -70,6 +75,7 @@ class NxsDistancesBlock
                 virtual                                ~NxsDistancesBlock();
 
                 double                                GetDistance(unsigned i, unsigned j) const;
+                const double *                GetDistanceRow(unsigned i, unsigned *rowLength) const;
                 char                                GetMissingSymbol() NCL_COULD_BE_CONST ; /*v2.1to2.2 1 */
                 unsigned                        GetNchar() NCL_COULD_BE_CONST ; /*v2.1to2.2 1 */
                 unsigned                        GetTriangle() NCL_COULD_BE_CONST ; /*v2.1to2.2 1 */
@@ -80,6 +86,10 @@ class NxsDistancesBlock
                 bool                                IsLabels() NCL_COULD_BE_CONST ; /*v2.1to2.2 1 */
                 bool                                IsLowerTriangular() NCL_COULD_BE_CONST ;  /*v2.1to2.2 1 */
                 bool                                IsMissing(unsigned i, unsigned j) const;
+                bool                                IsPackedTriangle() const
+                        {
+                        return packedTriangle;
+                        }
                 bool                                IsUpperTriangular() NCL_COULD_BE_CONST ;  /*v2.1to2.2 1 */
                 virtual void                Report(std::ostream &out) NCL_COULD_BE_CONST ;  /*v2.1to2.2 1 */
                 virtual void                Reset();
@@ -153,16 +163,18 @@ class NxsDistancesBlock
                 virtual void                Read(NxsToken &token);
 
         private:
-                NxsDistanceDatum & GetCell(unsigned i, unsigned j)
-                        {
-                        return matrix.at(i).at(j);
-                        }
-                const NxsDistanceDatum & GetCell(unsigned i, unsigned j) const
+                /* returns the position of cell (i, j) in `distances` and `missingCells` */
+                std::size_t CellIndex(unsigned i, unsigned j) const
                         {
-                        return matrix.at(i).at(j);
+                        if (i >= matrixDim || j >= matrixDim)
+                                throw NxsNCLAPIException("Taxon index out of range in a DISTANCES block matrix");
+                        if (!packedTriangle)
+                                return ((std::size_t) i) * matrixDim + j;
+                        if (j > i)
+                                std::swap(i, j);
+                        return (((std::size_t) i) * (i + 1))/2 + j;
                         }
-                typedef std::vector<NxsDistanceDatum> NxsDistanceDatumRow;
-                typedef std::vector<NxsDistanceDatumRow> NxsDistanceDatumMatrix;
+                void AllocateMatrix(unsigned dim);
 
                 unsigned                        expectedNtax;                /* number of taxa (determines dimensions of the matrix) */
                 unsigned                        nchar;                /* the number of characters used in generating the pairwise distances */
@@ -175,8 +187,13 @@ class NxsDistancesBlock
 
                 char                                missing;        /* the symbol used to represent missing data (e.g. '?') */
 
-                NxsDistanceDatumMatrix        matrix;        /* the structure used for storing the pairwise distance matrix */
+                unsigned                        matrixDim;        /* number of rows (and columns) in the stored matrix */
+                bool                                packedTriangle;        /* true if only the lower triangle (with the diagonal) is stored */
+                std::vector<double>        distances;        /* the pairwise distances (0.0 for missing cells). Row-major full matrix or packed lower triangle */
+                std::vector<bool>        missingCells;        /* bitmap with the same layout as `distances`. true for missing cells */
                 friend class PublicNexusReader;
+                friend class NxsPairwiseDistanceWorker;
+                friend class NxsRFDistanceCalculator;
         };
 
 typedef NxsDistancesBlock        DistancesBlock;
@@ -87,7 +87,8 @@ class DuplicatedLabelNxsException: public NxsException
 /*------------------------------------------------------------------------------
  This exception will be thrown if NCL signal handling is activated (static
         methods in NxsReader control this) and a SIGINT is detected during a
-        parse.
+        parse. It is also thrown if the NxsCancellationToken of the reader is
+        canceled during a parse.
 */
 class NxsSignalCanceledParseException: public NxsException
         {
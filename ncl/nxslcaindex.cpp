@@ -0,0 +1,446 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include <sstream>
+#include "ncl/nxslcaindex.h"
+#include "ncl/nxsoutputbuffer.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#        include <intrin.h>
+#endif
+
+namespace
+{
+/* the position of the lowest set bit of `x` (which must not be 0) */
+inline unsigned LowestBit(uint64_t x)
+        {
+#        if defined(__GNUC__)
+                return (unsigned) __builtin_ctzll(x);
+#        elif defined(_MSC_VER) && defined(_M_X64)
+                unsigned long i;
+                _BitScanForward64(&i, x);
+                return (unsigned) i;
+#        else
+                unsigned i = 0;
+                for (; (x & 1) == 0; x >>= 1)
+                        i++;
+                return i;
+#        endif
+        }
+
+/* the position of the highest set bit of `x` (which must not be 0) */
+inline unsigned HighestBit(uint64_t x)
+        {
+#        if defined(__GNUC__)
+                return 63 - (unsigned) __builtin_clzll(x);
+#        elif defined(_MSC_VER) && defined(_M_X64)
+                unsigned long i;
+                _BitScanReverse64(&i, x);
+                return (unsigned) i;
+#        else
+                unsigned i = 0;
+                for (x >>= 1; x != 0; x >>= 1)
+                        i++;
+                return i;
+#        endif
+        }
+
+inline std::size_t HashNodePointer(const NxsSimpleNode * nd)
+        {
+        uint64_t x = (uint64_t) (uintptr_t) nd;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDULL;
+        x ^= x >> 33;
+        return (std::size_t) x;
+        }
+
+} // anonymous namespace
+
+void NxsLCAIndex::Build(const NxsSimpleTree & tree)
+        {
+        nodes.clear();
+        parents.clear();
+        depths.clear();
+        leafOrder.clear();
+        taxonToNode.clear();
+        numBlocks = 0;
+        const NxsSimpleNode * root = tree.GetRootConst();
+        if (root != NULL)
+                {
+                /* preorder, following the child and sibling links (`path` holds the indices of the ancestors of nd) */
+                std::vector<unsigned> path;
+                const NxsSimpleNode * nd = root;
+                for (;;)
+                        {
+                        const unsigned ind = (unsigned) nodes.size();
+                        nodes.push_back(nd);
+                        parents.push_back(path.empty() ? UINT_MAX : path.back());
+                        depths.push_back((unsigned) path.size());
+                        if (nd->GetFirstChild())
+                                {
+                                path.push_back(ind);
+                                nd = nd->GetFirstChild();
+                                continue;
+                                }
+                        while (!path.empty() && nd->GetNextSib() == NULL)
+                                {
+                                nd = nodes[path.back()];
+                                path.pop_back();
+                                }
+                        if (path.empty())
+                                break;
+                        nd = nd->GetNextSib();
+                        }
+                }
+        const unsigned n = (unsigned) nodes.size();
+        subtreeSizes.assign(n, 1);
+        leafCounts.assign(n, 0);
+        for (unsigned i = n; i-- > 0;)
+                {
+                if (nodes[i]->IsTip())
+                        leafCounts[i] += 1;
+                if (i > 0)
+                        {
+                        subtreeSizes[parents[i]] += subtreeSizes[i];
+                        leafCounts[parents[i]] += leafCounts[i];
+                        }
+                }
+        firstLeaf.resize(n);
+        hasEdgeLens = false;
+        missingEdgeLens = false;
+        intEdgeLens = true;
+        for (unsigned i = 0; i < n; ++i)
+                {
+                if (i > 0)
+                        {
+                        const NxsSimpleEdge & edge = nodes[i]->GetEdgeToParentRef();
+                        if (edge.EdgeLenIsDefaultValue())
+                                missingEdgeLens = true;
+                        else
+                                {
+                                hasEdgeLens = true;
+                                if (!edge.IsIntEdgeLen())
+                                        intEdgeLens = false;
+                                }
+                        }
+                firstLeaf[i] = (unsigned) leafOrder.size();
+                if (nodes[i]->IsTip())
+                        leafOrder.push_back(i);
+                const unsigned t = nodes[i]->GetTaxonIndex();
+                if (t != UINT_MAX)
+                        {
+                        if (t >= taxonToNode.size())
+                                taxonToNode.resize(t + 1, UINT_MAX);
+                        taxonToNode[t] = i;
+                        }
+                }
+        /* node pointer to index hash table, with linear probing and a load factor of at most 1/2 */
+        std::size_t nBuckets = 16;
+        while (nBuckets < 2 * (std::size_t) n)
+                nBuckets *= 2;
+        nodeBuckets.assign(nBuckets, UINT_MAX);
+        for (unsigned i = 0; i < n; ++i)
+                {
+                std::size_t b = HashNodePointer(nodes[i]) & (nBuckets - 1);
+                while (nodeBuckets[b] != UINT_MAX)
+                        b = (b + 1) & (nBuckets - 1);
+                nodeBuckets[b] = i;
+                }
+        /* within each block of 64 nodes, the mask of node i has a bit for each node of the block up to i that is no
+                deeper than the nodes after it (up to i). These are the nodes left on a stack of increasing depths. */
+        numBlocks = (n + 63) / 64;
+        blockMasks.resize(n);
+        unsigned nLevels = 1;
+        while ((2U << (nLevels - 1)) <= numBlocks)
+                nLevels++;
+        blockSparseTable.assign(((std::size_t) nLevels) * numBlocks, 0);
+        for (unsigned blk = 0; blk < numBlocks; ++blk)
+                {
+                const unsigned s = blk * 64;
+                const unsigned e = (s + 64 < n ? s + 64 : n);
+                uint64_t mask = 0;
+                for (unsigned i = s; i < e; ++i)
+                        {
+                        while (mask != 0 && depths[s + HighestBit(mask)] > depths[i])
+                                mask &= ~(((uint64_t) 1) << HighestBit(mask));
+                        mask |= ((uint64_t) 1) << (i - s);
+                        blockMasks[i] = mask;
+                        }
+                blockSparseTable[blk] = s + LowestBit(mask);
+                }
+        for (unsigned level = 1; level < nLevels; ++level)
+                {
+                const unsigned half = 1U << (level - 1);
+                const unsigned * prev = &blockSparseTable[((std::size_t) level - 1) * numBlocks];
+                unsigned * curr = &blockSparseTable[((std::size_t) level) * numBlocks];
+                for (unsigned blk = 0; blk + 2 * half <= numBlocks; ++blk)
+                        curr[blk] = Shallower(prev[blk], prev[blk + half]);
+                }
+        }
+
+unsigned NxsLCAIndex::GetNodeIndex(const NxsSimpleNode * nd) const
+        {
+        if (nodeBuckets.empty())
+                return UINT_MAX;
+        const std::size_t mask = nodeBuckets.size() - 1;
+        for (std::size_t b = HashNodePointer(nd) & mask; nodeBuckets[b] != UINT_MAX; b = (b + 1) & mask)
+                {
+                if (nodes[nodeBuckets[b]] == nd)
+                        return nodeBuckets[b];
+                }
+        return UINT_MAX;
+        }
+
+unsigned NxsLCAIndex::RequireNodeIndex(const NxsSimpleNode * nd) const
+        {
+        const unsigned i = GetNodeIndex(nd);
+        if (i == UINT_MAX)
+                throw NxsNCLAPIException("A node that is not in the indexed tree was passed to an NxsLCAIndex");
+        return i;
+        }
+
+/* the shallowest node with an index from `first` to `last`, which are in the same block */
+unsigned NxsLCAIndex::GetShallowestInBlock(unsigned first, unsigned last) const
+        {
+        const unsigned s = first & ~63U;
+        return s + LowestBit(blockMasks[last] & (~((uint64_t) 0) << (first - s)));
+        }
+
+/* the shallowest node with an index from `first` to `last` */
+unsigned NxsLCAIndex::GetShallowestIndex(unsigned first, unsigned last) const
+        {
+        const unsigned firstBlock = first / 64;
+        const unsigned lastBlock = last / 64;
+        if (firstBlock == lastBlock)
+                return GetShallowestInBlock(first, last);
+        unsigned best = GetShallowestInBlock(first, firstBlock * 64 + 63);
+        if (lastBlock > firstBlock + 1)
+                {
+                const unsigned a = firstBlock + 1;
+                const unsigned b = lastBlock - 1;
+                const unsigned level = HighestBit(b - a + 1);
+                const unsigned * row = &blockSparseTable[((std::size_t) level) * numBlocks];
+                best = Shallower(best, Shallower(row[a], row[b + 1 - (1U << level)]));
+                }
+        return Shallower(best, GetShallowestInBlock(lastBlock * 64, last));
+        }
+
+unsigned NxsLCAIndex::GetMRCAIndex(unsigned a, unsigned b) const
+        {
+        if (a == b)
+                return a;
+        if (a > b)
+                std::swap(a, b);
+        /* the shallowest node after a (up to b) is a child of the MRCA */
+        return parents[GetShallowestIndex(a + 1, b)];
+        }
+
+unsigned NxsLCAIndex::GetMRCAIndex(const std::vector<unsigned> & nodeIndices) const
+        {
+        if (nodeIndices.empty())
+                return UINT_MAX;
+        /* the MRCA of a set of nodes is the MRCA of the first and last of them in preorder */
+        unsigned lowest = nodeIndices[0];
+        unsigned highest = nodeIndices[0];
+        for (std::vector<unsigned>::const_iterator iIt = nodeIndices.begin(); iIt != nodeIndices.end(); ++iIt)
+                {
+                if (*iIt < lowest)
+                        lowest = *iIt;
+                else if (*iIt > highest)
+                        highest = *iIt;
+                }
+        return GetMRCAIndex(lowest, highest);
+        }
+
+const NxsSimpleNode * NxsLCAIndex::GetMRCA(const NxsSimpleNode * a, const NxsSimpleNode * b) const
+        {
+        return nodes[GetMRCAIndex(RequireNodeIndex(a), RequireNodeIndex(b))];
+        }
+
+const NxsSimpleNode * NxsLCAIndex::GetMRCAOfTaxa(const std::vector<unsigned> & taxonIndices) const
+        {
+        std::vector<unsigned> nodeIndices;
+        nodeIndices.reserve(taxonIndices.size());
+        for (std::vector<unsigned>::const_iterator tIt = taxonIndices.begin(); tIt != taxonIndices.end(); ++tIt)
+                {
+                const unsigned i = GetTaxonNodeIndex(*tIt);
+                if (i == UINT_MAX)
+                        return NULL;
+                nodeIndices.push_back(i);
+                }
+        const unsigned m = GetMRCAIndex(nodeIndices);
+        return (m == UINT_MAX ? NULL : nodes[m]);
+        }
+
+std::vector<const NxsSimpleNode *> NxsLCAIndex::GetSubtreeNodes(const NxsSimpleNode * subRoot) const
+        {
+        const unsigned i = RequireNodeIndex(subRoot);
+        return std::vector<const NxsSimpleNode *>(nodes.begin() + i, nodes.begin() + i + subtreeSizes[i]);
+        }
+
+std::vector<const NxsSimpleNode *> NxsLCAIndex::GetSubtreeLeaves(const NxsSimpleNode * subRoot) const
+        {
+        const unsigned i = RequireNodeIndex(subRoot);
+        std::vector<const NxsSimpleNode *> leaves;
+        leaves.reserve(leafCounts[i]);
+        for (unsigned k = firstLeaf[i]; k < firstLeaf[i] + leafCounts[i]; ++k)
+                leaves.push_back(nodes[leafOrder[k]]);
+        return leaves;
+        }
+
+std::vector<unsigned> NxsLCAIndex::GetSubtreeTaxonIndices(const NxsSimpleNode * subRoot) const
+        {
+        const unsigned i = RequireNodeIndex(subRoot);
+        std::vector<unsigned> taxonIndices;
+        taxonIndices.reserve(leafCounts[i]);
+        for (unsigned k = firstLeaf[i]; k < firstLeaf[i] + leafCounts[i]; ++k)
+                taxonIndices.push_back(nodes[leafOrder[k]]->GetTaxonIndex());
+        return taxonIndices;
+        }
+
+void NxsLCAIndex::GetInducedSubtree(const std::vector<uint64_t> & taxonBits, std::vector<unsigned> & nodeIndices, std::vector<unsigned> & parentPositions) const
+        {
+        nodeIndices.clear();
+        parentPositions.clear();
+        for (unsigned w = 0; w < taxonBits.size(); ++w)
+                {
+                for (uint64_t bits = taxonBits[w]; bits != 0; bits &= bits - 1)
+                        {
+                        const unsigned i = GetTaxonNodeIndex(64 * w + LowestBit(bits));
+                        if (i != UINT_MAX)
+                                nodeIndices.push_back(i);
+                        }
+                }
+        /* the MRCAs of the nodes that are adjacent in preorder are the branching points of the induced subtree */
+        std::sort(nodeIndices.begin(), nodeIndices.end());
+        const std::size_t nSelected = nodeIndices.size();
+        for (std::size_t k = 1; k < nSelected; ++k)
+                nodeIndices.push_back(GetMRCAIndex(nodeIndices[k - 1], nodeIndices[k]));
+        std::sort(nodeIndices.begin(), nodeIndices.end());
+        nodeIndices.erase(std::unique(nodeIndices.begin(), nodeIndices.end()), nodeIndices.end());
+        /* `path` holds the positions of the ancestors (in the induced subtree) of the current node */
+        parentPositions.resize(nodeIndices.size());
+        std::vector<unsigned> path;
+        for (unsigned p = 0; p < nodeIndices.size(); ++p)
+                {
+                while (!path.empty() && !IsAncestor(nodeIndices[path.back()], nodeIndices[p]))
+                        path.pop_back();
+                parentPositions[p] = (path.empty() ? UINT_MAX : path.back());
+                path.push_back(p);
+                }
+        }
+
+/* the sum of the lengths of the edges between node `desc` and its ancestor `anc`. The edges of the path are added
+        up (rather than taking a difference of distances from the root), so that a single edge's length is returned as is
+        and the sum does not pick up the rounding errors of the edges above `anc`.
+*/
+double NxsLCAIndex::GetPathLength(unsigned anc, unsigned desc) const
+        {
+        double length = 0.0;
+        for (unsigned i = desc; i != anc; i = parents[i])
+                length += nodes[i]->GetEdgeToParentRef().GetDblEdgeLen();
+        return length;
+        }
+
+NxsFullTreeDescription NxsLCAIndex::GetInducedSubtreeDescription(const std::vector<uint64_t> & taxonBits, const std::string & treeName, bool rooted) const
+        {
+        std::vector<unsigned> vNodes;
+        std::vector<unsigned> vParents;
+        GetInducedSubtree(taxonBits, vNodes, vParents);
+        const unsigned m = (unsigned) vNodes.size();
+        if (m < 2)
+                throw NxsNCLAPIException("An induced subtree must have at least two of the taxa of the tree");
+        std::vector<unsigned> numChildren(m, 0);
+        for (unsigned p = 1; p < m; ++p)
+                numChildren[vParents[p]]++;
+        bool hasPolytomies = false;
+        bool hasDegTwoNodes = false;
+        for (unsigned p = 0; p < m; ++p)
+                {
+                if (numChildren[p] == 1)
+                        hasDegTwoNodes = true;
+                else if (numChildren[p] > 2 && (p != 0 || rooted || numChildren[p] > 3))
+                        hasPolytomies = true;
+                }
+        /* the newick string of a processed tree (the nodes are in preorder, so a node that is not the first child of its
+                parent follows a sibling's subtree) */
+        /* the merged edge lengths are written so that they are read back exactly */
+        std::ostringstream newick;
+        std::string edgeLen;
+        std::vector<unsigned> openNodes;
+        for (unsigned p = 0; p <= m; ++p)
+                {
+                while (!openNodes.empty() && (p == m || openNodes.back() != vParents[p]))
+                        {
+                        const unsigned c = openNodes.back();
+                        openNodes.pop_back();
+                        newick << ')';
+                        const unsigned t = nodes[vNodes[c]]->GetTaxonIndex();
+                        if (t != UINT_MAX)
+                                newick << 1 + t;
+                        if (c > 0 && hasEdgeLens)
+                                {
+                                edgeLen.clear();
+                                NxsAppendShortestDouble(edgeLen, GetPathLength(vNodes[vParents[c]], vNodes[c]), false);
+                                newick << ':' << edgeLen;
+                                }
+                        }
+                if (p == m)
+                        break;
+                if (p > 0 && vParents[p] != p - 1)
+                        newick << ',';
+                if (numChildren[p] > 0)
+                        {
+                        newick << '(';
+                        openNodes.push_back(p);
+                        }
+                else
+                        {
+                        newick << 1 + nodes[vNodes[p]]->GetTaxonIndex();
+                        if (hasEdgeLens)
+                                {
+                                edgeLen.clear();
+                                NxsAppendShortestDouble(edgeLen, GetPathLength(vNodes[vParents[p]], vNodes[p]), false);
+                                newick << ':' << edgeLen;
+                                }
+                        }
+                }
+        int flags = NxsFullTreeDescription::NXS_TREE_PROCESSED;
+        if (rooted)
+                flags |= NxsFullTreeDescription::NXS_IS_ROOTED_BIT;
+        if (hasEdgeLens)
+                {
+                flags |= NxsFullTreeDescription::NXS_HAS_SOME_EDGE_LENGTHS_BIT;
+                if (missingEdgeLens)
+                        flags |= NxsFullTreeDescription::NXS_MISSING_SOME_EDGE_LENGTHS_BIT;
+                if (intEdgeLens)
+                        flags |= NxsFullTreeDescription::NXS_INT_EDGE_LENGTHS_BIT;
+                }
+        if (hasPolytomies)
+                flags |= NxsFullTreeDescription::NXS_HAS_POLYTOMY_BIT;
+        if (hasDegTwoNodes)
+                flags |= NxsFullTreeDescription::NXS_HAS_DEG_TWO_NODES_BIT;
+        return NxsFullTreeDescription(newick.str(), treeName, flags);
+        }
+
+void NxsLCAIndex::BuildInducedSubtree(NxsSimpleTree & tree, const std::vector<uint64_t> & taxonBits) const
+        {
+        tree.Initialize(GetInducedSubtreeDescription(taxonBits, std::string(), true));
+        }
@@ -0,0 +1,177 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSLCAINDEX_H
+#define NCL_NXSLCAINDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ncl/nxstreesblock.h"
+
+/*! An index of the nodes of an NxsSimpleTree that answers most-recent-common-ancestor (MRCA, or lowest common
+        ancestor) queries in constant time.
+
+        Build numbers the nodes in preorder (without recursion, so very deep trees can be indexed) and records the
+        parent, depth and subtree size of each node. The nodes of a subtree have consecutive indices, and so do the
+        leaves of a subtree in the list of leaves, so ancestry tests are two comparisons and the nodes or leaves of a
+        subtree can be listed without a traversal.
+
+        For nodes a and b with preorder indices i < j, the MRCA is the parent of the shallowest node with an index in
+        (i, j]. That range-minimum query over the node depths is answered in constant time with a sparse table over
+        blocks of 64 nodes and, within a block, a bitmask (for each node) of the nodes that are no deeper than any later
+        node of the block. Building the index takes time and memory linear in the number of nodes (a few dozen bytes
+        per node).
+
+        The subtree induced by k taxa is found from the MRCAs of the k - 1 pairs of taxa that are adjacent in preorder,
+        in O(k log k) time (after a scan of the taxon bitset), so subtrees of a large tree can be extracted quickly.
+
+        The index refers to the nodes of the tree, so it must be rebuilt if the tree is changed or destroyed. The query
+        methods do not modify the index or the tree (they do not read edge comments), so one index can be used by
+        several threads at once.
+*/
+class NxsLCAIndex
+        {
+        public:
+                NxsLCAIndex()
+                        :hasEdgeLens(false),
+                        missingEdgeLens(false),
+                        intEdgeLens(true),
+                        numBlocks(0)
+                        {}
+                NxsLCAIndex(const NxsSimpleTree & tree)
+                        :hasEdgeLens(false),
+                        missingEdgeLens(false),
+                        intEdgeLens(true),
+                        numBlocks(0)
+                        {
+                        Build(tree);
+                        }
+                /*! Replaces the index with an index of `tree` */
+                void Build(const NxsSimpleTree & tree);
+
+                unsigned GetNumNodes() const
+                        {
+                        return (unsigned) nodes.size();
+                        }
+                /*! \returns the node with preorder index `nodeIndex` (the root has index 0) */
+                const NxsSimpleNode * GetNode(unsigned nodeIndex) const
+                        {
+                        return nodes[nodeIndex];
+                        }
+                /*! \returns the preorder index of `nd`, or UINT_MAX if it is not a node of the indexed tree */
+                unsigned GetNodeIndex(const NxsSimpleNode * nd) const;
+                /*! \returns the index of the node with taxon index `taxonIndex`, or UINT_MAX if no node has it */
+                unsigned GetTaxonNodeIndex(unsigned taxonIndex) const
+                        {
+                        return (taxonIndex < taxonToNode.size() ? taxonToNode[taxonIndex] : UINT_MAX);
+                        }
+                /*! \returns the index of the parent of node `nodeIndex` (UINT_MAX for the root) */
+                unsigned GetParentIndex(unsigned nodeIndex) const
+                        {
+                        return parents[nodeIndex];
+                        }
+                /*! \returns the number of edges between node `nodeIndex` and the root */
+                unsigned GetDepth(unsigned nodeIndex) const
+                        {
+                        return depths[nodeIndex];
+                        }
+                /*! \returns the number of nodes in the subtree of node `nodeIndex` (which are the nodes with indices
+                        nodeIndex to nodeIndex + GetSubtreeSize(nodeIndex) - 1)
+                */
+                unsigned GetSubtreeSize(unsigned nodeIndex) const
+                        {
+                        return subtreeSizes[nodeIndex];
+                        }
+                /*! \returns the number of leaves in the subtree of node `nodeIndex` */
+                unsigned GetNumLeavesBelow(unsigned nodeIndex) const
+                        {
+                        return leafCounts[nodeIndex];
+                        }
+                /*! \returns true if node `ancIndex` is node `descIndex` or one of its ancestors */
+                bool IsAncestor(unsigned ancIndex, unsigned descIndex) const
+                        {
+                        return (ancIndex <= descIndex && descIndex - ancIndex < subtreeSizes[ancIndex]);
+                        }
+                /*! \returns the index of the MRCA of nodes `a` and `b` */
+                unsigned GetMRCAIndex(unsigned a, unsigned b) const;
+                /*! \returns the index of the MRCA of the nodes (UINT_MAX if `nodeIndices` is empty) */
+                unsigned GetMRCAIndex(const std::vector<unsigned> & nodeIndices) const;
+                /*! \returns the MRCA of `a` and `b`. Raises an NxsNCLAPIException if either is not a node of the indexed
+                        tree.
+                */
+                const NxsSimpleNode * GetMRCA(const NxsSimpleNode * a, const NxsSimpleNode * b) const;
+                /*! \returns the MRCA of the nodes that have the taxon indices `taxonIndices`, or NULL if `taxonIndices` is
+                        empty or holds a taxon that is not in the tree.
+                */
+                const NxsSimpleNode * GetMRCAOfTaxa(const std::vector<unsigned> & taxonIndices) const;
+
+                /*! \returns the nodes of the subtree rooted at `subRoot` in preorder */
+                std::vector<const NxsSimpleNode *> GetSubtreeNodes(const NxsSimpleNode * subRoot) const;
+                /*! \returns the leaves of the subtree rooted at `subRoot` in preorder */
+                std::vector<const NxsSimpleNode *> GetSubtreeLeaves(const NxsSimpleNode * subRoot) const;
+                /*! \returns the taxon indices of the leaves of the subtree rooted at `subRoot` in preorder */
+                std::vector<unsigned> GetSubtreeTaxonIndices(const NxsSimpleNode * subRoot) const;
+
+                /*! Finds the subtree induced by the taxa whose bits are set in `taxonBits` (bit t % 64 of word t / 64 is
+                        the bit of taxon t, as in the bitsets of NxsSplitTable). Taxa that are not in the tree are ignored.
+
+                        The nodes of the induced subtree are the nodes of the selected taxa and the MRCAs of pairs of them.
+                        On exit `nodeIndices` holds their indices in preorder, and `parentPositions` holds the position (in
+                        `nodeIndices`) of the parent of each one in the induced subtree (UINT_MAX for its root). Nodes that
+                        would have only one child are suppressed, except for the nodes of selected taxa.
+                */
+                void GetInducedSubtree(const std::vector<uint64_t> & taxonBits, std::vector<unsigned> & nodeIndices, std::vector<unsigned> & parentPositions) const;
+                /*! \returns the processed description of the subtree induced by the taxa in `taxonBits` (see
+                        GetInducedSubtree). If the tree has edge lengths, the length of each edge of the subtree is the sum
+                        of the lengths of the edges of the path that it replaces. Internal nodes are labelled only if they
+                        have a taxon. Raises an NxsNCLAPIException if fewer than two of the taxa are in the tree.
+                */
+                NxsFullTreeDescription GetInducedSubtreeDescription(const std::vector<uint64_t> & taxonBits, const std::string & treeName, bool rooted) const;
+                /*! Replaces the contents of `tree` with the subtree induced by the taxa in `taxonBits` */
+                void BuildInducedSubtree(NxsSimpleTree & tree, const std::vector<uint64_t> & taxonBits) const;
+        private:
+                unsigned RequireNodeIndex(const NxsSimpleNode * nd) const;
+                unsigned GetShallowestIndex(unsigned first, unsigned last) const;
+                unsigned GetShallowestInBlock(unsigned first, unsigned last) const;
+                double GetPathLength(unsigned anc, unsigned desc) const;
+                unsigned Shallower(unsigned i, unsigned j) const
+                        {
+                        return (depths[j] < depths[i] ? j : i);
+                        }
+
+                std::vector<const NxsSimpleNode *> nodes; /* in preorder */
+                std::vector<unsigned> parents;
+                std::vector<unsigned> depths;
+                std::vector<unsigned> subtreeSizes;
+                std::vector<unsigned> leafCounts;
+                std::vector<unsigned> firstLeaf; /* position in leafOrder of the first leaf of each node's subtree */
+                std::vector<unsigned> leafOrder; /* the indices of the leaves in preorder */
+                std::vector<unsigned> taxonToNode;
+                bool hasEdgeLens;
+                bool missingEdgeLens;
+                bool intEdgeLens;
+                std::vector<unsigned> nodeBuckets; /* hash table from node pointers to indices (UINT_MAX for empty buckets) */
+                /* range-minimum structure over depths */
+                std::vector<uint64_t> blockMasks; /* bit k of the mask of node i is set if node (i & ~63) + k is no deeper than the nodes after it, up to i */
+                std::vector<unsigned> blockSparseTable; /* level l holds, for each block b, the shallowest node of blocks b to b + 2^l - 1 */
+                unsigned numBlocks;
+        };
+
+#endif
@@ -48,6 +48,8 @@
 #include <fstream>
 #include <algorithm>
 #include "ncl/nxsmultiformat.h"
+#include "ncl/nxsbinarytrees.h"
+#include "ncl/nxsdecompress.h"
 #include "ncl/nxsstring.h"
 
 const unsigned long MAX_BUFFER_SIZE = 0x80000;
@@ -86,9 +88,10 @@ const char * gFormatNames[] = {        "nexus",
                                                                 "nexml",
                                                                 "dnafin",
                                                                 "aafin",
-                                                                "rnafin"
+                                                                "rnafin",
+                                                                "nclbinarytrees"
                                                         };
-const unsigned gNumFormats = 29;
+const unsigned gNumFormats = 30;
 const unsigned PHYLIP_NMLNGTH = 10;
 
 std::vector<std::string> MultiFormatReader::getFormatNames()
@@ -107,6 +110,7 @@ class FileToCharBuffer
 {
                 char prevChar;
                 std::istream & inf;
+                bool readsUntilEOF; /* true if the size of the stream is not known (totalSize grows as it is read) */
                 unsigned long remaining;
                 unsigned long pos;
         public:
@@ -225,6 +229,7 @@ void MultiFormatReader::ReadStream(std::istream & inf, const char * formatName)
 FileToCharBuffer::FileToCharBuffer(std::istream & instream)
         :prevChar('\n'),
         inf(instream),
+        readsUntilEOF(false),
         pos(0),
         totalSize(0),
         lineNumber(1),
@@ -234,18 +239,38 @@ FileToCharBuffer::FileToCharBuffer(std::istream & instream)
         std::streampos s = inf.tellg();
         inf.seekg (0, std::ios::end);
         std::streampos e = inf.tellg();
-        if (e <= s)
+        if (s == std::streampos(-1) || e == std::streampos(-1))
                 {
-                inbuffer = 0;
+                /* the stream cannot seek (a pipe or decompressed input), so the size is not known */
+                inf.clear();
+                readsUntilEOF = true;
                 remaining = 0;
-                return;
+                buffer = new char [MAX_BUFFER_SIZE];
+                inf.read(buffer, MAX_BUFFER_SIZE);
+                inbuffer = static_cast<unsigned long>(inf.gcount());
+                totalSize = inbuffer;
+                if (inbuffer == 0)
+                        {
+                        delete [] buffer;
+                        buffer = 0L;
+                        return;
+                        }
+                }
+        else
+                {
+                if (e <= s)
+                        {
+                        inbuffer = 0;
+                        remaining = 0;
+                        return;
+                        }
+                inf.seekg(s);
+                totalSize = static_cast<unsigned long>(e - s);
+                inbuffer = std::min(MAX_BUFFER_SIZE, totalSize);
+                remaining = totalSize - inbuffer;
+                buffer = new char [inbuffer];
+                inf.read(buffer, inbuffer);
                 }
-        inf.seekg(s);
-        totalSize = static_cast<unsigned long>(e - s);
-        inbuffer = std::min(MAX_BUFFER_SIZE, totalSize);
-        remaining = totalSize - inbuffer;
-        buffer = new char [inbuffer];
-        inf.read(buffer, inbuffer);
         const char c = current();
 
         if (c == 13)
@@ -263,6 +288,21 @@ FileToCharBuffer::FileToCharBuffer(std::istream & instream)
 
 bool FileToCharBuffer::refillBuffer(unsigned long offset)
         {
+        if (readsUntilEOF)
+                {
+                if (!inf.good())
+                        return false;
+                if (offset == 0)
+                        prevChar = buffer[inbuffer-1];
+                inf.read(buffer + offset, MAX_BUFFER_SIZE - offset);
+                const unsigned long n = static_cast<unsigned long>(inf.gcount());
+                if (n == 0)
+                        return false;
+                inbuffer = n;
+                totalSize += n;
+                pos = offset;
+                return true;
+                }
         if (remaining  == 0)
                 return false;
         if (offset == 0)
@@ -499,7 +539,7 @@ void  MultiFormatReader::readPhylipData(
                 char f = ftcb.current();
                 while (f != '\r' && f != '\n')
                         {
-                        if (isgraph(f))
+                        if (isgraph(f) && ShouldReportWarning(NxsReader::PROBABLY_INCORRECT_CONTENT_WARNING))
                                 {
                                 err << "Sequence longer than " << n_char << " found for taxon " << n << ". The character \""<< f << "\" was found, and will be ignored. If the file position of this error corresponds to sequences for the next taxon in the matrix, then that is an indication that the sequences for taxon " << n << " are too short.";
                                 NexusWarn(err, NxsReader::PROBABLY_INCORRECT_CONTENT_WARNING, ftcb.position(), ftcb.line(), ftcb.column());
@@ -1293,17 +1333,16 @@ void  MultiFormatReader::ReadFilepath(const char * filepath, DataFormatType form
                 }
         else
                 {
-                std::ifstream inf;
+                NxsInputFile inf;
                 try{
-                        inf.open(filepath, std::ios::binary);
-                        if (!inf.good())
+                        if (!inf.Open(filepath))
                                 {
                                 NxsString err;
                                 err << "Could not open the file \"" << filepath <<"\"";
                                 this->NexusError(err, 0, -1, -1);
                                 }
                         else
-                                this->ReadStream(inf, format, filepath);
+                                this->ReadStream(inf.GetStream(), format, filepath);
                         }
                 catch (NxsException & x)
                         {
@@ -1381,6 +1420,8 @@ void  MultiFormatReader::ReadStream(std::istream & inf, DataFormatType format, c
                         readFinFile(inf, NxsCharactersBlock::rna);
                 else if (format == FIN_AA_FORMAT)
                         readFinFile(inf, NxsCharactersBlock::protein);
+                else if (format == NCL_BINARY_TREES_FORMAT)
+                        readBinaryTreesFile(inf);
                 else
                         {
                         NxsString m;
@@ -1481,6 +1522,34 @@ void MultiFormatReader::readPhylipTreeFile(std::istream & inf, bool relaxedNames
                 }
         }
 
+void MultiFormatReader::readBinaryTreesFile(std::istream & inf)
+        {
+        NxsString blockID("TREES");
+        NxsBlock *nb = cloneFactory.GetBlockReaderForID(blockID, this, NULL);
+        NCL_ASSERT(nb);
+        if (!nb)
+                return;
+        nb->SetNexus(this);
+
+        /* this should be safe because we know that the PublicNexusReader has a
+                NxsTreesBlock assigned to "TREES" -- unless the caller has replaced that
+                clone template (gulp)
+        */
+        NxsTreesBlock * treesB = static_cast<NxsTreesBlock *>(nb);
+        try {
+                NxsBinaryTreeCollection collection;
+                collection.ReadStream(inf);
+                treesB->Reset();
+                treesB->ReadBinaryTreeCollection(collection);
+                BlockReadHook(blockID, treesB);
+                }
+        catch (...)
+                {
+                cloneFactory.BlockError(nb);
+                throw;
+                }
+        }
+
 /* if this returns NULL, then the read failed and gLogMessage will contain
         and error message.
 */
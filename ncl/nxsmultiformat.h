@@ -74,6 +74,7 @@ class MultiFormatReader: public PublicNexusReader
                                 FIN_DNA_FORMAT,
                                 FIN_AA_FORMAT,
                                 FIN_RNA_FORMAT,
+                                NCL_BINARY_TREES_FORMAT,
                                 UNSUPPORTED_FORMAT // keep this last
                         };
 
@@ -90,7 +91,7 @@ class MultiFormatReader: public PublicNexusReader
                 
                 /*! \returns a vector with the "official" format names that can be used with formatNameToCode
 
-                Currently this list is:  {"nexus", "dnafasta", "aafasta", "rnafasta", "dnaphylip", "rnaphylip", "aaphylip", "discretephylip", "dnaphylipinterleaved", "rnaphylipinterleaved", "aaphylipinterleaved", "discretephylipinterleaved", "dnarelaxedphylip", "rnarelaxedphylip", "aarelaxedphylip", "discreterelaxedphylip", "dnarelaxedphylipinterleaved", "rnarelaxedphylipinterleaved", "aarelaxedphylipinterleaved", "discreterelaxedphylipinterleaved", "dnaaln", "rnaaln", "aaaln", "phyliptree", "relaxedphyliptree", "nexml"}
+                Currently this list is:  {"nexus", "dnafasta", "aafasta", "rnafasta", "dnaphylip", "rnaphylip", "aaphylip", "discretephylip", "dnaphylipinterleaved", "rnaphylipinterleaved", "aaphylipinterleaved", "discretephylipinterleaved", "dnarelaxedphylip", "rnarelaxedphylip", "aarelaxedphylip", "discreterelaxedphylip", "dnarelaxedphylipinterleaved", "rnarelaxedphylipinterleaved", "aarelaxedphylipinterleaved", "discreterelaxedphylipinterleaved", "dnaaln", "rnaaln", "aaaln", "phyliptree", "relaxedphyliptree", "nexml", "dnafin", "aafin", "rnafin", "nclbinarytrees"}
 
                 */
                 static std::vector<std::string> getFormatNames();
@@ -150,6 +151,7 @@ class MultiFormatReader: public PublicNexusReader
                 bool readFinSequences(FileToCharBuffer & ftcb, NxsDiscreteDatatypeMapper &dm, std::list<std::string> & taxaNames, std::list<NxsDiscreteStateRow> & matList, size_t & longest);
                 void readPhylipFile(std::istream & inf, NxsCharactersBlock::DataTypesEnum dt, bool relaxedNames, bool interleaved);
                 void readPhylipTreeFile(std::istream & inf, bool relaxedNames);
+                void readBinaryTreesFile(std::istream & inf);
                 void readAlnFile(std::istream & inf, NxsCharactersBlock::DataTypesEnum dt);
                 bool readAlnData(FileToCharBuffer & ftcb, const NxsDiscreteDatatypeMapper &dm, std::list<std::string> & taxaNames, std::list<NxsDiscreteStateRow> & matList);
 
@@ -252,6 +254,9 @@ so that the reader knows what type of data to expect.
 /*! var MultiFormatReader::NEXML_FORMAT
  NEXML formatted file currently unsupported, but support is planned
 */
+/*! var MultiFormatReader::NCL_BINARY_TREES_FORMAT
+ Trees in the binary tree collection format (see NxsBinaryTreeCollection)
+*/
 /*! var MultiFormatReader::UNSUPPORTED_FORMAT
 For NCL internal use only ( to mark the end of the DataFormatType enum).
 */
@@ -0,0 +1,264 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include "ncl/nxsnewickscanner.h"
+#include "ncl/nxsstring.h"
+
+/* bytes that the scanner leaves to NxsToken: NUL, and 0xFF (which NxsToken reads as the end of the file) */
+static inline bool IsUnsupportedByte(char c)
+        {
+        return (c == '\0' || (unsigned char) c == 0xFF);
+        }
+
+static inline bool IsNewickWhitespace(char c)
+        {
+        return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        }
+
+NxsNewickScanner::NxsNewickScanner(const char * buffer, std::size_t bufferLength, bool newickPunctuation)
+        :buf(buffer),
+        len(bufferLength),
+        pos(0),
+        labelBegin(0),
+        labelIsVerbatim(false),
+        posOffset(0),
+        posLine(1),
+        posColumn(1)
+        {
+        for (unsigned i = 0; i < 256; ++i)
+                {
+                const char c = (char) i;
+                punctuation[i] = (newickPunctuation ? NxsString::IsNewickPunctuation(c) : NxsString::IsNexusPunctuation(c));
+                }
+        }
+
+/*!
+        Reads the comment that starts at `pos` (which holds the '['), and records its range. \returns false if
+        NxsToken would read the comment differently: if it is not terminated, holds a carriage return (which NxsToken
+        converts to a newline) or starts with a nested comment (NxsToken does not count the first '[' when it looks for
+        the closing bracket).
+*/
+bool NxsNewickScanner::ReadComment()
+        {
+        const std::size_t bodyBegin = pos + 1;
+        if (bodyBegin < len && buf[bodyBegin] == '[')
+                return false;
+        int level = 1;
+        for (std::size_t i = bodyBegin; i < len; ++i)
+                {
+                const char c = buf[i];
+                if (c == ']')
+                        {
+                        if (--level == 0)
+                                {
+                                if (i > bodyBegin) /* NxsToken drops empty comments */
+                                        {
+                                        CommentRange cr;
+                                        cr.begin = bodyBegin;
+                                        cr.length = i - bodyBegin;
+                                        comments.push_back(cr);
+                                        }
+                                pos = i + 1;
+                                return true;
+                                }
+                        }
+                else if (c == '[')
+                        level++;
+                else if (c == '\r' || IsUnsupportedByte(c))
+                        return false;
+                }
+        return false;
+        }
+
+/*!
+        Reads the quoted label that starts at `pos` (which holds the opening quote) into `label`. \returns false for
+        labels that NxsToken would treat differently from other labels: empty labels and labels that consist of one of
+        the punctuation characters of newick descriptions (callers compare the token text to these characters).
+*/
+bool NxsNewickScanner::ReadQuotedLabel()
+        {
+        label.clear();
+        labelIsVerbatim = false;
+        std::size_t i = pos + 1;
+        for (;;)
+                {
+                if (i >= len)
+                        return false;
+                const char c = buf[i];
+                if (c == '\'')
+                        {
+                        if (i + 1 < len && buf[i + 1] == '\'')
+                                {
+                                label.append(1, '\'');
+                                i += 2;
+                                continue;
+                                }
+                        break;
+                        }
+                if (c == '\r' || IsUnsupportedByte(c))
+                        return false;
+                label.append(1, c);
+                i++;
+                }
+        /* NxsToken reads the character after the closing quote, and raises an error if there is none */
+        if (i + 1 >= len)
+                return false;
+        pos = i + 1;
+        if (label.empty())
+                return false;
+        if (label.length() == 1)
+                {
+                const char c = label[0];
+                if (c == '(' || c == ')' || c == ',' || c == ':' || c == ';')
+                        return false;
+                }
+        return true;
+        }
+
+NxsNewickScanner::TokenType NxsNewickScanner::NextToken(bool hyphenNotPunctuation)
+        {
+        comments.clear();
+        for (;;)
+                {
+                if (pos >= len)
+                        return UNSUPPORTED_TOKEN;
+                const char c = buf[pos];
+                if (IsNewickWhitespace(c))
+                        pos++;
+                else if (c == '[')
+                        {
+                        if (!ReadComment())
+                                return UNSUPPORTED_TOKEN;
+                        }
+                else
+                        break;
+                }
+        char c = buf[pos];
+        if (IsUnsupportedByte(c))
+                return UNSUPPORTED_TOKEN;
+        bool isPunct = punctuation[(unsigned char) c];
+        const bool hyphenIsLabelChar = hyphenNotPunctuation;
+#        if defined(NCL_VERSION_2_STYLE_HYPHEN) && NCL_VERSION_2_STYLE_HYPHEN
+                const bool plusIsLabelChar = false;
+#        else
+                const bool plusIsLabelChar = hyphenNotPunctuation;
+#        endif
+        if (isPunct && !((c == '-' && hyphenIsLabelChar) || (c == '+' && plusIsLabelChar)))
+                {
+                pos++;
+                switch (c)
+                        {
+                        case '(':
+                                return OPEN_PARENS_TOKEN;
+                        case ')':
+                                return CLOSE_PARENS_TOKEN;
+                        case ',':
+                                return COMMA_TOKEN;
+                        case ':':
+                                return COLON_TOKEN;
+                        case ';':
+                                return SEMICOLON_TOKEN;
+                        case '\'':
+                                pos--;
+                                return (ReadQuotedLabel() ? LABEL_TOKEN : UNSUPPORTED_TOKEN);
+                        default:
+                                return UNSUPPORTED_TOKEN;
+                        }
+                }
+        label.clear();
+        labelBegin = pos;
+        labelIsVerbatim = true;
+        for (;;)
+                {
+                if (pos >= len)
+                        return UNSUPPORTED_TOKEN;
+                c = buf[pos];
+                if (IsNewickWhitespace(c))
+                        {
+                        pos++;
+                        break;
+                        }
+                if (IsUnsupportedByte(c))
+                        return UNSUPPORTED_TOKEN;
+                if (c == '_')
+                        {
+                        label.append(1, ' ');
+                        labelIsVerbatim = false;
+                        pos++;
+                        }
+                else if (c == '[')
+                        {
+                        /* a comment inside an unquoted label does not end the label */
+                        if (!ReadComment())
+                                return UNSUPPORTED_TOKEN;
+                        labelIsVerbatim = false;
+                        }
+                else
+                        {
+                        isPunct = punctuation[(unsigned char) c];
+                        if (isPunct && !((c == '-' && hyphenIsLabelChar) || (c == '+' && plusIsLabelChar)))
+                                break;
+                        label.append(1, c);
+                        pos++;
+                        }
+                }
+        return LABEL_TOKEN;
+        }
+
+/*!
+        Moves the line and column counters to `offset`, counting lines and columns the way that NxsToken does (tabs
+        advance to the next multiple of 4 columns, and \r\n is one line break).
+*/
+void NxsNewickScanner::AdvancePositionTo(std::size_t offset)
+        {
+        for (; posOffset < offset; ++posOffset)
+                {
+                const char c = buf[posOffset];
+                if (c == '\n' || c == '\r')
+                        {
+                        if (c == '\r' && posOffset + 1 < len && buf[posOffset + 1] == '\n')
+                                ++posOffset;
+                        posLine++;
+                        posColumn = 1;
+                        }
+                else if (c == '\t')
+                        posColumn += 4 - ((posColumn - 1) % 4);
+                else
+                        posColumn++;
+                }
+        }
+
+void NxsNewickScanner::GetCommentPosition(const CommentRange & c, long * line, long * column)
+        {
+        /* NxsToken records the position after the closing bracket */
+        AdvancePositionTo(c.begin + c.length + 1);
+        *line = posLine;
+        *column = posColumn;
+        }
+
+void NxsNewickScanner::AppendNxsComments(std::vector<NxsComment> & ecs)
+        {
+        long line;
+        long column;
+        for (std::vector<CommentRange>::const_iterator cIt = comments.begin(); cIt != comments.end(); ++cIt)
+                {
+                GetCommentPosition(*cIt, &line, &column);
+                ecs.push_back(NxsComment(std::string(buf + cIt->begin, cIt->length), line, column));
+                }
+        }
@@ -0,0 +1,118 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSNEWICKSCANNER_H
+#define NCL_NXSNEWICKSCANNER_H
+
+#include <string>
+#include <vector>
+#include "ncl/nxstoken.h"
+
+/*! Splits a newick tree description that is held in memory into tokens.
+
+        NxsTreesBlock::ProcessTree and NxsSimpleTree::Initialize read trees with this class rather than NxsToken. The
+        tokens are the ones that NxsToken returns for the same text (underscores in unquoted labels become spaces,
+        doubled single quotes in quoted labels become one quote, comments nest and are attached to the token that they
+        are read with), but the scanner works on a contiguous buffer and does not copy the comments.
+
+        Only the tokens that occur in newick descriptions are recognized. For anything else (other punctuation,
+        NUL bytes, the end of the buffer, or constructs that NxsToken reads differently than a simple scanner would)
+        NextToken returns UNSUPPORTED_TOKEN, and the caller is expected to read the description with NxsToken instead.
+*/
+class NxsNewickScanner
+        {
+        public:
+                enum TokenType
+                        {
+                        OPEN_PARENS_TOKEN,
+                        CLOSE_PARENS_TOKEN,
+                        COMMA_TOKEN,
+                        COLON_TOKEN,
+                        SEMICOLON_TOKEN,
+                        LABEL_TOKEN,
+                        UNSUPPORTED_TOKEN
+                        };
+                /*! The position of a comment body (the text between the brackets) in the buffer */
+                class CommentRange
+                        {
+                        public:
+                                std::size_t begin;
+                                std::size_t length;
+                        };
+
+                /*! `newickPunctuation` selects the punctuation characters of NxsToken::UseNewickTokenization */
+                NxsNewickScanner(const char * buffer, std::size_t bufferLength, bool newickPunctuation);
+
+                /*! Reads the next token. `hyphenNotPunctuation` has the meaning of the NxsToken labile flag (it is
+                        set for the token after a colon, so that negative numbers and exponents are read as one token).
+                */
+                TokenType NextToken(bool hyphenNotPunctuation = false);
+
+                /*! \returns the text of the last LABEL_TOKEN */
+                const std::string & GetLabel() const
+                        {
+                        return label;
+                        }
+                /*! \returns true if the text of the last LABEL_TOKEN is found verbatim in the buffer (it was not quoted, and
+                        held no underscores or comments). If so, `*begin` is set to its position in the buffer.
+                */
+                bool GetVerbatimLabelPosition(std::size_t * begin) const
+                        {
+                        if (!labelIsVerbatim)
+                                return false;
+                        *begin = labelBegin;
+                        return true;
+                        }
+                /*! \returns the comments that were read with the last token */
+                const std::vector<CommentRange> & GetComments() const
+                        {
+                        return comments;
+                        }
+                const char * GetCommentText(const CommentRange & c) const
+                        {
+                        return buf + c.begin;
+                        }
+                /*! Appends the comments that were read with the last token to `ecs` as NxsComment objects (with the line
+                        and column numbers that NxsToken would have recorded).
+                */
+                void AppendNxsComments(std::vector<NxsComment> & ecs);
+                /*! Sets `*line` and `*column` to the position that NxsToken records for the comment `c` (the position
+                        after its closing bracket). Comments must be queried in the order in which they were read.
+                */
+                void GetCommentPosition(const CommentRange & c, long * line, long * column);
+        private:
+                bool ReadComment();
+                bool ReadQuotedLabel();
+                void AdvancePositionTo(std::size_t offset);
+
+                const char * buf;
+                std::size_t len;
+                std::size_t pos;
+                bool punctuation[256];
+                std::string label;
+                std::size_t labelBegin;
+                bool labelIsVerbatim;
+                std::vector<CommentRange> comments;
+                /* line and column at posOffset (computed only when comments are converted to NxsComment objects) */
+                std::size_t posOffset;
+                long posLine;
+                long posColumn;
+        };
+
+#endif
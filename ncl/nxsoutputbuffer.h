@@ -0,0 +1,118 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSOUTPUTBUFFER_H
+#define NCL_NXSOUTPUTBUFFER_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+/*! Appends the shortest of the %.15g, %.16g and %.17g forms of `d` that is read back as `d` (so that edge lengths
+        that are computed by NCL are written without losing precision). If `keepDecimalPoint` is true, ".0" is added to
+        numbers that would otherwise look like integers, so that they are still read as doubles.
+*/
+inline void NxsAppendShortestDouble(std::string & buffer, double d, bool keepDecimalPoint)
+        {
+        char digits[32];
+        for (int precision = 15; precision <= 17; ++precision)
+                {
+                std::sprintf(digits, "%.*g", precision, d);
+                if (precision == 17 || std::strtod(digits, NULL) == d)
+                        break;
+                }
+        buffer.append(digits);
+        if (keepDecimalPoint && std::strpbrk(digits, ".eEnN") == NULL)
+                buffer.append(".0");
+        }
+
+/*! Collects output in a string and writes it to a std::ostream in large chunks.
+
+        The NEXUS writers format many short pieces (single state symbols, labels, punctuation). Appending them to a
+        NxsOutputBuffer and writing the buffer with one ostream::write call per chunk avoids the per-call overhead of
+        the stream operators. The buffer is written when it grows past `chunkSize` (checked by FlushIfFull), when Flush
+        is called, and when the NxsOutputBuffer is destroyed.
+
+        Code that writes to the ostream directly must call Flush first, so that the output stays in order.
+*/
+class NxsOutputBuffer
+        {
+        public:
+                NxsOutputBuffer(std::ostream & outStream, std::string::size_type chunkSize = 65536)
+                        :out(outStream),
+                        flushSize(chunkSize)
+                        {
+                        buffer.reserve(chunkSize + 1024);
+                        }
+                ~NxsOutputBuffer()
+                        {
+                        Flush();
+                        }
+                void Append(char c)
+                        {
+                        buffer.push_back(c);
+                        }
+                void Append(const std::string & s)
+                        {
+                        buffer.append(s);
+                        }
+                void Append(const char * s)
+                        {
+                        buffer.append(s);
+                        }
+                void AppendRepeated(std::string::size_type n, char c)
+                        {
+                        buffer.append(n, c);
+                        }
+                void AppendUnsigned(unsigned long n)
+                        {
+                        char digits[24];
+                        std::sprintf(digits, "%lu", n);
+                        buffer.append(digits);
+                        }
+                /*! gives direct access to the string, for functions that append to a std::string */
+                std::string & GetBuffer()
+                        {
+                        return buffer;
+                        }
+                void FlushIfFull()
+                        {
+                        if (buffer.size() >= flushSize)
+                                Flush();
+                        }
+                void Flush()
+                        {
+                        if (!buffer.empty())
+                                {
+                                out.write(buffer.data(), (std::streamsize) buffer.size());
+                                buffer.clear();
+                                }
+                        }
+        private:
+                NxsOutputBuffer(const NxsOutputBuffer &); /** don't define, not copyable*/
+                NxsOutputBuffer & operator=(const NxsOutputBuffer &); /** don't define, not copyable*/
+
+                std::ostream & out;
+                std::string::size_type flushSize;
+                std::string buffer;
+        };
+
+#endif
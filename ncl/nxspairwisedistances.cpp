@@ -0,0 +1,312 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include "ncl/nxspairwisedistances.h"
+#include "ncl/nxsparallel.h"
+
+using namespace std;
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#        include <intrin.h>
+#endif
+
+namespace
+{
+/* the number of taxa along each side of the square tiles that the lower triangle is split into */
+const unsigned kTaxaPerTile = 32;
+
+inline unsigned countBits(uint64_t w)
+        {
+/* __builtin_popcountll is a library call unless the popcnt instruction is enabled (e.g. by -mpopcnt or -march=native) */
+#        if defined(__GNUC__) && (defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__)))
+                return (unsigned) __builtin_popcountll(w);
+#        elif defined(_MSC_VER) && defined(_M_X64)
+                return (unsigned) __popcnt64(w);
+#        else
+                w = w - ((w >> 1) & 0x5555555555555555ULL);
+                w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+                w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+                return (unsigned) ((w * 0x0101010101010101ULL) >> 56);
+#        endif
+        }
+} // anonymous namespace
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        The bit-plane form of a matrix used by NxsComputePairwiseDistances.
+|        Each taxon has `nWords` groups of `nPlanes` words. Word w of plane s has bit b set if the taxon has state s at
+|        the (64*w + b)-th compared site. The plane after the state planes flags the sites at which the taxon has exactly
+|        one state, and (for K2P) the last plane flags the purines.
+*/
+class NxsBitPlaneMatrix
+        {
+        public:
+                NxsBitPlaneMatrix(const NxsCXXDiscreteMatrix & mat, bool withPurinePlane)
+                        :nTax(mat.getNTax()),
+                        nStates(mat.getNStates()),
+                        nPlanes(mat.getNStates() + (withPurinePlane ? 2 : 1)),
+                        nSitesCompared(0),
+                        nWords(0)
+                        {
+                        const unsigned nChar = mat.getNChar();
+                        const std::set<unsigned> & excluded = mat.getExcludedCharIndices();
+                        std::vector<unsigned> included;
+                        for (unsigned j = 0; j < nChar; ++j)
+                                {
+                                if (excluded.find(j) == excluded.end())
+                                        included.push_back(j);
+                                }
+                        nSitesCompared = (unsigned) included.size();
+                        nWords = (nSitesCompared + 63)/64;
+                        const unsigned validPlane = nStates;
+                        std::vector<unsigned char> isPurine(nStates, 0);
+                        if (withPurinePlane)
+                                {
+                                const char * symbols = mat.getSymbolsList();
+                                for (unsigned s = 0; s < nStates; ++s)
+                                        {
+                                        const char c = (char) toupper(symbols[s]);
+                                        isPurine[s] = (c == 'A' || c == 'G' ? 1 : 0);
+                                        }
+                                }
+                        planes.assign(((std::size_t) nTax) * nWords * nPlanes, 0);
+                        const NxsCDiscreteStateSet * const * m = mat.getMatrix();
+                        for (unsigned i = 0; i < nTax; ++i)
+                                {
+                                const NxsCDiscreteStateSet * row = m[i];
+                                uint64_t * taxonWords = GetTaxonWords(i);
+                                for (unsigned k = 0; k < nSitesCompared; ++k)
+                                        {
+                                        const NxsCDiscreteStateSet code = row[included[k]];
+                                        if (code < 0 || (unsigned) code >= nStates)
+                                                continue;
+                                        const uint64_t bit = ((uint64_t) 1) << (k % 64);
+                                        uint64_t * w = taxonWords + (k/64)*nPlanes;
+                                        w[code] |= bit;
+                                        w[validPlane] |= bit;
+                                        if (withPurinePlane && isPurine[code])
+                                                w[validPlane + 1] |= bit;
+                                        }
+                                }
+                        }
+                uint64_t * GetTaxonWords(unsigned i)
+                        {
+                        return &planes[((std::size_t) i) * nWords * nPlanes];
+                        }
+                const uint64_t * GetTaxonWords(unsigned i) const
+                        {
+                        return &planes[((std::size_t) i) * nWords * nPlanes];
+                        }
+
+                unsigned nTax;
+                unsigned nStates;
+                unsigned nPlanes;
+                unsigned nSitesCompared;
+                unsigned nWords;
+        private:
+                std::vector<uint64_t> planes;
+        };
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Functor used by NxsComputePairwiseDistances. Workers claim tiles of the lower triangle of the distance matrix and
+|        write the distances directly into the packed storage of the NxsDistancesBlock (different tiles never share a
+|        cell). The missing-data bitmap is shared between neighboring cells, so the cells that turn out to be missing are
+|        recorded per worker and flagged after all of the workers have finished.
+*/
+class NxsPairwiseDistanceWorker
+        {
+        public:
+                NxsPairwiseDistanceWorker(const NxsBitPlaneMatrix & bitMatrix, NxsPairwiseDistanceModel distModel, NxsDistancesBlock & out, unsigned numWorkers)
+                        :m(bitMatrix),
+                        model(distModel),
+                        distances(out),
+                        nTiles((bitMatrix.nTax + kTaxaPerTile - 1)/kTaxaPerTile),
+                        nextTile(0),
+                        missingPerWorker(numWorkers)
+                        {
+                        const double k = (double) bitMatrix.nStates;
+                        jcFactor = (k > 1.0 ? (k - 1.0)/k : 1.0);
+                        }
+                void operator()(unsigned workerIndex, unsigned)
+                        {
+                        std::vector<std::size_t> & missing = missingPerWorker[workerIndex];
+                        const std::size_t nTilePairs = (((std::size_t) nTiles) * (nTiles + 1))/2;
+                        for (;;)
+                                {
+                                std::size_t tile;
+                                        {
+                                        NxsMutexLocker locker(mutex);
+                                        if (nextTile >= nTilePairs)
+                                                return;
+                                        tile = nextTile++;
+                                        }
+                                /* tiles are numbered row by row through the lower triangle of tiles */
+                                unsigned tileRow = 0;
+                                while ((((std::size_t) tileRow + 1) * (tileRow + 2))/2 <= tile)
+                                        ++tileRow;
+                                const unsigned tileCol = (unsigned) (tile - (((std::size_t) tileRow) * (tileRow + 1))/2);
+                                ComputeTile(tileRow, tileCol, missing);
+                                }
+                        }
+                /* Gives `out` an ntax x ntax lower-triangular matrix with no missing cells (and 0.0 everywhere). */
+                static void PrepareOutput(NxsDistancesBlock & out, unsigned nTax, unsigned nSitesCompared)
+                        {
+                        out.triangle = NxsDistancesBlock::NxsDistancesBlockEnum(NxsDistancesBlock::lower);
+                        out.diagonal = true;
+                        out.labels = true;
+                        out.interleave = false;
+                        out.expectedNtax = nTax;
+                        out.nchar = nSitesCompared;
+                        out.AllocateMatrix(nTax);
+                        out.missingCells.assign(out.missingCells.size(), false);
+                        out.isEmpty = false;
+                        }
+                /* Called after all of the workers are done. */
+                void FlagMissingCells()
+                        {
+                        for (std::vector<std::vector<std::size_t> >::const_iterator wIt = missingPerWorker.begin(); wIt != missingPerWorker.end(); ++wIt)
+                                {
+                                for (std::vector<std::size_t>::const_iterator cIt = wIt->begin(); cIt != wIt->end(); ++cIt)
+                                        {
+                                        distances.distances[*cIt] = 0.0;
+                                        distances.missingCells[*cIt] = true;
+                                        }
+                                }
+                        }
+        private:
+                void ComputeTile(unsigned tileRow, unsigned tileCol, std::vector<std::size_t> & missing)
+                        {
+                        const unsigned iBegin = tileRow*kTaxaPerTile;
+                        const unsigned iEnd = std::min(iBegin + kTaxaPerTile, m.nTax);
+                        const unsigned jBegin = tileCol*kTaxaPerTile;
+                        for (unsigned i = iBegin; i < iEnd; ++i)
+                                {
+                                const unsigned jEnd = std::min(jBegin + kTaxaPerTile, i);
+                                const std::size_t rowStart = (((std::size_t) i) * (i + 1))/2;
+                                double * row = &distances.distances[rowStart];
+                                for (unsigned j = jBegin; j < jEnd; ++j)
+                                        {
+                                        if (!ComputeDistance(i, j, row + j))
+                                                missing.push_back(rowStart + j);
+                                        }
+                                }
+                        }
+                /* returns false if the distance between taxa i and j is missing */
+                bool ComputeDistance(unsigned i, unsigned j, double * d) const
+                        {
+                        const unsigned nPlanes = m.nPlanes;
+                        const unsigned nStates = m.nStates;
+                        const unsigned nWords = m.nWords;
+                        const uint64_t * wi = m.GetTaxonWords(i);
+                        const uint64_t * wj = m.GetTaxonWords(j);
+                        unsigned nCompared = 0;
+                        unsigned nDiff = 0;
+                        unsigned nTransversions = 0;
+                        for (unsigned w = 0; w < nWords; ++w, wi += nPlanes, wj += nPlanes)
+                                {
+                                const uint64_t both = wi[nStates] & wj[nStates];
+                                uint64_t same = 0;
+                                for (unsigned s = 0; s < nStates; ++s)
+                                        same |= wi[s] & wj[s];
+                                nCompared += countBits(both);
+                                nDiff += countBits(both & ~same);
+                                if (model == NXS_K2P_DISTANCE)
+                                        nTransversions += countBits(both & (wi[nStates + 1] ^ wj[nStates + 1]));
+                                }
+                        if (nCompared == 0)
+                                return false;
+                        const double p = ((double) nDiff)/nCompared;
+                        if (model == NXS_P_DISTANCE)
+                                *d = p;
+                        else if (model == NXS_JC_DISTANCE)
+                                {
+                                const double x = 1.0 - p/jcFactor;
+                                if (x <= 0.0)
+                                        return false;
+                                *d = (p == 0.0 ? 0.0 : -jcFactor*log(x));
+                                }
+                        else
+                                {
+                                const double Q = ((double) nTransversions)/nCompared;
+                                const double P = p - Q;
+                                const double x = 1.0 - 2.0*P - Q;
+                                const double y = 1.0 - 2.0*Q;
+                                if (x <= 0.0 || y <= 0.0)
+                                        return false;
+                                *d = (p == 0.0 ? 0.0 : -0.5*log(x) - 0.25*log(y));
+                                }
+                        return true;
+                        }
+
+                const NxsBitPlaneMatrix & m;
+                NxsPairwiseDistanceModel model;
+                NxsDistancesBlock & distances;
+                double jcFactor; /* (k-1)/k for k states */
+                unsigned nTiles;
+                NxsMutex mutex;
+                std::size_t nextTile;
+                std::vector<std::vector<std::size_t> > missingPerWorker;
+        };
+
+void NxsComputePairwiseDistances(
+  const NxsCXXDiscreteMatrix & mat,
+  NxsPairwiseDistanceModel model,
+  NxsDistancesBlock & distances,
+  unsigned numThreads)
+        {
+        if (model == NXS_K2P_DISTANCE)
+                {
+                const int dt = mat.getDatatype();
+                if ((dt != NxsAltDNA_Datatype && dt != NxsAltRNA_Datatype && dt != NxsAltNuc_Datatype) || mat.getNStates() != 4)
+                        throw NxsNCLAPIException("The K2P distance can only be calculated from DNA, RNA or nucleotide data");
+                }
+        const NxsBitPlaneMatrix bitMatrix(mat, model == NXS_K2P_DISTANCE);
+        const unsigned nTax = bitMatrix.nTax;
+
+        NxsPairwiseDistanceWorker::PrepareOutput(distances, nTax, bitMatrix.nSitesCompared);
+        if (nTax == 0)
+                return;
+
+        const unsigned nTiles = (nTax + kTaxaPerTile - 1)/kTaxaPerTile;
+        const unsigned nWorkers = NxsChooseNumThreads(numThreads, (nTiles*(nTiles + 1))/2);
+        NxsPairwiseDistanceWorker worker(bitMatrix, model, distances, nWorkers);
+        NxsRunWorkers(worker, nWorkers);
+        worker.FlagMissingCells();
+        }
+
+NxsDistancesBlock * NxsComputePairwiseDistances(
+  const NxsCharactersBlock & charsBlock,
+  NxsPairwiseDistanceModel model,
+  unsigned numThreads)
+        {
+        NxsCXXDiscreteMatrix mat(charsBlock, true);
+        NxsDistancesBlock * distances = new NxsDistancesBlock(charsBlock.GetTaxaBlockPtr(0L));
+        try
+                {
+                NxsComputePairwiseDistances(mat, model, *distances, numThreads);
+                }
+        catch (...)
+                {
+                delete distances;
+                throw;
+                }
+        return distances;
+        }
@@ -0,0 +1,68 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSPAIRWISEDISTANCES_H
+#define NCL_NXSPAIRWISEDISTANCES_H
+
+#include "ncl/nxsdefs.h"
+#include "ncl/nxscxxdiscretematrix.h"
+#include "ncl/nxsdistancesblock.h"
+
+/*! The distances that NxsComputePairwiseDistances can calculate. */
+enum NxsPairwiseDistanceModel
+        {
+        NXS_P_DISTANCE = 0,        /* the proportion of compared sites that differ */
+        NXS_JC_DISTANCE = 1,        /* Jukes-Cantor (JC69) correction of the p-distance. For data with k states, the k-state version is used */
+        NXS_K2P_DISTANCE = 2        /* Kimura's two-parameter distance (nucleotide data only) */
+        };
+
+/*! Fills `distances` with the pairwise distances between the rows of `mat`.
+
+        For each pair of taxa only the sites at which both taxa have a single (unambiguous) state are compared. Gaps,
+        missing data, ambiguity codes and polymorphisms are skipped for that pair (pairwise deletion). Characters that
+        are excluded in `mat` are skipped for every pair. Character weights are not used.
+
+        A distance is stored as missing if the two taxa have no sites in common, or if the corrected distance is
+        undefined (the p-distance is too large for the JC or K2P correction).
+
+        The rows are stored as bit-planes (one bit per site for each state), so a pair of taxa is compared 64 sites at a
+        time with bitwise operations and population counts. The lower triangle of the distance matrix is split into
+        tiles that are divided among `numThreads` threads (0 means one thread per hardware thread).
+
+        `distances` is given a packed lower-triangular matrix with one row for each row of `mat`. Its taxa block is not
+        changed, so it should already refer to the taxa block of the characters block that `mat` was built from.
+
+        Throws NxsNCLAPIException if NXS_K2P_DISTANCE is requested for data that are not DNA, RNA or nucleotide data.
+*/
+void NxsComputePairwiseDistances(
+  const NxsCXXDiscreteMatrix & mat,
+  NxsPairwiseDistanceModel model,
+  NxsDistancesBlock & distances,
+  unsigned numThreads = 1);
+
+/*! Computes the pairwise distances between the taxa in `charsBlock` (see the other version of this function).
+
+        \returns a new NxsDistancesBlock (which the caller must delete) that refers to the taxa block of `charsBlock`.
+*/
+NxsDistancesBlock * NxsComputePairwiseDistances(
+  const NxsCharactersBlock & charsBlock,
+  NxsPairwiseDistanceModel model,
+  unsigned numThreads = 1);
+
+#endif
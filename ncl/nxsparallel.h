@@ -0,0 +1,326 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#if !defined(NXS_PARALLEL_H)
+#define NXS_PARALLEL_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ncl/nxsdefs.h"
+#if defined(NCL_HAS_STD_THREAD)
+#        include <condition_variable>
+#        include <exception>
+#        include <mutex>
+#        include <thread>
+#endif
+
+/*! \returns the number of worker threads that should be used when a client passes
+        0 as the `numThreads` argument to one of NCL's multi-threaded functions.
+        This is the number of hardware threads (or 1 if NCL was built without thread support).
+*/
+inline unsigned NxsGetDefaultNumThreads()
+        {
+#        if defined(NCL_HAS_STD_THREAD)
+                const unsigned n = std::thread::hardware_concurrency();
+                return (n == 0 ? 1 : n);
+#        else
+                return 1;
+#        endif
+        }
+
+/*! \returns `requested` clamped to the range [1, `maxUseful`]. If `requested` is 0 then
+        NxsGetDefaultNumThreads() is used.
+*/
+inline unsigned NxsChooseNumThreads(unsigned requested, unsigned maxUseful)
+        {
+        unsigned n = (requested == 0 ? NxsGetDefaultNumThreads() : requested);
+        if (n > maxUseful)
+                n = maxUseful;
+        return (n == 0 ? 1 : n);
+        }
+
+class NxsCondition;
+
+/*! A mutex that is a no-op if NCL was built without thread support. */
+class NxsMutex
+        {
+        friend class NxsCondition;
+        public:
+                NxsMutex()
+                        {}
+                void Lock()
+                        {
+#                        if defined(NCL_HAS_STD_THREAD)
+                                m.lock();
+#                        endif
+                        }
+                void Unlock()
+                        {
+#                        if defined(NCL_HAS_STD_THREAD)
+                                m.unlock();
+#                        endif
+                        }
+        private:
+                NxsMutex(const NxsMutex &); /** don't define, not copyable*/
+                NxsMutex & operator=(const NxsMutex &); /** don't define, not copyable*/
+#                if defined(NCL_HAS_STD_THREAD)
+                        std::mutex m;
+#                endif
+        };
+
+/*! Locks a NxsMutex for the lifetime of the NxsMutexLocker object. */
+class NxsMutexLocker
+        {
+        public:
+                NxsMutexLocker(NxsMutex & mutex)
+                        :m(mutex)
+                        {
+                        m.Lock();
+                        }
+                ~NxsMutexLocker()
+                        {
+                        m.Unlock();
+                        }
+        private:
+                NxsMutexLocker(const NxsMutexLocker &); /** don't define, not copyable*/
+                NxsMutexLocker & operator=(const NxsMutexLocker &); /** don't define, not copyable*/
+                NxsMutex & m;
+        };
+
+/*! A condition variable that is used with a NxsMutex. It is a no-op if NCL was built without thread support (so
+        code that waits must not wait in that case, because no other thread can wake it).
+*/
+class NxsCondition
+        {
+        public:
+                NxsCondition()
+                        {}
+                /*! Waits until NotifyAll is called. `mutex` must be locked by the calling thread; it is unlocked
+                        while waiting, and locked again before Wait returns.
+                */
+                void Wait(NxsMutex & mutex)
+                        {
+#                        if defined(NCL_HAS_STD_THREAD)
+                                std::unique_lock<std::mutex> lock(mutex.m, std::adopt_lock);
+                                c.wait(lock);
+                                lock.release();
+#                        endif
+                        }
+                void NotifyAll()
+                        {
+#                        if defined(NCL_HAS_STD_THREAD)
+                                c.notify_all();
+#                        endif
+                        }
+        private:
+                NxsCondition(const NxsCondition &); /** don't define, not copyable*/
+                NxsCondition & operator=(const NxsCondition &); /** don't define, not copyable*/
+#                if defined(NCL_HAS_STD_THREAD)
+                        std::condition_variable c;
+#                endif
+        };
+
+#if defined(NCL_HAS_STD_THREAD)
+template<typename WORKER>
+void NxsCallWorkerCatchingExceptions(WORKER * worker, unsigned workerIndex, unsigned numWorkers, std::exception_ptr * caught)
+        {
+        try
+                {
+                (*worker)(workerIndex, numWorkers);
+                }
+        catch (...)
+                {
+                *caught = std::current_exception();
+                }
+        }
+#endif
+
+/*! Calls `worker(i, numWorkers)` for every i in [0, numWorkers).
+
+        Each call is made on its own thread (call 0 is made on the calling thread), and this
+        function returns after all of them have finished. The worker is responsible for
+        choosing the share of the work that corresponds to its index, and for making sure
+        that different workers do not write to the same memory.
+
+        If any call raises an exception, then (after all of the threads have been joined)
+        the exception from the lowest-numbered worker is rethrown.
+
+        If NCL was built without thread support then the calls are made serially.
+*/
+template<typename WORKER>
+void NxsRunWorkers(WORKER & worker, unsigned numWorkers)
+        {
+        if (numWorkers < 2)
+                {
+                worker(0, 1);
+                return;
+                }
+#        if defined(NCL_HAS_STD_THREAD)
+                std::vector<std::exception_ptr> caught(numWorkers);
+                std::vector<std::thread> threads;
+                threads.reserve(numWorkers - 1);
+                for (unsigned i = 1; i < numWorkers; ++i)
+                        threads.push_back(std::thread(NxsCallWorkerCatchingExceptions<WORKER>, &worker, i, numWorkers, &caught[i]));
+                NxsCallWorkerCatchingExceptions<WORKER>(&worker, 0, numWorkers, &caught[0]);
+                for (std::vector<std::thread>::iterator tIt = threads.begin(); tIt != threads.end(); ++tIt)
+                        tIt->join();
+                for (std::vector<std::exception_ptr>::const_iterator cIt = caught.begin(); cIt != caught.end(); ++cIt)
+                        {
+                        if (*cIt)
+                                std::rethrow_exception(*cIt);
+                        }
+#        else
+                for (unsigned i = 0; i < numWorkers; ++i)
+                        worker(i, numWorkers);
+#        endif
+        }
+
+/*! Used by NxsWriteChunksInOrder. The workers are started once for the whole output. Each worker repeatedly claims
+        the next chunk and formats it (without holding the lock) into the buffer of the chunk. At most `numBuffers` chunks
+        are formatted but not yet written, so a worker waits for a buffer when all of them are in use.
+
+        Chunks are written by one worker at a time (the worker that set `writing`), in order. It writes every chunk that
+        is ready, including the chunks that other workers finish while it writes.
+*/
+template<typename FORMATTER>
+class NxsChunkFormattingWorker
+        {
+        public:
+                NxsChunkFormattingWorker(std::ostream & o, FORMATTER & f, unsigned nChunks, unsigned numBuffers)
+                        :out(o),
+                        formatter(f),
+                        numChunks(nChunks),
+                        chunkBuffers(numBuffers),
+                        formatted(numBuffers, 0),
+                        nextToFormat(0),
+                        nextToWrite(0),
+                        writing(false),
+                        failed(false)
+                        {}
+                void operator()(unsigned, unsigned)
+                        {
+                        try
+                                {
+                                FormatChunks();
+                                }
+                        catch (...)
+                                {
+                                NxsMutexLocker locker(mutex);
+                                failed = true;
+                                bufferReleased.NotifyAll();
+                                throw;
+                                }
+                        }
+        private:
+                void FormatChunks()
+                        {
+                        const unsigned numBuffers = (unsigned) chunkBuffers.size();
+                        NxsMutexLocker locker(mutex);
+                        for (;;)
+                                {
+                                while (!failed && nextToFormat < numChunks && nextToFormat - nextToWrite >= numBuffers)
+                                        bufferReleased.Wait(mutex);
+                                if (failed || nextToFormat >= numChunks)
+                                        return;
+                                const unsigned chunkIndex = nextToFormat++;
+                                const unsigned slot = chunkIndex % numBuffers;
+                                std::string & b = chunkBuffers[slot];
+                                mutex.Unlock();
+                                try
+                                        {
+                                        b.clear();
+                                        formatter(chunkIndex, b);
+                                        }
+                                catch (...)
+                                        {
+                                        mutex.Lock();
+                                        throw;
+                                        }
+                                mutex.Lock();
+                                formatted[slot] = 1;
+                                if (writing)
+                                        continue; /* the worker that is writing will write this chunk */
+                                writing = true;
+                                while (!failed && nextToWrite < numChunks && formatted[nextToWrite % numBuffers])
+                                        {
+                                        const unsigned writeSlot = nextToWrite % numBuffers;
+                                        const std::string & w = chunkBuffers[writeSlot];
+                                        mutex.Unlock();
+                                        try
+                                                {
+                                                out.write(w.data(), (std::streamsize) w.size());
+                                                }
+                                        catch (...)
+                                                {
+                                                mutex.Lock();
+                                                throw;
+                                                }
+                                        mutex.Lock();
+                                        formatted[writeSlot] = 0;
+                                        ++nextToWrite;
+                                        bufferReleased.NotifyAll();
+                                        }
+                                writing = false;
+                                }
+                        }
+
+                std::ostream & out;
+                FORMATTER & formatter;
+                const unsigned numChunks;
+                std::vector<std::string> chunkBuffers; /* chunk i is formatted into chunkBuffers[i % chunkBuffers.size()] */
+                std::vector<char> formatted; /* 1 for the buffers that hold a chunk that has not been written */
+                NxsMutex mutex;
+                NxsCondition bufferReleased;
+                unsigned nextToFormat;
+                unsigned nextToWrite;
+                bool writing;
+                bool failed;
+        };
+
+/*! Writes the output for chunks [0, numChunks) to `out`, in order.
+
+        `formatter(chunkIndex, buffer)` must append the text for chunk number `chunkIndex` to the std::string `buffer`.
+        The chunks are formatted by `numThreads` threads (0 means one thread per hardware thread), so the formatter must
+        be safe to call concurrently for different chunks. The threads are started once, and take chunks in order. To
+        limit the memory used, at most `chunksPerThread` chunks per thread are held in memory; a chunk is written as soon
+        as the chunks before it have been written.
+
+        With one thread, each chunk is formatted and written in turn on the calling thread.
+*/
+template<typename FORMATTER>
+void NxsWriteChunksInOrder(std::ostream & out, FORMATTER & formatter, unsigned numChunks, unsigned numThreads, unsigned chunksPerThread = 4)
+        {
+        const unsigned nThreads = NxsChooseNumThreads(numThreads, numChunks);
+        if (nThreads == 1)
+                {
+                std::string b;
+                for (unsigned c = 0; c < numChunks; ++c)
+                        {
+                        b.clear();
+                        formatter(c, b);
+                        out.write(b.data(), (std::streamsize) b.size());
+                        }
+                return;
+                }
+        NxsChunkFormattingWorker<FORMATTER> worker(out, formatter, numChunks, nThreads * (chunksPerThread == 0 ? 1 : chunksPerThread));
+        NxsRunWorkers(worker, nThreads);
+        }
+
+#endif // NXS_PARALLEL_H
@@ -24,10 +24,12 @@
 #include <sstream>
 #include <iterator>
 #include "ncl/nxsreader.h"
+#include "ncl/nxsdecompress.h"
 #include "ncl/nxsdefs.h"
 #include "ncl/nxscharactersblock.h"
 #include "ncl/nxstaxablock.h"
 #include "ncl/nxstreesblock.h"
+#include "ncl/nxsparallel.h"
 
 using namespace std;
 
@@ -44,7 +46,7 @@ static void NxsHandleSignalCallback(int);
 
 NxsReader::SignalHandlerFuncPtr NxsReader::prevSignalCatcher = 0L;
 bool NxsReader::nclCatchesSignals = false;
-unsigned NxsReader::numSigIntsCaught = 0;
+volatile unsigned NxsReader::numSigIntsCaught = 0;
 bool NxsReader::prevSignalStored = true;
 
 unsigned NxsReader::getNumSignalIntsCaught()
@@ -74,8 +76,17 @@ void NxsHandleSignalCallback(int)
         NxsReader::setNumSignalsIntsCaught(1 + nc);
         }
 
+/* Several readers (on different threads) may be in Execute at the same time, so the handler is
+        installed by the first of them and uninstalled by the last.
+*/
+static NxsMutex gSignalHandlerMutex;
+static unsigned gNumSignalHandlerUsers = 0;
+
 void NxsReader::installNCLSignalHandler()
         {
+        NxsMutexLocker locker(gSignalHandlerMutex);
+        if (gNumSignalHandlerUsers++ > 0)
+                return;
         NxsReader::SignalHandlerFuncPtr prev = std::signal(SIGINT, SIG_IGN);
         if (prev != SIG_IGN)
                 {
@@ -87,6 +98,9 @@ void NxsReader::installNCLSignalHandler()
 
 void NxsReader::uninstallNCLSignalHandler()
         {
+        NxsMutexLocker locker(gSignalHandlerMutex);
+        if (gNumSignalHandlerUsers == 0 || --gNumSignalHandlerUsers > 0)
+                return;
         if (prevSignalStored)
                 {
                 std::signal(SIGINT, NxsReader::prevSignalCatcher);
@@ -97,26 +111,32 @@ void NxsReader::uninstallNCLSignalHandler()
 
 
 
-/*! Reads a filename with NxsToken object. Calls NexusError on failures */
+/*! Reads a filename with NxsToken object. Calls NexusError on failures.
+        Files that are compressed with gzip or zstd are decompressed while they are read (see NxsInputFile).
+*/
 void NxsReader::ReadFilepath(const char *filename)
         {
-        std::ifstream inf;
+        NxsInputFile inf;
         try{
-                inf.open(filename, ios::binary);
-                if (!inf.good())
+                if (!inf.Open(filename))
                         {
                         NxsString err;
                         err << "Could not open the file \"" << filename <<"\"";
                         this->NexusError(err, 0, -1, -1);
                         }
                 }
+        catch (NxsException & x)
+                {
+                this->NexusError(x.msg, x.pos, x.line, x.col);
+                return;
+                }
         catch (...)
                 {
                 NxsString err;
                 err << '\"' << filename <<"\" does not refer to a valid file." ;
                 this->NexusError(err, 0, -1, -1);
                 }
-        this->ReadFilestream(inf);
+        this->ReadFilestream(inf.GetStream());
         }
 
 
@@ -328,7 +348,12 @@ NxsTreesBlockAPI *NxsReader::GetTreesBlockByTitle(const char *title, unsigned *n
 
 /*! Initializes both `blockList' and `currBlock' to NULL.
 */
-NxsReader::NxsReader() : currentWarningLevel(UNCOMMON_SYNTAX_WARNING), alwaysReportStatusMessages(false)
+NxsReader::NxsReader()
+        :currentWarningLevel(UNCOMMON_SYNTAX_WARNING),
+        alwaysReportStatusMessages(false),
+        cancellationToken(NULL),
+        messageStream(NULL),
+        diagnosticSink(NULL)
         {
         blockList        = NULL;
         currBlock        = NULL;
@@ -632,6 +657,8 @@ void NxsReader::Execute(
                 if (numSigInts != getNumSignalIntsCaught())
                         throw NxsSignalCanceledParseException("Reading NEXUS content");
                 }
+        if (cancellationToken != NULL && cancellationToken->IsCanceled())
+                throw NxsSignalCanceledParseException("Reading NEXUS content");
         }
 
 /*! used internally to  do most of the work of Execute() */
@@ -639,8 +666,7 @@ void NxsReader::CoreExecutionTasks(
   NxsToken        &token,                                /* the token object used to grab NxsReader tokens */
   bool                notifyStartStop)        /* if true, ExecuteStarting and ExecuteStopping will be called */
         {
-        unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
-        const bool checkingSignals = NxsReader::getNCLCatchesSignals();
+        const unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
 
         lastExecuteBlocksInOrder.clear();
         currBlock = NULL;
@@ -664,7 +690,7 @@ void NxsReader::CoreExecutionTasks(
                 token.SetLabileFlagBit(NxsToken::saveCommandComments);
                 token.GetNextToken();
                 }
-        else
+        else if (ShouldReportWarning(NxsReader::AMBIGUOUS_CONTENT_WARNING))
                 {
                 errormsg = "Expecting #NEXUS to be the first token in the file, but found ";
                 errormsg += token.GetToken();
@@ -680,7 +706,7 @@ void NxsReader::CoreExecutionTasks(
         bool keepReading = true;
         for (;keepReading && !token.AtEOF();)
                 {
-                if (checkingSignals && NxsReader::getNumSignalIntsCaught() != numSigInts)
+                if (IsParseCanceled(numSigInts))
                         {
                         throw NxsSignalCanceledParseException("Reading NEXUS content");
                         }
@@ -1027,11 +1053,12 @@ void NxsReader::ExecuteStopping()
         the precise location of the error.
 */
 void NxsReader::NexusError(
-  NxsString ,        /* the error message to be displayed */
-  file_pos        ,        /* the current file position */
-  long        ,        /* the current file line */
-  long        )        /* the current column within the current file line */
+  NxsString msg,        /* the error message to be displayed */
+  file_pos        pos,        /* the current file position */
+  long        line,        /* the current file line */
+  long        col)        /* the current column within the current file line */
         {
+        SendToDiagnosticSink(NxsReader::FATAL_WARNING, true, msg, pos, line, col);
         }
 
 /*!
@@ -1290,39 +1317,75 @@ std::set<NxsBlock*> NxsReader::GetSetOfAllUsedBlocks()
         return s;
         }
 
+/*! Passes the diagnostic to the reader's NxsDiagnosticSink.
+        \returns false if the reader does not have a sink.
+*/
+bool NxsReader::SendToDiagnosticSink(NxsWarnLevel warnLevel, bool isError, const std::string & msg, file_pos pos, long line, long col) const
+        {
+        if (diagnosticSink == NULL)
+                return false;
+        NxsDiagnostic d;
+        d.level = warnLevel;
+        d.isError = isError;
+        d.block = currBlock;
+        d.pos = pos;
+        d.line = line;
+        d.col = col;
+        d.message = &msg;
+        diagnosticSink->Report(d);
+        return true;
+        }
+
+/*! \returns true unless the warning will be dropped by NexusWarn because of its level or the warning mode. */
+bool ExceptionRaisingNxsReader::ShouldReportWarning(NxsWarnLevel warnLevel) const
+        {
+        if (warnLevel < currentWarningLevel)
+                return false;
+        if (warnLevel >= this->warningToErrorThreshold)
+                return true;
+        return (warnMode != NxsReader::IGNORE_WARNINGS || diagnosticSink != NULL);
+        }
+
 void ExceptionRaisingNxsReader::NexusWarn(const std::string &msg, NxsWarnLevel warnLevel, file_pos pos, long line, long col)
         {
         if (warnLevel < currentWarningLevel)
                 return;
         if (warnLevel >= this->warningToErrorThreshold)
                 {
+                SendToDiagnosticSink(warnLevel, true, msg, pos, line, col);
                 NxsString e(msg.c_str());
                 throw NxsException(e, pos, line, col);
                 }
-
+        /* This is the long-standing behavior of the modes: WARNINGS_TO_STDOUT raises the warning as an error, and
+                the modes other than IGNORE_WARNINGS and WARNINGS_TO_STDERR write it to std::cout.
+        */
+        if (warnMode == NxsReader::WARNINGS_TO_STDOUT)
+                {
+                NxsString m("WARNING:\n ");
+                m += msg.c_str();
+                NexusError(m, pos, line, col);
+                }
+        if (SendToDiagnosticSink(warnLevel, false, msg, pos, line, col))
+                return;
         if (warnMode == NxsReader::IGNORE_WARNINGS)
                 return;
         if (warnMode == NxsReader::WARNINGS_TO_STDERR)
                 {
-                std::cerr << "\nWarning:  ";
-                std::cerr << "\n " << msg << std::endl;
+                std::ostream & out = (messageStream ? *messageStream : std::cerr);
+                out << "\nWarning:  ";
+                out << "\n " << msg << std::endl;
                 if (line > 0 || pos > 0)
-                        std::cerr << "at line " << line << ", column (approximately) " << col << " (file position " << pos << ")\n";
+                        out << "at line " << line << ", column (approximately) " << col << " (file position " << pos << ")\n";
                 }
-        else if (warnMode != NxsReader::WARNINGS_TO_STDOUT)
+        else
                 {
-                std::cout << "\nWarning:  ";
+                std::ostream & out = (messageStream ? *messageStream : std::cout);
+                out << "\nWarning:  ";
                 if (line > 0 || pos > 0)
-                        std::cout << "at line " << line << ", column " << col << " (file position " << pos << "):\n";
-                std::cout << "\n " << msg << '\n';
+                        out << "at line " << line << ", column " << col << " (file position " << pos << "):\n";
+                out << "\n " << msg << '\n';
                 if (line > 0 || pos > 0)
-                        std::cout << "at line " << line << ", column (approximately) " << col << " (file position " << pos << ')' << std::endl;
-                }
-        else
-                {
-                NxsString m("WARNING:\n ");
-                m += msg.c_str();
-                NexusError(m, pos, line, col);
+                        out << "at line " << line << ", column (approximately) " << col << " (file position " << pos << ')' << std::endl;
                 }
         }
 
@@ -1331,9 +1394,9 @@ void ExceptionRaisingNxsReader::SkippingBlock(NxsString blockName)
         if (warnMode == NxsReader::IGNORE_WARNINGS)
                 return;
         if (warnMode == NxsReader::WARNINGS_TO_STDERR)
-                std::cerr << "[!Skipping unknown block (" << blockName << ")...]" << std::endl;
+                (messageStream ? *messageStream : std::cerr) << "[!Skipping unknown block (" << blockName << ")...]" << std::endl;
         else if (warnMode != NxsReader::WARNINGS_TO_STDOUT)
-                std::cout << "[!Skipping unknown block (" << blockName << ")...]" << std::endl;
+                (messageStream ? *messageStream : std::cout) << "[!Skipping unknown block (" << blockName << ")...]" << std::endl;
         }
 
 void ExceptionRaisingNxsReader::SkippingDisabledBlock(NxsString blockName)
@@ -1341,15 +1404,16 @@ void ExceptionRaisingNxsReader::SkippingDisabledBlock(NxsString blockName)
         if (warnMode == NxsReader::IGNORE_WARNINGS)
                 return;
         if (warnMode == NxsReader::WARNINGS_TO_STDERR)
-                std::cerr << "[!Skipping disabled block (" << blockName << ")...]" << std::endl;
+                (messageStream ? *messageStream : std::cerr) << "[!Skipping disabled block (" << blockName << ")...]" << std::endl;
         else if (warnMode != NxsReader::WARNINGS_TO_STDOUT)
-                std::cout << "[!Skipping disabled block (" << blockName << ")...]" << std::endl;
+                (messageStream ? *messageStream : std::cout) << "[!Skipping disabled block (" << blockName << ")...]" << std::endl;
         }
 
 void NxsReader::statusMessage(const std::string & m) const
 {
         if (alwaysReportStatusMessages || currentWarningLevel == UNCOMMON_SYNTAX_WARNING) {
-                std::cerr << m << std::endl;
+                std::ostream & out = (messageStream ? *messageStream : std::cerr);
+                out << m << std::endl;
         }
 }
 
@@ -24,6 +24,11 @@
 #include "ncl/nxsstring.h"
 #include "ncl/nxsexception.h"
 #include "ncl/nxstoken.h"
+#if defined(NCL_HAS_STD_THREAD)
+#        include <atomic>
+#else
+#        include <csignal>
+#endif
 
 class NxsBlock;
 class NxsBlockFactory;
@@ -32,10 +37,50 @@ class NxsAssumptionsBlockAPI;
 class NxsCharactersBlockAPI;
 class NxsTaxaBlockAPI;
 class NxsTreesBlockAPI;
+class NxsDiagnosticSink;
 
 typedef std::list<NxsBlock *> BlockReaderList;
 typedef std::map<std::string, BlockReaderList> BlockTypeToBlockList;
 
+/*! A flag that asks the readers that use it to stop parsing.
+
+        Cancel() may be called from any thread (or from a signal handler). Readers check the flag in the
+        same places that they check for SIGINTs, and raise NxsSignalCanceledParseException once it is set.
+        One token can be shared by several readers. \sa NxsReader::SetCancellationToken
+*/
+class NxsCancellationToken
+        {
+        public:
+                NxsCancellationToken()
+                        :canceled(0)
+                        {}
+                void Cancel()
+                        {
+                        canceled = 1;
+                        }
+                /*! Clears the flag so that the token can be used for another parse. */
+                void Reset()
+                        {
+                        canceled = 0;
+                        }
+                bool IsCanceled() const
+                        {
+#                        if defined(NCL_HAS_STD_THREAD)
+                                return canceled.load(std::memory_order_relaxed) != 0;
+#                        else
+                                return canceled != 0;
+#                        endif
+                        }
+        private:
+                NxsCancellationToken(const NxsCancellationToken &); /** don't define, not copyable*/
+                NxsCancellationToken & operator=(const NxsCancellationToken &); /** don't define, not copyable*/
+#                if defined(NCL_HAS_STD_THREAD)
+                        std::atomic<int> canceled;
+#                else
+                        volatile std::sig_atomic_t canceled;
+#                endif
+        };
+
 
 /*!
         This is the class that orchestrates the reading of a NEXUS data file, and so is the central class to NCL.
@@ -100,6 +145,9 @@ typedef std::map<std::string, BlockReaderList> BlockTypeToBlockList;
                 Traditionally, the user of an application can send an SIGINT to cause it to stop. NCL has very limited support
         for handling signals, and this support is turned off by default.
 
+                To stop one reader (rather than every reader in the process), give it a NxsCancellationToken with
+        NxsReader::SetCancellationToken, and call Cancel() on the token.
+
                 If you want NCL to raise an NxsSignalCanceledParseException if a signal is encountered during a parse then call:
                         NxsReader::setNCLCatchesSignals(true);
         before calling Execute on your NxsReader instance. Note that only the slowly-parsed blocks (TREES and CHARACTERS) and
@@ -107,6 +155,8 @@ typedef std::map<std::string, BlockReaderList> BlockTypeToBlockList;
         have a generic message indicating that the signal was caught during the parse.
 
                 The NCL signal handler is only installed during NxsReader::Execute calls!
+        If several readers are executing at once (for example, in NxsReadFilepaths) then the handler is installed
+        by the first of them and removed when the last one finishes; a SIGINT cancels all of them.
 
                 Note: that if you want your program to exit on SIGINT, you can leave the signal handling turned off. If you do turn
                         NCL's signal handling on, then after you do your apps clean up you'll have to exit by something like this:
@@ -161,6 +211,29 @@ class NxsReader
                         \sa The section on signal handling \ref signalsection
                 */
                 static void setNumSignalsIntsCaught(unsigned);
+                /*! \returns true if the current parse should stop. It stops if this reader's cancellation token has been
+                        canceled, or if NCL is catching signals and a SIGINT has arrived since getNumSignalIntsCaught()
+                        returned `numSigIntsAtStart`.
+                        This is cheap enough to call inside the parsing loops of blocks.
+                */
+                bool IsParseCanceled(unsigned numSigIntsAtStart) const
+                        {
+                        return (cancellationToken != NULL && cancellationToken->IsCanceled())
+                                || (nclCatchesSignals && numSigIntsCaught != numSigIntsAtStart);
+                        }
+                /*! Sets the token that is checked while this reader parses (NULL means no token). The caller keeps
+                        ownership of `token`, and may share it between readers.
+                        Unlike setNCLCatchesSignals, this only affects this reader, so it can be used to stop one of
+                        several readers that are running on different threads.
+                */
+                void SetCancellationToken(NxsCancellationToken * token)
+                        {
+                        cancellationToken = token;
+                        }
+                NxsCancellationToken * GetCancellationToken() const
+                        {
+                        return cancellationToken;
+                        }
 
 
                                                 NxsReader();
@@ -202,15 +275,29 @@ class NxsReader
 
                         The default NexusWarn behavior is to generate a NexusException for any
                         warnLevel >= PROBABLY_INCORRECT_CONTENT_WARNING
-                         and to ignore all other warnings.
+                         and to ignore all other warnings. Errors, and warnings at or above the current warning level,
+                         are first passed to the NxsDiagnosticSink of the reader (if there is one).
                 */
                 virtual void        NexusWarn(const std::string &s, NxsWarnLevel warnLevel, file_pos pos, long line, long col)
                         {
                         if (warnLevel >= PROBABLY_INCORRECT_CONTENT_WARNING)
                                 {
+                                SendToDiagnosticSink(warnLevel, true, s, pos, line, col);
                                 NxsString e(s.c_str());
                                 throw NxsException(e, pos, line, col);
                                 }
+                        if (warnLevel >= currentWarningLevel)
+                                SendToDiagnosticSink(warnLevel, false, s, pos, line, col);
+                        }
+                /*! \returns false if a warning of level `warnLevel` would be ignored (so there is no need to compose its
+                        message).  Block readers call this before formatting a warning message.
+
+                        The default implementation returns true because subclasses that override NexusWarn may want every
+                        warning. Subclasses that filter warnings should override this function to match their NexusWarn.
+                */
+                virtual bool        ShouldReportWarning(NxsWarnLevel) const
+                        {
+                        return true;
                         }
                 /*! Used internally as a more convenient way of calling NexusWarn */
                 void        NexusWarnToken(const std::string &m, NxsWarnLevel warnLevel, const ProcessedNxsToken &token)
@@ -329,6 +416,28 @@ class NxsReader
                         level (UNCOMMON_SYNTAX_WARNING) then these messages will show up in stderr.
                 */
                 virtual void statusMessage(const std::string & m) const;
+                /*! Status messages (and the warnings of ExceptionRaisingNxsReader) are written to `s` instead of
+                        std::cerr or std::cout. Passing NULL restores the default streams.
+                        Each reader writes to its own stream without any locking, so readers that run on different threads
+                        should not share a stream.
+                */
+                void SetMessageStream(std::ostream * s)
+                        {
+                        messageStream = s;
+                        }
+                /*! Warnings and errors that the reader would report are passed to `sink` (as NxsDiagnostic records)
+                        instead of being written to a stream. Pass NULL to restore the normal behavior.
+                        The caller keeps ownership of `sink`. Errors are still raised as exceptions after the sink has
+                        been called.
+                */
+                void SetDiagnosticSink(NxsDiagnosticSink * sink)
+                        {
+                        diagnosticSink = sink;
+                        }
+                NxsDiagnosticSink * GetDiagnosticSink() const
+                        {
+                        return diagnosticSink;
+                        }
 
                 /*! \deprecated This function is almost never needed.
                         \returns if true no blocks have registered as readers (does not indicate
@@ -369,7 +478,7 @@ class NxsReader
                 static bool nclCatchesSignals; // default False;
                 typedef void (*SignalHandlerFuncPtr) (int);
                 static SignalHandlerFuncPtr prevSignalCatcher; // the signal handler that was installed before NCL's signal handler
-                static unsigned numSigIntsCaught;
+                static volatile unsigned numSigIntsCaught;
                 static bool prevSignalStored ;
 
                 void                        CoreExecutionTasks(NxsToken& token, bool notifyStartStop = true);
@@ -400,6 +509,11 @@ class NxsReader
                 bool destroyRepeatedTaxaBlocks;
                 NxsWarnLevel currentWarningLevel;
                 bool alwaysReportStatusMessages;
+                NxsCancellationToken * cancellationToken; /* token checked during parsing (not owned, may be NULL) */
+                std::ostream * messageStream; /* destination of status and warning messages. NULL for the standard streams */
+                NxsDiagnosticSink * diagnosticSink; /* receives warnings and errors (not owned, may be NULL) */
+
+                bool                        SendToDiagnosticSink(NxsWarnLevel warnLevel, bool isError, const std::string & msg, file_pos pos, long line, long col) const;
 
         private:
 
@@ -421,6 +535,36 @@ class NxsReader
 typedef NxsBlock NexusBlock;
 typedef NxsReader Nexus;
 
+/*! A warning or error, as passed to a NxsDiagnosticSink.
+
+        NCL does not give its messages individual identifiers, so `level` serves as the code of the diagnostic.
+        Errors have `isError` set and a level of NxsReader::FATAL_WARNING (unless they were generated by a
+        warning that was converted to an error).
+
+        The `block` and `message` pointers are only valid during the call to NxsDiagnosticSink::Report. Sinks
+        that keep diagnostics must copy what they need.
+*/
+class NxsDiagnostic
+        {
+        public:
+                NxsReader::NxsWarnLevel level; /* severity (and category) of the diagnostic */
+                bool isError; /* true if parsing will stop with an NxsException */
+                const NxsBlock * block; /* the block being read (NULL if the diagnostic did not come from a block) */
+                file_pos pos; /* file position */
+                long line; /* line number (or -1 if unknown) */
+                long col; /* column number (or -1 if unknown) */
+                const std::string * message; /* the text of the message */
+        };
+
+/*! Interface for objects that collect the diagnostics of a reader. \sa NxsReader::SetDiagnosticSink */
+class NxsDiagnosticSink
+        {
+        public:
+                virtual ~NxsDiagnosticSink()
+                        {}
+                virtual void Report(const NxsDiagnostic & diagnostic) = 0;
+        };
+
 /*! A subclass of NxsReader that is used in much of NCL v2.1.
 
         The NexusError function raises a NxsException so that all errors are treated
@@ -444,9 +588,11 @@ class ExceptionRaisingNxsReader : public NxsReader
                 /*! Raise a NxsException. */
                 void NexusError(NxsString msg, file_pos pos, long line, long col)
                         {
+                        SendToDiagnosticSink(NxsReader::FATAL_WARNING, true, msg, pos, line, col);
                         throw NxsException(msg, pos, line, col);
                         }
                 virtual void NexusWarn(const std::string & msg, NxsWarnLevel level, file_pos pos, long line, long col);
+                virtual bool ShouldReportWarning(NxsWarnLevel warnLevel) const;
 
                 void SkippingBlock(NxsString blockName);
                 void SkippingDisabledBlock(NxsString blockName);
@@ -529,9 +675,12 @@ class DefaultErrorReportNxsReader : public NxsReader
                                 return;
                         if (warnLevel >= PROBABLY_INCORRECT_CONTENT_WARNING)
                                 {
+                                SendToDiagnosticSink(warnLevel, true, msg, pos, line, col);
                                 NxsString e(msg.c_str());
                                 throw NxsException(e, pos, line, col);
                                 }
+                        if (SendToDiagnosticSink(warnLevel, false, msg, pos, line, col))
+                                return;
                         if (errOut != 0)
                                 {
                                 *errOut << "\nWarning:  ";
@@ -548,6 +697,11 @@ class DefaultErrorReportNxsReader : public NxsReader
                                 }
                         }
 
+                bool ShouldReportWarning(NxsWarnLevel warnLevel) const
+                        {
+                        return warnLevel >= currentWarningLevel;
+                        }
+
                 /*! Raises a NxsException.
                 */
                 void NexusError(NxsString msg, file_pos pos, long line, long col)
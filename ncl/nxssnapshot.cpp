@@ -0,0 +1,618 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include "ncl/nxssnapshot.h"
+#include "ncl/nxspublicblocks.h"
+
+#if !defined(_WIN32)
+#        define NCL_SNAPSHOT_USE_MMAP
+#        include <fcntl.h>
+#        include <sys/mman.h>
+#        include <sys/stat.h>
+#        include <unistd.h>
+#endif
+
+using namespace std;
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Layout of a snapshot (all numbers use the byte order of the machine that wrote the file, every section starts at
+|        a multiple of 8 bytes, and every section is padded to a multiple of 8 bytes):
+|
+|        header:        char[8] "NCLSNAP" + '\0', uint32 format version, uint32 0x01020304 (byte order mark),
+|                        uint32 sizeof(NxsDiscreteStateCell), uint32 number of sections, uint64 offset and uint64 length
+|                        of the NEXUS part.
+|        section table:        for each section: uint32 kind, uint32 (unused), uint64 offset, uint64 length
+|        the NEXUS part (text)
+|        the sections
+|
+|        MATRIX_SECTION:        uint32 nRows, uint32 nChar, uint32 nStates, uint32 number of extra codes. Then for each state
+|                        code >= nStates: uint32 number of states, uint8 isPolymorphic, char nexusSymbol, uint16 (unused),
+|                        followed by the states (as int32). Then uint8 hasData[nRows]. Then nRows*nChar state codes.
+|        TREES_SECTION:        uint32 number of trees, uint32 index of the default tree. Then for each tree: uint32 name length,
+|                        uint32 newick length, int32 flags, int32 minIntEdgeLen, double minDblEdgeLen, uint32
+|                        requireNewickNameTokenizing, uint32 (unused), followed by the name and newick string.
+*/
+namespace
+{
+const char kSnapshotMagic[8] = {'N', 'C', 'L', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t kByteOrderMark = 0x01020304;
+const std::size_t kHeaderLength = 40;
+const std::size_t kSectionEntryLength = 24;
+
+std::size_t PaddingTo8(std::size_t n)
+        {
+        return (8 - (n % 8)) % 8;
+        }
+
+template<typename T>
+void AppendBinary(std::string & buffer, T value)
+        {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+void AppendPadding(std::string & buffer)
+        {
+        buffer.append(PaddingTo8(buffer.size()), '\0');
+        }
+
+/* Reads the numbers in a section, checking that every read is within the section */
+class SnapshotCursor
+        {
+        public:
+                SnapshotCursor(const char * start, std::size_t length)
+                        :curr(start),
+                        end(start + length)
+                        {}
+                template<typename T>
+                T Read()
+                        {
+                        T value;
+                        std::memcpy(&value, Advance(sizeof(T)), sizeof(T));
+                        return value;
+                        }
+                const char * Advance(std::size_t n)
+                        {
+                        if ((std::size_t)(end - curr) < n)
+                                throw NxsException("The snapshot file is truncated or corrupted");
+                        const char * p = curr;
+                        curr += n;
+                        return p;
+                        }
+                void SkipPadding(const char * sectionStart)
+                        {
+                        Advance(PaddingTo8((std::size_t)(curr - sectionStart)));
+                        }
+        private:
+                const char * curr;
+                const char * end;
+        };
+
+/* A discrete matrix that can be stored in a binary section */
+bool CanStoreMatrixInSection(const NxsCharactersBlock & cb)
+        {
+        const NxsCharactersBlock::DataTypesEnum dt = cb.GetDataType();
+        if (dt == NxsCharactersBlock::continuous || dt == NxsCharactersBlock::codon || cb.IsMixedType())
+                return false;
+        if (cb.GetNTaxTotal() == 0 || cb.GetDatatypeMapperForChar(0) == NULL)
+                return false;
+        const unsigned nc = cb.GetNCharTotal();
+        const unsigned nt = cb.GetNTaxTotal();
+        for (unsigned i = 0; i < nt; ++i)
+                {
+                const unsigned rowLen = (unsigned) cb.GetDiscreteMatrixRow(i).size();
+                if (rowLen != 0 && rowLen != nc)
+                        return false;
+                }
+        return true;
+        }
+} // anonymous namespace
+
+class NxsSnapshotSectionWriter
+        {
+        public:
+                NxsSnapshotSectionWriter(NxsSnapshotIO::SectionKind k)
+                        :kind(k),
+                        matrixBlock(0L),
+                        length(0)
+                        {}
+                NxsSnapshotIO::SectionKind kind;
+                std::string head; /* the part of the section that is written from memory */
+                const NxsCharactersBlock * matrixBlock; /* if not NULL, the state codes of this block follow head */
+                uint64_t length;
+        };
+
+void NxsSnapshotIO::Write(PublicNexusReader & reader, std::ostream & out)
+        {
+        std::vector<NxsSnapshotSectionWriter> sections;
+        std::ostringstream nexus;
+        nexus << "#NEXUS\n";
+        const std::size_t cellSize = sizeof(NxsDiscreteStateCell);
+        BlockReaderList blocks = reader.GetUsedBlocksInOrder();
+        for (BlockReaderList::const_iterator bIt = blocks.begin(); bIt != blocks.end(); ++bIt)
+                {
+                NxsBlock * b = *bIt;
+                if (b == NULL)
+                        continue;
+                const unsigned sectionIndex = (unsigned) sections.size();
+                NxsCharactersBlock * cb = dynamic_cast<NxsCharactersBlock *>(b);
+                if (cb != NULL && CanStoreMatrixInSection(*cb))
+                        {
+                        NxsSnapshotSectionWriter s(MATRIX_SECTION);
+                        const NxsDiscreteDatatypeMapper * dm = cb->GetDatatypeMapperForChar(0);
+                        const unsigned nt = cb->GetNTaxTotal();
+                        const unsigned nc = cb->GetNCharTotal();
+                        const NxsDiscreteStateCell nStates = (NxsDiscreteStateCell) dm->GetNumStates();
+                        const NxsDiscreteStateCell highestCode = dm->GetHighestStateCode();
+                        AppendBinary<uint32_t>(s.head, nt);
+                        AppendBinary<uint32_t>(s.head, nc);
+                        AppendBinary<uint32_t>(s.head, (uint32_t) nStates);
+                        AppendBinary<uint32_t>(s.head, (uint32_t) (highestCode >= nStates ? highestCode + 1 - nStates : 0));
+                        for (NxsDiscreteStateCell c = nStates; c <= highestCode; ++c)
+                                {
+                                const NxsDiscreteStateSetInfo & info = dm->stateSetsVec[c - dm->sclOffset];
+                                AppendBinary<uint32_t>(s.head, (uint32_t) info.states.size());
+                                AppendBinary<uint8_t>(s.head, (uint8_t) (info.isPolymorphic ? 1 : 0));
+                                AppendBinary<char>(s.head, info.nexusSymbol);
+                                AppendBinary<uint16_t>(s.head, 0);
+                                for (std::set<NxsDiscreteStateCell>::const_iterator sIt = info.states.begin(); sIt != info.states.end(); ++sIt)
+                                        AppendBinary<int32_t>(s.head, (int32_t) *sIt);
+                                }
+                        AppendPadding(s.head);
+                        for (unsigned i = 0; i < nt; ++i)
+                                AppendBinary<uint8_t>(s.head, (uint8_t) (cb->GetDiscreteMatrixRow(i).empty() ? 0 : 1));
+                        AppendPadding(s.head);
+                        s.matrixBlock = cb;
+                        s.length = s.head.size() + ((uint64_t) nt)*nc*cellSize;
+                        s.length += PaddingTo8((std::size_t) (s.length % 8));
+                        sections.push_back(s);
+                        cb->WriteBlockAsNexus(nexus, sectionIndex);
+                        continue;
+                        }
+                NxsTreesBlock * tb = dynamic_cast<NxsTreesBlock *>(b);
+                if (tb != NULL && tb->GetNumTrees() > 0)
+                        {
+                        NxsSnapshotSectionWriter s(TREES_SECTION);
+                        AppendBinary<uint32_t>(s.head, (uint32_t) tb->trees.size());
+                        AppendBinary<uint32_t>(s.head, (uint32_t) tb->defaultTreeInd);
+                        for (std::vector<NxsFullTreeDescription>::const_iterator tIt = tb->trees.begin(); tIt != tb->trees.end(); ++tIt)
+                                {
+                                AppendBinary<uint32_t>(s.head, (uint32_t) tIt->name.size());
+                                AppendBinary<uint32_t>(s.head, (uint32_t) tIt->newick.size());
+                                AppendBinary<int32_t>(s.head, (int32_t) tIt->flags);
+                                AppendBinary<int32_t>(s.head, (int32_t) tIt->minIntEdgeLen);
+                                AppendBinary<double>(s.head, tIt->minDblEdgeLen);
+                                AppendBinary<uint32_t>(s.head, (uint32_t) (tIt->requireNewickNameTokenizing ? 1 : 0));
+                                AppendBinary<uint32_t>(s.head, 0);
+                                s.head.append(tIt->name);
+                                s.head.append(tIt->newick);
+                                AppendPadding(s.head);
+                                }
+                        s.length = s.head.size();
+                        sections.push_back(s);
+                        tb->WriteBlockAsNexus(nexus, sectionIndex);
+                        continue;
+                        }
+                b->WriteAsNexus(nexus);
+                }
+        const std::string nexusContent = nexus.str();
+
+        std::string header(kSnapshotMagic, sizeof(kSnapshotMagic));
+        AppendBinary<uint32_t>(header, (uint32_t) FORMAT_VERSION);
+        AppendBinary<uint32_t>(header, kByteOrderMark);
+        AppendBinary<uint32_t>(header, (uint32_t) cellSize);
+        AppendBinary<uint32_t>(header, (uint32_t) sections.size());
+        uint64_t offset = kHeaderLength + kSectionEntryLength*sections.size();
+        AppendBinary<uint64_t>(header, offset);
+        AppendBinary<uint64_t>(header, (uint64_t) nexusContent.size());
+        offset += nexusContent.size() + PaddingTo8(nexusContent.size());
+        for (std::vector<NxsSnapshotSectionWriter>::const_iterator sIt = sections.begin(); sIt != sections.end(); ++sIt)
+                {
+                AppendBinary<uint32_t>(header, (uint32_t) sIt->kind);
+                AppendBinary<uint32_t>(header, 0);
+                AppendBinary<uint64_t>(header, offset);
+                AppendBinary<uint64_t>(header, sIt->length);
+                offset += sIt->length;
+                }
+        out.write(header.data(), (std::streamsize) header.size());
+        out.write(nexusContent.data(), (std::streamsize) nexusContent.size());
+        const std::string padding(8, '\0');
+        out.write(padding.data(), (std::streamsize) PaddingTo8(nexusContent.size()));
+
+        const std::vector<NxsDiscreteStateCell> missingRow;
+        for (std::vector<NxsSnapshotSectionWriter>::const_iterator sIt = sections.begin(); sIt != sections.end(); ++sIt)
+                {
+                out.write(sIt->head.data(), (std::streamsize) sIt->head.size());
+                if (sIt->matrixBlock == NULL)
+                        continue;
+                const NxsCharactersBlock & cb = *(sIt->matrixBlock);
+                const unsigned nt = cb.GetNTaxTotal();
+                const unsigned nc = cb.GetNCharTotal();
+                const std::vector<NxsDiscreteStateCell> emptyRow(nc, NXS_MISSING_CODE);
+                for (unsigned i = 0; i < nt; ++i)
+                        {
+                        const NxsDiscreteStateRow & row = cb.GetDiscreteMatrixRow(i);
+                        const NxsDiscreteStateRow & toWrite = (row.empty() ? emptyRow : row);
+                        if (nc > 0)
+                                out.write(reinterpret_cast<const char *>(&toWrite[0]), (std::streamsize) (nc*cellSize));
+                        }
+                out.write(padding.data(), (std::streamsize) PaddingTo8((std::size_t) ((((uint64_t) nt)*nc*cellSize) % 8)));
+                }
+        if (!out.good())
+                throw NxsException("Error writing the snapshot");
+        }
+
+void NxsSnapshotIO::WriteFilepath(PublicNexusReader & reader, const char * filepath)
+        {
+        std::ofstream out(filepath, std::ios::binary);
+        if (!out.good())
+                {
+                NxsString msg;
+                msg << "Could not open the file " << filepath << " to write a snapshot";
+                throw NxsException(msg);
+                }
+        Write(reader, out);
+        out.close();
+        }
+
+void NxsSnapshotIO::SetAcceptPlaceholders(PublicNexusReader & reader, bool accept)
+        {
+        NxsCharactersBlock * cb = reader.GetCharactersBlockTemplate();
+        if (cb)
+                cb->acceptSnapshotMatrixCommand = accept;
+        NxsDataBlock * db = reader.GetDataBlockTemplate();
+        if (db)
+                db->acceptSnapshotMatrixCommand = accept;
+        NxsTreesBlock * tb = reader.GetTreesBlockTemplate();
+        if (tb)
+                tb->acceptSnapshotTreesCommand = accept;
+        }
+
+void NxsSnapshotIO::ReadFilepath(PublicNexusReader & reader, const char * filepath)
+        {
+        NxsMappedSnapshot snapshot(filepath);
+        SetAcceptPlaceholders(reader, true);
+        try
+                {
+                reader.ReadStringAsNexusContent(snapshot.GetNexusContent());
+                }
+        catch (...)
+                {
+                SetAcceptPlaceholders(reader, false);
+                throw;
+                }
+        SetAcceptPlaceholders(reader, false);
+
+        BlockReaderList blocks = reader.GetBlocksFromLastExecuteInOrder();
+        for (BlockReaderList::const_iterator bIt = blocks.begin(); bIt != blocks.end(); ++bIt)
+                {
+                NxsCharactersBlock * cb = dynamic_cast<NxsCharactersBlock *>(*bIt);
+                if (cb != NULL)
+                        {
+                        cb->acceptSnapshotMatrixCommand = false;
+                        if (cb->snapshotMatrixSection != UINT_MAX)
+                                FillMatrix(*cb, snapshot);
+                        continue;
+                        }
+                NxsTreesBlock * tb = dynamic_cast<NxsTreesBlock *>(*bIt);
+                if (tb != NULL)
+                        {
+                        tb->acceptSnapshotTreesCommand = false;
+                        if (tb->snapshotTreesSection != UINT_MAX)
+                                FillTrees(*tb, snapshot);
+                        }
+                }
+        }
+
+/*!
+        Copies the matrix from the snapshot into `charsBlock`. The codes for ambiguous and polymorphic cells are
+        looked up in the datatype mapper that was created from the FORMAT command of the block (the codes only
+        need to be translated if the mapper numbers them differently from the mapper that wrote the snapshot).
+*/
+void NxsSnapshotIO::FillMatrix(NxsCharactersBlock & charsBlock, const NxsMappedSnapshot & snapshot)
+        {
+        const unsigned sectionIndex = charsBlock.snapshotMatrixSection;
+        const NxsSnapshotMatrixView view = snapshot.GetMatrix(sectionIndex);
+        std::vector<NxsDiscreteStateSetInfo> extraCodes;
+        const unsigned nStates = snapshot.GetMatrixStateCodes(sectionIndex, &extraCodes);
+        NxsDiscreteDatatypeMapper * dm = charsBlock.GetMutableDatatypeMapperForChar(0);
+        const NxsTaxaBlockAPI * taxa = charsBlock.GetTaxaBlockPtr();
+        if (dm == NULL || taxa == NULL || charsBlock.IsMixedType()
+                || view.GetNChar() != charsBlock.GetNCharTotal()
+                || view.GetNRows() != taxa->GetNTax()
+                || nStates != dm->GetNumStates())
+                {
+                NxsString msg;
+                msg << "The matrix in section " << sectionIndex << " of the snapshot does not match the " << charsBlock.GetID() << " block that refers to it";
+                throw NxsException(msg);
+                }
+        std::vector<NxsDiscreteStateCell> codeTranslation(extraCodes.size());
+        bool translating = false;
+        for (unsigned i = 0; i < extraCodes.size(); ++i)
+                {
+                const NxsDiscreteStateSetInfo & info = extraCodes[i];
+                const NxsDiscreteStateCell written = (NxsDiscreteStateCell) (nStates + i);
+                codeTranslation[i] = dm->StateCodeForStateSet(info.states, info.isPolymorphic, true, info.nexusSymbol);
+                if (codeTranslation[i] != written)
+                        translating = true;
+                }
+
+        const unsigned nRows = view.GetNRows();
+        const unsigned nChar = view.GetNChar();
+        const NxsDiscreteStateCell endCode = (NxsDiscreteStateCell) (nStates + extraCodes.size());
+        NxsDiscreteStateMatrix & matrix = charsBlock.discreteMatrix;
+        matrix.clear();
+        matrix.resize(nRows);
+        for (unsigned r = 0; r < nRows; ++r)
+                {
+                if (!view.RowHasData(r))
+                        continue;
+                const NxsDiscreteStateCell * cells = view.GetRow(r);
+                for (unsigned c = 0; c < nChar; ++c)
+                        {
+                        if (cells[c] < NXS_GAP_STATE_CODE || cells[c] >= endCode)
+                                {
+                                NxsString msg;
+                                msg << "The matrix in section " << sectionIndex << " of the snapshot has an invalid state code (" << cells[c] << ") for taxon " << r + 1 << " (" << taxa->GetTaxonLabel(r) << ") and character " << c + 1;
+                                throw NxsException(msg);
+                                }
+                        }
+                NxsDiscreteStateRow & row = matrix[r];
+                row.assign(cells, cells + nChar);
+                if (translating)
+                        {
+                        for (NxsDiscreteStateRow::iterator cIt = row.begin(); cIt != row.end(); ++cIt)
+                                {
+                                if (*cIt >= (NxsDiscreteStateCell) nStates)
+                                        *cIt = codeTranslation[*cIt - nStates];
+                                }
+                        }
+                }
+        charsBlock.snapshotMatrixSection = UINT_MAX;
+        charsBlock.FinishMatrix();
+        }
+
+/*!
+        Adds the tree descriptions from the snapshot to `treesBlock` (or passes them to its NxsTreeConsumer).
+*/
+void NxsSnapshotIO::FillTrees(NxsTreesBlock & treesBlock, const NxsMappedSnapshot & snapshot)
+        {
+        const unsigned sectionIndex = treesBlock.snapshotTreesSection;
+        treesBlock.snapshotTreesSection = UINT_MAX;
+        if (treesBlock.treeConsumer == NULL)
+                {
+                const unsigned defaultTree = snapshot.GetTreeDescriptions(sectionIndex, &treesBlock.trees);
+                if (defaultTree != UINT_MAX)
+                        treesBlock.defaultTreeInd = defaultTree;
+                return;
+                }
+        std::vector<NxsFullTreeDescription> trees;
+        snapshot.GetTreeDescriptions(sectionIndex, &trees);
+        for (std::vector<NxsFullTreeDescription>::iterator tIt = trees.begin(); tIt != trees.end(); ++tIt)
+                {
+                if (treesBlock.streamingTree != NULL)
+                        treesBlock.streamingTree->Initialize(*tIt, treesBlock.streamingInternalLabelsAsStrings);
+                treesBlock.treeConsumer->ConsumeTree(*tIt, treesBlock.streamingTree, treesBlock);
+                }
+        }
+
+NxsMappedSnapshot::NxsMappedSnapshot(const char * path)
+        :filepath(path),
+        data(0L),
+        dataLength(0),
+        nexusStart(0L),
+        nexusLength(0)
+        {
+        bool opened = false;
+#        if defined(NCL_SNAPSHOT_USE_MMAP)
+                const int fd = open(path, O_RDONLY);
+                if (fd >= 0)
+                        {
+                        struct stat st;
+                        if (fstat(fd, &st) == 0)
+                                {
+                                opened = true;
+                                dataLength = (std::size_t) st.st_size;
+                                if (dataLength > 0)
+                                        {
+                                        void * m = mmap(0L, dataLength, PROT_READ, MAP_PRIVATE, fd, 0);
+                                        if (m == MAP_FAILED)
+                                                opened = false;
+                                        else
+                                                data = static_cast<const char *>(m);
+                                        }
+                                }
+                        close(fd);
+                        }
+#        endif
+        if (!opened)
+                {
+                std::ifstream inf(path, std::ios::binary);
+                if (!inf.good())
+                        {
+                        NxsString msg;
+                        msg << "Could not open the snapshot file " << filepath;
+                        throw NxsException(msg);
+                        }
+                fileContents.assign(std::istreambuf_iterator<char>(inf), std::istreambuf_iterator<char>());
+                dataLength = fileContents.size();
+                data = (fileContents.empty() ? 0L : &fileContents[0]);
+                }
+        try
+                {
+                SnapshotCursor cursor(data, dataLength);
+                if (dataLength < kHeaderLength || std::memcmp(cursor.Advance(sizeof(kSnapshotMagic)), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0)
+                        {
+                        NxsString msg;
+                        msg << filepath << " is not an NCL snapshot file";
+                        throw NxsException(msg);
+                        }
+                const uint32_t version = cursor.Read<uint32_t>();
+                const uint32_t bom = cursor.Read<uint32_t>();
+                const uint32_t cellSize = cursor.Read<uint32_t>();
+                if (version != NxsSnapshotIO::FORMAT_VERSION || bom != kByteOrderMark || cellSize != sizeof(NxsDiscreteStateCell))
+                        {
+                        NxsString msg;
+                        msg << "The snapshot file " << filepath << " was written by a version of NCL (or a machine) that uses a different snapshot format";
+                        throw NxsException(msg);
+                        }
+                const uint32_t nSections = cursor.Read<uint32_t>();
+                const uint64_t nexusOffset = cursor.Read<uint64_t>();
+                const uint64_t nexusLen = cursor.Read<uint64_t>();
+                if (nexusOffset > dataLength || nexusLen > dataLength - nexusOffset)
+                        throw NxsException("The snapshot file is truncated or corrupted");
+                nexusStart = data + nexusOffset;
+                nexusLength = (std::size_t) nexusLen;
+                for (uint32_t i = 0; i < nSections; ++i)
+                        {
+                        Section s;
+                        s.kind = cursor.Read<uint32_t>();
+                        cursor.Read<uint32_t>();
+                        const uint64_t offset = cursor.Read<uint64_t>();
+                        const uint64_t length = cursor.Read<uint64_t>();
+                        if (offset > dataLength || length > dataLength - offset || offset % 8 != 0)
+                                throw NxsException("The snapshot file is truncated or corrupted");
+                        s.start = data + offset;
+                        s.length = (std::size_t) length;
+                        sections.push_back(s);
+                        }
+                }
+        catch (...)
+                {
+#                if defined(NCL_SNAPSHOT_USE_MMAP)
+                        if (fileContents.empty() && data != 0L)
+                                munmap(const_cast<char *>(data), dataLength);
+#                endif
+                throw;
+                }
+        }
+
+NxsMappedSnapshot::~NxsMappedSnapshot()
+        {
+#        if defined(NCL_SNAPSHOT_USE_MMAP)
+                if (fileContents.empty() && data != 0L)
+                        munmap(const_cast<char *>(data), dataLength);
+#        endif
+        }
+
+std::string NxsMappedSnapshot::GetNexusContent() const
+        {
+        return std::string(nexusStart, nexusLength);
+        }
+
+NxsSnapshotIO::SectionKind NxsMappedSnapshot::GetSectionKind(unsigned sectionIndex) const
+        {
+        if (sectionIndex >= sections.size())
+                throw NxsNCLAPIException("Snapshot section index out of range");
+        return NxsSnapshotIO::SectionKind(sections[sectionIndex].kind);
+        }
+
+const NxsMappedSnapshot::Section & NxsMappedSnapshot::GetSection(unsigned sectionIndex, NxsSnapshotIO::SectionKind kind) const
+        {
+        if (sectionIndex >= sections.size() || sections[sectionIndex].kind != (unsigned) kind)
+                {
+                NxsString msg;
+                msg << "The snapshot file " << filepath << " does not have a " << (kind == NxsSnapshotIO::MATRIX_SECTION ? "matrix" : "trees") << " section with index " << sectionIndex;
+                throw NxsException(msg);
+                }
+        return sections[sectionIndex];
+        }
+
+unsigned NxsMappedSnapshot::GetMatrixStateCodes(unsigned sectionIndex, std::vector<NxsDiscreteStateSetInfo> * extraCodes) const
+        {
+        const Section & s = GetSection(sectionIndex, NxsSnapshotIO::MATRIX_SECTION);
+        SnapshotCursor cursor(s.start, s.length);
+        cursor.Read<uint32_t>();
+        cursor.Read<uint32_t>();
+        const uint32_t nStates = cursor.Read<uint32_t>();
+        const uint32_t nExtra = cursor.Read<uint32_t>();
+        if (extraCodes)
+                {
+                extraCodes->clear();
+                for (uint32_t i = 0; i < nExtra; ++i)
+                        {
+                        const uint32_t n = cursor.Read<uint32_t>();
+                        const bool isPolymorphic = (cursor.Read<uint8_t>() != 0);
+                        const char symbol = cursor.Read<char>();
+                        cursor.Read<uint16_t>();
+                        std::set<NxsDiscreteStateCell> states;
+                        for (uint32_t j = 0; j < n; ++j)
+                                states.insert((NxsDiscreteStateCell) cursor.Read<int32_t>());
+                        extraCodes->push_back(NxsDiscreteStateSetInfo(states, isPolymorphic, symbol));
+                        }
+                }
+        return nStates;
+        }
+
+NxsSnapshotMatrixView NxsMappedSnapshot::GetMatrix(unsigned sectionIndex) const
+        {
+        const Section & s = GetSection(sectionIndex, NxsSnapshotIO::MATRIX_SECTION);
+        SnapshotCursor cursor(s.start, s.length);
+        NxsSnapshotMatrixView view;
+        view.nRows = cursor.Read<uint32_t>();
+        view.nChar = cursor.Read<uint32_t>();
+        cursor.Read<uint32_t>();
+        const uint32_t nExtra = cursor.Read<uint32_t>();
+        for (uint32_t i = 0; i < nExtra; ++i)
+                {
+                const uint32_t n = cursor.Read<uint32_t>();
+                cursor.Advance(4 + 4*((std::size_t) n));
+                }
+        cursor.SkipPadding(s.start);
+        view.rowHasData = reinterpret_cast<const unsigned char *>(cursor.Advance(view.nRows));
+        cursor.SkipPadding(s.start);
+        const std::size_t nCells = ((std::size_t) view.nRows)*view.nChar;
+        view.cells = reinterpret_cast<const NxsDiscreteStateCell *>(cursor.Advance(nCells*sizeof(NxsDiscreteStateCell)));
+        return view;
+        }
+
+unsigned NxsMappedSnapshot::GetTreeDescriptions(unsigned sectionIndex, std::vector<NxsFullTreeDescription> * trees) const
+        {
+        const Section & s = GetSection(sectionIndex, NxsSnapshotIO::TREES_SECTION);
+        SnapshotCursor cursor(s.start, s.length);
+        const uint32_t nTrees = cursor.Read<uint32_t>();
+        const uint32_t defaultTree = cursor.Read<uint32_t>();
+        trees->reserve(trees->size() + nTrees);
+        const std::size_t firstNewTree = trees->size();
+        for (uint32_t i = 0; i < nTrees; ++i)
+                {
+                const uint32_t nameLen = cursor.Read<uint32_t>();
+                const uint32_t newickLen = cursor.Read<uint32_t>();
+                const int32_t flags = cursor.Read<int32_t>();
+                const int32_t minIntEdgeLen = cursor.Read<int32_t>();
+                const double minDblEdgeLen = cursor.Read<double>();
+                const bool requireNewickNameTokenizing = (cursor.Read<uint32_t>() != 0);
+                cursor.Read<uint32_t>();
+                const char * name = cursor.Advance(nameLen);
+                const char * newick = cursor.Advance(newickLen);
+                cursor.SkipPadding(s.start);
+                trees->push_back(NxsFullTreeDescription(std::string(newick, newickLen), std::string(name, nameLen), flags));
+                NxsFullTreeDescription & td = trees->back();
+                td.minIntEdgeLen = minIntEdgeLen;
+                td.minDblEdgeLen = minDblEdgeLen;
+                td.requireNewickNameTokenizing = requireNewickNameTokenizing;
+                }
+        if (defaultTree == UINT_MAX)
+                return UINT_MAX;
+        return (unsigned) (firstNewTree + defaultTree);
+        }
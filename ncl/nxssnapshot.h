@@ -0,0 +1,174 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSSNAPSHOT_H
+#define NCL_NXSSNAPSHOT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ncl/nxsdefs.h"
+#include "ncl/nxscharactersblock.h"
+#include "ncl/nxstreesblock.h"
+
+class PublicNexusReader;
+class NxsMappedSnapshot;
+
+/*! A snapshot is a binary file that holds the blocks of a PublicNexusReader, so that they can be restored without
+        tokenizing the original NEXUS file.
+
+        The file starts with a header and a table of sections. Next comes the "NEXUS part": every block, written as
+        NEXUS. Most blocks (taxa, sets, assumptions, distances...) are written exactly as WriteAsNexus would write them.
+        Blocks that hold most of the data are written with a placeholder command instead:
+                - a discrete CHARACTERS (or DATA) block has "SnapshotMatrix <section>;" instead of its MATRIX command. The
+                        matrix is stored in a binary section as one contiguous array of state codes (taxa x characters). The
+                        section also lists the ambiguity and polymorphism codes of the block's datatype mapper, so that the
+                        codes can be mapped onto the mapper that is rebuilt from the FORMAT command.
+                - a TREES block has "SnapshotTrees <section>;" instead of its TREE commands. The tree descriptions (the
+                        name, newick string and flags that NxsTreesBlock stores for each tree) are stored in a binary
+                        section, so the newick strings are not tokenized again when the snapshot is read.
+        Continuous matrices, codon matrices and mixed-datatype matrices are written as NEXUS.
+
+        The numbers in the file use the byte order and the NxsDiscreteStateCell size of the machine that wrote it.
+        Reading a snapshot that was written with a different byte order or cell size (or a different version of the
+        format) raises an NxsException.
+*/
+class NxsSnapshotIO
+        {
+        public:
+                enum SectionKind
+                        {
+                        MATRIX_SECTION = 1,
+                        TREES_SECTION = 2
+                        };
+                enum {FORMAT_VERSION = 1};
+
+                /*! Writes the blocks that `reader` has read (in the order returned by GetUsedBlocksInOrder) to `out`.
+                        `out` should be a binary stream.
+                */
+                static void Write(PublicNexusReader & reader, std::ostream & out);
+                /*! Writes a snapshot of `reader` to the file at `filepath` (see Write).*/
+                static void WriteFilepath(PublicNexusReader & reader, const char * filepath);
+                /*! Reads the snapshot at `filepath` into `reader`. The NEXUS part is read with the reader's usual block
+                        templates (so the settings of the templates apply), then the matrices and trees are filled in from the
+                        binary sections.
+                */
+                static void ReadFilepath(PublicNexusReader & reader, const char * filepath);
+        private:
+                static void FillMatrix(NxsCharactersBlock & charsBlock, const NxsMappedSnapshot & snapshot);
+                static void FillTrees(NxsTreesBlock & treesBlock, const NxsMappedSnapshot & snapshot);
+                static void SetAcceptPlaceholders(PublicNexusReader & reader, bool accept);
+        };
+
+/*! A read-only view of one matrix section of a snapshot (see NxsMappedSnapshot::GetMatrix).
+        The pointers refer to the memory of the NxsMappedSnapshot, and are only valid while it exists.
+*/
+class NxsSnapshotMatrixView
+        {
+        public:
+                NxsSnapshotMatrixView()
+                        :nRows(0),
+                        nChar(0),
+                        rowHasData(0L),
+                        cells(0L)
+                        {}
+                /*! \returns the number of rows (the number of taxa in the taxa block that the matrix refers to). */
+                unsigned GetNRows() const
+                        {
+                        return nRows;
+                        }
+                unsigned GetNChar() const
+                        {
+                        return nChar;
+                        }
+                /*! \returns false for taxa that were not included in the matrix. Their rows are filled with NXS_MISSING_CODE.*/
+                bool RowHasData(unsigned row) const
+                        {
+                        return rowHasData[row] != 0;
+                        }
+                /*! \returns a pointer to the `GetNChar()` state codes of row `row` */
+                const NxsDiscreteStateCell * GetRow(unsigned row) const
+                        {
+                        return cells + ((std::size_t) row)*nChar;
+                        }
+        private:
+                unsigned nRows;
+                unsigned nChar;
+                const unsigned char * rowHasData;
+                const NxsDiscreteStateCell * cells;
+                friend class NxsMappedSnapshot;
+        };
+
+/*! Opens a snapshot file and maps it into memory (the file is read into memory on platforms without mmap).
+
+        Nothing is copied: the NEXUS part and the matrix sections are accessed in place, so opening a snapshot of a
+        very large alignment is fast and only the pages that are used are read from disk. NxsSnapshotIO::ReadFilepath
+        uses this class, and copies the data into the blocks of a PublicNexusReader. Clients that only need the state
+        codes can use GetMatrix to avoid that copy.
+
+        Raises an NxsException if the file cannot be opened or is not a snapshot that this build can read.
+*/
+class NxsMappedSnapshot
+        {
+        public:
+                NxsMappedSnapshot(const char * filepath);
+                ~NxsMappedSnapshot();
+
+                /*! \returns the NEXUS part of the snapshot (see NxsSnapshotIO).*/
+                std::string GetNexusContent() const;
+                unsigned GetNumSections() const
+                        {
+                        return (unsigned) sections.size();
+                        }
+                NxsSnapshotIO::SectionKind GetSectionKind(unsigned sectionIndex) const;
+                /*! \returns a view of the state codes stored in section `sectionIndex`.
+                        Raises an NxsException if the section is not a matrix section.
+                */
+                NxsSnapshotMatrixView GetMatrix(unsigned sectionIndex) const;
+                /*! \returns the number of state codes in the datatype mapper that the matrix was written with (not
+                        counting the gap and missing codes), and fills `extraCodes` with the state set of each code that is
+                        larger than the number of states.
+                */
+                unsigned GetMatrixStateCodes(unsigned sectionIndex, std::vector<NxsDiscreteStateSetInfo> * extraCodes) const;
+                /*! Appends the tree descriptions stored in section `sectionIndex` to `trees`, and returns the index of
+                        the default tree (UINT_MAX if no default tree was specified).
+                */
+                unsigned GetTreeDescriptions(unsigned sectionIndex, std::vector<NxsFullTreeDescription> * trees) const;
+        private:
+                NxsMappedSnapshot(const NxsMappedSnapshot &); /** don't define, not copyable*/
+                NxsMappedSnapshot & operator=(const NxsMappedSnapshot &); /** don't define, not copyable*/
+
+                class Section
+                        {
+                        public:
+                                unsigned kind;
+                                const char * start;
+                                std::size_t length;
+                        };
+                const Section & GetSection(unsigned sectionIndex, NxsSnapshotIO::SectionKind kind) const;
+                std::string filepath;
+                const char * data;
+                std::size_t dataLength;
+                std::vector<char> fileContents; /* only used if the file could not be mapped */
+                const char * nexusStart;
+                std::size_t nexusLength;
+                std::vector<Section> sections;
+        };
+
+#endif
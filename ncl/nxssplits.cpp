@@ -0,0 +1,475 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include "ncl/nxssplits.h"
+#include "ncl/nxsparallel.h"
+
+static inline void SetTaxonBit(NxsSplitWord * words, unsigned taxonIndex)
+        {
+        words[taxonIndex / 64] |= ((NxsSplitWord) 1) << (taxonIndex % 64);
+        }
+
+static inline bool HasTaxonBit(const NxsSplitWord * words, unsigned taxonIndex)
+        {
+        return ((words[taxonIndex / 64] >> (taxonIndex % 64)) & 1) != 0;
+        }
+
+/* A second mixing step for split hashes. Split hashes are combined by exclusive-or, so the hash of a topology adds
+        these (non-linear) functions of them, so that different sets of splits do not cancel out to the same sum.
+*/
+static inline uint64_t MixSplitHash(uint64_t h)
+        {
+        h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDULL;
+        h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+        return h ^ (h >> 33);
+        }
+
+uint64_t NxsCalcSplitHash(const NxsSplitWord * words, unsigned nWords)
+        {
+        uint64_t h = 0;
+        for (unsigned w = 0; w < nWords; ++w)
+                {
+                NxsSplitWord x = words[w];
+                for (unsigned b = 0; x != 0; ++b, x >>= 1)
+                        {
+                        if (x & 1)
+                                h ^= NxsGetTaxonSplitHash(64 * w + b);
+                        }
+                }
+        return h;
+        }
+
+void NxsTreeSplits::Extract(const NxsSimpleTree & tree, unsigned numTaxa, bool treatAsRooted, bool includeTrivial)
+        {
+        nTax = numTaxa;
+        nWords = NxsGetNumSplitWords(numTaxa);
+        splitSlots.clear();
+        splitHashes.clear();
+        splitEdgeLens.clear();
+        splitHeights.clear();
+        splitNodes.clear();
+        nodes.clear();
+        parentPos.clear();
+        treeTaxaHash = 0;
+        topologyHash = 0;
+        const NxsSimpleNode * root = tree.GetRootConst();
+        if (root == NULL)
+                return;
+        /* preorder (every node before its children) with the position of each node's parent */
+        toVisit.clear();
+        toVisit.push_back(std::pair<const NxsSimpleNode *, unsigned>(root, UINT_MAX));
+        while (!toVisit.empty())
+                {
+                const std::pair<const NxsSimpleNode *, unsigned> v = toVisit.back();
+                toVisit.pop_back();
+                const unsigned pos = (unsigned) nodes.size();
+                nodes.push_back(v.first);
+                parentPos.push_back(v.second);
+                for (const NxsSimpleNode * c = v.first->GetFirstChild(); c; c = c->GetNextSib())
+                        toVisit.push_back(std::pair<const NxsSimpleNode *, unsigned>(c, pos));
+                }
+        const unsigned nNodes = (unsigned) nodes.size();
+
+        /* internal nodes always get a bitset, leaves only if their (trivial) splits can be reported */
+        nodeSlot.resize(nNodes);
+        unsigned nSlots = 0;
+        treeTaxa.assign(nWords, 0);
+        uint64_t treeHash = 0;
+        unsigned numTreeTaxa = 0;
+        unsigned refTaxon = UINT_MAX;
+        for (unsigned i = 0; i < nNodes; ++i)
+                {
+                const NxsSimpleNode * nd = nodes[i];
+                const bool isLeaf = nd->IsTip();
+                nodeSlot[i] = ((!isLeaf || includeTrivial) ? nSlots++ : UINT_MAX);
+                const unsigned t = nd->GetTaxonIndex();
+                if (t == UINT_MAX)
+                        {
+                        if (isLeaf)
+                                throw NxsNCLAPIException("Splits cannot be computed for a tree that has a leaf without a taxon index.");
+                        continue;
+                        }
+                if (t >= nTax)
+                        {
+                        NxsString eMsg;
+                        eMsg << "Taxon number " << (t + 1) << " was found in a tree, but splits are being computed for " << nTax << " taxa.";
+                        throw NxsNCLAPIException(eMsg);
+                        }
+                SetTaxonBit(&treeTaxa[0], t);
+                treeHash ^= NxsGetTaxonSplitHash(t);
+                numTreeTaxa++;
+                if (t < refTaxon)
+                        refTaxon = t;
+                }
+        bitsets.assign(nSlots * nWords, 0);
+        nodeNumTaxa.assign(nNodes, 0);
+        nodeHash.assign(nNodes, 0);
+        nodeHeight.assign(nNodes, 0.0);
+        nodeSplit.assign(nNodes, UINT_MAX);
+        nodeNumChildren.assign(nNodes, 0);
+        singleChildPos.resize(nNodes);
+
+        /* In an unrooted tree, the edges to the two children of a root of degree two display the same split. It is
+                reported once, for the first child (with the length of both edges). A root with one child is skipped, as
+                the edges above the first node with several children do not display splits. */
+        const NxsSimpleNode * splitRoot = root;
+        while (splitRoot->GetOutDegree() == 1 && splitRoot->GetTaxonIndex() == UINT_MAX)
+                splitRoot = splitRoot->GetFirstChild();
+        const NxsSimpleNode * firstRootChild = splitRoot->GetFirstChild();
+        const NxsSimpleNode * secondRootChild = NULL;
+        if (!treatAsRooted && firstRootChild && splitRoot->GetTaxonIndex() == UINT_MAX)
+                {
+                const NxsSimpleNode * c = firstRootChild->GetNextSib();
+                if (c && c->GetNextSib() == NULL)
+                        secondRootChild = c;
+                }
+        unsigned firstRootChildPos = UINT_MAX;
+        unsigned secondRootChildPos = UINT_MAX;
+
+        /* postorder: each node is complete when it is reached, and is then added to its parent */
+        for (unsigned i = nNodes; i-- > 1;)
+                {
+                const NxsSimpleNode * nd = nodes[i];
+                const unsigned t = nd->GetTaxonIndex();
+                NxsSplitWord * b = (nodeSlot[i] == UINT_MAX ? NULL : &bitsets[nodeSlot[i] * nWords]);
+                if (t != UINT_MAX)
+                        {
+                        if (b)
+                                SetTaxonBit(b, t);
+                        nodeHash[i] ^= NxsGetTaxonSplitHash(t);
+                        nodeNumTaxa[i] += 1;
+                        }
+                const unsigned p = parentPos[i];
+                NxsSplitWord * pb = &bitsets[nodeSlot[p] * nWords];
+                if (b)
+                        {
+                        for (unsigned w = 0; w < nWords; ++w)
+                                pb[w] |= b[w];
+                        }
+                else
+                        SetTaxonBit(pb, t);
+                nodeHash[p] ^= nodeHash[i];
+                nodeNumTaxa[p] += nodeNumTaxa[i];
+                const double edgeLen = nd->GetEdgeToParentRef().GetDblEdgeLen();
+                const double h = nodeHeight[i] + edgeLen;
+                if (h > nodeHeight[p])
+                        nodeHeight[p] = h;
+                nodeNumChildren[p] += 1;
+                singleChildPos[p] = i;
+
+                if (nd == firstRootChild)
+                        firstRootChildPos = i;
+                else if (nd == secondRootChild)
+                        secondRootChildPos = i;
+                if (nodeNumChildren[i] == 1 && t == UINT_MAX)
+                        {
+                        /* same split as its child */
+                        const unsigned s = nodeSplit[singleChildPos[i]];
+                        nodeSplit[i] = s;
+                        if (s != UINT_MAX)
+                                splitEdgeLens[s] += edgeLen;
+                        continue;
+                        }
+                const unsigned k = nodeNumTaxa[i];
+                if (k == 0 || k >= numTreeTaxa)
+                        continue; /* one side of the split is empty */
+                const unsigned smallerSide = (treatAsRooted ? k : std::min(k, numTreeTaxa - k));
+                if (smallerSide == 1 && !includeTrivial)
+                        continue;
+                uint64_t splitHash = nodeHash[i];
+                if (!treatAsRooted && HasTaxonBit(b, refTaxon))
+                        {
+                        for (unsigned w = 0; w < nWords; ++w)
+                                b[w] = treeTaxa[w] & ~b[w];
+                        splitHash ^= treeHash;
+                        }
+                nodeSplit[i] = (unsigned) splitSlots.size();
+                splitSlots.push_back(nodeSlot[i]);
+                splitHashes.push_back(splitHash);
+                splitEdgeLens.push_back(edgeLen);
+                splitHeights.push_back(nodeHeight[i]);
+                splitNodes.push_back(nd);
+                }
+        if (secondRootChild != NULL)
+                {
+                const unsigned s1 = nodeSplit[firstRootChildPos];
+                const unsigned s2 = nodeSplit[secondRootChildPos];
+                if (s1 != UINT_MAX && s2 != UINT_MAX)
+                        {
+                        splitEdgeLens[s1] += splitEdgeLens[s2];
+                        splitSlots.erase(splitSlots.begin() + s2);
+                        splitHashes.erase(splitHashes.begin() + s2);
+                        splitEdgeLens.erase(splitEdgeLens.begin() + s2);
+                        splitHeights.erase(splitHeights.begin() + s2);
+                        splitNodes.erase(splitNodes.begin() + s2);
+                        }
+                }
+        treeTaxaHash = treeHash;
+        /* the trivial splits are determined by the taxa, so they are left out of the topology hash */
+        topologyHash = MixSplitHash(~treeHash);
+        const unsigned nSplits = (unsigned) splitHashes.size();
+        for (unsigned s = 0; s < nSplits; ++s)
+                {
+                if (includeTrivial)
+                        {
+                        const unsigned k = NxsCountSplitTaxa(GetSplitWords(s), nWords);
+                        if (k < 2 || (!treatAsRooted && k + 2 > numTreeTaxa))
+                                continue;
+                        }
+                topologyHash += MixSplitHash(splitHashes[s]);
+                }
+        }
+
+void NxsRunningStats::Merge(const NxsRunningStats & other)
+        {
+        if (other.count == 0)
+                return;
+        if (count == 0)
+                {
+                *this = other;
+                return;
+                }
+        const double n = (double) count;
+        const double otherN = (double) other.count;
+        const double delta = other.mean - mean;
+        count += other.count;
+        mean += delta * otherN / (double) count;
+        sumSqDev += other.sumSqDev + delta * delta * n * otherN / (double) count;
+        if (other.minValue < minValue)
+                minValue = other.minValue;
+        if (other.maxValue > maxValue)
+                maxValue = other.maxValue;
+        }
+
+void NxsSplitInfo::Merge(const NxsSplitInfo & other)
+        {
+        nTimes += other.nTimes;
+        treeIndices.insert(treeIndices.end(), other.treeIndices.begin(), other.treeIndices.end());
+        edgeLens.insert(edgeLens.end(), other.edgeLens.begin(), other.edgeLens.end());
+        heights.insert(heights.end(), other.heights.begin(), other.heights.end());
+        edgeLenSummary.Merge(other.edgeLenSummary);
+        heightSummary.Merge(other.heightSummary);
+        }
+
+void NxsSplitTable::Reset(unsigned numTaxa)
+        {
+        nTax = numTaxa;
+        nWords = NxsGetNumSplitWords(numTaxa);
+        splitWords.clear();
+        splitHashes.clear();
+        splitInfo.clear();
+        buckets.assign(64, UINT_MAX);
+        }
+
+std::vector<unsigned> NxsSplitTable::GetTaxonIndices(unsigned splitIndex) const
+        {
+        std::vector<unsigned> inds;
+        const NxsSplitWord * words = GetSplitWords(splitIndex);
+        for (unsigned t = 0; t < nTax; ++t)
+                {
+                if (HasTaxonBit(words, t))
+                        inds.push_back(t);
+                }
+        return inds;
+        }
+
+bool NxsSplitTable::SplitEquals(unsigned splitIndex, const NxsSplitWord * words) const
+        {
+        const NxsSplitWord * s = GetSplitWords(splitIndex);
+        return std::equal(s, s + nWords, words);
+        }
+
+unsigned NxsSplitTable::FindSplit(const NxsSplitWord * words, uint64_t hash) const
+        {
+        const std::size_t mask = buckets.size() - 1;
+        for (std::size_t b = (std::size_t) hash & mask;; b = (b + 1) & mask)
+                {
+                const unsigned ind = buckets[b];
+                if (ind == UINT_MAX)
+                        return UINT_MAX;
+                if (splitHashes[ind] == hash && SplitEquals(ind, words))
+                        return ind;
+                }
+        }
+
+unsigned NxsSplitTable::InsertSplit(const NxsSplitWord * words, uint64_t hash)
+        {
+        std::size_t mask = buckets.size() - 1;
+        std::size_t b = (std::size_t) hash & mask;
+        for (;; b = (b + 1) & mask)
+                {
+                const unsigned ind = buckets[b];
+                if (ind == UINT_MAX)
+                        break;
+                if (splitHashes[ind] == hash && SplitEquals(ind, words))
+                        return ind;
+                }
+        const unsigned newInd = GetNumSplits();
+        splitWords.insert(splitWords.end(), words, words + nWords);
+        splitHashes.push_back(hash);
+        if (keepInfo)
+                splitInfo.push_back(NxsSplitInfo());
+        /* keep the load factor at or below 1/2 */
+        if (2 * (std::size_t) splitHashes.size() > buckets.size())
+                Rehash(2 * buckets.size());
+        else
+                buckets[b] = newInd;
+        return newInd;
+        }
+
+void NxsSplitTable::Rehash(std::size_t numBuckets)
+        {
+        buckets.assign(numBuckets, UINT_MAX);
+        const std::size_t mask = numBuckets - 1;
+        const unsigned n = GetNumSplits();
+        for (unsigned i = 0; i < n; ++i)
+                {
+                std::size_t b = (std::size_t) splitHashes[i] & mask;
+                while (buckets[b] != UINT_MAX)
+                        b = (b + 1) & mask;
+                buckets[b] = i;
+                }
+        }
+
+void NxsSplitTable::ThrowNoSplitInfo()
+        {
+        throw NxsNCLAPIException("NxsSplitInfo was requested from an NxsSplitTable that was created without it.");
+        }
+
+void NxsSplitTable::Merge(const NxsSplitTable & other)
+        {
+        if (other.nTax != nTax)
+                throw NxsNCLAPIException("Split tables for different numbers of taxa cannot be merged.");
+        if (keepInfo && !other.keepInfo)
+                ThrowNoSplitInfo();
+        const unsigned n = other.GetNumSplits();
+        for (unsigned i = 0; i < n; ++i)
+                {
+                const unsigned ind = InsertSplit(other.GetSplitWords(i), other.GetSplitHash(i));
+                if (keepInfo)
+                        splitInfo[ind].Merge(other.splitInfo[i]);
+                }
+        }
+
+void NxsSplitCounter::RecordTree(const NxsFullTreeDescription & ftd)
+        {
+        scratchTree.Initialize(ftd);
+        RecordTree(scratchTree);
+        }
+
+void NxsSplitCounter::RecordTree(const NxsSimpleTree & tree)
+        {
+        treeSplits.Extract(tree, table.GetNumTaxa(), treatAsRooted, trackTrivial);
+        RecordTreeSplits(treeSplits);
+        }
+
+void NxsSplitCounter::RecordTreeSplits(const NxsTreeSplits & splits)
+        {
+        if (splits.GetNumTaxa() != table.GetNumTaxa())
+                throw NxsNCLAPIException("The splits of a tree were extracted for a different number of taxa than the NxsSplitCounter holds.");
+        const unsigned n = splits.GetNumSplits();
+        for (unsigned i = 0; i < n; ++i)
+                {
+                const unsigned ind = table.InsertSplit(splits.GetSplitWords(i), splits.GetSplitHash(i));
+                NxsSplitInfo & info = table.GetSplitInfo(ind);
+                info.nTimes += 1;
+                if (trackOccurrence)
+                        info.treeIndices.push_back(nTrees);
+                const double el = splits.GetEdgeLen(i);
+                if (trackEdgeLen)
+                        info.edgeLens.push_back(el);
+                if (trackEdgeLenSummary)
+                        info.edgeLenSummary.Add(el);
+                const double h = splits.GetHeight(i);
+                if (trackHeight)
+                        info.heights.push_back(h);
+                if (trackHeightSummary)
+                        info.heightSummary.Add(h);
+                }
+        const NxsSplitWord * treeTaxa = splits.GetTreeTaxa();
+        for (unsigned w = 0; w < splits.GetNumWords(); ++w)
+                taxaInTrees[w] |= treeTaxa[w];
+        nTrees++;
+        }
+
+/*! Used by NxsSplitCounter::RecordTrees: worker i records a contiguous range of the trees with counters[i]. */
+class NxsSplitCountingWorker
+        {
+        public:
+                NxsSplitCountingWorker(const std::vector<NxsFullTreeDescription> & t, std::vector<NxsSplitCounter *> & c)
+                        :trees(t),
+                        counters(c)
+                        {}
+                void operator()(unsigned workerIndex, unsigned numWorkers)
+                        {
+                        const std::size_t n = trees.size();
+                        const std::size_t end = (n * (workerIndex + 1)) / numWorkers;
+                        for (std::size_t i = (n * workerIndex) / numWorkers; i < end; ++i)
+                                counters[workerIndex]->RecordTree(trees[i]);
+                        }
+        private:
+                const std::vector<NxsFullTreeDescription> & trees;
+                std::vector<NxsSplitCounter *> & counters;
+        };
+
+void NxsSplitCounter::RecordTrees(const std::vector<NxsFullTreeDescription> & trees, unsigned numThreads)
+        {
+        const unsigned nThreads = NxsChooseNumThreads(numThreads, (unsigned) trees.size());
+        if (nThreads < 2)
+                {
+                for (std::vector<NxsFullTreeDescription>::const_iterator tIt = trees.begin(); tIt != trees.end(); ++tIt)
+                        RecordTree(*tIt);
+                return;
+                }
+        std::vector<NxsSplitCounter *> counters(nThreads, (NxsSplitCounter *) 0L);
+        try
+                {
+                for (unsigned i = 0; i < nThreads; ++i)
+                        {
+                        NxsSplitCounter * c = new NxsSplitCounter(table.GetNumTaxa());
+                        counters[i] = c;
+                        c->nTrees = nTrees + (unsigned) ((trees.size() * i) / nThreads);
+                        c->treatAsRooted = treatAsRooted;
+                        c->trackTrivial = trackTrivial;
+                        c->trackOccurrence = trackOccurrence;
+                        c->trackEdgeLen = trackEdgeLen;
+                        c->trackEdgeLenSummary = trackEdgeLenSummary;
+                        c->trackHeight = trackHeight;
+                        c->trackHeightSummary = trackHeightSummary;
+                        }
+                NxsSplitCountingWorker worker(trees, counters);
+                NxsRunWorkers(worker, nThreads);
+                for (unsigned i = 0; i < nThreads; ++i)
+                        {
+                        table.Merge(counters[i]->table);
+                        for (unsigned w = 0; w < taxaInTrees.size(); ++w)
+                                taxaInTrees[w] |= counters[i]->taxaInTrees[w];
+                        }
+                }
+        catch (...)
+                {
+                for (unsigned i = 0; i < nThreads; ++i)
+                        delete counters[i];
+                throw;
+                }
+        for (unsigned i = 0; i < nThreads; ++i)
+                delete counters[i];
+        nTrees += (unsigned) trees.size();
+        }
@@ -0,0 +1,474 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSSPLITS_H
+#define NCL_NXSSPLITS_H
+
+#include <climits>
+#include <stdint.h>
+#include <vector>
+#include "ncl/nxsdefs.h"
+#include "ncl/nxstreesblock.h"
+
+/*! Splits (the sets of taxa below the edges of a tree) are stored as bitsets of a fixed number of words: taxon `i`
+        is bit (i % 64) of word (i / 64). Bits for taxon indices that are not in the split (including those beyond the
+        number of taxa) are 0.
+*/
+typedef uint64_t NxsSplitWord;
+
+/*! \returns the number of NxsSplitWord values used to store a split of `nTax` taxa */
+inline unsigned NxsGetNumSplitWords(unsigned nTax)
+        {
+        return (nTax + 63) / 64;
+        }
+
+/*! \returns the number of taxa in the split stored in the `nWords` words at `words` */
+inline unsigned NxsCountSplitTaxa(const NxsSplitWord * words, unsigned nWords)
+        {
+        unsigned n = 0;
+        for (unsigned w = 0; w < nWords; ++w)
+                {
+#                if defined(__GNUC__)
+                        n += (unsigned) __builtin_popcountll(words[w]);
+#                else
+                        for (NxsSplitWord x = words[w]; x != 0; x &= x - 1)
+                                n++;
+#                endif
+                }
+        return n;
+        }
+
+/*! \returns the 64-bit hash of the split that contains only taxon `taxonIndex`.
+
+        The hash of a split is the exclusive-or of the hashes of its taxa, so the hash of the union of disjoint splits
+        (and of the complement of a split) can be computed from the hashes of the parts.
+*/
+inline uint64_t NxsGetTaxonSplitHash(unsigned taxonIndex)
+        {
+        /* splitmix64 finalizer */
+        uint64_t z = ((uint64_t) taxonIndex + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+        }
+
+/*! \returns the hash of the split stored in the `nWords` words at `words` (see NxsGetTaxonSplitHash) */
+uint64_t NxsCalcSplitHash(const NxsSplitWord * words, unsigned nWords);
+
+/*! The splits of one tree.
+
+        Extract computes the bitset of every node of a NxsSimpleTree in one postorder pass, in which each node's
+        bitset and hash are added to those of its parent. Nodes with one child (whose split is the same as the child's)
+        and the root are not reported, and unless `includeTrivial` is true neither are splits that hold a single taxon.
+
+        If `treatAsRooted` is false, the splits are canonicalized so that they can be compared between trees with
+        different roots: the side of the split that does not contain the lowest-numbered taxon of the tree is reported.
+        Splits that separate fewer than two taxa from the rest of the tree are trivial, and if the root has two children
+        (the usual form of a rooted newick string) the two edges at the root are reported as one split.
+
+        An NxsTreeSplits object keeps its buffers between calls to Extract, so extracting the splits of many trees with
+        one object does not allocate memory after the largest tree has been seen.
+*/
+class NxsTreeSplits
+        {
+        public:
+                NxsTreeSplits()
+                        :nTax(0),
+                        nWords(0),
+                        treeTaxaHash(0),
+                        topologyHash(0)
+                        {}
+                /*! Replaces the splits with those of `tree`. `nTax` is the number of taxa that the taxon indices of the
+                        tree refer to. Raises an NxsNCLAPIException if a leaf does not have a taxon index that is less than `nTax`.
+                */
+                void Extract(const NxsSimpleTree & tree, unsigned nTax, bool treatAsRooted, bool includeTrivial = false);
+
+                unsigned GetNumTaxa() const
+                        {
+                        return nTax;
+                        }
+                unsigned GetNumWords() const
+                        {
+                        return nWords;
+                        }
+                unsigned GetNumSplits() const
+                        {
+                        return (unsigned) splitSlots.size();
+                        }
+                const NxsSplitWord * GetSplitWords(unsigned splitIndex) const
+                        {
+                        return &bitsets[splitSlots[splitIndex] * nWords];
+                        }
+                uint64_t GetSplitHash(unsigned splitIndex) const
+                        {
+                        return splitHashes[splitIndex];
+                        }
+                /*! \returns the length of the edge that displays the split (the sum of the edge lengths if it is displayed by
+                        a path of edges through nodes of degree two).
+                */
+                double GetEdgeLen(unsigned splitIndex) const
+                        {
+                        return splitEdgeLens[splitIndex];
+                        }
+                /*! \returns the height of the node below the split (the longest path to a leaf below the node) */
+                double GetHeight(unsigned splitIndex) const
+                        {
+                        return splitHeights[splitIndex];
+                        }
+                /*! \returns the node below the edge that displays the split (the lowest node if there are several) */
+                const NxsSimpleNode * GetNode(unsigned splitIndex) const
+                        {
+                        return splitNodes[splitIndex];
+                        }
+                /*! \returns the bitset of the taxa of the tree (GetNumWords() words) */
+                const NxsSplitWord * GetTreeTaxa() const
+                        {
+                        return (treeTaxa.empty() ? (const NxsSplitWord *) 0L : &treeTaxa[0]);
+                        }
+                /*! \returns the hash of the set of taxa of the tree (see NxsGetTaxonSplitHash) */
+                uint64_t GetTreeTaxaHash() const
+                        {
+                        return treeTaxaHash;
+                        }
+                /*! \returns a hash of the topology of the tree, which is computed from the taxa of the tree and the
+                        hashes of its non-trivial splits. Trees that have the same taxa and the same splits have the same
+                        hash, whatever the order of the children of their nodes, and (unless the splits were extracted with
+                        `treatAsRooted` set to true) wherever they are rooted. Edge lengths and node names are ignored.
+                        Different topologies have different hashes with high probability, see NxsTopologyTable for an exact
+                        comparison.
+                */
+                uint64_t GetTopologyHash() const
+                        {
+                        return topologyHash;
+                        }
+        private:
+                unsigned nTax;
+                unsigned nWords;
+                std::vector<NxsSplitWord> bitsets; /* one bitset of nWords words for each node that has a slot */
+                /* per node (in preorder) scratch */
+                std::vector<const NxsSimpleNode *> nodes;
+                std::vector<unsigned> parentPos;
+                std::vector<unsigned> nodeSlot;
+                std::vector<unsigned> nodeNumTaxa;
+                std::vector<uint64_t> nodeHash;
+                std::vector<double> nodeHeight;
+                std::vector<unsigned> nodeSplit; /* index of the split reported for the node (UINT_MAX for none) */
+                std::vector<unsigned> singleChildPos; /* position of a child of the node (used for nodes with one child) */
+                std::vector<unsigned> nodeNumChildren;
+                std::vector<NxsSplitWord> treeTaxa;
+                std::vector<std::pair<const NxsSimpleNode *, unsigned> > toVisit;
+                /* the reported splits */
+                std::vector<unsigned> splitSlots;
+                std::vector<uint64_t> splitHashes;
+                std::vector<double> splitEdgeLens;
+                std::vector<double> splitHeights;
+                std::vector<const NxsSimpleNode *> splitNodes;
+                uint64_t treeTaxaHash;
+                uint64_t topologyHash;
+        };
+
+/*! The count, mean, variance and range of a stream of values.
+
+        The mean and the sum of squared deviations from the mean are updated with each value (Welford's method), so
+        the variance does not suffer from the cancellation of a sum of squares. Two summaries can be merged into the
+        summary of the combined values.
+*/
+class NxsRunningStats
+        {
+        public:
+                NxsRunningStats()
+                        :count(0),
+                        mean(0.0),
+                        sumSqDev(0.0),
+                        minValue(0.0),
+                        maxValue(0.0)
+                        {}
+                void Add(double x)
+                        {
+                        count++;
+                        const double delta = x - mean;
+                        mean += delta / (double) count;
+                        sumSqDev += delta * (x - mean);
+                        if (count == 1 || x < minValue)
+                                minValue = x;
+                        if (count == 1 || x > maxValue)
+                                maxValue = x;
+                        }
+                void Merge(const NxsRunningStats & other);
+
+                unsigned long GetCount() const
+                        {
+                        return count;
+                        }
+                double GetMean() const
+                        {
+                        return mean;
+                        }
+                double GetSum() const
+                        {
+                        return mean * (double) count;
+                        }
+                /*! \returns the sample variance (0 if there are fewer than 2 values) */
+                double GetVariance() const
+                        {
+                        return (count < 2 ? 0.0 : sumSqDev / (double) (count - 1));
+                        }
+                double GetMin() const
+                        {
+                        return minValue;
+                        }
+                double GetMax() const
+                        {
+                        return maxValue;
+                        }
+        private:
+                unsigned long count;
+                double mean;
+                double sumSqDev;
+                double minValue;
+                double maxValue;
+        };
+
+/*! The data that are recorded (by NxsSplitCounter) for each occurrence of a split. Which fields are filled depends on
+        the tracking options of the NxsSplitCounter.
+*/
+class NxsSplitInfo
+        {
+        public:
+                NxsSplitInfo()
+                        :nTimes(0)
+                        {}
+                /*! Adds the occurrences recorded in `other` (which must be for later trees) */
+                void Merge(const NxsSplitInfo & other);
+
+                unsigned nTimes; /* the number of trees that have the split */
+                std::vector<unsigned> treeIndices; /* the indices of the trees that have the split */
+                std::vector<double> edgeLens;
+                std::vector<double> heights;
+                NxsRunningStats edgeLenSummary;
+                NxsRunningStats heightSummary;
+        };
+
+/*! A hash table of distinct splits (with an NxsSplitInfo for each split).
+
+        The splits are numbered in the order in which they were inserted. Their bitsets are stored contiguously, and
+        the table is indexed with open addressing on the 64-bit split hashes, so a lookup compares the full bitsets of
+        a split only when the hashes are equal.
+
+        A table created with `keepSplitInfo` set to false only stores the splits, which saves the memory of an
+        NxsSplitInfo for each split. GetSplitInfo raises an NxsNCLAPIException for such a table, and it can only be
+        merged with tables that do not keep their NxsSplitInfo either.
+*/
+class NxsSplitTable
+        {
+        public:
+                NxsSplitTable(unsigned numTaxa = 0, bool keepSplitInfo = true)
+                        :keepInfo(keepSplitInfo)
+                        {
+                        Reset(numTaxa);
+                        }
+                /*! Removes all splits, and sets the number of taxa to `numTaxa` */
+                void Reset(unsigned numTaxa);
+
+                unsigned GetNumTaxa() const
+                        {
+                        return nTax;
+                        }
+                unsigned GetNumWords() const
+                        {
+                        return nWords;
+                        }
+                unsigned GetNumSplits() const
+                        {
+                        return (unsigned) splitHashes.size();
+                        }
+                const NxsSplitWord * GetSplitWords(unsigned splitIndex) const
+                        {
+                        return &splitWords[splitIndex * nWords];
+                        }
+                uint64_t GetSplitHash(unsigned splitIndex) const
+                        {
+                        return splitHashes[splitIndex];
+                        }
+                bool KeepsSplitInfo() const
+                        {
+                        return keepInfo;
+                        }
+                NxsSplitInfo & GetSplitInfo(unsigned splitIndex)
+                        {
+                        if (!keepInfo)
+                                ThrowNoSplitInfo();
+                        return splitInfo[splitIndex];
+                        }
+                const NxsSplitInfo & GetSplitInfo(unsigned splitIndex) const
+                        {
+                        if (!keepInfo)
+                                ThrowNoSplitInfo();
+                        return splitInfo[splitIndex];
+                        }
+                /*! \returns the indices of the taxa in split `splitIndex` (in increasing order) */
+                std::vector<unsigned> GetTaxonIndices(unsigned splitIndex) const;
+                /*! \returns the index of the split stored in `words` (with hash `hash`), or UINT_MAX if the table does not
+                        hold it.
+                */
+                unsigned FindSplit(const NxsSplitWord * words, uint64_t hash) const;
+                /*! \returns the index of the split stored in `words` (with hash `hash`), adding it to the table (with an
+                        empty NxsSplitInfo) if it is not there.
+                */
+                unsigned InsertSplit(const NxsSplitWord * words, uint64_t hash);
+                /*! Adds the splits of `other` (which must be for the same number of taxa, and must keep NxsSplitInfo if
+                        this table does) to the table, merging the NxsSplitInfo of the splits that are in both tables. The
+                        splits of `other` that are not in this table are added in the order of their indices in `other`.
+                */
+                void Merge(const NxsSplitTable & other);
+        private:
+                static void ThrowNoSplitInfo();
+                bool SplitEquals(unsigned splitIndex, const NxsSplitWord * words) const;
+                void Rehash(std::size_t numBuckets);
+
+                unsigned nTax;
+                unsigned nWords;
+                std::vector<NxsSplitWord> splitWords;
+                std::vector<uint64_t> splitHashes;
+                std::vector<NxsSplitInfo> splitInfo;
+                std::vector<unsigned> buckets; /* split indices (UINT_MAX for empty buckets), the size is a power of 2 */
+                bool keepInfo;
+        };
+
+/*! Counts the splits of a collection of trees (for example, the trees sampled by an MCMC run).
+
+        Each recorded tree is given the next tree index (starting at 0). By default only the number of trees that have
+        each split is recorded; the Set...Tracking functions add data to the NxsSplitInfo of each split.
+*/
+class NxsSplitCounter
+        {
+        public:
+                NxsSplitCounter(unsigned numTaxa)
+                        :table(numTaxa),
+                        taxaInTrees(NxsGetNumSplitWords(numTaxa), 0),
+                        scratchTree(0, 0.0),
+                        nTrees(0),
+                        treatAsRooted(false),
+                        trackTrivial(false),
+                        trackOccurrence(false),
+                        trackEdgeLen(false),
+                        trackEdgeLenSummary(false),
+                        trackHeight(false),
+                        trackHeightSummary(false)
+                        {
+                        /* the comments of the trees are not used */
+                        scratchTree.SetParseCommentsLazily(true);
+                        }
+                /*! Records the splits of `ftd` (which must be processed). */
+                void RecordTree(const NxsFullTreeDescription & ftd);
+                /*! Records the splits of `tree` */
+                void RecordTree(const NxsSimpleTree & tree);
+                /*! Records splits that were extracted from a tree (`splits` must have been extracted for the number of
+                        taxa of the table, with the rooting and trivial-split options of this counter).
+                */
+                void RecordTreeSplits(const NxsTreeSplits & splits);
+                /*! Records the splits of the `trees` (which must be processed), using `numThreads` threads (0 means one
+                        thread per hardware thread).
+
+                        Each thread counts the splits of a contiguous range of the trees in its own NxsSplitTable, and the
+                        tables are merged in the order of the trees. So the split indices, tree indices and lists of
+                        edge lengths and heights are the same as if the trees had been recorded one at a time (the
+                        summaries can differ in the last bits, because the values are added in a different order).
+                */
+                void RecordTrees(const std::vector<NxsFullTreeDescription> & trees, unsigned numThreads = 0);
+
+                unsigned GetNumTrees() const
+                        {
+                        return nTrees;
+                        }
+                const NxsSplitTable & GetSplitTable() const
+                        {
+                        return table;
+                        }
+                /*! \returns the bitset of the taxa that occur in any of the recorded trees */
+                const std::vector<NxsSplitWord> & GetTaxaInTrees() const
+                        {
+                        return taxaInTrees;
+                        }
+                /*! If true, the splits are clusters of a rooted tree (see NxsTreeSplits). Default false. */
+                void SetTreatAsRooted(bool v)
+                        {
+                        treatAsRooted = v;
+                        }
+                bool GetTreatAsRooted() const
+                        {
+                        return treatAsRooted;
+                        }
+                /*! If true, splits that hold a single taxon are recorded. Default false. */
+                void SetTrackTrivial(bool v)
+                        {
+                        trackTrivial = v;
+                        }
+                bool GetTrackTrivial() const
+                        {
+                        return trackTrivial;
+                        }
+                /*! If true, NxsSplitInfo::treeIndices is filled. Default false. */
+                void SetTrackOccurrence(bool v)
+                        {
+                        trackOccurrence = v;
+                        }
+                /*! If true, NxsSplitInfo::edgeLens is filled. Default false. */
+                void SetTrackEdgeLen(bool v)
+                        {
+                        trackEdgeLen = v;
+                        }
+                /*! If true, NxsSplitInfo::edgeLenSummary is filled. Default false. */
+                void SetTrackEdgeLenSummary(bool v)
+                        {
+                        trackEdgeLenSummary = v;
+                        }
+                bool GetTrackEdgeLenSummary() const
+                        {
+                        return trackEdgeLenSummary;
+                        }
+                /*! If true, NxsSplitInfo::heights is filled. Default false. */
+                void SetTrackHeight(bool v)
+                        {
+                        trackHeight = v;
+                        }
+                /*! If true, NxsSplitInfo::heightSummary is filled. Default false. */
+                void SetTrackHeightSummary(bool v)
+                        {
+                        trackHeightSummary = v;
+                        }
+        private:
+                NxsSplitCounter(const NxsSplitCounter &); /** don't define, not copyable*/
+                NxsSplitCounter & operator=(const NxsSplitCounter &); /** don't define, not copyable*/
+
+                NxsSplitTable table;
+                std::vector<NxsSplitWord> taxaInTrees;
+                NxsTreeSplits treeSplits;
+                NxsSimpleTree scratchTree;
+                unsigned nTrees;
+                bool treatAsRooted;
+                bool trackTrivial;
+                bool trackOccurrence;
+                bool trackEdgeLen;
+                bool trackEdgeLenSummary;
+                bool trackHeight;
+                bool trackHeightSummary;
+        };
+
+#endif
@@ -24,8 +24,142 @@
 #include "ncl/nxsdefs.h"
 #include "ncl/nxsstring.h"
 
+#if __cplusplus >= 201703L && !defined(NCL_NO_FROM_CHARS)
+#        include <charconv>
+#        if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#                define NCL_HAS_FROM_CHARS_DOUBLE
+#        endif
+#endif
+
 using namespace std;
 
+/*----------------------------------------------------------------------------------------------------------------------
+|        Helpers for NxsString::to_long and NxsString::to_double. Numbers in NEXUS files are nearly always short decimal
+|        strings, so these functions convert the common cases directly (without the locale lookups done by strtol and
+|        strtod). Anything unusual (overflow, hexadecimal, inf, nan, more than 19 significant digits...) is left to the
+|        C library so that the results are always identical to the strtol/strtod results.
+*/
+namespace
+{
+/* Returns true and sets *n if `o` is an optional sign followed by decimal digits that fit in a long. */
+bool fastDecimalToLong(const char *o, long *n)
+        {
+        const char * p = o;
+        const bool negative = (*p == '-');
+        if (*p == '-' || *p == '+')
+                ++p;
+        if (*p < '0' || *p > '9')
+                return false;
+        unsigned long v = 0;
+        const unsigned long maxBeforeMult = ((unsigned long) LONG_MAX) / 10;
+        for (; *p >= '0' && *p <= '9'; ++p)
+                {
+                const unsigned d = (unsigned) (*p - '0');
+                if (v > maxBeforeMult || v * 10 > ((unsigned long) LONG_MAX) - d)
+                        return false;
+                v = 10 * v + d;
+                }
+        if (*p != '\0')
+                return false;
+        *n = (negative ? -((long) v) : (long) v);
+        return true;
+        }
+
+/* The powers of ten that are exactly representable as doubles */
+const double kExactPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Returns true and sets *n if `o` is a plain decimal number ([+-]digits[.digits][(e|E)[+-]digits]) that can be
+|        converted with correct rounding here.
+|        When the significand has at most 15 digits and the power of ten is exactly representable, a single IEEE
+|        multiplication or division gives the correctly rounded result (Clinger's fast path). Other decimal strings are
+|        converted with std::from_chars when the standard library provides it (it is also correctly rounded and does
+|        not depend on the locale).
+*/
+bool fastDecimalToDouble(const char *o, double *n)
+        {
+        const char * p = o;
+        const bool negative = (*p == '-');
+        if (*p == '-' || *p == '+')
+                ++p;
+        const char * const numStart = p;
+        unsigned long long significand = 0;
+        int nSigDigits = 0;
+        int exp10 = 0;
+        bool anyDigits = false;
+        for (; *p >= '0' && *p <= '9'; ++p)
+                {
+                anyDigits = true;
+                if (significand == 0 && *p == '0')
+                        continue;
+                if (nSigDigits < 19)
+                        significand = 10 * significand + (unsigned)(*p - '0');
+                else
+                        ++exp10;
+                ++nSigDigits;
+                }
+        if (*p == '.')
+                {
+                for (++p; *p >= '0' && *p <= '9'; ++p)
+                        {
+                        anyDigits = true;
+                        if (significand == 0 && *p == '0')
+                                {
+                                --exp10;
+                                continue;
+                                }
+                        if (nSigDigits < 19)
+                                {
+                                significand = 10 * significand + (unsigned)(*p - '0');
+                                --exp10;
+                                }
+                        ++nSigDigits;
+                        }
+                }
+        if (!anyDigits)
+                return false;
+        if (*p == 'e' || *p == 'E')
+                {
+                ++p;
+                const bool negExp = (*p == '-');
+                if (*p == '-' || *p == '+')
+                        ++p;
+                if (*p < '0' || *p > '9')
+                        return false;
+                int e = 0;
+                for (; *p >= '0' && *p <= '9'; ++p)
+                        {
+                        if (e > 100000)
+                                return false;
+                        e = 10 * e + (*p - '0');
+                        }
+                exp10 += (negExp ? -e : e);
+                }
+        if (*p != '\0')
+                return false;
+        double v;
+        if (significand == 0)
+                v = 0.0;
+#        if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+        else if (nSigDigits <= 15 && exp10 >= -22 && exp10 <= 22)
+                v = (exp10 < 0 ? ((double) significand) / kExactPowersOfTen[-exp10] : ((double) significand) * kExactPowersOfTen[exp10]);
+#        endif
+        else
+                {
+#                if defined(NCL_HAS_FROM_CHARS_DOUBLE)
+                        const std::from_chars_result r = std::from_chars(numStart, p, v);
+                        if (r.ec != std::errc() || r.ptr != p)
+                                return false; /* out of range. strtod decides what to return */
+#                else
+                        return false;
+#                endif
+                }
+        *n = (negative ? -v : v);
+        return true;
+        }
+} // anonymous namespace
+
 // splits a string by whitespace and push the graphical strings to the back of r.
 //        Leading and trailing whitespace is lost ( there will be no empty strings added
 //                to the list.
@@ -139,6 +273,13 @@ bool NxsString::to_long(const char *o, long *n)
                 return false;
         if (strchr("0123456789-+",*o) != NULL) // strtol skips leading whitespace, but we don't  do that in
                 {
+                long fastValue;
+                if (fastDecimalToLong(o, &fastValue))
+                        {
+                        if (n != NULL)
+                                *n = fastValue;
+                        return true;
+                        }
                 char * pEnd;
                 const long i = strtol (o, &pEnd, 10);
                 if (*pEnd != '\0')
@@ -153,6 +294,8 @@ bool NxsString::to_long(const char *o, long *n)
 /*!
         Returns true if `o` points to a string that represents a double (and `o` has no other characters than the long).
         if n is not NULL, then when the function returns true, *n will be the long.
+        Plain decimal numbers are converted without using the C locale (so '.' is always the decimal point), and the
+        result is always the correctly rounded double (identical to the value strtod returns in the "C" locale).
 */
 bool NxsString::to_double(const char *o, double *n)
         {
@@ -160,6 +303,13 @@ bool NxsString::to_double(const char *o, double *n)
                 return false;
         if (strchr("0123456789-.+",*o) != NULL ) // strtol skips leading whitespace, but we don't  do that in
                 {
+                double fastValue;
+                if (fastDecimalToDouble(o, &fastValue))
+                        {
+                        if (n != NULL)
+                                *n = fastValue;
+                        return true;
+                        }
                 char * pEnd;
                 const double i = strtod (o, &pEnd);
                 if (*pEnd != '\0')
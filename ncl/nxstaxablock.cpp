@@ -49,6 +49,18 @@ std::vector<std::string> NxsTaxaBlockAPI::GetAllLabels() const
         return v;
         }
 
+const std::vector<std::string> & NxsGetEscapedTaxonLabels(const NxsTaxaBlockAPI & taxa, std::vector<std::string> & storage)
+        {
+        const NxsTaxaBlock * taxaBlock = dynamic_cast<const NxsTaxaBlock *>(&taxa);
+        if (taxaBlock != NULL)
+                return taxaBlock->GetEscapedLabels();
+        const unsigned n = taxa.GetNTaxTotal();
+        storage.resize(n);
+        for (unsigned i = 0; i < n; ++i)
+                storage[i] = NxsString::GetEscaped(taxa.GetTaxonLabel(i));
+        return storage;
+        }
+
 /* \returns a 1-based number of the taxon with label of `label` (not case-sensitive).
         This is a low-level function not intended for widespread use (it is faster way to
         query the label list because it does not throw exceptions or do the numeric interpretation
@@ -106,6 +118,7 @@ bool NxsTaxaBlock::AddNewPartition(const std::string &label, const NxsPartition
 NxsTaxaBlock::NxsTaxaBlock()
           {
         dimNTax        = 0;
+        escapedLabelsCached = false;
         NCL_BLOCKTYPE_ATTR_NAME                = "TAXA";
         }
 
@@ -147,6 +160,7 @@ void NxsTaxaBlock::Read(
                                         }
                                 DemandEquals(token, "after NTAX");
                                 dimNTax = DemandPositiveInt(token, "NTAX");
+                                InvalidateEscapedLabels();
                                 taxLabels.reserve(dimNTax);
                                 DemandEndSemicolon(token, "DIMENSIONS");
                                 }        // if (token.Equals("DIMENSIONS"))
@@ -171,6 +185,7 @@ void NxsTaxaBlock::HandleTaxLabels(NxsToken &token)
                 }
         taxLabels.clear();
         labelToIndex.clear();
+        InvalidateEscapedLabels();
         for (unsigned i = 0; i < dimNTax; i++)
                 {
                 token.GetNextToken();
@@ -234,6 +249,19 @@ void NxsTaxaBlock::WriteTaxLabelsCommand(std::ostream &out) const
                 }
         }
 
+const std::vector<std::string> & NxsTaxaBlock::GetEscapedLabels() const
+        {
+        if (!escapedLabelsCached)
+                {
+                const unsigned n = GetNTaxTotal();
+                escapedLabels.resize(n);
+                for (unsigned i = 0; i < n; ++i)
+                        escapedLabels[i] = NxsString::GetEscaped(GetTaxonLabel(i));
+                escapedLabelsCached = true;
+                }
+        return escapedLabels;
+        }
+
 /* Flushes taxonLabels and sets dimNTax to 0 in preparation for reading a new TAXA block.
 */
 void NxsTaxaBlock::Reset()
@@ -242,6 +270,7 @@ void NxsTaxaBlock::Reset()
         taxLabels.clear();
         labelToIndex.clear();
         dimNTax = 0;
+        InvalidateEscapedLabels();
         inactiveTaxa.clear();
         taxSets.clear();
         taxPartitions.clear();
@@ -261,6 +290,7 @@ unsigned NxsTaxaBlock::AddTaxonLabel(
         CheckCapitalizedTaxonLabel(x);
         taxLabels.push_back(s);
         labelToIndex[x] = ind;
+        InvalidateEscapedLabels();
         return ind;
         }
 
@@ -319,6 +349,7 @@ void NxsTaxaBlock::RemoveTaxonLabel(
         NxsString::to_upper(oldLabel);
         labelToIndex.erase(oldLabel);
         taxLabels[i] = NxsString();
+        InvalidateEscapedLabels();
         }
 
 /* Returns the length of the longest taxon label stored. Useful for formatting purposes in outputting the data matrix
@@ -399,6 +430,7 @@ void NxsTaxaBlock::SetNtax(
   unsigned n)        /* the number of taxa */
         {
         dimNTax = n;
+        InvalidateEscapedLabels();
         if (taxLabels.size() > dimNTax)
                 {
                 for (unsigned i = dimNTax; i < taxLabels.size(); i++)
@@ -486,7 +518,7 @@ void NxsTaxaBlockSurrogate::HandleLinkTaxaCommand(NxsToken & token)
                                 SetTaxaBlockPtr(cb, NxsBlock::BLOCK_LINK_FROM_LINK_CMD);
                                 }
                         }
-                else
+                else if (nxsReader && nxsReader->ShouldReportWarning(NxsReader::SKIPPING_CONTENT_WARNING))
                         {
                         NxsString errormsg = "Skipping unknown LINK subcommand: ";
                         errormsg += pairIt->first.c_str();
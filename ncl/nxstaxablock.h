@@ -183,6 +183,12 @@ class NxsTaxaBlock
                 class NxsX_NoSuchTaxon {};        /* thrown if FindTaxon cannot locate a supplied taxon label in the taxLabels vector */
 
                 void                                 WriteTaxLabelsCommand(std::ostream &out) const;
+                /*! \returns the labels of all of the taxa in the form used when writing NEXUS (quoted, or with
+                        underscores for spaces, if necessary). The escaped labels are cached by the block until its
+                        labels change, so writers do not escape a label every time that it is written.
+                        The cache is filled by the first call, which should not run concurrently with other calls.
+                */
+                const std::vector<std::string> & GetEscapedLabels() const;
 
                 unsigned GetMaxIndex() const;
                 unsigned GetNumLabelsCurrentlyStored() const;
@@ -198,6 +204,7 @@ class NxsTaxaBlock
                         {
                         while (dimNTax <= taxLabels.size())
                                 dimNTax++;
+                        InvalidateEscapedLabels();
                         return AddTaxonLabel(label);
                         }
 
@@ -211,6 +218,7 @@ class NxsTaxaBlock
 
                 void CopyTaxaContents(const NxsTaxaBlock &other)
                         {
+                        InvalidateEscapedLabels();
                         taxLabels = other.taxLabels;
                         labelToIndex = other.labelToIndex;
                         dimNTax = other.dimNTax;
@@ -231,13 +239,26 @@ class NxsTaxaBlock
                 NxsUnsignedSetMap taxSets;
                 NxsPartitionsByName taxPartitions;
                 std::set<unsigned> inactiveTaxa;
+                mutable std::vector<std::string> escapedLabels; /* cache for GetEscapedLabels */
+                mutable bool escapedLabelsCached;
 
                 virtual void         Read(NxsToken &token);
                 void CheckCapitalizedTaxonLabel(const std::string &s) const;
                 unsigned CapitalizedTaxLabelToNumber(const std::string & s) const;
                 void                         RemoveTaxonLabel(unsigned taxInd);
+                /*! Must be called by subclasses that change taxLabels or dimNTax directly. */
+                void InvalidateEscapedLabels()
+                        {
+                        escapedLabelsCached = false;
+                        }
         };
 
+/*! \returns the labels of all of the taxa of `taxa` in the form used when writing NEXUS (see
+        NxsTaxaBlock::GetEscapedLabels). The cached labels are returned if `taxa` is a NxsTaxaBlock; the labels of other
+        implementations of NxsTaxaBlockAPI are escaped into `storage`.
+*/
+const std::vector<std::string> & NxsGetEscapedTaxonLabels(const NxsTaxaBlockAPI & taxa, std::vector<std::string> & storage);
+
 
 /*! This class is the base class for blocks that can (in a pinch) serve as
 a TAXA block reader(NxsCharactersBlock, NxsTreesBlock, NxsUnalignedBlock, and NxsDistancesBlock)
@@ -0,0 +1,212 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include "ncl/nxstopologies.h"
+
+namespace
+{
+/* orders topology indices by decreasing number of trees */
+class MoreFrequentTopology
+        {
+        public:
+                MoreFrequentTopology(const std::vector<NxsTopologyInfo> & info)
+                        :topologyInfo(info)
+                        {}
+                bool operator()(unsigned a, unsigned b) const
+                        {
+                        return topologyInfo[a].nTimes > topologyInfo[b].nTimes;
+                        }
+        private:
+                const std::vector<NxsTopologyInfo> & topologyInfo;
+        };
+} // anonymous namespace
+
+NxsTopologyTable::NxsTopologyTable(unsigned numTaxa, bool rooted)
+        :splitTable(numTaxa, false),
+        taxonSets(numTaxa, false),
+        scratchTree(0, 0.0),
+        topologyStarts(1, 0),
+        buckets(64, UINT_MAX),
+        nTrees(0),
+        treatAsRooted(rooted),
+        trackOccurrence(false),
+        keepDescriptions(false)
+        {
+        /* the comments of the trees are not used */
+        scratchTree.SetParseCommentsLazily(true);
+        }
+
+unsigned NxsTopologyTable::RecordTree(const NxsFullTreeDescription & ftd)
+        {
+        scratchTree.Initialize(ftd);
+        treeSplits.Extract(scratchTree, GetNumTaxa(), treatAsRooted);
+        return Record(treeSplits, &ftd);
+        }
+
+unsigned NxsTopologyTable::RecordTree(const NxsSimpleTree & tree)
+        {
+        treeSplits.Extract(tree, GetNumTaxa(), treatAsRooted);
+        return Record(treeSplits, NULL);
+        }
+
+unsigned NxsTopologyTable::RecordTreeSplits(const NxsTreeSplits & splits)
+        {
+        return Record(splits, NULL);
+        }
+
+void NxsTopologyTable::RecordTrees(const std::vector<NxsFullTreeDescription> & trees)
+        {
+        for (std::vector<NxsFullTreeDescription>::const_iterator tIt = trees.begin(); tIt != trees.end(); ++tIt)
+                RecordTree(*tIt);
+        }
+
+void NxsTopologyTable::ConsumeTree(const NxsFullTreeDescription & treeDesc, const NxsSimpleTree * tree, NxsTreesBlock & treesBlock)
+        {
+        if (nTrees == 0 && GetNumTaxa() == 0)
+                {
+                const NxsTaxaBlockAPI * taxa = treesBlock.GetTaxaBlockPtr(NULL);
+                if (taxa != NULL)
+                        {
+                        splitTable.Reset(taxa->GetNTax());
+                        taxonSets.Reset(taxa->GetNTax());
+                        }
+                }
+        if (tree != NULL)
+                {
+                treeSplits.Extract(*tree, GetNumTaxa(), treatAsRooted);
+                Record(treeSplits, &treeDesc);
+                }
+        else if (treeDesc.IsProcessed())
+                RecordTree(treeDesc);
+        else
+                {
+                NxsFullTreeDescription processed(treeDesc);
+                treesBlock.ProcessTree(processed);
+                RecordTree(processed);
+                }
+        }
+
+unsigned NxsTopologyTable::Record(const NxsTreeSplits & splits, const NxsFullTreeDescription * ftd)
+        {
+        if (splits.GetNumTaxa() != GetNumTaxa())
+                throw NxsNCLAPIException("The splits of a tree were extracted for a different number of taxa than the NxsTopologyTable holds.");
+        const unsigned nSplits = splits.GetNumSplits();
+        const NxsSplitWord * treeTaxa = splits.GetTreeTaxa();
+        if (treeTaxa == NULL)
+                throw NxsNCLAPIException("A tree without taxa cannot be recorded in a NxsTopologyTable.");
+        /* the topology can only be in the table if all of its splits are */
+        scratchKey.clear();
+        unsigned ind = taxonSets.FindSplit(treeTaxa, splits.GetTreeTaxaHash());
+        bool known = (ind != UINT_MAX);
+        scratchKey.push_back(ind);
+        for (unsigned i = 0; known && i < nSplits; ++i)
+                {
+                ind = splitTable.FindSplit(splits.GetSplitWords(i), splits.GetSplitHash(i));
+                known = (ind != UINT_MAX);
+                scratchKey.push_back(ind);
+                }
+        const uint64_t hash = splits.GetTopologyHash();
+        const std::size_t mask = buckets.size() - 1;
+        std::size_t b = (std::size_t) hash & mask;
+        unsigned topologyIndex = UINT_MAX;
+        if (known)
+                {
+                std::sort(scratchKey.begin() + 1, scratchKey.end());
+                for (;; b = (b + 1) & mask)
+                        {
+                        const unsigned t = buckets[b];
+                        if (t == UINT_MAX)
+                                break;
+                        if (topologyHashes[t] == hash && KeyEquals(t, scratchKey))
+                                {
+                                topologyIndex = t;
+                                break;
+                                }
+                        }
+                }
+        else
+                {
+                scratchKey.clear();
+                scratchKey.push_back(taxonSets.InsertSplit(treeTaxa, splits.GetTreeTaxaHash()));
+                for (unsigned i = 0; i < nSplits; ++i)
+                        scratchKey.push_back(splitTable.InsertSplit(splits.GetSplitWords(i), splits.GetSplitHash(i)));
+                std::sort(scratchKey.begin() + 1, scratchKey.end());
+                for (; buckets[b] != UINT_MAX; b = (b + 1) & mask)
+                        ;
+                }
+        if (topologyIndex == UINT_MAX)
+                {
+                topologyIndex = GetNumTopologies();
+                topologyHashes.push_back(hash);
+                topologyInfo.push_back(NxsTopologyInfo());
+                topologyInfo.back().firstTreeIndex = nTrees;
+                if (keepDescriptions && ftd != NULL)
+                        descriptions.insert(std::pair<unsigned, NxsFullTreeDescription>(topologyIndex, *ftd));
+                topologyKeys.insert(topologyKeys.end(), scratchKey.begin(), scratchKey.end());
+                topologyStarts.push_back(topologyKeys.size());
+                /* keep the load factor at or below 1/2 */
+                if (2 * (std::size_t) topologyHashes.size() > buckets.size())
+                        Rehash(2 * buckets.size());
+                else
+                        buckets[b] = topologyIndex;
+                }
+        NxsTopologyInfo & info = topologyInfo[topologyIndex];
+        info.nTimes += 1;
+        if (trackOccurrence)
+                info.treeIndices.push_back(nTrees);
+        nTrees++;
+        return topologyIndex;
+        }
+
+bool NxsTopologyTable::KeyEquals(unsigned topologyIndex, const std::vector<unsigned> & key) const
+        {
+        const std::size_t start = topologyStarts[topologyIndex];
+        if (topologyStarts[topologyIndex + 1] - start != key.size())
+                return false;
+        return std::equal(key.begin(), key.end(), topologyKeys.begin() + start);
+        }
+
+void NxsTopologyTable::Rehash(std::size_t numBuckets)
+        {
+        buckets.assign(numBuckets, UINT_MAX);
+        const std::size_t mask = numBuckets - 1;
+        const unsigned n = GetNumTopologies();
+        for (unsigned i = 0; i < n; ++i)
+                {
+                std::size_t b = (std::size_t) topologyHashes[i] & mask;
+                while (buckets[b] != UINT_MAX)
+                        b = (b + 1) & mask;
+                buckets[b] = i;
+                }
+        }
+
+std::vector<unsigned> NxsTopologyTable::GetTopologySplitIds(unsigned topologyIndex) const
+        {
+        return std::vector<unsigned>(topologyKeys.begin() + topologyStarts[topologyIndex] + 1, topologyKeys.begin() + topologyStarts[topologyIndex + 1]);
+        }
+
+std::vector<unsigned> NxsTopologyTable::GetTopologiesByFrequency() const
+        {
+        std::vector<unsigned> order(GetNumTopologies());
+        for (unsigned i = 0; i < order.size(); ++i)
+                order[i] = i;
+        std::stable_sort(order.begin(), order.end(), MoreFrequentTopology(topologyInfo));
+        return order;
+        }
@@ -0,0 +1,180 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSTOPOLOGIES_H
+#define NCL_NXSTOPOLOGIES_H
+
+#include <map>
+#include <vector>
+#include "ncl/nxssplits.h"
+
+/*! The data that are recorded (by NxsTopologyTable) for each distinct topology. */
+class NxsTopologyInfo
+        {
+        public:
+                NxsTopologyInfo()
+                        :nTimes(0),
+                        firstTreeIndex(UINT_MAX)
+                        {}
+
+                unsigned nTimes; /* the number of trees that have the topology */
+                unsigned firstTreeIndex; /* the index of the first tree that has the topology */
+                std::vector<unsigned> treeIndices; /* the indices of the trees that have the topology (if tracked) */
+        };
+
+/*! A table of the distinct topologies of a collection of trees (for example, the trees sampled by an MCMC run), with
+        the number of trees that have each topology.
+
+        Two trees have the same topology if they have the same taxa and the same non-trivial splits (or clusters, if
+        the trees are treated as rooted), so the order of the children of the nodes, edge lengths and node names do not
+        matter, and neither does the position of the root of trees that are not treated as rooted.
+
+        The splits of each tree are extracted by NxsTreeSplits, and the topologies are indexed by
+        NxsTreeSplits::GetTopologyHash. A topology is stored as the sorted ids of its splits in an NxsSplitTable (and the
+        id of its taxon set), and trees with equal hashes are compared with these ids, so topologies are never merged by
+        a hash collision. The topologies are numbered in the order in which they are first seen.
+
+        The table is also a NxsTreeConsumer, so a TREES block can pass it each tree as it is read and the trees do not
+        have to be stored:
+
+                NxsTopologyTable topologies(0, false);
+                treesBlock->SetTreeConsumer(&topologies, true);
+                ... read the file ...
+                std::vector<unsigned> order = topologies.GetTopologiesByFrequency();
+*/
+class NxsTopologyTable : public NxsTreeConsumer
+        {
+        public:
+                /*! `numTaxa` is the number of taxa that the taxon indices of the trees refer to. If it is 0, then the
+                        number of taxa of the TREES block of the first tree passed to ConsumeTree is used. If
+                        `treatAsRooted` is true, the trees are compared as rooted trees.
+                */
+                NxsTopologyTable(unsigned numTaxa, bool treatAsRooted);
+
+                /*! Records `ftd` (which must be processed). \returns the index of its topology. */
+                unsigned RecordTree(const NxsFullTreeDescription & ftd);
+                /*! Records `tree`. \returns the index of its topology. */
+                unsigned RecordTree(const NxsSimpleTree & tree);
+                /*! Records a tree from its splits (`splits` must have been extracted for the number of taxa of the
+                        table, with the rooting option of the table and without trivial splits). \returns the index of
+                        its topology.
+                */
+                unsigned RecordTreeSplits(const NxsTreeSplits & splits);
+                /*! Records each of the `trees` (which must be processed) */
+                void RecordTrees(const std::vector<NxsFullTreeDescription> & trees);
+                /*! Records the tree (see NxsTreeConsumer). Trees that have not been processed are processed (in a copy)
+                        by `treesBlock`.
+                */
+                virtual void ConsumeTree(const NxsFullTreeDescription & treeDesc, const NxsSimpleTree * tree, NxsTreesBlock & treesBlock);
+
+                unsigned GetNumTaxa() const
+                        {
+                        return splitTable.GetNumTaxa();
+                        }
+                unsigned GetNumTrees() const
+                        {
+                        return nTrees;
+                        }
+                unsigned GetNumTopologies() const
+                        {
+                        return (unsigned) topologyHashes.size();
+                        }
+                const NxsTopologyInfo & GetTopologyInfo(unsigned topologyIndex) const
+                        {
+                        return topologyInfo[topologyIndex];
+                        }
+                /*! \returns the description of the first tree with topology `topologyIndex` that was recorded from a
+                        NxsFullTreeDescription while descriptions were kept (see SetKeepDescriptions), or NULL if there is
+                        no such tree.
+                */
+                const NxsFullTreeDescription * GetTopologyDescription(unsigned topologyIndex) const
+                        {
+                        std::map<unsigned, NxsFullTreeDescription>::const_iterator dIt = descriptions.find(topologyIndex);
+                        return (dIt == descriptions.end() ? NULL : &(dIt->second));
+                        }
+                /*! \returns the hash of topology `topologyIndex` (see NxsTreeSplits::GetTopologyHash) */
+                uint64_t GetTopologyHash(unsigned topologyIndex) const
+                        {
+                        return topologyHashes[topologyIndex];
+                        }
+                /*! \returns the ids (in the table returned by GetSplitTable) of the non-trivial splits of topology
+                        `topologyIndex`, in increasing order.
+                */
+                std::vector<unsigned> GetTopologySplitIds(unsigned topologyIndex) const;
+                /*! \returns the indices of the taxa of topology `topologyIndex` (in increasing order) */
+                std::vector<unsigned> GetTopologyTaxonIndices(unsigned topologyIndex) const
+                        {
+                        return taxonSets.GetTaxonIndices(topologyKeys[topologyStarts[topologyIndex]]);
+                        }
+                /*! \returns the table of the splits of the recorded topologies (which does not keep an NxsSplitInfo for
+                        each split).
+                */
+                const NxsSplitTable & GetSplitTable() const
+                        {
+                        return splitTable;
+                        }
+                /*! \returns the indices of the topologies, from the most frequent to the least frequent (topologies that
+                        are equally frequent are in the order in which they were first seen).
+                */
+                std::vector<unsigned> GetTopologiesByFrequency() const;
+
+                bool GetTreatAsRooted() const
+                        {
+                        return treatAsRooted;
+                        }
+                /*! If true, NxsTopologyInfo::treeIndices is filled. Default false. */
+                void SetTrackOccurrence(bool v)
+                        {
+                        trackOccurrence = v;
+                        }
+                /*! If true, the first tree that is recorded from a NxsFullTreeDescription with a new topology is stored
+                        (see GetTopologyDescription). Default false, so that no descriptions are stored.
+                */
+                void SetKeepDescriptions(bool v)
+                        {
+                        keepDescriptions = v;
+                        }
+        private:
+                NxsTopologyTable(const NxsTopologyTable &); /** don't define, not copyable*/
+                NxsTopologyTable & operator=(const NxsTopologyTable &); /** don't define, not copyable*/
+
+                unsigned Record(const NxsTreeSplits & splits, const NxsFullTreeDescription * ftd);
+                bool KeyEquals(unsigned topologyIndex, const std::vector<unsigned> & key) const;
+                void Rehash(std::size_t numBuckets);
+
+                NxsSplitTable splitTable;
+                NxsSplitTable taxonSets;
+                NxsTreeSplits treeSplits;
+                NxsSimpleTree scratchTree;
+                std::vector<uint64_t> topologyHashes;
+                std::vector<NxsTopologyInfo> topologyInfo;
+                std::map<unsigned, NxsFullTreeDescription> descriptions; /* only filled if keepDescriptions is true */
+                /* the id of the taxon set of each topology followed by its sorted split ids. Topology i is at positions
+                        topologyStarts[i] to topologyStarts[i + 1] - 1 */
+                std::vector<unsigned> topologyKeys;
+                std::vector<std::size_t> topologyStarts;
+                std::vector<unsigned> buckets; /* topology indices (UINT_MAX for empty buckets), the size is a power of 2 */
+                std::vector<unsigned> scratchKey;
+                unsigned nTrees;
+                bool treatAsRooted;
+                bool trackOccurrence;
+                bool keepDescriptions;
+        };
+
+#endif
@@ -0,0 +1,224 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#include <algorithm>
+#include "ncl/nxstreedistances.h"
+#include "ncl/nxsparallel.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#        include <intrin.h>
+#endif
+
+namespace
+{
+/* the number of trees along each side of the square tiles that the lower triangle is split into */
+const unsigned kTreesPerTile = 32;
+
+inline unsigned countBits(uint64_t w)
+        {
+/* __builtin_popcountll is a library call unless the popcnt instruction is enabled (e.g. by -mpopcnt or -march=native) */
+#        if defined(__GNUC__) && (defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__)))
+                return (unsigned) __builtin_popcountll(w);
+#        elif defined(_MSC_VER) && defined(_M_X64)
+                return (unsigned) __popcnt64(w);
+#        else
+                w = w - ((w >> 1) & 0x5555555555555555ULL);
+                w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+                w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+                return (unsigned) ((w * 0x0101010101010101ULL) >> 56);
+#        endif
+        }
+
+/* returns the number of values that are in both of the sorted lists */
+unsigned countCommon(const std::vector<unsigned> & a, const std::vector<unsigned> & b)
+        {
+        std::vector<unsigned>::const_iterator aIt = a.begin();
+        std::vector<unsigned>::const_iterator bIt = b.begin();
+        unsigned n = 0;
+        while (aIt != a.end() && bIt != b.end())
+                {
+                if (*aIt < *bIt)
+                        ++aIt;
+                else if (*bIt < *aIt)
+                        ++bIt;
+                else
+                        {
+                        ++n;
+                        ++aIt;
+                        ++bIt;
+                        }
+                }
+        return n;
+        }
+} // anonymous namespace
+
+/*----------------------------------------------------------------------------------------------------------------------
+|        Functor used by NxsRFDistanceCalculator::FillLowerTriangle. Workers claim tiles of the lower triangle of the
+|        distance matrix and write the distances directly into the packed triangle (different tiles never share a cell).
+*/
+template<typename T>
+class NxsRFDistanceWorker
+        {
+        public:
+                NxsRFDistanceWorker(const NxsRFDistanceCalculator & calc, T * out)
+                        :rf(calc),
+                        distances(out),
+                        nTrees(calc.GetNumTrees()),
+                        nTiles((calc.GetNumTrees() + kTreesPerTile - 1)/kTreesPerTile),
+                        nextTile(0)
+                        {}
+                void operator()(unsigned, unsigned)
+                        {
+                        const std::size_t nTilePairs = (((std::size_t) nTiles) * (nTiles + 1))/2;
+                        for (;;)
+                                {
+                                std::size_t tile;
+                                        {
+                                        NxsMutexLocker locker(mutex);
+                                        if (nextTile >= nTilePairs)
+                                                return;
+                                        tile = nextTile++;
+                                        }
+                                /* tiles are numbered row by row through the lower triangle of tiles */
+                                unsigned tileRow = 0;
+                                while ((((std::size_t) tileRow + 1) * (tileRow + 2))/2 <= tile)
+                                        ++tileRow;
+                                const unsigned tileCol = (unsigned) (tile - (((std::size_t) tileRow) * (tileRow + 1))/2);
+                                ComputeTile(tileRow, tileCol);
+                                }
+                        }
+        private:
+                void ComputeTile(unsigned tileRow, unsigned tileCol)
+                        {
+                        const unsigned iBegin = tileRow*kTreesPerTile;
+                        const unsigned iEnd = std::min(iBegin + kTreesPerTile, nTrees);
+                        const unsigned jBegin = tileCol*kTreesPerTile;
+                        for (unsigned i = iBegin; i < iEnd; ++i)
+                                {
+                                const unsigned jEnd = std::min(jBegin + kTreesPerTile, i + 1);
+                                T * row = distances + (((std::size_t) i) * (i + 1))/2;
+                                for (unsigned j = jBegin; j < jEnd; ++j)
+                                        row[j] = (T) rf.GetDistance(i, j);
+                                }
+                        }
+
+                const NxsRFDistanceCalculator & rf;
+                T * distances;
+                unsigned nTrees;
+                unsigned nTiles;
+                NxsMutex mutex;
+                std::size_t nextTile;
+        };
+
+NxsRFDistanceCalculator::NxsRFDistanceCalculator(unsigned numTaxa, bool treatAsRooted)
+        :counter(numTaxa),
+        nBitmapWords(0)
+        {
+        counter.SetTreatAsRooted(treatAsRooted);
+        counter.SetTrackOccurrence(true);
+        }
+
+void NxsRFDistanceCalculator::AddTrees(const std::vector<NxsFullTreeDescription> & trees, unsigned numThreads)
+        {
+        const unsigned firstNewTree = GetNumTrees();
+        counter.RecordTrees(trees, numThreads);
+        treeSplitIds.resize(counter.GetNumTrees());
+        /* the split ids are visited in increasing order, so each tree's list is sorted */
+        const NxsSplitTable & table = counter.GetSplitTable();
+        const unsigned nSplits = table.GetNumSplits();
+        std::size_t nIds = 0;
+        for (unsigned s = 0; s < nSplits; ++s)
+                {
+                const std::vector<unsigned> & treeIndices = table.GetSplitInfo(s).treeIndices;
+                std::vector<unsigned>::const_iterator tIt = std::lower_bound(treeIndices.begin(), treeIndices.end(), firstNewTree);
+                for (; tIt != treeIndices.end(); ++tIt)
+                        treeSplitIds[*tIt].push_back(s);
+                nIds += treeIndices.size();
+                }
+        /* bitmaps are used if they are no longer than the lists of split ids (on average) */
+        const unsigned nTrees = GetNumTrees();
+        const unsigned nWords = (nSplits + 63)/64;
+        bitmaps.clear();
+        nBitmapWords = 0;
+        if (nTrees > 0 && nWords > 0 && ((std::size_t) nWords) * nTrees <= nIds)
+                {
+                nBitmapWords = nWords;
+                bitmaps.assign(((std::size_t) nWords) * nTrees, 0);
+                for (unsigned t = 0; t < nTrees; ++t)
+                        {
+                        uint64_t * b = &bitmaps[((std::size_t) t) * nWords];
+                        const std::vector<unsigned> & ids = treeSplitIds[t];
+                        for (std::vector<unsigned>::const_iterator idIt = ids.begin(); idIt != ids.end(); ++idIt)
+                                b[*idIt / 64] |= ((uint64_t) 1) << (*idIt % 64);
+                        }
+                }
+        }
+
+unsigned NxsRFDistanceCalculator::GetDistance(unsigned i, unsigned j) const
+        {
+        const std::vector<unsigned> & a = treeSplitIds[i];
+        const std::vector<unsigned> & b = treeSplitIds[j];
+        unsigned nShared;
+        if (nBitmapWords > 0)
+                {
+                const uint64_t * ba = &bitmaps[((std::size_t) i) * nBitmapWords];
+                const uint64_t * bb = &bitmaps[((std::size_t) j) * nBitmapWords];
+                nShared = 0;
+                for (unsigned w = 0; w < nBitmapWords; ++w)
+                        nShared += countBits(ba[w] & bb[w]);
+                }
+        else
+                nShared = countCommon(a, b);
+        return (unsigned) (a.size() + b.size()) - 2*nShared;
+        }
+
+template<typename T>
+void NxsRFDistanceCalculator::FillLowerTriangle(T * distances, unsigned numThreads) const
+        {
+        const unsigned nTiles = (GetNumTrees() + kTreesPerTile - 1)/kTreesPerTile;
+        const unsigned nWorkers = NxsChooseNumThreads(numThreads, (nTiles*(nTiles + 1))/2);
+        NxsRFDistanceWorker<T> worker(*this, distances);
+        NxsRunWorkers(worker, nWorkers);
+        }
+
+void NxsRFDistanceCalculator::ComputeDistances(std::vector<unsigned> & distances, unsigned numThreads) const
+        {
+        const std::size_t nTrees = GetNumTrees();
+        distances.assign((nTrees * (nTrees + 1))/2, 0);
+        if (nTrees > 0)
+                FillLowerTriangle(&distances[0], numThreads);
+        }
+
+void NxsRFDistanceCalculator::ComputeDistances(NxsDistancesBlock & distances, unsigned numThreads) const
+        {
+        const unsigned nTrees = GetNumTrees();
+        if (distances.taxa != NULL && distances.taxa->GetNTax() != nTrees)
+                throw NxsNCLAPIException("The taxa block of the DISTANCES block for Robinson-Foulds distances must have one taxon for each tree");
+        distances.triangle = NxsDistancesBlock::NxsDistancesBlockEnum(NxsDistancesBlock::lower);
+        distances.diagonal = true;
+        distances.labels = true;
+        distances.interleave = false;
+        distances.expectedNtax = nTrees;
+        distances.nchar = 0;
+        distances.AllocateMatrix(nTrees);
+        distances.missingCells.assign(distances.missingCells.size(), false);
+        distances.isEmpty = false;
+        if (nTrees > 0)
+                FillLowerTriangle(&distances.distances[0], numThreads);
+        }
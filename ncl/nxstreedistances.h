@@ -0,0 +1,100 @@
+//        Copyright (C) 2008 Mark Holder
+//
+//        This file is part of NCL (Nexus Class Library) version 2.1
+//
+//        NCL is free software; you can redistribute it and/or modify
+//        it under the terms of the GNU General Public License as published by
+//        the Free Software Foundation; either version 2 of the License, or
+//        (at your option) any later version.
+//
+//        NCL is distributed in the hope that it will be useful,
+//        but WITHOUT ANY WARRANTY; without even the implied warranty of
+//        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+//        GNU General Public License for more details.
+//
+//        You should have received a copy of the GNU General Public License
+//        along with NCL; if not, write to the Free Software Foundation, Inc.,
+//        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+
+#ifndef NCL_NXSTREEDISTANCES_H
+#define NCL_NXSTREEDISTANCES_H
+
+#include <vector>
+#include "ncl/nxsdistancesblock.h"
+#include "ncl/nxssplits.h"
+
+/*! Computes Robinson-Foulds distances (the number of non-trivial splits that are in one tree but not the other)
+        between the trees of a collection.
+
+        Each distinct split is given an integer id by the NxsSplitTable of an NxsSplitCounter, and each tree is stored
+        as the sorted list of the ids of its splits, so the distance between two trees is computed by merging two lists
+        of integers. If there are few distinct splits (no more than 64 times the number of splits in a tree), the
+        trees are also stored as bitmaps of split ids, and the number of shared splits is the population count of the
+        intersection of two bitmaps.
+
+        ComputeDistances fills the lower triangle of the distance matrix. The triangle is split into tiles of trees that
+        are divided among threads. For example, to cluster the trees of a TREES block:
+
+                NxsRFDistanceCalculator rf(taxa->GetNTax(), false);
+                rf.AddTrees(treesBlock->GetProcessedTrees());
+                std::vector<unsigned> d;
+                rf.ComputeDistances(d);
+*/
+class NxsRFDistanceCalculator
+        {
+        public:
+                /*! `numTaxa` is the number of taxa that the taxon indices of the trees refer to. If `treatAsRooted` is
+                        true the trees are compared as rooted trees (their clusters), otherwise as unrooted trees.
+                */
+                NxsRFDistanceCalculator(unsigned numTaxa, bool treatAsRooted);
+
+                /*! Adds the `trees` (which must be processed). The splits are extracted with `numThreads` threads (0
+                        means one thread per hardware thread).
+                */
+                void AddTrees(const std::vector<NxsFullTreeDescription> & trees, unsigned numThreads = 0);
+
+                unsigned GetNumTrees() const
+                        {
+                        return (unsigned) treeSplitIds.size();
+                        }
+                /*! \returns the number of distinct non-trivial splits in the trees */
+                unsigned GetNumUniqueSplits() const
+                        {
+                        return counter.GetSplitTable().GetNumSplits();
+                        }
+                /*! \returns the table that maps the split ids to the splits */
+                const NxsSplitTable & GetSplitTable() const
+                        {
+                        return counter.GetSplitTable();
+                        }
+                /*! \returns the ids of the splits of tree `treeIndex`, in increasing order */
+                const std::vector<unsigned> & GetTreeSplitIds(unsigned treeIndex) const
+                        {
+                        return treeSplitIds[treeIndex];
+                        }
+                /*! \returns the Robinson-Foulds distance between trees `i` and `j` */
+                unsigned GetDistance(unsigned i, unsigned j) const;
+                /*! Replaces `distances` with the packed lower triangle (including the diagonal) of the distance matrix:
+                        the distance between trees i and j (for j <= i) is at position i*(i+1)/2 + j.
+                */
+                void ComputeDistances(std::vector<unsigned> & distances, unsigned numThreads = 0) const;
+                /*! Fills `distances` with the lower-triangular distance matrix. The taxa block of `distances` is not
+                        changed, so it should already have one taxon for each tree (in the order of the trees). Raises an
+                        NxsNCLAPIException if it has a taxa block with a different number of taxa.
+                */
+                void ComputeDistances(NxsDistancesBlock & distances, unsigned numThreads = 0) const;
+        private:
+                NxsRFDistanceCalculator(const NxsRFDistanceCalculator &); /** don't define, not copyable*/
+                NxsRFDistanceCalculator & operator=(const NxsRFDistanceCalculator &); /** don't define, not copyable*/
+
+                template<typename T>
+                void FillLowerTriangle(T * distances, unsigned numThreads) const;
+
+                NxsSplitCounter counter;
+                std::vector<std::vector<unsigned> > treeSplitIds;
+                unsigned nBitmapWords; /* words in each tree's bitmap (0 if bitmaps are not used) */
+                std::vector<uint64_t> bitmaps;
+        };
+
+#endif
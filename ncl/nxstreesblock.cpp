@@ -17,10 +17,14 @@
 //        59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 //
 #include <climits>
+#include <cstring>
 #include <sstream>
 #include <stack>
 
 #include "ncl/nxstreesblock.h"
+#include "ncl/nxsbinarytrees.h"
+#include "ncl/nxsnewickscanner.h"
+#include "ncl/nxsoutputbuffer.h"
 #include "ncl/nxsreader.h"
 using namespace std;
 #define REGRESSION_TESTING_GET_TRANS_TREE_DESC 0
@@ -37,15 +41,10 @@ enum PrevTreeTokenDesc
 
 NxsSimpleNode * NxsSimpleNode::FindTaxonIndex(unsigned leafIndex)
 {
-        if (leafIndex == taxIndex)
-                return this;
-        NxsSimpleNode *n = lChild;
-        while (n)
+        for (NxsSimpleNodeWalker w(this, NxsSimpleNodeWalker::PREORDER); w.GetNode() != NULL; w.Next())
                 {
-                NxsSimpleNode * r = n->FindTaxonIndex(leafIndex);
-                if (r)
-                        return r;
-                n = n->rSib;
+                if (w.GetNode()->taxIndex == leafIndex)
+                        return const_cast<NxsSimpleNode *>(w.GetNode());
                 }
         return NULL;
 }
@@ -57,8 +56,8 @@ NxsSimpleNode * NxsSimpleTree::RerootAt(unsigned leafIndex)
         NxsSimpleNode * newRoot = NULL;
         if (root)
                 {
-                if (leafIndex < leaves.size())
-                        newRoot = leaves[leafIndex];
+                newRoot = GetTaxonNode(leafIndex);
+                /* trees that were assembled with AllocNewNode do not fill the lookup table */
                 if (newRoot == NULL)
                         newRoot = root->FindTaxonIndex(leafIndex);
                 }
@@ -76,61 +75,68 @@ NxsSimpleNode * NxsSimpleTree::RerootAtNode(NxsSimpleNode *newRoot)
         NxsSimpleNode * p = newRoot->edgeToPar.parent;
         if (!p || p == root)
                 return newRoot;
-        std::stack<NxsSimpleNode *> toFlip;
+        rerootPath.clear();
         while (p != root)
                 {
-                toFlip.push(p);
+                rerootPath.push_back(p);
                 p = p->edgeToPar.parent;
                 }
-        while (!toFlip.empty())
+        while (!rerootPath.empty())
                 {
-                NxsSimpleNode *subRoot = toFlip.top();
-                toFlip.pop();
+                NxsSimpleNode *subRoot = rerootPath.back();
+                rerootPath.pop_back();
                 FlipRootsChildToRoot(subRoot);
                 }
         return newRoot;
 }
+
+/* Records `nd` (which has just been given its taxon index by the newick parser) in the taxon lookup table */
+void NxsSimpleTree::RecordTaxonNode(NxsSimpleNode *nd)
+{
+        std::vector<NxsSimpleNode *> & table = (nd->lChild == NULL ? leaves : internalTaxonNodes);
+        if (nd->taxIndex >= table.size())
+                table.resize(nd->taxIndex + 1, 0L);
+        table[nd->taxIndex] = nd;
+}
+
+/* Removes the links of the root, which is about to be replaced by one of its children. The node stays in allNodes
+        (rather than being freed, which would require a search of allNodes), so it is reused by the next Initialize.
+*/
+void NxsSimpleTree::UnlinkRoot()
+{
+        if (root->taxIndex < internalTaxonNodes.size() && internalTaxonNodes[root->taxIndex] == root)
+                internalTaxonNodes[root->taxIndex] = 0L;
+        root->lChild = 0L;
+        root->lastChild = 0L;
+        root->numChildren = 0;
+        root->rSib = 0L;
+        root->edgeToPar.parent = 0L;
+        root = NULL;
+}
 void NxsSimpleTree::FlipRootsChildToRoot(NxsSimpleNode *subRoot)
 {
-        std::vector<NxsSimpleNode *> rc = root->GetChildren();
-        if (rc.size() < 2)
-                {
-                NCL_ASSERT(!rc.empty());
-                NCL_ASSERT(rc[0] == subRoot);
-                /* root has degree 1 delete it */
-                std::vector<NxsSimpleNode *> tmp;
-                tmp.swap(allNodes);
-                allNodes.reserve(tmp.size() - 1);
-                for (std::vector<NxsSimpleNode *>::const_iterator nIt = tmp.begin(); nIt != tmp.end(); ++nIt)
-                        {
-                        if (*nIt != root)
-                                allNodes.push_back(*nIt);
-                        }
-                delete root;
+        const unsigned rootDegree = root->GetOutDegree();
+        if (rootDegree < 2)
+                {
+                NCL_ASSERT(rootDegree == 1);
+                NCL_ASSERT(root->lChild == subRoot);
+                /* root has degree 1 remove it */
+                UnlinkRoot();
                 root = subRoot;
                 subRoot->edgeToPar.parent = NULL;
                 return;
                 }
 
-        if (rc.size() == 2)
+        if (rootDegree == 2)
                 {
-                /* root has degree 2 delete it */
+                /* root has degree 2 remove it */
 
                 NxsSimpleNode * formerSib = subRoot->rSib;
                 if (formerSib == NULL)
                         formerSib = root->lChild;
                 NCL_ASSERT(formerSib != subRoot);
 
-                std::vector<NxsSimpleNode *> tmp;
-                tmp.swap(allNodes);
-                allNodes.reserve(tmp.size() - 1);
-                for (std::vector<NxsSimpleNode *>::const_iterator nIt = tmp.begin(); nIt != tmp.end(); ++nIt)
-                        {
-                        if (*nIt != root)
-                                allNodes.push_back(*nIt);
-                        }
-                delete root;
-                root = NULL;
+                UnlinkRoot();
 
                 formerSib->edgeToPar.parent = subRoot;
                 if (formerSib->edgeToPar.defaultEdgeLen)
@@ -171,6 +177,8 @@ void NxsSimpleTree::FlipRootsChildToRoot(NxsSimpleNode *subRoot)
                         subRoot->lChild = formerSib;
                 else
                         subRootRChild->rSib = formerSib;
+                formerSib->rSib = NULL;
+                subRoot->RecountChildren();
                 subRoot->rSib = NULL;
                 root = subRoot;
                 subRoot->edgeToPar.parent = NULL;
@@ -202,17 +210,52 @@ void NxsSimpleTree::FlipRootsChildToRoot(NxsSimpleNode *subRoot)
                                 }
                         }
                 subRoot->rSib = NULL;
+                root->rSib = NULL;
+                root->RecountChildren();
+                subRoot->RecountChildren();
                 root = subRoot;
                 subRoot->edgeToPar.parent = NULL;
                 }
 }
 
+bool NxsSimpleEdge::EdgeLenIsWrittenAsInt() const
+        {
+        if (defaultEdgeLen)
+                return false;
+        if (hasIntEdgeLens)
+                return true;
+        const char * c = NULL;
+        const char * e = NULL;
+        if (lenLength > 0)
+                {
+                c = lazyData->newick.data() + lenOffset;
+                e = c + lenLength;
+                }
+        else if (!lenAsString.empty())
+                {
+                c = lenAsString.data();
+                e = c + lenAsString.length();
+                }
+        if (c != e && (*c == '-' || *c == '+'))
+                ++c;
+        if (c == e)
+                return false;
+        for (; c != e; ++c)
+                {
+                if (*c < '0' || *c > '9')
+                        return false;
+                }
+        return true;
+        }
+
 void NxsSimpleEdge::WriteAsNewick(std::ostream &out, bool nhx) const
         {
         if (!defaultEdgeLen)
                 {
                 out << ':';
-                if (lenAsString.empty())
+                if (lenLength > 0)
+                        out.write(lazyData->newick.data() + lenOffset, lenLength);
+                else if (lenAsString.empty())
                         if (hasIntEdgeLens)
                                 out << iEdgeLen;
                         else
@@ -220,6 +263,7 @@ void NxsSimpleEdge::WriteAsNewick(std::ostream &out, bool nhx) const
                 else
                         out << lenAsString;
                 }
+        ParseLazyComments();
         for (std::vector<NxsComment>::const_iterator uc = unprocessedComments.begin(); uc != unprocessedComments.end(); ++uc)
                 out << '[' << uc->GetText() << ']';
         if (nhx && !parsedInfo.empty())
@@ -231,23 +275,16 @@ void NxsSimpleEdge::WriteAsNewick(std::ostream &out, bool nhx) const
                 }
         }
 
-void NxsSimpleNode::WriteAsNewick(std::ostream &out, bool nhx, bool useLeafNames, bool escapeNames, const NxsTaxaBlockAPI *taxa, bool escapeInternals) const
+/* writes the label of `nd` (as NxsSimpleNode::WriteAsNewick does) */
+static void WriteNodeLabelAsNewick(std::ostream &out, const NxsSimpleNode & nd, bool useLeafNames, bool escapeNames, const NxsTaxaBlockAPI *taxa, bool escapeInternals)
         {
-        if (lChild)
+        const std::string & name = nd.GetName();
+        const unsigned taxIndex = nd.GetTaxonIndex();
+        if (!nd.IsTip())
                 {
-                out << '(';
-                const std::vector<NxsSimpleNode *> children = GetChildren();
-                for (std::vector<NxsSimpleNode *>::const_iterator child = children.begin(); child != children.end(); ++child)
-                        {
-                        if (child != children.begin())
-                                out << ',';
-                        (*child)->WriteAsNewick(out, nhx, useLeafNames, escapeNames, taxa, escapeInternals);
-                        }
-                out << ')';
                 if (!name.empty())
                         {
-                        if (escapeNames
-                            || (escapeInternals && (!children.empty())))
+                        if (escapeNames || escapeInternals)
                                 out << NxsString::GetEscaped(name);
                         else
                                 out << name;
@@ -279,56 +316,79 @@ void NxsSimpleNode::WriteAsNewick(std::ostream &out, bool nhx, bool useLeafNames
                 else
                         out << (1 + taxIndex);
                 }
-        edgeToPar.WriteAsNewick(out, nhx);
         }
 
-void NxsSimpleNode::AddSelfAndDesToPreorder(std::vector<const NxsSimpleNode *> &p) const
+/*! Writes the subtree of this node. The nodes are visited by following the child, sibling and parent links, so deep
+        trees do not exhaust the stack.
+*/
+void NxsSimpleNode::WriteAsNewick(std::ostream &out, bool nhx, bool useLeafNames, bool escapeNames, const NxsTaxaBlockAPI *taxa, bool escapeInternals) const
         {
-#if  0
-        p.push_back(this);
-        NxsSimpleNode * currCh = this->lChild;
-        while (currCh)
-                {
-                currCh->AddSelfAndDesToPreorder(p);
-                currCh = currCh->rSib;
-                }
-#else
-        std::stack<const NxsSimpleNode *> ndStack;
-        const NxsSimpleNode * currCh = this;
+        const NxsSimpleNode * nd = this;
         for (;;)
                 {
-                p.push_back(currCh);
-                if (currCh->lChild)
+                if (nd->lChild)
                         {
-                        currCh = currCh->lChild;
-                        if (currCh->rSib)
-                                {
-                                ndStack.push(currCh->rSib);
-                                }
+                        out << '(';
+                        nd = nd->lChild;
+                        continue;
                         }
-                else
+                WriteNodeLabelAsNewick(out, *nd, useLeafNames, escapeNames, taxa, escapeInternals);
+                nd->edgeToPar.WriteAsNewick(out, nhx);
+                while (nd != this && nd->rSib == NULL)
                         {
-                        if (ndStack.empty())
-                                break;
-                        currCh = ndStack.top();
-                        ndStack.pop();
-                        if (currCh->rSib)
-                                {
-                                ndStack.push(currCh->rSib);
-                                }
+                        nd = nd->edgeToPar.parent;
+                        out << ')';
+                        WriteNodeLabelAsNewick(out, *nd, useLeafNames, escapeNames, taxa, escapeInternals);
+                        nd->edgeToPar.WriteAsNewick(out, nhx);
                         }
+                if (nd == this)
+                        break;
+                out << ',';
+                nd = nd->rSib;
                 }
-#endif
+        }
+
+void NxsSimpleNode::AddSelfAndDesToPreorder(std::vector<const NxsSimpleNode *> &p) const
+        {
+        for (NxsSimpleNodeWalker w(this, NxsSimpleNodeWalker::PREORDER); w.GetNode() != NULL; w.Next())
+                p.push_back(w.GetNode());
         }
 
 std::vector<const NxsSimpleNode *> NxsSimpleTree::GetPreorderTraversal() const
         {
         std::vector<const NxsSimpleNode *> p;
-        if (root)
-                root->AddSelfAndDesToPreorder(p);
+        FillPreorder(p);
         return p;
         }
 
+void NxsSimpleTree::FillPreorder(std::vector<const NxsSimpleNode *> & nodes) const
+        {
+        nodes.clear();
+        if (root)
+                root->AddSelfAndDesToPreorder(nodes);
+        }
+
+void NxsSimpleTree::FillPostorder(std::vector<const NxsSimpleNode *> & nodes) const
+        {
+        nodes.clear();
+        for (NxsSimpleNodeWalker w(root, NxsSimpleNodeWalker::POSTORDER); w.GetNode() != NULL; w.Next())
+                nodes.push_back(w.GetNode());
+        }
+
+void NxsSimpleTree::FillLevelOrder(std::vector<const NxsSimpleNode *> & nodes) const
+        {
+        nodes.clear();
+        if (root == NULL)
+                return;
+        /* `nodes` is also the queue of the nodes whose children have not been added */
+        nodes.push_back(root);
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+                {
+                for (const NxsSimpleNode * c = nodes[i]->lChild; c; c = c->rSib)
+                        nodes.push_back(c);
+                }
+        }
+
 std::vector<std::vector<int> > NxsSimpleTree::GetIntPathDistances(bool toMRCA) const
         {
         if (root == NULL || root->lChild == NULL)
@@ -613,16 +673,200 @@ void NxsSimpleEdge::DealWithNexusComments(const std::vector<NxsComment> & ecs, b
                 }
         }
 
+/*!
+        Moves the comments that were recorded by NxsSimpleTree::Initialize (when the tree parses comments lazily) into
+        unprocessedComments and parsedInfo.
+*/
+void NxsSimpleEdge::ParseLazyCommentsNow() const
+        {
+        std::vector<NxsComment> ecs;
+        for (unsigned i = firstLazyComment; i != UINT_MAX; i = lazyData->comments[i].next)
+                {
+                const NxsLazyEdgeData::Comment & c = lazyData->comments[i];
+                ecs.push_back(NxsComment(lazyData->newick.substr(c.begin, c.length), c.line, c.col));
+                }
+        firstLazyComment = UINT_MAX;
+        const_cast<NxsSimpleEdge *>(this)->DealWithNexusComments(ecs, lazyData->NHXComments);
+        }
+
+/*!
+        Gives the comments that `scanner` read with its last token to `edge`. If `lazyData` is not NULL, only the
+        positions of the comments are recorded (they are parsed by NxsSimpleEdge::ParseLazyCommentsNow).
+*/
+void NxsSimpleTree::AttachScannedComments(NxsNewickScanner & scanner,
+                                          NxsSimpleEdge * edge,
+                                          std::vector<NxsComment> & ecs,
+                                          bool NHXComments,
+                                          NxsLazyEdgeData * lazyData)
+        {
+        if (lazyData == NULL)
+                {
+                ecs.clear();
+                scanner.AppendNxsComments(ecs);
+                edge->DealWithNexusComments(ecs, NHXComments);
+                return;
+                }
+        const std::vector<NxsNewickScanner::CommentRange> & cr = scanner.GetComments();
+        for (std::vector<NxsNewickScanner::CommentRange>::const_iterator crIt = cr.begin(); crIt != cr.end(); ++crIt)
+                {
+                const unsigned ind = (unsigned) lazyData->comments.size();
+                lazyData->comments.push_back(NxsLazyEdgeData::Comment());
+                NxsLazyEdgeData::Comment & c = lazyData->comments.back();
+                c.begin = (unsigned) crIt->begin;
+                c.length = (unsigned) crIt->length;
+                scanner.GetCommentPosition(*crIt, &c.line, &c.col);
+                c.next = UINT_MAX;
+                if (edge->firstLazyComment == UINT_MAX)
+                        edge->firstLazyComment = ind;
+                else
+                        lazyData->comments[edge->lastLazyComment].next = ind;
+                edge->lastLazyComment = ind;
+                edge->lazyData = lazyData;
+                }
+        }
+
+/*!
+        Builds the tree from the processed newick string `s` (which must end with a semicolon) with a NxsNewickScanner.
+        The nodes, names, edge lengths and comments are the same as those created by reading `s` with a NxsToken.
+        \returns false if `s` holds anything that the scanner does not handle, or an error (the caller then clears the
+        nodes and reads `s` with a NxsToken, which reports the error).
+        If `lazyData` is not NULL, `s` must be lazyData->newick, and the comments and (when possible) the edge lengths
+        are recorded as positions in `s`.
+*/
+bool NxsSimpleTree::InitializeFromNewickBuffer(const std::string & s,
+                                               bool newickTokenizing,
+                                               bool NHXComments,
+                                               bool treatInternalNodeLabelsAsStrings,
+                                               NxsLazyEdgeData * lazyData)
+        {
+        NxsNewickScanner scanner(s.data(), s.length(), newickTokenizing);
+        NxsNewickScanner::TokenType tt = scanner.NextToken();
+        if (tt != NxsNewickScanner::OPEN_PARENS_TOKEN)
+                return false;
+        std::vector<NxsComment> ecs;
+        double lastFltEdgeLen;
+        long lastIntEdgeLen;
+        long currTaxNumber;
+        root = AllocNewNode(0L);
+        NxsSimpleNode * currNd = root;
+        NxsSimpleEdge * currEdge = &(currNd->edgeToPar);
+        NxsSimpleNode * tmpNode;
+        bool prevInternalOrLength;
+        bool currInternalOrLength = false;
+        for (;;)
+                {
+                if (tt == NxsNewickScanner::UNSUPPORTED_TOKEN)
+                        return false;
+                if (!scanner.GetComments().empty())
+                        AttachScannedComments(scanner, currEdge, ecs, NHXComments, lazyData);
+                if (tt == NxsNewickScanner::SEMICOLON_TOKEN)
+                        return (currNd == root);
+                prevInternalOrLength = currInternalOrLength;
+                currInternalOrLength = false;
+                if (tt == NxsNewickScanner::OPEN_PARENS_TOKEN)
+                        {
+                        tmpNode = AllocNewNode(currNd);
+                        currNd->AddChild(tmpNode);
+                        currNd = tmpNode;
+                        currEdge = &(currNd->edgeToPar);
+                        }
+                else if (tt == NxsNewickScanner::CLOSE_PARENS_TOKEN)
+                        {
+                        currNd = currNd->GetParent();
+                        if (currNd == NULL)
+                                return false;
+                        currEdge = &(currNd->edgeToPar);
+                        currInternalOrLength = true;
+                        }
+                else if (tt == NxsNewickScanner::COLON_TOKEN)
+                        {
+                        tt = scanner.NextToken(true);
+                        if (tt != NxsNewickScanner::LABEL_TOKEN)
+                                return false;
+                        if (!scanner.GetComments().empty())
+                                AttachScannedComments(scanner, currEdge, ecs, NHXComments, lazyData);
+                        const char * t = scanner.GetLabel().c_str();
+                        std::size_t lenBegin;
+                        const bool lenIsVerbatim = (lazyData != NULL && scanner.GetVerbatimLabelPosition(&lenBegin));
+                        if (realEdgeLens)
+                                {
+                                if (!NxsString::to_double(t, &lastFltEdgeLen))
+                                        return false;
+                                currEdge->SetDblEdgeLen(lastFltEdgeLen, (lenIsVerbatim ? NULL : t));
+                                }
+                        else
+                                {
+                                if (!NxsString::to_long(t, &lastIntEdgeLen))
+                                        return false;
+                                currEdge->SetIntEdgeLen((int)lastIntEdgeLen, (lenIsVerbatim ? NULL : t));
+                                }
+                        if (lenIsVerbatim)
+                                {
+                                currEdge->lenOffset = (unsigned) lenBegin;
+                                currEdge->lenLength = (unsigned) scanner.GetLabel().length();
+                                currEdge->lazyData = lazyData;
+                                }
+                        currInternalOrLength = true;
+                        }
+                else if (tt == NxsNewickScanner::COMMA_TOKEN)
+                        {
+                        currNd = currNd->GetParent();
+                        if (currNd == NULL)
+                                return false;
+                        tmpNode = AllocNewNode(currNd);
+                        currNd->AddChild(tmpNode);
+                        currNd = tmpNode;
+                        currEdge = &(currNd->edgeToPar);
+                        }
+                else
+                        {
+                        const char * t = scanner.GetLabel().c_str();
+                        bool wasReadAsNumber = false;
+                        if (currNd->IsTip() ||  !treatInternalNodeLabelsAsStrings)
+                                wasReadAsNumber = NxsString::to_long(t, &currTaxNumber);
+                        if (wasReadAsNumber && currTaxNumber < 1)
+                                {
+                                if (!prevInternalOrLength)
+                                        return false;
+                                wasReadAsNumber = false;
+                                }
+                        if (wasReadAsNumber)
+                                {
+                                currNd->taxIndex = (unsigned)currTaxNumber - 1;
+                                RecordTaxonNode(currNd);
+                                }
+                        else
+                                currNd->name = t;
+                        }
+                tt = scanner.NextToken();
+                }
+        }
+
 void NxsSimpleTree::Initialize(const NxsFullTreeDescription & td, bool treatInternalNodeLabelsAsStrings)
         {
         if (!td.IsProcessed())
                 throw NxsNCLAPIException("A tree description must be processed by ProcessTree before calling NxsSimpleTree::NxsSimpleTree");
-        Clear();
-        std::string s;
+        ClearAndRecycleNodes();
         const std::string & n = td.GetNewick();
+        /* the positions of lazily parsed comments are stored as unsigned ints */
+        const bool lazy = (parseCommentsLazily && n.length() < UINT_MAX);
+        std::string newick;
+        std::string & s = (lazy ? lazyEdgeData.newick : newick);
         s.reserve(n.length() + 1);
         s.assign(n.c_str());
         s.append(1, ';');
+        realEdgeLens = td.SomeEdgesHaveLengths() && (! td.EdgeLengthsAreAllIntegers());
+        const bool NHXComments = td.HasNHXComments();
+        NxsLazyEdgeData * lazyData = NULL;
+        if (lazy)
+                {
+                lazyData = &lazyEdgeData;
+                lazyData->comments.clear();
+                lazyData->NHXComments = NHXComments;
+                }
+        if (InitializeFromNewickBuffer(s, td.RequiresNewickNameTokenizing(), NHXComments, treatInternalNodeLabelsAsStrings, lazyData))
+                return;
+        ClearAndRecycleNodes();
         istringstream newickstream(s);
         NxsToken token(newickstream);
         if (td.RequiresNewickNameTokenizing())
@@ -630,8 +874,6 @@ void NxsSimpleTree::Initialize(const NxsFullTreeDescription & td, bool treatInte
                 token.UseNewickTokenization(true);
                 }
         token.SetEOFAllowed(false);
-        realEdgeLens = td.SomeEdgesHaveLengths() && (! td.EdgeLengthsAreAllIntegers());
-        const bool NHXComments = td.HasNHXComments();
         NxsString emsg;
         double lastFltEdgeLen;
         long lastIntEdgeLen;
@@ -738,12 +980,7 @@ void NxsSimpleTree::Initialize(const NxsFullTreeDescription & td, bool treatInte
                         if (wasReadAsNumber)
                                 {
                                 currNd->taxIndex = (unsigned)currTaxNumber - 1;
-                                if (currNd->lChild == NULL)
-                                        {
-                                        while (currNd->taxIndex >= leaves.size())
-                                                leaves.push_back(0L);
-                                        leaves[currNd->taxIndex] = currNd;
-                                        }
+                                RecordTaxonNode(currNd);
                                 }
                         else
                                 currNd->name = t;
@@ -807,7 +1044,13 @@ NxsTreesBlock::NxsTreesBlock(
   :NxsTaxaBlockSurrogate(tb, NULL),
   processedTreeValidationFunction(NULL),
   constructingTaxaBlock(false),
-  ptvArg(NULL)
+  ptvArg(NULL),
+  treeConsumer(NULL),
+  streamedTreeDesc(std::string(), std::string(), 0),
+  streamingTree(NULL),
+  streamingIntEdgeLen(0),
+  streamingDblEdgeLen(0.0),
+  streamingInternalLabelsAsStrings(false)
         {
         NCL_BLOCKTYPE_ATTR_NAME = "TREES";
         defaultTreeInd = UINT_MAX;
@@ -820,6 +1063,8 @@ NxsTreesBlock::NxsTreesBlock(
         writeFromNodeEdgeDataStructure = false;
         validateInternalNodeLabels = true;
         treatAsRootedByDefault = true;
+        acceptSnapshotTreesCommand = false;
+        snapshotTreesSection = UINT_MAX;
         allowNumericInterpretationOfTaxLabels = true;
         allowUnquotedSpaces = false;
         disambiguateDuplicateNames = false;
@@ -829,6 +1074,56 @@ NxsTreesBlock::NxsTreesBlock(
 */
 NxsTreesBlock::~NxsTreesBlock()
         {
+        delete streamingTree;
+        }
+/*!
+        Registers (or, if `consumer` is NULL, removes) the object that receives trees as they are read. See the
+        declaration for a description of the arguments.
+*/
+void NxsTreesBlock::SetTreeConsumer(
+  NxsTreeConsumer * consumer,
+  bool buildSimpleTrees,
+  int defaultIntEdgeLen,
+  double defaultDblEdgeLen,
+  bool treatInternalNodeLabelsAsStrings)
+        {
+        treeConsumer = consumer;
+        streamingIntEdgeLen = defaultIntEdgeLen;
+        streamingDblEdgeLen = defaultDblEdgeLen;
+        streamingInternalLabelsAsStrings = treatInternalNodeLabelsAsStrings;
+        if (consumer != NULL && buildSimpleTrees)
+                {
+                if (streamingTree == NULL)
+                        streamingTree = new NxsSimpleTree(defaultIntEdgeLen, defaultDblEdgeLen);
+                }
+        else
+                {
+                delete streamingTree;
+                streamingTree = NULL;
+                }
+        }
+/*!
+        Returns the NxsFullTreeDescription that the next tree should be read into. Normally this is a new element at
+        the end of `trees`, but if a NxsTreeConsumer has been registered then the same description is reused for
+        every tree (the description is written into its newick string in place, so the string is not reallocated once
+        its buffer is large enough).
+*/
+NxsFullTreeDescription & NxsTreesBlock::StartNewTreeDescription(const std::string & treeName, int treeFlags)
+        {
+        if (treeConsumer == NULL)
+                {
+                std::string mt;
+                trees.push_back(NxsFullTreeDescription(mt, treeName, treeFlags));
+                return trees[trees.size() -1];
+                }
+        NxsFullTreeDescription & td = streamedTreeDesc;
+        td.newick.clear();
+        td.name = treeName;
+        td.flags = treeFlags;
+        td.minIntEdgeLen = INT_MAX;
+        td.minDblEdgeLen = DBL_MAX;
+        td.requireNewickNameTokenizing = false;
+        return td;
         }
 /*!
         Makes data member `taxa' point to `tb' rather than the NxsTaxaBlockAPI object it was previously pointing to. Assumes
@@ -944,6 +1239,7 @@ void NxsTreesBlock::Reset()
         NxsBlock::Reset();
         ResetSurrogate();
         defaultTreeInd = UINT_MAX;
+        snapshotTreesSection = UINT_MAX;
         trees.clear();
         capNameToInd.clear();
         treeSets.clear();
@@ -977,15 +1273,44 @@ unsigned NxsTreesBlock::GetNumTrees()
 void NxsTreesBlock::WriteTranslateCommand(std::ostream & out) const
         {
         NCL_ASSERT(taxa);
-        out << "    TRANSLATE" << "\n";
-        const unsigned nt = taxa->GetNTaxTotal();
+        NxsOutputBuffer buffer(out);
+        buffer.Append("    TRANSLATE\n");
+        std::vector<std::string> escapedStorage;
+        const std::vector<std::string> & escapedLabels = NxsGetEscapedTaxonLabels(*taxa, escapedStorage);
+        const unsigned nt = (unsigned) escapedLabels.size();
         for (unsigned i = 0; i < nt; ++i)
                 {
                 if (i > 0)
-                                out << ",\n";
-                out << "        " << i + 1 << ' ' << NxsString::GetEscaped(taxa->GetTaxonLabel(i));
+                        buffer.Append(",\n");
+                buffer.Append("        ");
+                buffer.AppendUnsigned(i + 1);
+                buffer.Append(' ');
+                buffer.Append(escapedLabels[i]);
+                buffer.FlushIfFull();
+                }
+        buffer.Append(";\n");
+        }
+
+void NxsTreesBlock::WriteRerootedTrees(std::ostream & out, unsigned outgroupTaxonIndex, bool useLeafNames, bool nhx) const
+        {
+        if (constructingTaxaBlock)
+                throw NxsNCLAPIException("WriteRerootedTrees cannot be called while the Trees Block is still being constructed");
+        NxsSimpleTree nst(0, 0.0);
+        for (unsigned k = 0; k < trees.size(); k++)
+                {
+                NxsFullTreeDescription & treeDesc = trees[k];
+                ProcessTree(treeDesc);
+                nst.Initialize(treeDesc);
+                if (nst.GetTaxonNode(outgroupTaxonIndex) == NULL)
+                        {
+                        NxsString eMsg;
+                        eMsg << "Reroot failed. Taxon number " << (outgroupTaxonIndex + 1) << " was not found in the tree " << NxsString::GetEscaped(treeDesc.GetName());
+                        throw NxsNCLAPIException(eMsg);
+                        }
+                nst.RerootAt(outgroupTaxonIndex);
+                nst.WriteAsNewick(out, nhx, useLeafNames, true, taxa, true);
+                out << ";\n";
                 }
-        out << ";\n";
         }
 
 void NxsTreesBlock::WriteTreesCommand(std::ostream & out) const
@@ -1000,6 +1325,7 @@ void NxsTreesBlock::WriteTreesCommand(std::ostream & out) const
         NxsTreesBlock *ncthis = const_cast<NxsTreesBlock *>(this);
         NxsSimpleTree nst(0, 0.0);
         const bool useLeafNames = !(this->writeTranslateTable);
+        NxsOutputBuffer buffer(out);
         for (unsigned k = 0; k < trees.size(); k++)
                 {
 #                if defined REGRESSION_TESTING_GET_TRANS_TREE_DESC
@@ -1009,23 +1335,28 @@ void NxsTreesBlock::WriteTreesCommand(std::ostream & out) const
                 NxsFullTreeDescription & treeDesc = trees.at(k);
                 ncthis->ProcessTree(treeDesc);
                 const std::string & name = treeDesc.GetName();
-                out << "    TREE ";
+                buffer.Append("    TREE ");
                 if (k == defaultTreeInd)
-                        out << "* ";
+                        buffer.Append("* ");
                 if (name.length() == 0)
-                        out <<  "UnnamedTree = [&";
+                        buffer.Append("UnnamedTree = [&");
                 else
-                        out << NxsString::GetEscaped(name) << " = [&";
-                out << (treeDesc.IsRooted() ? 'R' : 'U');
-                out << ']';
+                        {
+                        buffer.Append(NxsString::GetEscaped(name));
+                        buffer.Append(" = [&");
+                        }
+                buffer.Append(treeDesc.IsRooted() ? 'R' : 'U');
+                buffer.Append(']');
                 if (writeFromNodeEdgeDataStructure)
                         {
                         nst.Initialize(treeDesc);
+                        buffer.Flush();
                         nst.WriteAsNewick(out, true, useLeafNames, true, taxa, true);
                         }
                 else
-                        out << treeDesc.GetNewick();
-                out << ";\n";
+                        buffer.Append(treeDesc.GetNewick());
+                buffer.Append(";\n");
+                buffer.FlushIfFull();
 
 
 #                if defined(PHYLOBASE_TESTING)
@@ -1103,11 +1434,23 @@ void NxsTreesBlock::WriteAsNexus(std::ostream &out) const
         {
         if (GetNumTrees() == 0)
                 return;
+        WriteBlockAsNexus(out, UINT_MAX);
+        }
+
+/*!
+        Writes the block. If `treesSnapshotSection` is not UINT_MAX then a "SnapshotTrees <section>;" command is written
+        instead of the TREE commands (see NxsSnapshotIO).
+*/
+void NxsTreesBlock::WriteBlockAsNexus(std::ostream &out, unsigned treesSnapshotSection) const
+        {
         out << "BEGIN TREES;\n";
         WriteBasicBlockCommands(out);
         if (this->writeTranslateTable)
                 WriteTranslateCommand(out);
-        WriteTreesCommand(out);
+        if (treesSnapshotSection == UINT_MAX)
+                WriteTreesCommand(out);
+        else
+                out << "    SnapshotTrees " << treesSnapshotSection << ";\n";
         WriteSkippedCommands(out);
         out << "END;\n";
         }
@@ -1188,7 +1531,7 @@ void NxsTreesBlock::HandleTranslateCommand(NxsToken &token)
                                         capNameToInd[value] = newVal;
 
                                 }
-                        else if (nexusReader)
+                        else if (nexusReader && nexusReader->ShouldReportWarning(NxsReader::PROBABLY_INCORRECT_CONTENT_WARNING))
                                 {
                                 errormsg << "Unknown taxon " << value << " in TRANSLATE command.\nThe translate key "<< key << " has NOT been added to the translation table!";
                                 nexusReader->NexusWarnToken(errormsg, NxsReader::PROBABLY_INCORRECT_CONTENT_WARNING, token);
@@ -1197,7 +1540,7 @@ void NxsTreesBlock::HandleTranslateCommand(NxsToken &token)
                         }
                 if (valueInd > 0)
                         {
-                        if (keyInd != 0 && keyInd != valueInd && nexusReader)
+                        if (keyInd != 0 && keyInd != valueInd && nexusReader && nexusReader->ShouldReportWarning(NxsReader::OVERWRITING_CONTENT_WARNING))
                                 {
                                 errormsg << "TRANSLATE command overwriting the taxon " << key << " with a redirection to " << value;
                                 nexusReader->NexusWarnToken(errormsg, NxsReader::OVERWRITING_CONTENT_WARNING, token);
@@ -1380,7 +1723,8 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
         long lastIntEdgeLen;
         bool taxsetRead = false;
         token.GetNextToken();
-        ostringstream newickStream;
+        std::string & newick = td.newick; /* written in place, so its buffer is reused */
+        newick.clear();
         NxsString nameDisambiguator;
         const NxsString * taxaLabelPtr;
         if (!token.Equals("("))
@@ -1389,7 +1733,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                 throw NxsException(errormsg, token);
                 }
         nchildren.push(0);
-        newickStream << '(';
+        newick.push_back('(');
         int prevToken = NXS_TREE_OPEN_PARENS_TOKEN;
         if (allowUnquotedSpaces)
             token.SetLabileFlagBit(NxsToken::spaceDoesNotBreakToken);
@@ -1406,7 +1750,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                 if (ns.length() > 5 && ns[0] == '&' && ns[1] == '&' && ns[2] == 'N' &&ns[3] == 'H' && ns[4] == 'X')
                                         NHXComments = true;
                                 }
-                        ecsIt->WriteAsNexus(newickStream);
+                        newick.append(1, '[').append(ecsIt->GetText()).append(1, ']');
                         }
                 if (token.Equals(";"))
                         {
@@ -1436,14 +1780,14 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                         */
                                         if (!someMissingEdgeLens && (prevToken == NXS_TREE_CLOSE_PARENS_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN))
                                                 someMissingEdgeLens = true;
-                                        newickStream << ',';
+                                        newick.push_back(',');
                                         prevToken = NXS_TREE_COMMA_TOKEN;
                                         }
                                 else if (prevToken == NXS_TREE_COLON_TOKEN)
                                         throw NxsException("Expecting a branch length after a : but found (", token);
                                 nchildren.top() += 1;
                                 nchildren.push(0);
-                                newickStream << '(';
+                                newick.push_back('(');
                                 prevToken = NXS_TREE_OPEN_PARENS_TOKEN;
                                 handled = true;
                                 }
@@ -1467,7 +1811,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                                 hasPolytomies = true;
                                         }
                                 nchildren.pop();
-                                newickStream << ')';
+                                newick.push_back(')');
                                 prevToken = NXS_TREE_CLOSE_PARENS_TOKEN;
                                 handled = true;
                                 }
@@ -1477,7 +1821,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                         throw NxsException("Found a : separator for a subtree at an inappropriate location. A colon is only permitted after a clade name or )-symbol.", token);
                                 if (taxsetRead && prevToken == NXS_TREE_CLADE_NAME_TOKEN)
                                         throw NxsException("Found a : separator after a taxset name. Branch lengths cannot be assigned to multi-taxon taxsets.", token);
-                                newickStream << ':';
+                                newick.push_back(':');
                                 prevToken = NXS_TREE_COLON_TOKEN;
                                 handled = true;
                                 token.SetLabileFlagBit(NxsToken::hyphenNotPunctuation); // this allows us to deal with sci. not. in branchlengths (and negative branch lengths).
@@ -1492,7 +1836,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                         throw NxsException("Found a , when a branch length was expected found. The combination \":,\" is prohibited.", token);
                                 if (!someMissingEdgeLens && (prevToken == NXS_TREE_CLOSE_PARENS_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN))
                                         someMissingEdgeLens = true;
-                                newickStream << ',';
+                                newick.push_back(',');
                                 prevToken = NXS_TREE_COMMA_TOKEN;
                                 handled = true;
                                 }
@@ -1522,7 +1866,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                         if (lastFltEdgeLen < minDblEdgeLen)
                                                 minDblEdgeLen = lastFltEdgeLen;
                                         }
-                                newickStream << tstr;
+                                newick.append(tstr);
                                 someHaveEdgeLens = true;
                                 prevToken = NXS_TREE_BRLEN_TOKEN;
                                 }
@@ -1707,7 +2051,7 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                                                 toAppend += (1 + ind);
                                                 }
                                         }
-                                newickStream << toAppend;
+                                newick.append(toAppend);
                                 prevToken = NXS_TREE_CLADE_NAME_TOKEN;
                                 }
                         }
@@ -1731,7 +2075,6 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                         td.minIntEdgeLen = minIntEdgeLen;
                         }
                 }
-        td.newick = newickStream.str();
         if (someMissingEdgeLens)
                 flags |= NxsFullTreeDescription::NXS_MISSING_SOME_EDGE_LENGTHS_BIT;
         if (hasPolytomies)
@@ -1752,11 +2095,251 @@ void NxsTreesBlock::ProcessTokenStreamIntoTree(
                 flags |= NxsFullTreeDescription::NXS_HAS_ALL_TAXA_BIT;
         }
 
+static void AppendTaxonNumber(std::string & s, unsigned n)
+        {
+        char digits[16];
+        char * p = digits + sizeof(digits);
+        do
+                {
+                *--p = (char)('0' + (n % 10));
+                n /= 10;
+                }
+        while (n != 0);
+        s.append(p, digits + sizeof(digits));
+        }
+
+/*!
+        Processes the newick string of `td` (which must end with a semicolon) with a NxsNewickScanner instead of a
+        NxsToken. This produces the same description, flags and minimum edge lengths as ProcessTokenStreamIntoTree,
+        but only handles the trees that do not need any of the slower features of ProcessTokenStreamIntoTree:
+        every leaf label must be found in `capNameToInd` (so no taxa are added and taxset names are not expanded), and
+        the tree must be free of errors. \returns false (without changing `td`) for any other tree, so that the caller
+        can process the tree with ProcessTokenStreamIntoTree (which reports the errors).
+*/
+bool NxsTreesBlock::ProcessNewickBufferIntoTree(
+  NxsFullTreeDescription & td,
+  const NxsLabelToIndicesMapper * taxaMapper,
+  const std::map<std::string, unsigned> & capNameToInd,
+  const bool validateInternalNodeLabels)
+        {
+        const std::string & incomingNewick = td.newick;
+        NxsNewickScanner scanner(incomingNewick.data(), incomingNewick.length(), td.RequiresNewickNameTokenizing());
+        /* comments before the opening parenthesis are dropped (as in ProcessTokenStreamIntoTree) */
+        if (scanner.NextToken() != NxsNewickScanner::OPEN_PARENS_TOKEN)
+                return false;
+        const bool rooted = (td.flags & NxsFullTreeDescription::NXS_IS_ROOTED_BIT);
+        bool NHXComments = false;
+        bool someMissingEdgeLens = false;
+        bool someHaveEdgeLens = false;
+        bool someRealEdgeLens = false;
+        bool hasPolytomies = false;
+        bool hasDegTwoNodes = false;
+        bool hasInternalLabels = false;
+        bool hasInternalLabelsInTaxa = false;
+        bool hasInternalLabelsNotInTaxa = false;
+        double minDblEdgeLen = DBL_MAX;
+        int minIntEdgeLen = INT_MAX;
+        double lastFltEdgeLen;
+        long lastIntEdgeLen;
+        std::vector<unsigned> nchildren;
+        std::vector<bool> taxonEncountered(taxaMapper->GetMaxIndex() + 1, false);
+        unsigned numTaxaEncountered = 0;
+        std::string processed;
+        processed.reserve(incomingNewick.length());
+        std::string ucl;
+        nchildren.push_back(0);
+        processed.append(1, '(');
+        int prevToken = NXS_TREE_OPEN_PARENS_TOKEN;
+        bool afterColon = false;
+        for (;;)
+                {
+                const NxsNewickScanner::TokenType tt = scanner.NextToken(afterColon);
+                afterColon = false;
+                if (tt == NxsNewickScanner::UNSUPPORTED_TOKEN)
+                        return false;
+                const std::vector<NxsNewickScanner::CommentRange> & ecs = scanner.GetComments();
+                for (std::vector<NxsNewickScanner::CommentRange>::const_iterator ecsIt = ecs.begin(); ecsIt != ecs.end(); ++ecsIt)
+                        {
+                        const char * ns = scanner.GetCommentText(*ecsIt);
+                        if (!NHXComments && ecsIt->length > 5 && strncmp(ns, "&&NHX", 5) == 0)
+                                NHXComments = true;
+                        processed.append(1, '[');
+                        processed.append(ns, ecsIt->length);
+                        processed.append(1, ']');
+                        }
+                if (tt == NxsNewickScanner::SEMICOLON_TOKEN)
+                        {
+                        if (!nchildren.empty())
+                                return false;
+                        break;
+                        }
+                if (tt == NxsNewickScanner::OPEN_PARENS_TOKEN)
+                        {
+                        if (nchildren.empty() || prevToken == NXS_TREE_CLOSE_PARENS_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN || prevToken == NXS_TREE_BRLEN_TOKEN || prevToken == NXS_TREE_COLON_TOKEN)
+                                return false;
+                        nchildren.back() += 1;
+                        nchildren.push_back(0);
+                        processed.append(1, '(');
+                        prevToken = NXS_TREE_OPEN_PARENS_TOKEN;
+                        }
+                else if (tt == NxsNewickScanner::CLOSE_PARENS_TOKEN)
+                        {
+                        if (nchildren.empty() || prevToken == NXS_TREE_OPEN_PARENS_TOKEN || prevToken == NXS_TREE_COMMA_TOKEN || prevToken == NXS_TREE_COLON_TOKEN)
+                                return false;
+                        if (prevToken == NXS_TREE_CLOSE_PARENS_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN)
+                                someMissingEdgeLens = true;
+                        const unsigned nc = nchildren.back();
+                        if (nc == 1)
+                                hasDegTwoNodes = true;
+                        else if (nc > 2)
+                                {
+                                if (rooted)
+                                        hasPolytomies = true;
+                                else if (nc > 3 || nchildren.size() > 1) /* three children are allowed not considered a polytomy */
+                                        hasPolytomies = true;
+                                }
+                        nchildren.pop_back();
+                        processed.append(1, ')');
+                        prevToken = NXS_TREE_CLOSE_PARENS_TOKEN;
+                        }
+                else if (tt == NxsNewickScanner::COLON_TOKEN)
+                        {
+                        if (prevToken != NXS_TREE_CLOSE_PARENS_TOKEN && prevToken != NXS_TREE_CLADE_NAME_TOKEN)
+                                return false;
+                        processed.append(1, ':');
+                        prevToken = NXS_TREE_COLON_TOKEN;
+                        afterColon = true;
+                        }
+                else if (tt == NxsNewickScanner::COMMA_TOKEN)
+                        {
+                        if (prevToken == NXS_TREE_OPEN_PARENS_TOKEN || prevToken == NXS_TREE_COMMA_TOKEN || prevToken == NXS_TREE_COLON_TOKEN)
+                                return false;
+                        if (prevToken == NXS_TREE_CLOSE_PARENS_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN)
+                                someMissingEdgeLens = true;
+                        processed.append(1, ',');
+                        prevToken = NXS_TREE_COMMA_TOKEN;
+                        }
+                else
+                        {
+                        const std::string & tstr = scanner.GetLabel();
+                        const char * t = tstr.c_str();
+                        if (prevToken == NXS_TREE_COLON_TOKEN)
+                                {
+                                bool handledLength = false;
+                                if (!someRealEdgeLens)
+                                        {
+                                        if (NxsString::to_long(t, &lastIntEdgeLen))
+                                                {
+                                                handledLength = true;
+                                                if (lastIntEdgeLen < minIntEdgeLen)
+                                                        minIntEdgeLen = (int)lastIntEdgeLen;
+                                                }
+                                        }
+                                if (!handledLength)
+                                        {
+                                        if (!NxsString::to_double(t, &lastFltEdgeLen))
+                                                return false;
+                                        someRealEdgeLens = true;
+                                        if (lastFltEdgeLen < minDblEdgeLen)
+                                                minDblEdgeLen = lastFltEdgeLen;
+                                        }
+                                processed.append(tstr);
+                                someHaveEdgeLens = true;
+                                prevToken = NXS_TREE_BRLEN_TOKEN;
+                                continue;
+                                }
+                        if (prevToken == NXS_TREE_BRLEN_TOKEN || prevToken == NXS_TREE_CLADE_NAME_TOKEN)
+                                return false;
+                        ucl.assign(tstr);
+                        NxsString::to_upper(ucl);
+                        std::map<std::string, unsigned>::const_iterator cntiIt = capNameToInd.find(ucl);
+                        const unsigned ind = (cntiIt == capNameToInd.end() ? UINT_MAX : cntiIt->second);
+                        if (ind != UINT_MAX && ind >= taxonEncountered.size())
+                                taxonEncountered.resize(ind + 1, false);
+                        const bool isLeaf = (prevToken != NXS_TREE_CLOSE_PARENS_TOKEN);
+                        if (isLeaf && nchildren.empty())
+                                return false;
+                        if (isLeaf || validateInternalNodeLabels)
+                                {
+                                if (ind == UINT_MAX)
+                                        {
+                                        if (isLeaf)
+                                                return false;
+                                        }
+                                else if (taxonEncountered[ind])
+                                        return false;
+                                }
+                        if (isLeaf)
+                                {
+                                nchildren.back() += 1;
+                                taxonEncountered[ind] = true;
+                                numTaxaEncountered++;
+                                AppendTaxonNumber(processed, 1 + ind);
+                                }
+                        else
+                                {
+                                hasInternalLabels = true;
+                                if (validateInternalNodeLabels && ind != UINT_MAX)
+                                        {
+                                        hasInternalLabelsInTaxa = true;
+                                        taxonEncountered[ind] = true;
+                                        numTaxaEncountered++;
+                                        AppendTaxonNumber(processed, 1 + ind);
+                                        }
+                                else
+                                        {
+                                        hasInternalLabelsNotInTaxa = true;
+                                        processed.append(NxsString::GetEscaped(tstr));
+                                        }
+                                }
+                        prevToken = NXS_TREE_CLADE_NAME_TOKEN;
+                        }
+                }
+        int & flags = td.flags;
+        flags |= NxsFullTreeDescription::NXS_TREE_PROCESSED;
+        if (someHaveEdgeLens)
+                {
+                flags |= NxsFullTreeDescription::NXS_HAS_SOME_EDGE_LENGTHS_BIT;
+                if (someRealEdgeLens)
+                        {
+                        flags &= ~(NxsFullTreeDescription::NXS_INT_EDGE_LENGTHS_BIT);
+                        td.minDblEdgeLen = minDblEdgeLen;
+                        }
+                else
+                        {
+                        flags |= NxsFullTreeDescription::NXS_INT_EDGE_LENGTHS_BIT;
+                        td.minIntEdgeLen = minIntEdgeLen;
+                        }
+                }
+        td.newick.swap(processed);
+        if (someMissingEdgeLens)
+                flags |= NxsFullTreeDescription::NXS_MISSING_SOME_EDGE_LENGTHS_BIT;
+        if (hasPolytomies)
+                flags |= NxsFullTreeDescription::NXS_HAS_POLYTOMY_BIT;
+        if (hasDegTwoNodes)
+                flags |= NxsFullTreeDescription::NXS_HAS_DEG_TWO_NODES_BIT;
+        if (hasInternalLabels)
+                {
+                flags |= NxsFullTreeDescription::NXS_HAS_INTERNAL_NAMES_BIT;
+                if (hasInternalLabelsNotInTaxa)
+                        flags |= NxsFullTreeDescription::NXS_HAS_NEW_INTERNAL_NAMES_BIT;
+                if (hasInternalLabelsInTaxa)
+                        flags |= NxsFullTreeDescription::NXS_KNOWN_INTERNAL_NAMES_BIT;
+                }
+        if (NHXComments)
+                flags |= NxsFullTreeDescription::NXS_HAS_NHX_BIT;
+        if (numTaxaEncountered == taxaMapper->GetMaxIndex() + 1)
+                flags |= NxsFullTreeDescription::NXS_HAS_ALL_TAXA_BIT;
+        return true;
+        }
+
 void NxsTreesBlock::ProcessTree(NxsFullTreeDescription & ftd) const
         {
         if (ftd.flags & NxsFullTreeDescription::NXS_TREE_PROCESSED)
                 return;
         ftd.newick.append(1, ';');
+        if (!allowUnquotedSpaces && ProcessNewickBufferIntoTree(ftd, taxa, capNameToInd, validateInternalNodeLabels))
+                return;
         const std::string incomingNewick = ftd.newick;
         ftd.newick.clear();
         istringstream newickstream(incomingNewick);
@@ -1830,10 +2413,8 @@ void NxsTreesBlock::HandleTreeCommand(NxsToken &token, bool rooted)
                 errormsg << "This probably indicates that the parentheses in the newick description are not balanced, and one or more closing parentheses are needed.";
                 throw NxsException(errormsg, fp, fline, fcol);
                 }
-        std::string mt;
         int f = (rooted ? NxsFullTreeDescription::NXS_IS_ROOTED_BIT : 0);
-        trees.push_back(NxsFullTreeDescription(mt, treeName, f));
-        NxsFullTreeDescription & td = trees[trees.size() -1];
+        NxsFullTreeDescription & td = StartNewTreeDescription(treeName, f);
         ReadTreeFromOpenParensToken(td, token);
         }
 
@@ -1848,34 +2429,34 @@ void NxsTreesBlock::ReadTreeFromOpenParensToken(NxsFullTreeDescription &td, NxsT
                 file_pos fp = 0;
                 int fline = (int)token.GetFileLine();
                 int fcol = (int)token.GetFileColumn();
-                ostringstream newickStream;
-                newickStream << token.GetTokenReference();
+                /* the description is appended to td.newick, which keeps its buffer between streamed trees */
+                std::string & newick = td.newick;
+                newick.append(token.GetTokenReference());
                 token.GetNextToken();
                 const std::vector<NxsComment> & ecs = token.GetEmbeddedComments();
                 for (std::vector<NxsComment>::const_iterator ecsIt = ecs.begin(); ecsIt != ecs.end(); ++ecsIt)
-                        ecsIt->WriteAsNexus(newickStream);
+                        newick.append(1, '[').append(ecsIt->GetText()).append(1, ']');
                 while (!token.Equals(";"))
                         {
                         if (token.Equals("(") || token.Equals(")") || token.Equals(","))
                                 GenerateUnexpectedTokenNxsException(token, "root taxon information");
-                        newickStream << NxsString::GetEscaped(token.GetTokenReference());
+                        newick.append(NxsString::GetEscaped(token.GetTokenReference()));
                         if (allowUnquotedSpaces) {
                             token.SetLabileFlagBit(NxsToken::spaceDoesNotBreakToken);
                         }
                         token.GetNextToken();
                         const std::vector<NxsComment> & iecs = token.GetEmbeddedComments();
                         for (std::vector<NxsComment>::const_iterator iecsIt = iecs.begin(); iecsIt != iecs.end(); ++iecsIt)
-                                iecsIt->WriteAsNexus(newickStream);
+                                newick.append(1, '[').append(iecsIt->GetText()).append(1, ']');
                         }
-                td.newick = newickStream.str();
-                if (processAllTreesDuringParse)
+                if (processAllTreesDuringParse || streamingTree != NULL)
                         {
                         try
                                 {
                                 ProcessTree(td);
                                 if (this->processedTreeValidationFunction)
                                         {
-                                        if (!this->processedTreeValidationFunction(td, this->ptvArg, this))
+                                        if (!this->processedTreeValidationFunction(td, this->ptvArg, this) && treeConsumer == NULL)
                                                 trees.pop_back();
                                         }
                                 }
@@ -1887,6 +2468,12 @@ void NxsTreesBlock::ReadTreeFromOpenParensToken(NxsFullTreeDescription &td, NxsT
                                 throw x;
                                 }
                         }
+                if (treeConsumer != NULL)
+                        {
+                        if (streamingTree != NULL)
+                                streamingTree->Initialize(td, streamingInternalLabelsAsStrings);
+                        treeConsumer->ConsumeTree(td, streamingTree, *this);
+                        }
                 }
         catch (...)
                 {
@@ -1915,13 +2502,13 @@ void NxsTreesBlock::Read(
         constructingTaxaBlock = false;
         newtaxa = false;
         capNameToInd.clear();
-        unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
-        const bool checkingSignals = NxsReader::getNCLCatchesSignals();
+        const unsigned numSigInts = NxsReader::getNumSignalIntsCaught();
+        const bool checkingSignals = (nexusReader != NULL);
 
         for (;;)
                 {
                 token.GetNextToken();
-                if (checkingSignals && NxsReader::getNumSignalIntsCaught() != numSigInts)
+                if (checkingSignals && nexusReader->IsParseCanceled(numSigInts))
                         {
                         throw NxsSignalCanceledParseException("Reading TREES Block");
                         }
@@ -1963,6 +2550,19 @@ void NxsTreesBlock::Read(
                                         readTree = true;
                                         HandleTreeCommand(token, readAsRooted);
                                         }
+                                else if (acceptSnapshotTreesCommand && token.Equals("SNAPSHOTTREES"))
+                                        {
+                                        /* the trees are added by NxsSnapshotIO after the NEXUS part of the snapshot has been read */
+                                        if (!readTranslate && ! readTree)
+                                                ConstructDefaultTranslateTable(token, "SnapshotTrees");
+                                        readTree = true;
+                                        token.GetNextToken();
+                                        long sectionIndex = -1;
+                                        if (!NxsString::to_long(token.GetTokenReference().c_str(), &sectionIndex) || sectionIndex < 0)
+                                                GenerateNxsException(token, "Expecting a section number after SnapshotTrees");
+                                        DemandEndSemicolon(token, "SnapshotTrees");
+                                        snapshotTreesSection = (unsigned) sectionIndex;
+                                        }
                                 else
                                         SkipCommand(token);
                                 }
@@ -2109,9 +2709,7 @@ void NxsTreesBlock::ReadPhylipTreeFile(NxsToken & token)
                                 firstTree = false;
                                 }
                         int f = (rooted ? NxsFullTreeDescription::NXS_IS_ROOTED_BIT : 0);
-                        std::string mt;
-                        trees.push_back(NxsFullTreeDescription(mt, mt, f));
-                        NxsFullTreeDescription & td = trees[trees.size() -1];
+                        NxsFullTreeDescription & td = StartNewTreeDescription(std::string(), f);
                         this->useNewickTokenizingDuringParse = true;
                         ReadTreeFromOpenParensToken(td, token);
                         this->useNewickTokenizingDuringParse = prevUNTDP;
@@ -2145,3 +2743,69 @@ void NxsTreesBlock::ReadPhylipTreeFile(NxsToken & token)
         useNewickTokenizingDuringParse = prevUNTDP;
         }
 
+void NxsTreesBlock::ReadBinaryTreeCollection(const NxsBinaryTreeCollection & collection)
+        {
+        const std::vector<std::string> & labels = collection.GetTaxonLabels();
+        if (taxa == NULL)
+                {
+                /* the token is only used for error messages */
+                std::istringstream noInput;
+                NxsToken token(noInput);
+                unsigned nTb = 0;
+                if (nxsReader != NULL)
+                        nxsReader->GetTaxaBlockByTitle(NULL, &nTb);
+                AssureTaxaBlock(nxsReader == NULL || (nTb == 0 && createImpliedBlock), token, "TREES");
+                }
+        if (taxa->GetNTaxTotal() == 0)
+                {
+                taxa->SetNtax((unsigned) labels.size());
+                for (std::vector<std::string>::const_iterator lIt = labels.begin(); lIt != labels.end(); ++lIt)
+                        taxa->AddTaxonLabel(*lIt);
+                newtaxa = true;
+                }
+        std::vector<unsigned> taxonIndices(labels.size());
+        bool renumbering = false;
+        for (unsigned i = 0; i < labels.size(); ++i)
+                {
+                const unsigned taxonNumber = taxa->TaxLabelToNumber(labels[i]);
+                if (taxonNumber == 0)
+                        {
+                        errormsg.clear();
+                        errormsg << "The taxon " << labels[i] << " of the binary tree collection is not in the taxa block";
+                        throw NxsException(errormsg);
+                        }
+                taxonIndices[i] = taxonNumber - 1;
+                if (taxonIndices[i] != i)
+                        renumbering = true;
+                }
+        const bool taxaDiffer = (renumbering || taxa->GetNTaxTotal() != labels.size());
+        const unsigned nTrees = collection.GetNumTrees();
+        if (treeConsumer == NULL)
+                trees.reserve(trees.size() + nTrees);
+        for (unsigned k = 0; k < nTrees; ++k)
+                {
+                NxsFullTreeDescription td = collection.GetTreeDescription(k, (renumbering ? &taxonIndices : NULL));
+                if (taxaDiffer)
+                        td.flags &= ~NxsFullTreeDescription::NXS_HAS_ALL_TAXA_BIT;
+                if (treeConsumer == NULL)
+                        trees.push_back(td);
+                else
+                        {
+                        if (streamingTree != NULL)
+                                streamingTree->Initialize(td, streamingInternalLabelsAsStrings);
+                        treeConsumer->ConsumeTree(td, streamingTree, *this);
+                        }
+                }
+        }
+
+void NxsTreesBlock::WriteAsBinaryTreeCollection(std::ostream & out, bool shareTopologies) const
+        {
+        if (constructingTaxaBlock)
+                throw NxsNCLAPIException("WriteAsBinaryTreeCollection cannot be called while the Trees Block is still being constructed");
+        if (taxa == NULL)
+                throw NxsNCLAPIException("WriteAsBinaryTreeCollection requires a taxa block");
+        for (std::vector<NxsFullTreeDescription>::iterator tIt = trees.begin(); tIt != trees.end(); ++tIt)
+                ProcessTree(*tIt);
+        NxsBinaryTreeCollection::Write(out, taxa->GetAllLabels(), trees, shareTopologies);
+        }
+
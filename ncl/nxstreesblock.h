@@ -47,6 +47,33 @@ std::string parseNHXComment(const std::string comment, /*! the comment without t
                         std::map<std::string, std::string> *infoMap); /*!< the destination for key value pairs parsed out of the NHX comment */
 class NxsFullTreeDescription;
 class NxsSimpleNode;
+class NxsBinaryTreeCollection;
+class NxsNewickScanner;
+
+/*! The comments of a tree that was built by NxsSimpleTree::Initialize with SetParseCommentsLazily(true).
+
+        The tree keeps a copy of its newick string, and the position of each comment in it. The edges of the tree refer
+        to these records until the comments are parsed.
+*/
+class NxsLazyEdgeData
+        {
+        public:
+                class Comment
+                        {
+                        public:
+                                unsigned begin; /* position of the text between the brackets in newick */
+                                unsigned length;
+                                long line; /* the position that NxsToken would record for the comment */
+                                long col;
+                                unsigned next; /* index of the next comment of the same edge (UINT_MAX for none) */
+                        };
+                NxsLazyEdgeData()
+                        :NHXComments(false)
+                        {}
+                std::string newick;
+                std::vector<Comment> comments;
+                bool NHXComments;
+        };
 /*! The edge used by the NxsSimpleTree class.
 */
 class NxsSimpleEdge
@@ -61,6 +88,11 @@ class NxsSimpleEdge
                         {
                         return hasIntEdgeLens;
                         }
+                /*! \returns true if the edge has a length that was written as an integer (digits without a decimal point or
+                        an exponent). Trees that have any real-valued edge length store all of their lengths as doubles
+                        (IsIntEdgeLen is false for every edge), so this is the way to find the lengths that were integers.
+                */
+                bool EdgeLenIsWrittenAsInt() const;
 
                 double GetDblEdgeLen() const
                         {
@@ -74,6 +106,7 @@ class NxsSimpleEdge
 
                 std::vector<NxsComment> GetUnprocessedComments() const
                         {
+                        ParseLazyComments();
                         return unprocessedComments;
                         }
 
@@ -83,6 +116,7 @@ class NxsSimpleEdge
                 */
                 bool GetInfo(const std::string &key, std::string *value) const
                         {
+                        ParseLazyComments();
                         std::map<std::string, std::string>::const_iterator kvit = parsedInfo.find(key);
                         if (kvit == parsedInfo.end())
                                 return false;
@@ -98,6 +132,7 @@ class NxsSimpleEdge
                 */
                 const std::map<std::string, std::string> & GetInfo() const
                         {
+                        ParseLazyComments();
                         return parsedInfo;
                         }
                 const NxsSimpleNode * GetParent() const
@@ -115,7 +150,10 @@ class NxsSimpleEdge
                         hasIntEdgeLens = false;
                         dEdgeLen = e;
                         if (asString)
+                                {
                                 lenAsString.assign(asString);
+                                lenLength = 0;
+                                }
 
                         }
 
@@ -125,7 +163,10 @@ class NxsSimpleEdge
                         hasIntEdgeLens = true;
                         iEdgeLen = e;
                         if (asString)
+                                {
                                 lenAsString.assign(asString);
+                                lenLength = 0;
+                                }
                         }
                 mutable void * scratch;
                 void SetParent(NxsSimpleNode *p)
@@ -135,6 +176,12 @@ class NxsSimpleEdge
         private:
                 void WriteAsNewick(std::ostream &out, bool nhx) const;
                 void DealWithNexusComments(const std::vector<NxsComment> & ecs, bool NHXComments);
+                void ParseLazyComments() const
+                        {
+                        if (firstLazyComment != UINT_MAX)
+                                ParseLazyCommentsNow();
+                        }
+                void ParseLazyCommentsNow() const;
 
                 NxsSimpleEdge(NxsSimpleNode  *par, NxsSimpleNode * des, double edgeLen)
                         :scratch(0L),
@@ -142,7 +189,12 @@ class NxsSimpleEdge
                         child(des),
                         defaultEdgeLen(true),
                         hasIntEdgeLens(false),
-                        dEdgeLen(edgeLen)
+                        dEdgeLen(edgeLen),
+                        lazyData(0L),
+                        firstLazyComment(UINT_MAX),
+                        lastLazyComment(UINT_MAX),
+                        lenOffset(0),
+                        lenLength(0)
                         {
                         }
 
@@ -152,7 +204,12 @@ class NxsSimpleEdge
                         child(des),
                         defaultEdgeLen(true),
                         hasIntEdgeLens(true),
-                        iEdgeLen(edgeLen)
+                        iEdgeLen(edgeLen),
+                        lazyData(0L),
+                        firstLazyComment(UINT_MAX),
+                        lastLazyComment(UINT_MAX),
+                        lenOffset(0),
+                        lenLength(0)
                         {
                         }
 
@@ -170,11 +227,71 @@ class NxsSimpleEdge
                 std::string                lenAsString; /*easy (but inefficient) means of preserving the formatting of the input branch length */
                 std::vector<NxsComment> unprocessedComments;
                 std::map<std::string, std::string> parsedInfo;
+                /* The fields below are used for edges of trees that parse comments lazily (see
+                        NxsSimpleTree::SetParseCommentsLazily) */
+                const NxsLazyEdgeData * lazyData;
+                mutable unsigned firstLazyComment; /* index in lazyData->comments of the first comment that has not been parsed (UINT_MAX if none) */
+                unsigned lastLazyComment;
+                unsigned lenOffset; /* position of the edge length in lazyData->newick (used instead of lenAsString if lenLength > 0) */
+                unsigned lenLength;
                 friend class NxsSimpleTree;
                 friend class NxsSimpleNode;
         };
 
+/*! A forward iterator over the children of an NxsSimpleNode (see NxsSimpleNode::GetChildRange). It follows the
+        sibling links, so it does not allocate memory.
+*/
+class NxsSimpleChildIterator
+        {
+        public:
+                NxsSimpleChildIterator(NxsSimpleNode * child = 0L)
+                        :curr(child)
+                        {}
+                NxsSimpleNode * operator*() const
+                        {
+                        return curr;
+                        }
+                inline NxsSimpleChildIterator & operator++();
+                bool operator==(const NxsSimpleChildIterator & other) const
+                        {
+                        return curr == other.curr;
+                        }
+                bool operator!=(const NxsSimpleChildIterator & other) const
+                        {
+                        return curr != other.curr;
+                        }
+        private:
+                NxsSimpleNode * curr;
+        };
+
+/*! The children of an NxsSimpleNode as a range, for example:
+
+                NxsSimpleChildRange children = nd->GetChildRange();
+                for (NxsSimpleChildIterator cIt = children.begin(); cIt != children.end(); ++cIt)
+                        visit(*cIt);
+*/
+class NxsSimpleChildRange
+        {
+        public:
+                NxsSimpleChildRange(NxsSimpleNode * first)
+                        :firstChild(first)
+                        {}
+                NxsSimpleChildIterator begin() const
+                        {
+                        return NxsSimpleChildIterator(firstChild);
+                        }
+                NxsSimpleChildIterator end() const
+                        {
+                        return NxsSimpleChildIterator();
+                        }
+        private:
+                NxsSimpleNode * firstChild;
+        };
+
 /*! The node used by the NxsSimpleTree class.
+
+        Each node keeps its first and last child and its number of children, so adding a child, finding the last child
+        and finding the out-degree take constant time.
 */
 class NxsSimpleNode
         {
@@ -208,38 +325,33 @@ class NxsSimpleNode
                         }
                 NxsSimpleNode * GetLastChild() const
                         {
-                        NxsSimpleNode * currNode = GetFirstChild();
-                        if (!currNode)
-                                return NULL;
-                        NxsSimpleNode * nextNd = currNode->GetNextSib();
-                        while (nextNd)
-                                {
-                                currNode = nextNd;
-                                nextNd = currNode->GetNextSib();
-                                }
-                        return currNode;
+                        return lastChild;
+                        }
+                /*! \returns the children of the node (which can be iterated without allocating a vector) */
+                NxsSimpleChildRange GetChildRange() const
+                        {
+                        return NxsSimpleChildRange(lChild);
                         }
 
                 std::vector<NxsSimpleNode *> GetChildren() const
                         {
                         std::vector<NxsSimpleNode *> children;
-                        NxsSimpleNode * currNode = GetFirstChild();
-                        while(currNode)
-                                {
-                                children.push_back(currNode);
-                                currNode = currNode->GetNextSib();
-                                }
+                        FillChildren(children);
                         return children;
                         }
-                unsigned GetOutDegree() const {
-                        unsigned n = 0;
-                        NxsSimpleNode * currNode = GetFirstChild();
-                        while(currNode) {
-                                n += 1;
-                                currNode = currNode->GetNextSib();
+                /*! Replaces the contents of `children` with the children of the node (so one vector can be reused) */
+                void FillChildren(std::vector<NxsSimpleNode *> & children) const
+                        {
+                        children.clear();
+                        children.reserve(numChildren);
+                        for (NxsSimpleNode * currNode = lChild; currNode; currNode = currNode->rSib)
+                                children.push_back(currNode);
+                        }
+                /*! \returns the number of children (which is stored, so the children are not counted) */
+                unsigned GetOutDegree() const
+                        {
+                        return numChildren;
                         }
-                        return n;
-                }
                 // present for every leaf. UINT_MAX for internals labeled with taxlabels
                 unsigned GetTaxonIndex() const
                         {
@@ -267,8 +379,10 @@ class NxsSimpleNode
                         :scratch(0L),
                         lChild(0L),
                         rSib(0L),
+                        lastChild(0L),
                         edgeToPar(par, 0L, edgeLen),
-                        taxIndex(UINT_MAX)
+                        taxIndex(UINT_MAX),
+                        numChildren(0)
                         {
                         edgeToPar.child = this;
                         }
@@ -282,8 +396,10 @@ class NxsSimpleNode
                         :scratch(0L),
                         lChild(0L),
                         rSib(0L),
+                        lastChild(0L),
                         edgeToPar(edgeLen, par, 0L),
-                        taxIndex(UINT_MAX)
+                        taxIndex(UINT_MAX),
+                        numChildren(0)
                         {
                         edgeToPar.child = this;
                         }
@@ -293,61 +409,175 @@ class NxsSimpleNode
                         return edgeToPar.GetMutableParent();
                         }
 
+                /*! Adds `n` (and the siblings that follow it) after the last sibling of this node. If this node is in
+                        the list of children of its parent, the parent's last child and number of children are updated.
+                */
                 void AddSib(NxsSimpleNode *n)
                         {
-                        if (rSib)
-                                rSib->AddSib(n);
-                        else
-                                rSib = n;
+                        NxsSimpleNode * last = this;
+                        while (last->rSib)
+                                last = last->rSib;
+                        last->rSib = n;
+                        NxsSimpleNode * par = GetParent();
+                        if (par != 0L && par->lastChild == last)
+                                par->CountAppendedChildren(n);
                         }
+                /*! Makes `n` (and the siblings that follow it) the last children of this node. This takes constant time
+                        when `n` has no next sibling.
+                */
                 void AddChild(NxsSimpleNode *n)
                         {
-                        if (lChild)
-                                lChild->AddSib(n);
+                        if (lastChild)
+                                lastChild->rSib = n;
                         else
                                 lChild = n;
+                        CountAppendedChildren(n);
                         }
 
                 bool RemoveChild(NxsSimpleNode *n)
                         {
                         if (n == 0L || lChild == 0L)
                             return false;
-                        if (lChild == n)
-                                lChild = lChild->rSib;
-                        else
+                        NxsSimpleNode * prev = 0L;
+                        if (lChild != n)
                             {
-                            NxsSimpleNode * c = lChild;
-                                for (;;)
-                                    {
-                                    if (c->rSib == n)
-                                        {
-                                        c->rSib = n->rSib;
-                                        break;
-                                        }
-                                    if (c->rSib == 0L)
-                                        return false;
-                                    }
+                            prev = lChild;
+                            while (prev->rSib != n)
+                                {
+                                if (prev->rSib == 0L)
+                                    return false;
+                                prev = prev->rSib;
+                                }
                             }
+                        if (prev)
+                            prev->rSib = n->rSib;
+                        else
+                            lChild = n->rSib;
+                        if (lastChild == n)
+                            lastChild = prev;
+                        numChildren--;
+                        n->rSib = 0L;
                         n->edgeToPar.parent = 0L;
                         return true;
                         }
                 void AddSelfAndDesToPreorder(std::vector<const NxsSimpleNode *> &p) const;
                 NxsSimpleNode * FindTaxonIndex(unsigned leafIndex);
 
+        /* The low-level setters recount the children of the node whose list of children they change */
         void LowLevelSetFirstChild(NxsSimpleNode *nd) {
             lChild = nd;
+            RecountChildren();
         }
         void LowLevelSetNextSib(NxsSimpleNode *nd) {
             rSib = nd;
+            if (GetParent())
+                GetParent()->RecountChildren();
         }
     private:
+                /* Adds the children from `first` to the end of the sibling list to the count, and updates lastChild */
+                void CountAppendedChildren(NxsSimpleNode * first)
+                        {
+                        for (NxsSimpleNode * c = first; c; c = c->rSib)
+                                {
+                                numChildren++;
+                                lastChild = c;
+                                }
+                        }
+                void RecountChildren()
+                        {
+                        numChildren = 0;
+                        lastChild = 0L;
+                        for (NxsSimpleNode * c = lChild; c; c = c->rSib)
+                                {
+                                numChildren++;
+                                lastChild = c;
+                                }
+                        }
+
                 NxsSimpleNode * lChild;
                 NxsSimpleNode * rSib;
+                NxsSimpleNode * lastChild;
                 NxsSimpleEdge edgeToPar;
                 std::string name; // non-empty only for internals that are labelled with names that are NOT taxLabels
                 unsigned taxIndex; // present for every leaf. UINT_MAX for internals labeled with taxlabels
+                unsigned numChildren;
                 friend class NxsSimpleTree;
         };
+
+inline NxsSimpleChildIterator & NxsSimpleChildIterator::operator++()
+        {
+        curr = curr->GetNextSib();
+        return *this;
+        }
+
+/*! Visits the nodes of a subtree in preorder or postorder without recursion. The walk follows the child, sibling and
+        parent links of the nodes, so it needs no stack and does not allocate memory, and trees of any depth can be
+        walked. For example:
+
+                for (NxsSimpleNodeWalker w(tree.GetRootConst(), NxsSimpleNodeWalker::POSTORDER); w.GetNode() != NULL; w.Next())
+                        visit(w.GetNode());
+
+        The links of the subtree must not be changed during the walk.
+*/
+class NxsSimpleNodeWalker
+        {
+        public:
+                enum WalkOrder
+                        {
+                        PREORDER, /* each node before its descendants, children in order */
+                        POSTORDER /* each node after its descendants, children in order */
+                        };
+                /*! Starts a walk of the subtree of `subRoot` (which may be NULL for an empty walk) */
+                NxsSimpleNodeWalker(const NxsSimpleNode * subRoot, WalkOrder walkOrder)
+                        :top(subRoot),
+                        order(walkOrder),
+                        curr(subRoot)
+                        {
+                        if (curr != NULL && order == POSTORDER)
+                                curr = LeftmostLeaf(curr);
+                        }
+                /*! \returns the current node, or NULL if every node has been visited */
+                const NxsSimpleNode * GetNode() const
+                        {
+                        return curr;
+                        }
+                /*! Moves to the next node, and returns it (or NULL at the end of the walk) */
+                const NxsSimpleNode * Next()
+                        {
+                        if (curr == NULL)
+                                return NULL;
+                        if (order == PREORDER)
+                                {
+                                if (curr->GetFirstChild() != NULL)
+                                        curr = curr->GetFirstChild();
+                                else
+                                        {
+                                        while (curr != top && curr->GetNextSib() == NULL)
+                                                curr = curr->GetParent();
+                                        curr = (curr == top ? NULL : curr->GetNextSib());
+                                        }
+                                }
+                        else if (curr == top)
+                                curr = NULL;
+                        else if (curr->GetNextSib() != NULL)
+                                curr = LeftmostLeaf(curr->GetNextSib());
+                        else
+                                curr = curr->GetParent();
+                        return curr;
+                        }
+        private:
+                static const NxsSimpleNode * LeftmostLeaf(const NxsSimpleNode * nd)
+                        {
+                        while (nd->GetFirstChild() != NULL)
+                                nd = nd->GetFirstChild();
+                        return nd;
+                        }
+
+                const NxsSimpleNode * top;
+                WalkOrder order;
+                const NxsSimpleNode * curr;
+        };
+
 /*! A simple tree class.
         Internally NCL stores trees as newick strings with metadata (see the NxsFullTreeDescription class)
         but you can create a NxsSimpleTree
@@ -361,23 +591,58 @@ class NxsSimpleTree
                                           bool treatInternalNodeLabelsAsStrings=false)
                         :defIntEdgeLen(defaultIntEdgeLen),
                         defDblEdgeLen(defaultDblEdgeLen),
-                        realEdgeLens(false)
+                        realEdgeLens(false),
+                        parseCommentsLazily(false)
                         {
                         Initialize(ftd, treatInternalNodeLabelsAsStrings);
                         }
                 NxsSimpleTree(const int defaultIntEdgeLen, const double defaultDblEdgeLen)
                         :defIntEdgeLen(defaultIntEdgeLen),
                         defDblEdgeLen(defaultDblEdgeLen),
-                        realEdgeLens(false)
+                        realEdgeLens(false),
+                        parseCommentsLazily(false)
                         {}
                 ~NxsSimpleTree()
                         {
                         Clear();
                         }
+                /*! Builds the tree from `td`, replacing the previous tree.
+                        The nodes of the previous tree are reused, so calling Initialize repeatedly on one NxsSimpleTree
+                        does not allocate new nodes unless the new tree is larger than any of the previous ones.
+                */
                 void Initialize(const NxsFullTreeDescription &, bool treatInternalNodeLabelsAsStrings=false);
+                /*! If `v` is true, later calls to Initialize do not copy the comments and edge lengths of the newick
+                        string into the edges. The tree keeps the newick string, and the comments of an edge (including the
+                        NHX key-value pairs) are parsed the first time that GetUnprocessedComments, GetInfo or
+                        WriteAsNewick is called for the edge. This saves time and memory when most of the comments are
+                        never examined.
+
+                        Edges (including copies returned by NxsSimpleNode::GetEdgeToParent) refer to the data of the tree,
+                        so they must not be used after the tree is initialized again or destroyed. Parsing the comments
+                        modifies the edge, so the comment accessors of one edge must not be called from several threads
+                        at once.
+                */
+                void SetParseCommentsLazily(bool v)
+                        {
+                        parseCommentsLazily = v;
+                        }
+                bool GetParseCommentsLazily() const
+                        {
+                        return parseCommentsLazily;
+                        }
 
 
                 std::vector<const NxsSimpleNode *> GetPreorderTraversal() const;
+                /*! Replaces the contents of `nodes` with the nodes of the tree in preorder. Reusing one vector for
+                        many trees avoids the allocations of GetPreorderTraversal.
+                */
+                void FillPreorder(std::vector<const NxsSimpleNode *> & nodes) const;
+                /*! Replaces the contents of `nodes` with the nodes of the tree in postorder */
+                void FillPostorder(std::vector<const NxsSimpleNode *> & nodes) const;
+                /*! Replaces the contents of `nodes` with the nodes of the tree in level order (the root, then its
+                        children, then its grandchildren...)
+                */
+                void FillLevelOrder(std::vector<const NxsSimpleNode *> & nodes) const;
                 std::vector<NxsSimpleNode *> & GetLeavesRef()
                         {
                         return leaves;
@@ -393,25 +658,60 @@ class NxsSimpleTree
                         if (root)
                                 root->WriteAsNewick(out, nhx, useLeafNames, escapeNames, taxa, escapeInternals);
                         }
+                /*! \returns the node with taxon index `taxonIndex` (a leaf, or an internal node that was labelled with
+                        the taxon), or NULL if no node of the tree has that taxon. The lookup table is filled by Initialize
+                        and is still valid after rerooting.
+                */
+                NxsSimpleNode * GetTaxonNode(unsigned taxonIndex) const
+                        {
+                        if (taxonIndex < leaves.size() && leaves[taxonIndex] != NULL)
+                                return leaves[taxonIndex];
+                        if (taxonIndex < internalTaxonNodes.size())
+                                return internalTaxonNodes[taxonIndex];
+                        return NULL;
+                        }
+                /*! Makes the node with taxon index `leafIndex` a child of the root of the tree. The rerooting only
+                        changes the links of the nodes on the path to the old root, and nodes are not allocated or freed, so
+                        rerooting a tree that has been read by Initialize takes time proportional to the length of that path.
+                        \returns the node that is the new child of the root.
+                */
                 NxsSimpleNode * RerootAt(unsigned leafIndex);
-        NxsSimpleNode * RerootAtNode(NxsSimpleNode *newRoot);
+                NxsSimpleNode * RerootAtNode(NxsSimpleNode *newRoot);
 
                 const NxsSimpleNode * GetRootConst() const
                         {
                         return root;
                         }
         protected:
-                std::vector<NxsSimpleNode *> allNodes;
+                std::vector<NxsSimpleNode *> allNodes; /* includes the old roots that were unlinked from the tree by rerooting */
                 std::vector<NxsSimpleNode *> leaves;
+                std::vector<NxsSimpleNode *> internalTaxonNodes; /* internal nodes labelled with a taxon (indexed by taxon) */
+                std::vector<NxsSimpleNode *> rerootPath; /* scratch space for RerootAtNode */
                 NxsSimpleNode * root;
                 int defIntEdgeLen;
                 double defDblEdgeLen;
                 bool realEdgeLens;
+                std::vector<NxsSimpleNode *> recycledNodes; /* nodes from a previous tree that can be reused by AllocNewNode */
+                bool parseCommentsLazily;
+                NxsLazyEdgeData lazyEdgeData; /* newick and comment positions of the current tree (if parseCommentsLazily) */
+
+                void RecordTaxonNode(NxsSimpleNode *nd);
+                void UnlinkRoot();
         public:
                 NxsSimpleNode * AllocNewNode(NxsSimpleNode *p)
                         {
                         NxsSimpleNode * nd;
-                        if (realEdgeLens)
+                        if (!recycledNodes.empty())
+                                {
+                                nd = recycledNodes.back();
+                                recycledNodes.pop_back();
+                                if (realEdgeLens)
+                                        *nd = NxsSimpleNode(p, defDblEdgeLen);
+                                else
+                                        *nd = NxsSimpleNode(defIntEdgeLen, p);
+                                nd->edgeToPar.child = nd;
+                                }
+                        else if (realEdgeLens)
                                 nd = new NxsSimpleNode(p, defDblEdgeLen);
                         else
                                 nd = new NxsSimpleNode(defIntEdgeLen, p);
@@ -424,10 +724,25 @@ class NxsSimpleTree
                         root = NULL;
                         for (std::vector<NxsSimpleNode *>::iterator nIt = allNodes.begin(); nIt != allNodes.end(); ++nIt)
                                 delete *nIt;
+                        for (std::vector<NxsSimpleNode *>::iterator nIt = recycledNodes.begin(); nIt != recycledNodes.end(); ++nIt)
+                                delete *nIt;
+                        allNodes.clear();
+                        recycledNodes.clear();
+                        leaves.clear();
+                        internalTaxonNodes.clear();
+                        }
+                /*! Removes the tree, but keeps its nodes so that AllocNewNode can reuse them. */
+                void ClearAndRecycleNodes()
+                        {
+                        root = NULL;
+                        recycledNodes.insert(recycledNodes.end(), allNodes.begin(), allNodes.end());
                         allNodes.clear();
                         leaves.clear();
+                        internalTaxonNodes.clear();
                         }
                 void FlipRootsChildToRoot(NxsSimpleNode *subRoot);
+                bool InitializeFromNewickBuffer(const std::string & s, bool newickTokenizing, bool NHXComments, bool treatInternalNodeLabelsAsStrings, NxsLazyEdgeData * lazyData);
+                void AttachScannedComments(NxsNewickScanner & scanner, NxsSimpleEdge * edge, std::vector<NxsComment> & ecs, bool NHXComments, NxsLazyEdgeData * lazyData);
                 NxsSimpleTree(const NxsSimpleTree &); //not defined.  Not copyable
                 NxsSimpleTree & operator=(const NxsSimpleTree &); //not defined.  Not copyable
         };
@@ -612,9 +927,31 @@ class NxsFullTreeDescription
                 double minDblEdgeLen; /* if EdgeLengthsAreAllIntegers returns false then this will hold shortest edge length in the tree (useful as means of checking for constraints by programs that prohibit 0 or negative branch lengths)*/
                 bool requireNewickNameTokenizing;  /* False by default. If true, then newick rather than NEXUS tokenizing rules should be used for the taxa names */
         friend class NxsTreesBlock;
+        friend class NxsSnapshotIO;
+        friend class NxsMappedSnapshot;
+        friend class NxsBinaryTreeCollection;
         };
 class NxsTreesBlock;
 typedef bool (* ProcessedTreeValidationFunction)(NxsFullTreeDescription &, void *, NxsTreesBlock *);
+
+/*! Interface for clients that process the trees of a TREES block one at a time, as they are read.
+
+        When a consumer is registered with NxsTreesBlock::SetTreeConsumer, the NxsTreesBlock does not store any
+        trees (GetNumTrees() will return 0 after the block is read). Instead ConsumeTree is called once for every
+        TREE command. The NxsFullTreeDescription (and the NxsSimpleTree, if one was requested) are reused for
+        the next tree, so memory use does not grow with the number of trees in the file. Consumers that need
+        to keep information about a tree must copy it during the call.
+*/
+class NxsTreeConsumer
+        {
+        public:
+                virtual ~NxsTreeConsumer()
+                        {}
+                /*! Called for every tree after it has been read (and processed, if the NxsTreesBlock processes trees).
+                        `tree` is NULL unless the consumer was registered with `buildSimpleTrees` set to true.
+                */
+                virtual void ConsumeTree(const NxsFullTreeDescription & treeDesc, const NxsSimpleTree * tree, NxsTreesBlock & treesBlock) = 0;
+        };
 /*!
         This class handles reading and storage for the NEXUS block TREES.
         The class can  read the TRANSLATE and TREE commands.
@@ -838,9 +1175,12 @@ class NxsTreesBlock
                         treePartitions = other.treePartitions;
                         processedTreeValidationFunction = other.processedTreeValidationFunction;
                         ptvArg = other.ptvArg;
+                        SetTreeConsumer(other.treeConsumer, other.streamingTree != NULL, other.streamingIntEdgeLen, other.streamingDblEdgeLen, other.streamingInternalLabelsAsStrings);
                         treatAsRootedByDefault = other.treatAsRootedByDefault;
                         allowUnquotedSpaces = other.allowUnquotedSpaces;
                         disambiguateDuplicateNames = other.disambiguateDuplicateNames;
+                        acceptSnapshotTreesCommand = other.acceptSnapshotTreesCommand;
+                        snapshotTreesSection = other.snapshotTreesSection;
                         }
         bool GetTreatAsRootedByDefault() const {
             return treatAsRootedByDefault;
@@ -923,11 +1263,52 @@ class NxsTreesBlock
                         this->processedTreeValidationFunction = func;
                         this->ptvArg = blob;
                         }
+                /*! Registers a consumer that is given each tree as it is read. While a consumer is registered the
+                        block does not store trees. \sa NxsTreeConsumer
+
+                        If `buildSimpleTrees` is true then each tree is also converted into a NxsSimpleTree (with
+                        `defaultIntEdgeLen` and `defaultDblEdgeLen` as the lengths of edges that do not have lengths in
+                        the file). The same NxsSimpleTree (and its nodes) is reused for every tree.
+                        Trees are always processed when `buildSimpleTrees` is true.
+
+                        If a validation callback is also registered, then it is called before the consumer, but its
+                        return value is ignored.
+
+                        Pass NULL to go back to storing trees. The caller keeps ownership of `consumer`.
+                */
+                void SetTreeConsumer(NxsTreeConsumer * consumer,
+                                                         bool buildSimpleTrees = false,
+                                                         int defaultIntEdgeLen = 0,
+                                                         double defaultDblEdgeLen = 0.0,
+                                                         bool treatInternalNodeLabelsAsStrings = false);
+                NxsTreeConsumer * GetTreeConsumer() const
+                        {
+                        return this->treeConsumer;
+                        }
                 bool                 SwapEquivalentTaxaBlock(NxsTaxaBlockAPI * tb)
                 {
                         return SurrogateSwapEquivalentTaxaBlock(tb);
                 }
                 void ReadPhylipTreeFile(NxsToken & token);
+                /*! Adds the trees in `collection` to the block (or passes them to the NxsTreeConsumer).
+                        If the block does not have a taxa block yet, it uses the only TAXA block of the reader or (if none has
+                        been read) creates a taxa block with the taxa of the collection. The taxa of the collection are
+                        found in the taxa block by label, so the taxa block may hold them in a different order.
+                */
+                void ReadBinaryTreeCollection(const NxsBinaryTreeCollection & collection);
+                /*! Writes the trees as a binary tree collection (see NxsBinaryTreeCollection) that uses the taxa block
+                        of this block as its taxon table.
+                */
+                void WriteAsBinaryTreeCollection(std::ostream & out, bool shareTopologies = true) const;
+                /*! Writes the newick description of each tree, rerooted so that the taxon with index `outgroupTaxonIndex`
+                        is a child of the root, followed by ";" and a newline. Taxa are written as their labels if
+                        `useLeafNames` is true, and otherwise as numbers (1 + the taxon index), as in processed trees.
+
+                        All of the trees are read into one NxsSimpleTree, so nodes are only allocated for the first trees
+                        and rerooting each tree only relinks the nodes between the outgroup and the root.
+                        Raises an NxsNCLAPIException if a tree does not have the taxon.
+                */
+                void WriteRerootedTrees(std::ostream & out, unsigned outgroupTaxonIndex, bool useLeafNames = true, bool nhx = true) const;
                 void setWriteTranslateTable(bool wtt)
                 {
                         this->writeTranslateTable = wtt;
@@ -966,7 +1347,12 @@ class NxsTreesBlock
                 }
                 void WriteTranslateCommand(std::ostream & out) const;
         protected :
+                NxsFullTreeDescription & StartNewTreeDescription(const std::string & treeName, int treeFlags);
                 void ReadTreeFromOpenParensToken(NxsFullTreeDescription &td, NxsToken & token);
+                static bool ProcessNewickBufferIntoTree(NxsFullTreeDescription & ftd,
+                                                        const NxsLabelToIndicesMapper * taxaMapper,
+                                                        const std::map<std::string, unsigned> & capNameToInd,
+                                                        const bool validateInternalNodeLabels);
 
                 void WriteTreesCommand(std::ostream & out) const;
                 void ConstructDefaultTranslateTable(NxsToken &token, const char * cmd);
@@ -992,12 +1378,22 @@ class NxsTreesBlock
 
                 ProcessedTreeValidationFunction processedTreeValidationFunction;
                 void * ptvArg;
+                NxsTreeConsumer * treeConsumer; /* not owned. NULL unless trees are being streamed */
+                NxsFullTreeDescription streamedTreeDesc; /* reused for every tree when treeConsumer is not NULL */
+                NxsSimpleTree * streamingTree; /* owned. Non-NULL if treeConsumer wants NxsSimpleTree objects */
+                int streamingIntEdgeLen;
+                double streamingDblEdgeLen;
+                bool streamingInternalLabelsAsStrings;
         bool treatAsRootedByDefault; /* true by default */
+                bool acceptSnapshotTreesCommand; /* false by default. Set by NxsSnapshotIO while it reads the NEXUS part of a snapshot */
+                unsigned snapshotTreesSection; /* UINT_MAX unless the trees are waiting to be added from a section of a snapshot */
                 virtual        void                Read(NxsToken &token);
+                void                                WriteBlockAsNexus(std::ostream &out, unsigned treesSnapshotSection) const;
                 void                                HandleTranslateCommand(NxsToken &token);
                 void                                HandleTreeCommand(NxsToken &token, bool rooted);
 
                 friend class PublicNexusReader;
+                friend class NxsSnapshotIO;
         };
 
 typedef NxsTreesBlock TreesBlock;
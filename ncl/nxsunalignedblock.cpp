@@ -389,10 +389,10 @@ void NxsUnalignedBlock::HandleFormat(
                                 {
                                 if (IsInSymbols(to[i]))
                                         {
-                                        errormsg = "The character ";
-                                        errormsg << to[i] << " defined in SYMBOLS is predefined for this DATATYPE and shoud not occur in a SYMBOLS subcommand of a FORMAT command.";
-                                        if (nexusReader)
+                                        if (nexusReader && nexusReader->ShouldReportWarning(NxsReader::SKIPPING_CONTENT_WARNING))
                                                 {
+                                                errormsg = "The character ";
+                                                errormsg << to[i] << " defined in SYMBOLS is predefined for this DATATYPE and shoud not occur in a SYMBOLS subcommand of a FORMAT command.";
                                                 nexusReader->NexusWarnToken(errormsg, NxsReader::SKIPPING_CONTENT_WARNING, token);
                                                 errormsg.clear();
                                                 }
@@ -18,13 +18,14 @@ def runTest(inArgPath,
             invalid=False,
             parseOutput=True,
             extra_args=[],
-            inoutxml=False):
+            inoutxml=False,
+            errorMessage=None):
     if invalid:
         compareOut = False
     if external:
         fileNamePatterns = ["*.dat", "*.phy", "*.fasta", "*.txt", "*.fas", "*.nex", "*.tre", "*.aln"]
     else:
-        fileNamePatterns = ["*.nex", "*.tre" ]
+        fileNamePatterns = ["*.nex", "*.tre", "*.nex.gz", "*.tre.gz", "*.nex.zst", "*.tre.zst"]
     if not os.path.exists(inArgPath):
         sys.exit("input file " + inArgPath + " does not exist")
     if os.path.isdir(inArgPath):
@@ -56,7 +57,12 @@ def runTest(inArgPath,
 
         toCheck = [invokedInFile]
         if compareOut:
-            expectedOut = os.path.join(outParent, f)
+            # compressed inputs are compared to the output for the uncompressed file
+            expectedName = f
+            for suffix in [".gz", ".zst"]:
+                if expectedName.endswith(suffix):
+                    expectedName = expectedName[:-len(suffix)]
+            expectedOut = os.path.join(outParent, expectedName)
             if not copyOutput and not os.path.exists(expectedOut):
                 sys.exit("Expected output file " + expectedOut + " does not exist.")
             if parseOutput:
@@ -90,11 +96,18 @@ def runTest(inArgPath,
             invocation.extend(extra_args)
             invocation.append(inFile)
             sys.stderr.write('"%s"\n' % '" "'.join(invocation))
-            retCode = subprocess.call(invocation, stdout=tFileObj)
+            if errorMessage is None:
+                retCode = subprocess.call(invocation, stdout=tFileObj)
+            else:
+                proc = subprocess.run(invocation, stdout=tFileObj, stderr=subprocess.PIPE, universal_newlines=True)
+                retCode = proc.returncode
+                sys.stderr.write(proc.stderr)
             tFileObj.close()
             if invalid:
                 if retCode == 0:
                     sys.exit("Call to " + normalizer + " accepted the invalid file " + inFile)
+                if errorMessage is not None and errorMessage not in proc.stderr:
+                    sys.exit("Call to " + normalizer + " rejected the invalid file " + inFile + " without the error message \"" + errorMessage + "\"")
             elif retCode != 0:
                 sys.exit("Call to " + normalizer + " failed for "+ inFile)
             if inoutxml:
@@ -175,6 +188,10 @@ parser.add_option("-i", "--invalid",
               default=False,
               action="store_true",
               help="Demand that the parser rejects the file(s) because they are invalid.")
+parser.add_option("-r", "--error-message",
+              dest="errorMessage",
+              default=None,
+              help="With -i, demand that the error reported by the parser contains ERRORMESSAGE.")
 parser.add_option("-o", "--output-invalid",
               dest="parseOutput",
               default=True,
@@ -262,7 +279,8 @@ try:
                 options.invalid,
                 options.parseOutput,
                 extra_args=extra_args,
-                inoutxml=options.y)
+                inoutxml=options.y,
+                errorMessage=options.errorMessage)
 
 except StopIteration:
     if len(inputParentPath) > 0 and inputParentPath != "#":